@@ -4,6 +4,7 @@
 #include "Logging.hpp"
 #include "Model.hpp"
 #include "Parameters.hpp"
+#include "Tracing.hpp"
 #include "Utils.hpp"
 
 #include <imgui.h>
@@ -13,6 +14,11 @@
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
 #if __APPLE__
 constexpr auto GLSL_VERSION = "#version 150";
 #else
@@ -47,6 +53,7 @@ bool ParticleSystemApp::initWindow()
   m_OGLContext = SDL_GL_CreateContext(m_window);
   SDL_GL_MakeCurrent(m_window, m_OGLContext);
   SDL_GL_SetSwapInterval(1); // Enable vsync
+  updateVsync();
 
   // Attempt to fit app to full working space of current window
   int displayIndex = SDL_GetWindowDisplayIndex(m_window);
@@ -88,6 +95,21 @@ bool ParticleSystemApp::initWindow()
   return true;
 }
 
+void ParticleSystemApp::updateVsync()
+{
+  // Vsync may be refused by the driver, asking for the effective swap interval
+  bool isVsyncEnabled = (SDL_GL_GetSwapInterval() != 0);
+
+  int refreshRate = 0;
+  SDL_DisplayMode displayMode;
+  if (SDL_GetWindowDisplayMode(m_window, &displayMode) == 0)
+    refreshRate = displayMode.refresh_rate;
+
+  m_frameScheduler.setVsync(isVsyncEnabled, refreshRate);
+
+  LOG_INFO("Vsync {}, display refresh rate {} Hz", isVsyncEnabled ? "enabled" : "disabled", refreshRate);
+}
+
 bool ParticleSystemApp::closeWindow()
 {
   ImGui_ImplOpenGL3_Shutdown();
@@ -187,7 +209,8 @@ bool ParticleSystemApp::checkSDLStatus()
   return stopRendering;
 }
 
-ParticleSystemApp::ParticleSystemApp()
+ParticleSystemApp::ParticleSystemApp(size_t maxNbParticles, size_t nbOutOfCoreParticles, size_t nbPartitions, size_t nbInstances, int metricsPort,
+    const std::string& metricsFilePath, size_t nbTraceFrames, const std::string& traceFilePath)
     : m_nameApp("RealTimeParticles " + Utils::GetVersions())
     , m_mousePrevPos(0, 0)
     , m_backGroundColor(0.0f, 0.0f, 0.0f, 1.00f)
@@ -195,18 +218,39 @@ ParticleSystemApp::ParticleSystemApp()
     , m_buttonLeftActivated(false)
     , m_windowSize(1280, 720)
     , m_modelType(Physics::ModelType::FLUIDS)
+    , m_maxNbParticles(Utils::GetSupportedMaxNbParticles(maxNbParticles))
+    , m_nbOutOfCoreParticles(nbOutOfCoreParticles)
+    , m_nbPartitions(nbPartitions)
+    , m_nbInstances(nbInstances > 0 ? nbInstances : 1)
     , m_targetFps(60)
+    , m_targetRenderFps(60)
     , m_currFps(60.0f)
+    , m_frameScheduler(60, 60)
+    , m_stepTimeMetric(nullptr)
+    , m_nbStepsMetric(nullptr)
+    , m_nbParticlesMetric(nullptr)
+    , m_nbJacobiItersMetric(nullptr)
+    , m_nbSubstepsMetric(nullptr)
+    , m_deviceMemoryMetric(nullptr)
+    , m_nbTraceFrames(nbTraceFrames > 0 ? (int)nbTraceFrames : 60)
+    , m_traceFilePath(traceFilePath)
     , m_init(false)
 {
   LOG_INFO("Starting RealTimeParticles");
 
+  LOG_INFO("Max number of particles {}, out-of-core particles {}, partitions {}, instances {}", m_maxNbParticles, m_nbOutOfCoreParticles,
+      m_nbPartitions, m_nbInstances);
+
   if (!initWindow())
   {
     LOG_ERROR("Failed to initialize application window");
     return;
   }
 
+  // OpenCL context is shared with the OpenGL one of the window, programs of all the models
+  // are then built in background while the rest of the application is initialized
+  prebuildPhysicsPrograms();
+
   if (!initGraphicsEngine())
   {
     LOG_ERROR("Failed to initialize graphics engine");
@@ -231,40 +275,113 @@ ParticleSystemApp::ParticleSystemApp()
     return;
   }
 
+  if ((metricsPort != 0 || !metricsFilePath.empty()) && !initMetrics(metricsPort, metricsFilePath))
+  {
+    LOG_ERROR("Failed to initialize metrics");
+    return;
+  }
+
   LOG_INFO("RealTimeParticles initialization successful");
 
+  if (nbTraceFrames > 0)
+    Utils::Tracer::Get().requestCapture(nbTraceFrames, m_traceFilePath);
+
   m_init = true;
 }
 
 ParticleSystemApp::~ParticleSystemApp()
 {
   LOG_INFO("Quitting RealTimeParticles");
+
+  m_metrics.stop();
+}
+
+bool ParticleSystemApp::initMetrics(int port, const std::string& filePath)
+{
+  m_stepTimeMetric = &m_metrics.metric("rtp_step_time_ms", Utils::MetricType::GAUGE, "Duration of the last physics step");
+  m_nbStepsMetric = &m_metrics.metric("rtp_steps_total", Utils::MetricType::COUNTER, "Number of physics steps");
+  m_nbParticlesMetric = &m_metrics.metric("rtp_particles", Utils::MetricType::GAUGE, "Number of simulated particles");
+  m_nbJacobiItersMetric = &m_metrics.metric("rtp_solver_jacobi_iterations", Utils::MetricType::GAUGE, "Jacobi iterations of the solver per substep");
+  m_nbSubstepsMetric = &m_metrics.metric("rtp_solver_substeps", Utils::MetricType::GAUGE, "Substeps per physics step");
+  m_deviceMemoryMetric = &m_metrics.metric("rtp_device_memory_bytes", Utils::MetricType::GAUGE, "Device memory used by the current model");
+
+  // Kernel times are read from events once complete, never stalling the device
+  m_physicsEngine->enableKernelTiming(true);
+
+  return m_metrics.start(port, filePath);
+}
+
+void ParticleSystemApp::updateMetrics(float stepTimeMs)
+{
+  if (!m_metrics.isRunning())
+    return;
+
+  m_stepTimeMetric->set(stepTimeMs);
+  m_nbStepsMetric->add(1.0);
+  m_nbParticlesMetric->set((double)m_physicsEngine->nbParticles());
+  m_nbJacobiItersMetric->set((double)m_physicsEngine->getNbJacobiIters());
+  m_nbSubstepsMetric->set((double)m_physicsEngine->getNbSubsteps());
+  m_deviceMemoryMetric->set((double)m_physicsEngine->memoryFootprint());
+
+  for (const auto& kernelTime : m_physicsEngine->kernelTimesMs())
+  {
+    // Registered once, at the first completed run of each kernel
+    Utils::Metric*& kernelTimeMetric = m_kernelTimeMetrics[kernelTime.first];
+    if (kernelTimeMetric == nullptr)
+      kernelTimeMetric = &m_metrics.metric("rtp_kernel_time_ms", Utils::MetricType::GAUGE, "Device time of the last completed run of a kernel",
+          "kernel=\"" + kernelTime.first + "\"");
+
+    kernelTimeMetric->set(kernelTime.second);
+  }
+}
+
+void ParticleSystemApp::resetKernelTimeMetrics()
+{
+  if (!m_metrics.isRunning())
+    return;
+
+  // Kernels of the former model must not be exported anymore, and timings of a warm model are out of date
+  m_metrics.removeMetrics("rtp_kernel_time_ms");
+  m_kernelTimeMetrics.clear();
+
+  m_physicsEngine->enableKernelTiming(false);
+  m_physicsEngine->enableKernelTiming(true);
 }
 
 bool ParticleSystemApp::initGraphicsEngine()
 {
   Render::EngineParams params;
-  params.maxNbParticles = Utils::ALL_NB_PARTICLES.crbegin()->first;
+  params.maxNbParticles = m_maxNbParticles;
   params.boxSize = Geometry::BOX_SIZE_3D;
-  params.gridRes = Geometry::GRID_RES_3D;
   params.aspectRatio = (float)m_windowSize.x / m_windowSize.y;
   params.dimension = (m_graphicsEngine.get() != nullptr) ? m_graphicsEngine->dimension() : Geometry::Dimension::dim2D;
 
   if (m_modelType == Physics::ModelType::CLOUDS)
   {
     params.boxSize.y *= 2;
-    params.gridRes.y *= 2;
   }
   else if (m_modelType == Physics::ModelType::BOIDS)
   {
     params.pointSize = 2;
   }
 
+  params.gridRes = Geometry::ComputeGridRes(params.boxSize, effectRadius(m_modelType));
+
   m_graphicsEngine = std::make_unique<Render::Engine>(params);
 
   return (m_graphicsEngine.get() != nullptr);
 }
 
+float ParticleSystemApp::effectRadius(Physics::ModelType modelType) const
+{
+  // Grid is refined for all the particles of the out-of-core mode, only supported by fluids
+  const bool isOutOfCore = (modelType == Physics::ModelType::FLUIDS) && (m_nbOutOfCoreParticles > m_maxNbParticles);
+  const size_t nbParticles = isOutOfCore ? m_nbOutOfCoreParticles : m_maxNbParticles;
+
+  // Same density of particles in each cell whatever the number of particles
+  return Geometry::REF_EFFECT_RADIUS * std::cbrt((float)Utils::REF_NB_PARTICLES / nbParticles);
+}
+
 bool ParticleSystemApp::initGraphicsWidget()
 {
   m_graphicsWidget = std::make_unique<UI::GraphicsWidget>(m_graphicsEngine.get());
@@ -275,33 +392,73 @@ bool ParticleSystemApp::initGraphicsWidget()
 bool ParticleSystemApp::initPhysicsEngine()
 {
   Physics::ModelParams params;
-  params.maxNbParticles = Utils::ALL_NB_PARTICLES.crbegin()->first;
+  params.maxNbParticles = m_maxNbParticles;
   params.boxSize = Geometry::BOX_SIZE_3D;
-  params.gridRes = Geometry::GRID_RES_3D;
   params.velocity = 1.0f;
   params.particlePosVBO = (unsigned int)m_graphicsEngine->pointCloudCoordVBO();
   params.particleColVBO = (unsigned int)m_graphicsEngine->pointCloudColorVBO();
   params.cameraVBO = (unsigned int)m_graphicsEngine->cameraCoordVBO();
   params.gridVBO = (unsigned int)m_graphicsEngine->gridDetectorVBO();
   params.dimension = m_graphicsEngine->dimension();
+  params.nbOutOfCoreParticles = m_nbOutOfCoreParticles;
+  params.nbPartitions = m_nbPartitions;
+
+  // Ensemble only supported by fluids
+  if (m_modelType == Physics::ModelType::FLUIDS)
+  {
+    params.nbInstances = m_nbInstances;
+  }
 
   if (m_modelType == Physics::ModelType::CLOUDS)
   {
     params.boxSize.y *= 2;
-    params.gridRes.y *= 2;
   }
 
+  params.gridRes = Geometry::ComputeGridRes(params.boxSize, effectRadius(m_modelType));
+
   if (m_physicsEngine)
   {
-    LOG_DEBUG("Physics engine already existing, resetting it");
+    LOG_DEBUG("Physics engine already existing, releasing it");
     m_physicsEngine.reset();
   }
 
   m_physicsEngine = Physics::CreateModel(m_modelType, params);
 
+  if (m_physicsEngine)
+    m_physicsEngine->reportMemoryFootprint();
+
+  m_qualityGovernor.reset();
+
   return (m_physicsEngine.get() != nullptr);
 }
 
+void ParticleSystemApp::prebuildPhysicsPrograms() const
+{
+  // Same grid as the one of initPhysicsEngine, so that models find their programs cached
+  for (const auto& model : Physics::ALL_MODELS)
+  {
+    Physics::ModelParams params;
+    params.maxNbParticles = m_maxNbParticles;
+    params.boxSize = Geometry::BOX_SIZE_3D;
+    params.nbOutOfCoreParticles = m_nbOutOfCoreParticles;
+    params.nbPartitions = m_nbPartitions;
+
+    if (model.first == Physics::ModelType::FLUIDS)
+    {
+      params.nbInstances = m_nbInstances;
+    }
+
+    if (model.first == Physics::ModelType::CLOUDS)
+    {
+      params.boxSize.y *= 2;
+    }
+
+    params.gridRes = Geometry::ComputeGridRes(params.boxSize, effectRadius(model.first));
+
+    Physics::PrebuildModelPrograms(model.first, params);
+  }
+}
+
 bool ParticleSystemApp::initPhysicsWidget()
 {
   m_physicsWidget = std::make_unique<UI::PhysicsWidget>(m_physicsEngine);
@@ -311,69 +468,96 @@ bool ParticleSystemApp::initPhysicsWidget()
 
 void ParticleSystemApp::run()
 {
-  auto start = std::chrono::steady_clock::now();
-
   bool stopRendering = false;
   while (!stopRendering)
   {
-    stopRendering = checkSDLStatus();
+    Utils::Tracer::Get().nextFrame();
 
-    checkMouseState();
+    {
+      TRACE_SCOPE("processEvents");
+      stopRendering = checkSDLStatus();
 
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplSDL2_NewFrame(m_window);
-    ImGui::NewFrame();
+      checkMouseState();
+    }
 
-    static bool noted = false;
-    if (!noted && m_physicsEngine->isUsingIGPU())
+    // Physics engine runs at its own rate, whatever the render rate is
+    m_frameScheduler.setPhysicsRate(m_targetFps);
+    if (m_frameScheduler.isPhysicsStepDue())
     {
-      noted = popUpMessage("Warning", "The application is currently running on your integrated GPU. It will perform better on your dedicated GPU (NVIDIA/AMD).");
+      TRACE_SCOPE("physicsStep");
+
+      const float stepIntervalMs = m_frameScheduler.stats().physicsStepIntervalMs;
+      m_currFps = (stepIntervalMs > 0.0f) ? 1000.0f / stepIntervalMs : m_currFps;
+
+      auto startStep = std::chrono::steady_clock::now();
+
+      m_physicsEngine->update();
+
+      // Update is blocking as GL buffers are released at the end of it, measured time is the full step time
+      float stepTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startStep).count();
+      m_qualityGovernor.setFrameBudget(1000.0f / m_targetFps);
+      m_qualityGovernor.update(*m_physicsEngine, stepTimeMs);
+
+      updateMetrics(stepTimeMs);
+
+      m_graphicsEngine->setNbParticles((int)m_physicsEngine->nbParticles());
+      m_graphicsEngine->setTargetVisibility(m_physicsEngine->isTargetVisible());
+      m_graphicsEngine->setTargetPos(m_physicsEngine->targetPos());
     }
 
-    if (!m_physicsEngine->isInit())
+    m_frameScheduler.setRenderRate(m_targetRenderFps);
+    if (m_frameScheduler.isRenderDue())
     {
-      stopRendering = popUpMessage("Error", "The application needs OpenCL 1.2 or more recent to run.");
-    }
+      TRACE_SCOPE("renderFrame");
 
-    displayMainWidget();
+      ImGui_ImplOpenGL3_NewFrame();
+      ImGui_ImplSDL2_NewFrame(m_window);
+      ImGui::NewFrame();
 
-    m_graphicsWidget->display();
-    m_physicsWidget->display();
+      static bool noted = false;
+      if (!noted && m_physicsEngine->isUsingIGPU())
+      {
+        noted = popUpMessage("Warning", "The application is currently running on your integrated GPU. It will perform better on your dedicated GPU (NVIDIA/AMD).");
+      }
+
+      if (!m_physicsEngine->isInit())
+      {
+        stopRendering = popUpMessage("Error", "The application needs OpenCL 1.2 or more recent to run.");
+      }
+
+      displayMainWidget();
+
+      m_graphicsWidget->display();
+      m_physicsWidget->display();
 
-    ImGuiIO& io = ImGui::GetIO();
+      ImGuiIO& io = ImGui::GetIO();
 
 #ifdef __APPLE__
-    // On Apple, window size is reported in low DPI, even when running in high DPI mode
-    glViewport(0, 0, (int)io.DisplaySize.x * io.DisplayFramebufferScale.x, (int)io.DisplaySize.y * io.DisplayFramebufferScale.y);
+      // On Apple, window size is reported in low DPI, even when running in high DPI mode
+      glViewport(0, 0, (int)io.DisplaySize.x * io.DisplayFramebufferScale.x, (int)io.DisplaySize.y * io.DisplayFramebufferScale.y);
 #else
-    glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+      glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
 #endif
 
-    glClearColor(m_backGroundColor.x, m_backGroundColor.y, m_backGroundColor.z, m_backGroundColor.w);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      glClearColor(m_backGroundColor.x, m_backGroundColor.y, m_backGroundColor.z, m_backGroundColor.w);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Slowing down physics engine if target fps is lower than current fps
-    auto now = std::chrono::steady_clock::now();
-    auto timeSpent = now - start;
-    if (timeSpent > std::chrono::milliseconds(1000 / m_targetFps))
-    {
-      m_currFps = 1000.0f / std::chrono::duration_cast<std::chrono::milliseconds>(timeSpent).count();
+      m_graphicsEngine->draw();
 
-      m_physicsEngine->update();
+      {
+        TRACE_SCOPE("drawUI");
+        ImGui::Render();
 
-      m_graphicsEngine->setNbParticles((int)m_physicsEngine->nbParticles());
-      m_graphicsEngine->setTargetVisibility(m_physicsEngine->isTargetVisible());
-      m_graphicsEngine->setTargetPos(m_physicsEngine->targetPos());
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      }
 
-      start = now;
+      TRACE_SCOPE("swapWindow");
+      SDL_GL_SwapWindow(m_window);
     }
 
-    m_graphicsEngine->draw();
-
-    ImGui::Render();
-
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-    SDL_GL_SwapWindow(m_window);
+    // Idle time is given back to the system, CPU OpenCL runtimes need it
+    TRACE_SCOPE("waitForDeadline");
+    m_frameScheduler.waitForNextDeadline();
   }
 
   closeWindow();
@@ -399,25 +583,43 @@ void ParticleSystemApp::displayMainWidget()
   {
     for (const auto& model : Physics::ALL_MODELS)
     {
-      if (ImGui::Selectable(model.second.c_str(), m_modelType == model.first))
+      if (ImGui::Selectable(model.second.c_str(), m_modelType == model.first) && m_modelType != model.first)
       {
+        // Keeping current model warm with its graphics engine, switching back to it will be instantaneous
+        const Geometry::Dimension dimension = m_graphicsEngine->dimension();
+        m_warmModels[m_modelType] = std::make_pair(std::move(m_graphicsEngine), m_physicsEngine);
+
         m_modelType = model.first;
 
-        if (!initGraphicsEngine())
+        auto warmModel = m_warmModels.find(m_modelType);
+        if (warmModel != m_warmModels.end())
         {
-          LOG_ERROR("Failed to reset graphics engine");
-          return;
-        }
+          m_graphicsEngine = std::move(warmModel->second.first);
+          m_physicsEngine = warmModel->second.second;
+          m_warmModels.erase(warmModel);
 
-        if (!initGraphicsWidget())
+          m_qualityGovernor.reset();
+        }
+        else
         {
-          LOG_ERROR("Failed to reset graphics widget");
-          return;
+          if (!initGraphicsEngine())
+          {
+            LOG_ERROR("Failed to reset graphics engine");
+            return;
+          }
+
+          m_graphicsEngine->setDimension(dimension);
+
+          if (!initPhysicsEngine())
+          {
+            LOG_ERROR("Failed to reset physics engine");
+            return;
+          }
         }
 
-        if (!initPhysicsEngine())
+        if (!initGraphicsWidget())
         {
-          LOG_ERROR("Failed to reset physics engine");
+          LOG_ERROR("Failed to reset graphics widget");
           return;
         }
 
@@ -427,6 +629,8 @@ void ParticleSystemApp::displayMainWidget()
           return;
         }
 
+        resetKernelTimeMetrics();
+
         LOG_INFO("Application correctly switched to {}", Physics::ALL_MODELS.find(m_modelType)->second);
       }
     }
@@ -521,8 +725,31 @@ void ParticleSystemApp::displayMainWidget()
   ImGui::Spacing();
 
   ImGui::SliderInt("Target FPS", &m_targetFps, 1, 60);
+  ImGui::SliderInt("Target Render FPS", &m_targetRenderFps, 1, 144);
+
+  bool isVsyncEnabled = m_frameScheduler.isVsyncEnabled();
+  if (ImGui::Checkbox("Vsync", &isVsyncEnabled))
+  {
+    SDL_GL_SetSwapInterval(isVsyncEnabled ? 1 : 0);
+    updateVsync();
+  }
 
+  const auto& frameStats = m_frameScheduler.stats();
   ImGui::Text(" %.3f ms/frame (%.1f FPS) ", 1000.0f / m_currFps, m_currFps);
+  ImGui::Text(" Render %.3f ms/frame ", frameStats.renderFrameIntervalMs);
+  ImGui::Text(" Missed deadlines: physics %zu | render %zu ", frameStats.nbMissedPhysicsDeadlines, frameStats.nbMissedRenderDeadlines);
+  ImGui::Text(" Device memory %.1f MB, fits up to %zu particles ", m_physicsEngine->memoryFootprint() / (1024.0f * 1024.0f), m_physicsEngine->maxNbParticlesFittingDevice());
+
+  bool isGovernorEnabled = m_qualityGovernor.isEnabled();
+  if (ImGui::Checkbox(" Adapt Quality To Target FPS ", &isGovernorEnabled))
+  {
+    m_qualityGovernor.enable(isGovernorEnabled);
+  }
+
+  if (isGovernorEnabled)
+  {
+    ImGui::Text(" %.3f ms/step (budget %.3f ms) ", m_qualityGovernor.smoothedStepTime(), m_qualityGovernor.frameBudget());
+  }
 
 // Apple is not very OpenCL friendly
 #ifndef __APPLE__
@@ -533,6 +760,19 @@ void ParticleSystemApp::displayMainWidget()
   }
 #endif
 
+  // Timeline of CPU, OpenCL and OpenGL work, to be opened in chrome://tracing or Perfetto
+  Utils::Tracer& tracer = Utils::Tracer::Get();
+  ImGui::InputInt("Traced frames", &m_nbTraceFrames);
+  m_nbTraceFrames = std::max(m_nbTraceFrames, 1);
+  if (tracer.isBusy())
+  {
+    ImGui::Text(" Tracing to %s ", m_traceFilePath.c_str());
+  }
+  else if (ImGui::Button(" Capture Trace "))
+  {
+    tracer.requestCapture((size_t)m_nbTraceFrames, m_traceFilePath);
+  }
+
   ImGui::End();
 }
 
@@ -558,11 +798,45 @@ bool ParticleSystemApp::popUpMessage(const std::string& title, const std::string
 
 } // End namespace App
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
   Utils::InitializeLogger();
 
-  App::ParticleSystemApp app;
+  // Particle buffers size can be raised from command line, e.g. --max-particles 4000000
+  // Fluids bigger than device memory can be streamed through those buffers, e.g. --out-of-core-particles 64000000
+  // Fluids can be decomposed on several devices or NUMA nodes, e.g. --partitions 2
+  // Fluids can be run as an ensemble of instances sharing the same kernel launches, e.g. --instances 4
+  // Metrics of long-running jobs can be scraped on localhost or written to a file, e.g. --metrics-port 9464 --metrics-file rtp.prom
+  // Startup can be traced in Chrome trace format, e.g. --trace-frames 120 --trace-file trace.json
+  size_t maxNbParticles = Utils::REF_NB_PARTICLES;
+  size_t nbOutOfCoreParticles = 0;
+  size_t nbPartitions = 1;
+  size_t nbInstances = 1;
+  int metricsPort = 0;
+  std::string metricsFilePath;
+  size_t nbTraceFrames = 0;
+  std::string traceFilePath = "trace.json";
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--max-particles")
+      maxNbParticles = (size_t)std::strtoull(argv[i + 1], nullptr, 10);
+    else if (std::string(argv[i]) == "--out-of-core-particles")
+      nbOutOfCoreParticles = (size_t)std::strtoull(argv[i + 1], nullptr, 10);
+    else if (std::string(argv[i]) == "--partitions")
+      nbPartitions = (size_t)std::strtoull(argv[i + 1], nullptr, 10);
+    else if (std::string(argv[i]) == "--instances")
+      nbInstances = (size_t)std::strtoull(argv[i + 1], nullptr, 10);
+    else if (std::string(argv[i]) == "--metrics-port")
+      metricsPort = std::atoi(argv[i + 1]);
+    else if (std::string(argv[i]) == "--metrics-file")
+      metricsFilePath = argv[i + 1];
+    else if (std::string(argv[i]) == "--trace-frames")
+      nbTraceFrames = (size_t)std::strtoull(argv[i + 1], nullptr, 10);
+    else if (std::string(argv[i]) == "--trace-file")
+      traceFilePath = argv[i + 1];
+  }
+
+  App::ParticleSystemApp app(maxNbParticles, nbOutOfCoreParticles, nbPartitions, nbInstances, metricsPort, metricsFilePath, nbTraceFrames, traceFilePath);
 
   if (app.isInit())
   {
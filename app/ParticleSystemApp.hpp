@@ -2,20 +2,31 @@
 #pragma once
 
 #include "Engine.hpp"
+#include "FrameScheduler.hpp"
 #include "GraphicsWidget.hpp"
 #include "Math.hpp"
+#include "Metrics.hpp"
 #include "Model.hpp"
 #include "Parameters.hpp"
 #include "PhysicsWidget.hpp"
+#include "QualityGovernor.hpp"
 #include <SDL.h>
 #include <imgui.h>
 
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
 namespace App
 {
 class ParticleSystemApp
 {
   public:
-  ParticleSystemApp();
+  // Metrics are published if a port or a file is given
+  // A trace of the first nbTraceFrames frames is written to traceFilePath if not 0
+  ParticleSystemApp(size_t maxNbParticles = Utils::REF_NB_PARTICLES, size_t nbOutOfCoreParticles = 0, size_t nbPartitions = 1, size_t nbInstances = 1,
+      int metricsPort = 0, const std::string& metricsFilePath = "", size_t nbTraceFrames = 0, const std::string& traceFilePath = "trace.json");
   ~ParticleSystemApp();
   void run();
   bool isInit() const { return m_init; }
@@ -26,7 +37,15 @@ class ParticleSystemApp
   bool initPhysicsEngine();
   bool initPhysicsWidget();
   bool initGraphicsWidget();
+  bool initMetrics(int port, const std::string& filePath);
+  void updateMetrics(float stepTimeMs);
+  // Kernel times of the previous model are dropped when switching models
+  void resetKernelTimeMetrics();
   bool closeWindow();
+  void updateVsync();
+  // Programs of all the models, built in background
+  void prebuildPhysicsPrograms() const;
+  float effectRadius(Physics::ModelType modelType) const;
   bool checkSDLStatus();
   void checkMouseState();
   void displayMainWidget();
@@ -37,6 +56,9 @@ class ParticleSystemApp
   std::unique_ptr<UI::PhysicsWidget> m_physicsWidget;
   std::unique_ptr<UI::GraphicsWidget> m_graphicsWidget;
 
+  // Models not currently selected, kept alive with their graphics engine to switch instantly between them
+  std::map<Physics::ModelType, std::pair<std::unique_ptr<Render::Engine>, std::shared_ptr<Physics::Model>>, Physics::CompareModelType> m_warmModels;
+
   SDL_Window* m_window;
   SDL_GLContext m_OGLContext;
 
@@ -45,13 +67,44 @@ class ParticleSystemApp
   // Type of physics model currently selected
   Physics::ModelType m_modelType;
 
+  // Size of the particle buffers, shared by all models
+  size_t m_maxNbParticles;
+  // Number of particles streamed through device buffers in out-of-core mode, 0 if disabled
+  size_t m_nbOutOfCoreParticles;
+  // Number of device partitions fluids are decomposed on, 1 if disabled
+  size_t m_nbPartitions;
+  // Number of fluids instances of the ensemble mode, 1 if disabled
+  size_t m_nbInstances;
+
   // FPS (Frame per second or framerate)
   // User-defined target framerate
   int m_targetFps;
+  // User-defined target render framerate, limited by display refresh rate if vsync is enabled
+  int m_targetRenderFps;
   // Real framerate
   // can be lower than target depending on the physics simulation cost
   float m_currFps;
 
+  // Paces physics steps and rendering, sleeping in between
+  Utils::FrameScheduler m_frameScheduler;
+
+  // Adapts simulation cost to stay inside the target framerate budget
+  Physics::QualityGovernor m_qualityGovernor;
+
+  // Published from a background thread, metrics below are only stored to from the simulation loop
+  Utils::MetricsExporter m_metrics;
+  Utils::Metric* m_stepTimeMetric;
+  Utils::Metric* m_nbStepsMetric;
+  Utils::Metric* m_nbParticlesMetric;
+  Utils::Metric* m_nbJacobiItersMetric;
+  Utils::Metric* m_nbSubstepsMetric;
+  Utils::Metric* m_deviceMemoryMetric;
+  std::map<std::string, Utils::Metric*> m_kernelTimeMetrics;
+
+  // Window of the traces captured from the UI
+  int m_nbTraceFrames;
+  std::string m_traceFilePath;
+
   Math::int2 m_windowSize;
   Math::int2 m_mousePrevPos;
   ImVec4 m_backGroundColor;
@@ -40,6 +40,34 @@ using namespace Physics;
 #define KERNEL_BOIDS_RULES_GRID_3D "bd_applyBoidsRulesWithGrid3D"
 #define KERNEL_ADD_TARGET_RULE "bd_addTargetRule"
 
+#define MAX_NB_PARTS_IN_CELL 3000
+
+namespace
+{
+// file.cl order matters, define.cl must be first
+const std::vector<std::string> PROGRAM_FILES = { "define.cl", "boids.cl", "utils.cl", "grid.cl" };
+
+std::string ProgramBuildOptions(const Geometry::BoxSize3D& boxSize, const Geometry::BoxSize3D& gridRes, size_t maxNbPartsInCell)
+{
+  assert(boxSize.x / gridRes.x == boxSize.y / gridRes.y);
+  assert(boxSize.z / gridRes.z == boxSize.y / gridRes.y);
+
+  std::ostringstream clBuildOptions;
+  clBuildOptions << "-DEFFECT_RADIUS_SQUARED=" << Utils::FloatToStr(1.0f * boxSize.x * boxSize.x / (gridRes.x * gridRes.x));
+  clBuildOptions << " -DABS_WALL_X=" << Utils::FloatToStr(boxSize.x / 2.0f);
+  clBuildOptions << " -DABS_WALL_Y=" << Utils::FloatToStr(boxSize.y / 2.0f);
+  clBuildOptions << " -DABS_WALL_Z=" << Utils::FloatToStr(boxSize.z / 2.0f);
+  clBuildOptions << " -DGRID_RES_X=" << gridRes.x;
+  clBuildOptions << " -DGRID_RES_Y=" << gridRes.y;
+  clBuildOptions << " -DGRID_RES_Z=" << gridRes.z;
+  clBuildOptions << " -DGRID_CELL_SIZE_XYZ=" << Utils::FloatToStr((float)boxSize.x / gridRes.x);
+  clBuildOptions << " -DGRID_NUM_CELLS=" << gridRes.x * gridRes.y * gridRes.z;
+  clBuildOptions << " -DNUM_MAX_PARTS_IN_CELL=" << maxNbPartsInCell;
+
+  return clBuildOptions.str();
+}
+}
+
 Boids::Boids(ModelParams params)
     : Model(params)
     , m_scaleAlignment(1.6f)
@@ -48,9 +76,11 @@ Boids::Boids(ModelParams params)
     , m_activeAlignment(true)
     , m_activeSeparation(true)
     , m_activeCohesion(true)
+    , m_areParamsDirty(true)
+    , m_boidsParams()
     , m_simplifiedMode(true)
-    , m_maxNbPartsInCell(3000)
-    , m_radixSort(params.maxNbParticles)
+    , m_maxNbPartsInCell(MAX_NB_PARTS_IN_CELL)
+    , m_radixSort(clNamespace(), params.maxNbParticles)
     , m_target(params.boxSize.x)
 {
   m_currNbParticles = Utils::NbParticles::P512;
@@ -61,6 +91,8 @@ Boids::Boids(ModelParams params)
 
   createKernels();
 
+  m_statistics = std::make_unique<Statistics>(clNamespace(), "p_vel");
+
   m_init = true;
 
   reset();
@@ -69,41 +101,38 @@ Boids::Boids(ModelParams params)
 // Must be defined on implementation side to have RadixSort complete
 Boids::~Boids() {};
 
+void Boids::PrebuildPrograms(const ModelParams& params)
+{
+  CL::Context::Get().prebuildProgram(PROGRAM_FILES, ProgramBuildOptions(params.boxSize, params.gridRes, MAX_NB_PARTS_IN_CELL));
+}
+
 bool Boids::createProgram() const
 {
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
-  assert(m_boxSize.x / m_gridRes.x == m_boxSize.y / m_gridRes.y);
-  assert(m_boxSize.z / m_gridRes.z == m_boxSize.y / m_gridRes.y);
+  const std::string clBuildOptions = ProgramBuildOptions(m_boxSize, m_gridRes, m_maxNbPartsInCell);
+  LOG_INFO(clBuildOptions);
 
-  std::ostringstream clBuildOptions;
-  clBuildOptions << "-DEFFECT_RADIUS_SQUARED=" << Utils::FloatToStr(1.0f * m_boxSize.x * m_boxSize.x / (m_gridRes.x * m_gridRes.x));
-  clBuildOptions << " -DABS_WALL_X=" << Utils::FloatToStr(m_boxSize.x / 2.0f);
-  clBuildOptions << " -DABS_WALL_Y=" << Utils::FloatToStr(m_boxSize.y / 2.0f);
-  clBuildOptions << " -DABS_WALL_Z=" << Utils::FloatToStr(m_boxSize.z / 2.0f);
-  clBuildOptions << " -DGRID_RES_X=" << m_gridRes.x;
-  clBuildOptions << " -DGRID_RES_Y=" << m_gridRes.y;
-  clBuildOptions << " -DGRID_RES_Z=" << m_gridRes.z;
-  clBuildOptions << " -DGRID_CELL_SIZE_XYZ=" << Utils::FloatToStr((float)m_boxSize.x / m_gridRes.x);
-  clBuildOptions << " -DGRID_NUM_CELLS=" << m_nbCells;
-  clBuildOptions << " -DNUM_MAX_PARTS_IN_CELL=" << m_maxNbPartsInCell;
-
-  LOG_INFO(clBuildOptions.str());
-  // file.cl order matters, define.cl must be first
-  clContext.createProgram(PROGRAM_BOIDS, std::vector<std::string>({ "define.cl", "boids.cl", "utils.cl", "grid.cl" }), clBuildOptions.str());
+  clContext.createProgram(PROGRAM_BOIDS, PROGRAM_FILES, clBuildOptions);
 
   return true;
 }
 
 bool Boids::createBuffers() const
 {
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   clContext.createGLBuffer("u_cameraPos", m_cameraVBO, CL_MEM_READ_ONLY);
   clContext.createGLBuffer("p_pos", m_particlePosVBO, CL_MEM_READ_WRITE);
   clContext.createGLBuffer("p_col", m_particleColVBO, CL_MEM_READ_WRITE);
   clContext.createGLBuffer("c_partDetector", m_gridVBO, CL_MEM_READ_WRITE);
 
+  // Non GL buffers are carved from a single device allocation
+  clContext.beginArena("BoidsArena");
+
+  // Parameters read from constant memory, written once per step when changed
+  clContext.createBuffer("u_boidsParams", 8 * sizeof(float), CL_MEM_READ_ONLY);
+
   clContext.createBuffer("p_vel", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_acc", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_cellID", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
@@ -111,12 +140,12 @@ bool Boids::createBuffers() const
 
   clContext.createBuffer("c_startEndPartID", 2 * m_nbCells * sizeof(unsigned int), CL_MEM_READ_WRITE);
 
-  return true;
+  return clContext.endArena();
 }
 
 bool Boids::createKernels() const
 {
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   // Init only
   clContext.createKernel(PROGRAM_BOIDS, KERNEL_INFINITE_POS, { "p_pos" });
@@ -140,10 +169,10 @@ bool Boids::createKernels() const
   clContext.createKernel(PROGRAM_BOIDS, KERNEL_RESET_START_END_CELL, { "c_startEndPartID" });
   clContext.createKernel(PROGRAM_BOIDS, KERNEL_FILL_START_CELL, { "p_cellID", "c_startEndPartID" });
   clContext.createKernel(PROGRAM_BOIDS, KERNEL_FILL_END_CELL, { "p_cellID", "c_startEndPartID" });
-  clContext.createKernel(PROGRAM_BOIDS, KERNEL_ADJUST_END_CELL, { "c_startEndPartID" });
+  clContext.createKernel(PROGRAM_BOIDS, KERNEL_ADJUST_END_CELL, { "", "c_startEndPartID" });
 
-  clContext.createKernel(PROGRAM_BOIDS, KERNEL_BOIDS_RULES_GRID_2D, { "p_pos", "p_vel", "c_startEndPartID", "", "p_acc" });
-  clContext.createKernel(PROGRAM_BOIDS, KERNEL_BOIDS_RULES_GRID_3D, { "p_pos", "p_vel", "c_startEndPartID", "", "p_acc" });
+  clContext.createKernel(PROGRAM_BOIDS, KERNEL_BOIDS_RULES_GRID_2D, { "p_pos", "p_vel", "c_startEndPartID", "u_boidsParams", "p_acc" });
+  clContext.createKernel(PROGRAM_BOIDS, KERNEL_BOIDS_RULES_GRID_3D, { "p_pos", "p_vel", "c_startEndPartID", "u_boidsParams", "p_acc" });
 
   clContext.createKernel(PROGRAM_BOIDS, KERNEL_ADD_TARGET_RULE, { "p_pos", "", "", "", "p_acc" });
 
@@ -152,19 +181,26 @@ bool Boids::createKernels() const
 
 void Boids::updateBoidsParamsInKernel()
 {
-  CL::Context& clContext = CL::Context::Get();
+  if (!m_init || !m_areParamsDirty)
+    return;
+
+  m_areParamsDirty = false;
+
+  CL::Context& clContext = getCLContext();
 
   float vel = m_velocity;
   clContext.setKernelArg(KERNEL_UPDATE_VEL, 2, sizeof(float), &vel);
 
-  std::array<float, 8> boidsParams;
-  boidsParams[0] = m_velocity;
-  boidsParams[1] = m_activeCohesion ? m_scaleCohesion : 0.0f;
-  boidsParams[2] = m_activeAlignment ? m_scaleAlignment : 0.0f;
-  boidsParams[3] = m_activeSeparation ? m_scaleSeparation : 0.0f;
-  boidsParams[4] = isTargetActivated() ? 1.0f : 0.0f;
-  clContext.setKernelArg(KERNEL_BOIDS_RULES_GRID_2D, 3, sizeof(boidsParams), &boidsParams);
-  clContext.setKernelArg(KERNEL_BOIDS_RULES_GRID_3D, 3, sizeof(boidsParams), &boidsParams);
+  m_boidsParams[0] = m_velocity;
+  m_boidsParams[1] = m_activeCohesion ? m_scaleCohesion : 0.0f;
+  m_boidsParams[2] = m_activeAlignment ? m_scaleAlignment : 0.0f;
+  m_boidsParams[3] = m_activeSeparation ? m_scaleSeparation : 0.0f;
+  m_boidsParams[4] = isTargetActivated() ? 1.0f : 0.0f;
+  // Enqueued before the kernels of the step, finished with them before parameters can be changed again
+  clContext.loadBufferFromHost("u_boidsParams", 0, sizeof(m_boidsParams), m_boidsParams.data(), false);
+
+  cl_uint maxNbPartsInCell = (cl_uint)m_maxNbPartsInCell;
+  clContext.setKernelArg(KERNEL_ADJUST_END_CELL, 0, sizeof(cl_uint), &maxNbPartsInCell);
 
   if (isTargetActivated())
   {
@@ -180,9 +216,11 @@ void Boids::reset()
   if (!m_init)
     return;
 
+  // Dimension may have changed
+  m_areParamsDirty = true;
   updateBoidsParamsInKernel();
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   initBoidsParticles();
 
@@ -206,7 +244,7 @@ void Boids::initBoidsParticles()
     return;
   }
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   clContext.acquireGLBuffers({ "p_pos" });
 
@@ -214,7 +252,7 @@ void Boids::initBoidsParticles()
 
   if (m_dimension == Geometry::Dimension::dim2D)
   {
-    const auto& subdiv2D = Utils::GetNbParticlesSubdiv2D((Utils::NbParticles)m_currNbParticles);
+    const auto& subdiv2D = Utils::GetNbParticlesSubdiv2D(m_currNbParticles);
     Math::int2 grid2DRes = { subdiv2D[0], subdiv2D[1] };
     Math::float3 start2D = { 0.0f, m_boxSize.y / -6.0f, m_boxSize.z / -6.0f };
     Math::float3 end2D = { 0.0f, m_boxSize.y / 6.0f, m_boxSize.z / 6.0f };
@@ -223,7 +261,7 @@ void Boids::initBoidsParticles()
   }
   else if (m_dimension == Geometry::Dimension::dim3D)
   {
-    const auto& subdiv3D = Utils::GetNbParticlesSubdiv3D((Utils::NbParticles)m_currNbParticles);
+    const auto& subdiv3D = Utils::GetNbParticlesSubdiv3D(m_currNbParticles);
     Math::int3 grid3DRes = { subdiv3D[0], subdiv3D[1], subdiv3D[2] };
     Math::float3 start3D = { m_boxSize.x / -6.0f, m_boxSize.y / -6.0f, m_boxSize.z / -6.0f };
     Math::float3 end3D = { m_boxSize.x / 6.0f, m_boxSize.y / 6.0f, m_boxSize.z / 6.0f };
@@ -249,7 +287,10 @@ void Boids::update()
   if (!m_init)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
+
+  // Parameters changed since the last step are written at once
+  updateBoidsParamsInKernel();
 
   clContext.acquireGLBuffers({ "p_pos", "p_col", "c_partDetector", "u_cameraPos" });
 
@@ -296,6 +337,8 @@ void Boids::update()
       break;
     }
 
+    m_statistics->record(m_currNbParticles);
+
     clContext.runKernel(KERNEL_RESET_PART_DETECTOR, m_nbCells);
     clContext.runKernel(KERNEL_FILL_PART_DETECTOR, m_currNbParticles);
   }
@@ -19,24 +19,27 @@ class Boids : public Model
   void update() override;
   void reset() override;
 
+  // Build programs in background before the model is created
+  static void PrebuildPrograms(const ModelParams& params);
+
   //
   void setVelocity(float velocity) override
   {
     m_velocity = velocity;
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
 
   void setScaleAlignment(float alignment)
   {
     m_scaleAlignment = alignment;
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   float scaleAlignment() const { return m_scaleAlignment; }
 
   void activateAlignment(bool alignment)
   {
     m_activeAlignment = alignment;
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   bool isAlignmentActivated() const { return m_activeAlignment; }
 
@@ -45,14 +48,14 @@ class Boids : public Model
   void setScaleCohesion(float cohesion)
   {
     m_scaleCohesion = cohesion;
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   float scaleCohesion() const { return m_scaleCohesion; }
 
   void activateCohesion(bool cohesion)
   {
     m_activeCohesion = cohesion;
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   bool isCohesionActivated() const { return m_activeCohesion; }
 
@@ -61,14 +64,14 @@ class Boids : public Model
   void setScaleSeparation(float separation)
   {
     m_scaleSeparation = separation;
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   float scaleSeparation() const { return m_scaleSeparation; }
 
   void activateSeparation(bool separation)
   {
     m_activeSeparation = separation;
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   bool isSeparationActivated() const { return m_activeSeparation; }
 
@@ -81,7 +84,7 @@ class Boids : public Model
   void activateTarget(bool isActive)
   {
     m_target.activate(isActive);
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   bool isTargetActivated() const override { return m_target.isActivated(); }
 
@@ -94,14 +97,14 @@ class Boids : public Model
   void setTargetRadiusEffect(float radiusEffect)
   {
     m_target.setRadiusEffect(radiusEffect);
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   float targetRadiusEffect() const { return m_target.radiusEffect(); }
 
   void setTargetSignEffect(int signEffect)
   {
     m_target.setSignEffect(signEffect);
-    updateBoidsParamsInKernel();
+    m_areParamsDirty = true;
   }
   int targetSignEffect() const { return m_target.signEffect(); }
 
@@ -110,6 +113,7 @@ class Boids : public Model
   bool createProgram() const;
   bool createBuffers() const;
   bool createKernels() const;
+  // Write parameters to the constant buffer if changed since the last step
   void updateBoidsParamsInKernel();
   void updateGridParamsInKernel();
 
@@ -121,6 +125,11 @@ class Boids : public Model
   float m_scaleCohesion;
   float m_scaleSeparation;
 
+  // Setters only flag parameters, written once at the start of the next step
+  bool m_areParamsDirty;
+  // Source of the non blocking write, must outlive it
+  std::array<float, 8> m_boidsParams;
+
   bool m_simplifiedMode;
   size_t m_maxNbPartsInCell;
 
@@ -25,7 +25,9 @@ using namespace Physics;
 #define KERNEL_INFINITE_POS "infPosVerts"
 #define KERNEL_RESET_CAMERA_DIST "resetCameraDist"
 #define KERNEL_FILL_CAMERA_DIST "fillCameraDist"
+#define KERNEL_RESET_FLOAT "resetFloat"
 #define KERNEL_FILL_COLOR "fillColorFloat"
+#define KERNEL_FILL_COLOR_PACKED "fillColorFloat4"
 
 // grid.cl
 #define KERNEL_RESET_PART_DETECTOR "resetGridDetector"
@@ -38,15 +40,9 @@ using namespace Physics;
 #define KERNEL_ADJUST_END_CELL "adjustEndCell"
 
 // clouds.cl
-#define KERNEL_INIT_TEMP "cld_initTemperature"
-#define KERNEL_INIT_VAPOR_DENSITY "cld_initVaporDensity"
+#define KERNEL_INIT_THERMODYNAMICS "cld_initThermodynamics"
 #define KERNEL_RANDOM_POS "cld_randPosVertsClouds"
-#define KERNEL_HEAT_GROUND "cld_heatFromGround"
-#define KERNEL_BUOYANCY "cld_computeBuoyancy"
-#define KERNEL_ADIABATIC_COOLING "cld_applyAdiabaticCooling"
-#define KERNEL_CLOUD_GENERATION "cld_generateCloud"
-#define KERNEL_PHASE_TRANSITION "cld_applyPhaseTransition"
-#define KERNEL_LATENT_HEAT "cld_applyLatentHeat"
+#define KERNEL_UPDATE_THERMODYNAMICS "cld_updateThermodynamics"
 #define KERNEL_PREDICT_POS "cld_predictPosition"
 #define KERNEL_UPDATE_POS "cld_updatePosition"
 #define KERNEL_UPDATE_VEL "cld_updateVel"
@@ -64,6 +60,10 @@ using namespace Physics;
 #define KERNEL_CONSTRAINT_FACTOR_TEMP "cld_computeConstraintFactorTemp"
 #define KERNEL_CONSTRAINT_CORRECTION_TEMP "cld_computeConstraintCorrectionTemp"
 #define KERNEL_CORRECT_TEMP "cld_correctTemperature"
+//
+#define KERNEL_SPLAT_TEMP_TO_GRID "cld_splatTempToGrid"
+#define KERNEL_SMOOTH_TEMP_ON_GRID "cld_smoothTempOnGrid"
+#define KERNEL_GATHER_TEMP_FROM_GRID "cld_gatherTempFromGrid"
 
 namespace Physics
 {
@@ -83,6 +83,9 @@ struct FluidKernelInputs
   cl_uint isVorticityConfEnabled = 1;
   cl_float vorticityConfCoeff = 0.0004f;
   cl_float xsphViscosityCoeff = 0.0001f;
+  // Sleeping particles and unilateral constraint are only supported by Fluids, kept for the layout of FluidParams
+  cl_uint isSleepingEnabled = 0;
+  cl_uint isUnilateralEnabled = 0;
 };
 
 // Clouds params for clouds-specific physics
@@ -124,15 +127,56 @@ const std::map<Clouds::CaseType, std::string, Clouds::CompareCaseType> Clouds::A
 };
 }
 
+namespace
+{
+// file.cl order matters
+// 1/ define.cl must be first as it defines variables used by other kernels
+// 2/ fluids.cl contains Position Based Fluids algorithms needed for the fluids part of the cloud sim
+// 3/ clouds.cl contains Clouds-specific physics and constraint on temperature field, it needs PBF framework
+const std::vector<std::string> PROGRAM_FILES = { "define.cl", "sph.cl", "clouds.cl", "grid.cl", "utils.cl" };
+
+std::string ProgramBuildOptions(const Geometry::BoxSize3D& boxSize, const Geometry::BoxSize3D& gridRes)
+{
+  assert(boxSize.x / gridRes.x == boxSize.y / gridRes.y);
+  assert(boxSize.z / gridRes.z == boxSize.y / gridRes.y);
+
+  float effectRadius = ((float)boxSize.x) / gridRes.x;
+
+  std::ostringstream clBuildOptions;
+  clBuildOptions << "-DEFFECT_RADIUS=" << Utils::FloatToStr(effectRadius);
+  clBuildOptions << " -DABS_WALL_X=" << Utils::FloatToStr(boxSize.x / 2.0f);
+  clBuildOptions << " -DABS_WALL_Y=" << Utils::FloatToStr(boxSize.y / 2.0f);
+  clBuildOptions << " -DABS_WALL_Z=" << Utils::FloatToStr(boxSize.z / 2.0f);
+  clBuildOptions << " -DGRID_RES_X=" << gridRes.x;
+  clBuildOptions << " -DGRID_RES_Y=" << gridRes.y;
+  clBuildOptions << " -DGRID_RES_Z=" << gridRes.z;
+  clBuildOptions << " -DGRID_CELL_SIZE_XYZ=" << Utils::FloatToStr((float)boxSize.x / gridRes.x);
+  clBuildOptions << " -DGRID_NUM_CELLS=" << gridRes.x * gridRes.y * gridRes.z;
+  clBuildOptions << " -DPOLY6_COEFF=" << Utils::FloatToStr(315.0f / (64.0f * Math::PI_F * std::pow(effectRadius, 9.f)));
+  clBuildOptions << " -DSPIKY_COEFF=" << Utils::FloatToStr(15.0f / (Math::PI_F * std::pow(effectRadius, 6.f)));
+  clBuildOptions << " -DMAX_VEL=" << Utils::FloatToStr(30.0f);
+
+  return clBuildOptions.str();
+}
+}
+
 Clouds::Clouds(ModelParams params)
     : Model(params)
     , m_simplifiedMode(true)
     , m_maxNbPartsInCell(100)
-    , m_radixSort(params.maxNbParticles)
+    , m_radixSort(clNamespace(), params.maxNbParticles)
     , m_fluidKernelInputs(std::make_unique<FluidKernelInputs>())
     , m_cloudKernelInputs(std::make_unique<CloudKernelInputs>())
+    , m_stepFluidKernelInputs(std::make_unique<FluidKernelInputs>())
+    , m_stepCloudKernelInputs(std::make_unique<CloudKernelInputs>())
+    , m_areFluidParamsDirty(true)
+    , m_areCloudParamsDirty(true)
     , m_initialCase(CaseType::CUMULUS)
     , m_nbJacobiIters(1)
+    , m_nbSubsteps(1)
+    , m_isTempSmoothingOnGrid(false)
+    , m_nbTempGridIters(4)
+    , m_isWarmStartEnabled(false)
 {
   createProgram();
 
@@ -140,6 +184,8 @@ Clouds::Clouds(ModelParams params)
 
   createKernels();
 
+  m_statistics = std::make_unique<Statistics>(clNamespace(), "p_vel", "p_density", "p_thermo");
+
   m_init = (m_fluidKernelInputs && m_cloudKernelInputs && !m_allDisplayableQuantities.empty());
 
   reset();
@@ -148,89 +194,82 @@ Clouds::Clouds(ModelParams params)
 // Must be on implementation side as FluidKernelInputs must be complete
 Clouds::~Clouds() {};
 
-bool Clouds::createProgram() const
+void Clouds::PrebuildPrograms(const ModelParams& params)
 {
-  CL::Context& clContext = CL::Context::Get();
-
-  assert(m_boxSize.x / m_gridRes.x == m_boxSize.y / m_gridRes.y);
-  assert(m_boxSize.z / m_gridRes.z == m_boxSize.y / m_gridRes.y);
+  CL::Context::Get().prebuildProgram(PROGRAM_FILES, ProgramBuildOptions(params.boxSize, params.gridRes));
+}
 
-  float effectRadius = ((float)m_boxSize.x) / m_gridRes.x;
+bool Clouds::createProgram() const
+{
+  CL::Context& clContext = getCLContext();
 
-  std::ostringstream clBuildOptions;
-  clBuildOptions << "-DEFFECT_RADIUS=" << Utils::FloatToStr(effectRadius);
-  clBuildOptions << " -DABS_WALL_X=" << Utils::FloatToStr(m_boxSize.x / 2.0f);
-  clBuildOptions << " -DABS_WALL_Y=" << Utils::FloatToStr(m_boxSize.y / 2.0f);
-  clBuildOptions << " -DABS_WALL_Z=" << Utils::FloatToStr(m_boxSize.z / 2.0f);
-  clBuildOptions << " -DGRID_RES_X=" << m_gridRes.x;
-  clBuildOptions << " -DGRID_RES_Y=" << m_gridRes.y;
-  clBuildOptions << " -DGRID_RES_Z=" << m_gridRes.z;
-  clBuildOptions << " -DGRID_CELL_SIZE_XYZ=" << Utils::FloatToStr((float)m_boxSize.x / m_gridRes.x);
-  clBuildOptions << " -DGRID_NUM_CELLS=" << m_nbCells;
-  clBuildOptions << " -DNUM_MAX_PARTS_IN_CELL=" << m_maxNbPartsInCell;
-  clBuildOptions << " -DPOLY6_COEFF=" << Utils::FloatToStr(315.0f / (64.0f * Math::PI_F * std::pow(effectRadius, 9.f)));
-  clBuildOptions << " -DSPIKY_COEFF=" << Utils::FloatToStr(15.0f / (Math::PI_F * std::pow(effectRadius, 6.f)));
-  clBuildOptions << " -DMAX_VEL=" << Utils::FloatToStr(30.0f);
+  const std::string clBuildOptions = ProgramBuildOptions(m_boxSize, m_gridRes);
+  LOG_INFO(clBuildOptions);
 
-  LOG_INFO(clBuildOptions.str());
-  // file.cl order matters
-  // 1/ define.cl must be first as it defines variables used by other kernels
-  // 2/ fluids.cl contains Position Based Fluids algorithms needed for the fluids part of the cloud sim
-  // 3/ clouds.cl contains Clouds-specific physics and constraint on temperature field, it needs PBF framework
-  clContext.createProgram(PROGRAM_CLOUDS, std::vector<std::string>({ "define.cl", "sph.cl", "clouds.cl", "grid.cl", "utils.cl" }), clBuildOptions.str());
+  clContext.createProgram(PROGRAM_CLOUDS, PROGRAM_FILES, clBuildOptions);
 
   return true;
 }
 
 bool Clouds::createBuffers()
 {
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   clContext.createGLBuffer("u_cameraPos", m_cameraVBO, CL_MEM_READ_ONLY);
   clContext.createGLBuffer("p_pos", m_particlePosVBO, CL_MEM_READ_WRITE);
   clContext.createGLBuffer("p_col", m_particleColVBO, CL_MEM_READ_WRITE);
   clContext.createGLBuffer("c_partDetector", m_gridVBO, CL_MEM_READ_WRITE);
 
+  // Non GL buffers are carved from a single device allocation
+  // Corrections, vorticity and viscosity input are scratch buffers used one after the other within a step, they share memory
+  clContext.beginArena("CloudsArena");
+
+  // Parameters read from constant memory, written once per step when changed
+  clContext.createBuffer("u_fluidParams", sizeof(FluidKernelInputs), CL_MEM_READ_ONLY);
+  clContext.createBuffer("u_cloudParams", sizeof(CloudKernelInputs), CL_MEM_READ_ONLY);
+
   clContext.createBuffer("p_partID", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
 
   // Position Based Fluids
   clContext.createBuffer("p_density", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_predPos", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_totCorrPos", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_corrPos", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+  clContext.createBuffer("p_corrPos", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE, "Float4Scratch");
   clContext.createBuffer("p_constFactorFld", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_vel", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_velInViscosity", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_vort", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+  clContext.createBuffer("p_velInViscosity", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE, "Float4Scratch");
+  clContext.createBuffer("p_vort", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE, "Float4Scratch");
   clContext.createBuffer("p_cellID", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_cameraDist", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
 
   // Clouds specific
-  // Some buffers are duplicated because they are both input/output of some kernels
-  clContext.createBuffer("p_temp", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_tempIn", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+  // Thermodynamic state packed as (temperature, vapor density, cloud density, buoyancy)
+  clContext.createBuffer("p_thermo", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+  // Temperature constraint solver
   clContext.createBuffer("p_laplacianTemp", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_corrTemp", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_constFactorTemp", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_vaporDens", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_vaporDensIn", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_cloudDens", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_cloudDensIn", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_buoyancy", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_cloudGen", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
 
   clContext.createBuffer("c_startEndPartID", 2 * m_nbCells * sizeof(unsigned int), CL_MEM_READ_WRITE);
 
-  // Physical parameters displayable in UI, only m_maxNbParts * sizeof(float) size supported for now
+  // Temperature field on the grid, used by grid based temperature smoothing
+  clContext.createBuffer("c_tempInit", 2 * m_nbCells * sizeof(float), CL_MEM_READ_WRITE);
+  clContext.createBuffer("c_tempA", 2 * m_nbCells * sizeof(float), CL_MEM_READ_WRITE);
+  clContext.createBuffer("c_tempB", 2 * m_nbCells * sizeof(float), CL_MEM_READ_WRITE);
+
+  if (!clContext.endArena())
+    return false;
+
+  // Physical parameters displayable in UI, either float buffers or one component of a packed float4 buffer
   PhysicalQuantity partID { "Particle ID", "p_partID", { 0.0f, (float)(m_maxNbParticles - 1) }, { 0.0f, (float)(32000 - 1) } };
   m_allDisplayableQuantities.insert(std::make_pair(partID.name, partID));
-  PhysicalQuantity vaporDens { "Vapor Density", "p_vaporDens", { 0.0f, 100.0f }, { 0.001f, 100.0f } };
+  PhysicalQuantity vaporDens { "Vapor Density", "p_thermo", { 0.0f, 100.0f }, { 0.001f, 100.0f }, 1 };
   m_allDisplayableQuantities.insert(std::make_pair(vaporDens.name, vaporDens));
-  PhysicalQuantity cloudDens { "Cloud Density", "p_cloudDens", { 0.0f, 100.0f }, { 1.0f, 15.0f } };
+  PhysicalQuantity cloudDens { "Cloud Density", "p_thermo", { 0.0f, 100.0f }, { 1.0f, 15.0f }, 2 };
   m_allDisplayableQuantities.insert(std::make_pair(cloudDens.name, cloudDens));
-  PhysicalQuantity netForce { "Net Force", "p_buoyancy", { -10.0f, 10.0f }, { -1.0f, 1.0f } };
+  PhysicalQuantity netForce { "Net Force", "p_thermo", { -10.0f, 10.0f }, { -1.0f, 1.0f }, 3 };
   m_allDisplayableQuantities.insert(std::make_pair(netForce.name, netForce));
-  PhysicalQuantity temp { "Temperature", "p_temp", { 0.0f, 500.0f }, { 223.0f, 293.0f } };
+  PhysicalQuantity temp { "Temperature", "p_thermo", { 0.0f, 500.0f }, { 223.0f, 293.0f }, 0 };
   m_allDisplayableQuantities.insert(std::make_pair(temp.name, temp));
 
   m_currentDisplayedQuantityName = cloudDens.name;
@@ -240,10 +279,11 @@ bool Clouds::createBuffers()
 
 bool Clouds::createKernels() const
 {
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   // Init only
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_INFINITE_POS, { "p_pos" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_RESET_FLOAT, { "p_constFactorFld" });
 
   // For rendering purpose only
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_RESET_PART_DETECTOR, { "c_partDetector" });
@@ -251,6 +291,7 @@ bool Clouds::createKernels() const
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_RESET_CAMERA_DIST, { "p_cameraDist" });
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_FILL_CAMERA_DIST, { "p_pos", "u_cameraPos", "p_cameraDist" });
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_FILL_COLOR, { "", "", "", "p_col" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_FILL_COLOR_PACKED, { "", "", "", "", "p_col" });
 
   // Radix Sort based on 3D grid, using predicted positions, not corrected ones
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_RESET_CELL_ID, { "p_cellID" });
@@ -259,85 +300,85 @@ bool Clouds::createKernels() const
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_RESET_START_END_CELL, { "c_startEndPartID" });
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_FILL_START_CELL, { "p_cellID", "c_startEndPartID" });
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_FILL_END_CELL, { "p_cellID", "c_startEndPartID" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_ADJUST_END_CELL, { "c_startEndPartID" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_ADJUST_END_CELL, { "", "c_startEndPartID" });
 
   // Clouds thermodynamics
   // Init steps
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_INIT_TEMP, { "p_pos", "p_temp" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_INIT_VAPOR_DENSITY, { "", "p_temp", "p_vaporDens" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_INIT_THERMODYNAMICS, { "u_cloudParams", "p_pos", "p_thermo" });
   //
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_HEAT_GROUND, { "p_tempIn", "p_pos", "", "p_temp" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_BUOYANCY, { "p_temp", "p_pos", "p_cloudDens", "", "p_buoyancy" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_ADIABATIC_COOLING, { "p_temp", "p_vel", "", "p_tempIn" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CLOUD_GENERATION, { "p_tempIn", "p_vaporDens", "p_cloudDens", "", "p_cloudGen" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_PHASE_TRANSITION, { "p_vaporDensIn", "p_cloudDensIn", "p_cloudGen", "", "p_vaporDens", "p_cloudDens" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_LATENT_HEAT, { "p_tempIn", "p_cloudGen", "", "p_temp" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_UPDATE_THERMODYNAMICS, { "p_pos", "p_vel", "u_cloudParams", "p_thermo" });
   // Jacobi solver to correct temperature
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_LAPLACIAN_TEMP, { "p_pos", "p_temp", "c_startEndPartID", "", "p_laplacianTemp" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CONSTRAINT_FACTOR_TEMP, { "p_pos", "p_laplacianTemp", "c_startEndPartID", "", "p_constFactorTemp" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CONSTRAINT_CORRECTION_TEMP, { "p_constFactorTemp", "c_startEndPartID", "p_pos", "", "p_corrTemp" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CORRECT_TEMP, { "p_corrTemp", "p_temp" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_LAPLACIAN_TEMP, { "p_pos", "p_thermo", "c_startEndPartID", "u_cloudParams", "p_laplacianTemp" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CONSTRAINT_FACTOR_TEMP, { "p_pos", "p_laplacianTemp", "c_startEndPartID", "u_cloudParams", "p_constFactorTemp" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CONSTRAINT_CORRECTION_TEMP, { "p_constFactorTemp", "c_startEndPartID", "p_pos", "u_cloudParams", "p_corrTemp" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CORRECT_TEMP, { "p_corrTemp", "p_thermo" });
+  // Grid based solver to correct temperature
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_SPLAT_TEMP_TO_GRID, { "c_startEndPartID", "p_thermo", "c_tempInit" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_SMOOTH_TEMP_ON_GRID, { "", "" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_GATHER_TEMP_FROM_GRID, { "p_predPos", "c_tempInit", "", "p_thermo" });
 
   // Position Based Fluids - connected to clouds physics through buoyancy force applied on particles
   /// Boundary conditions
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_APPLY_BOUNDARY, { "p_predPos" });
   /// Position prediction
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_PREDICT_POS, { "p_pos", "p_vel", "p_buoyancy", "", "p_predPos", "p_totCorrPos" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_PREDICT_POS, { "p_pos", "p_vel", "p_thermo", "u_cloudParams", "p_predPos", "p_totCorrPos" });
   /// Jacobi solver to correct position
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_DENSITY, { "p_predPos", "c_startEndPartID", "", "p_density" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CONSTRAINT_FACTOR_FLUIDS, { "p_predPos", "p_density", "c_startEndPartID", "", "p_constFactorFld" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CONSTRAINT_CORRECTION_FLUIDS, { "p_constFactorFld", "c_startEndPartID", "p_predPos", "", "p_corrPos" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_DENSITY, { "p_predPos", "c_startEndPartID", "u_fluidParams", "p_density" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CONSTRAINT_FACTOR_FLUIDS, { "p_predPos", "p_density", "c_startEndPartID", "u_fluidParams", "p_constFactorFld" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CONSTRAINT_CORRECTION_FLUIDS, { "p_constFactorFld", "c_startEndPartID", "p_predPos", "u_fluidParams", "p_corrPos" });
   clContext.createKernel(PROGRAM_CLOUDS, KERNEL_CORRECT_POS, { "p_corrPos", "p_predPos" });
   /// Velocity update and correction using vorticity confinement and xsph viscosity
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_UPDATE_VEL, { "p_totCorrPos", "", "p_vel" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_COMPUTE_VORTICITY, { "p_predPos", "c_startEndPartID", "p_vel", "", "p_vort" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_VORTICITY_CONFINEMENT, { "p_predPos", "c_startEndPartID", "p_vort", "", "p_vel" });
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_XSPH_VISCOSITY, { "p_predPos", "c_startEndPartID", "p_velInViscosity", "", "p_vel" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_UPDATE_VEL, { "p_totCorrPos", "u_fluidParams", "p_vel" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_COMPUTE_VORTICITY, { "p_predPos", "c_startEndPartID", "p_vel", "u_fluidParams", "p_vort" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_VORTICITY_CONFINEMENT, { "p_predPos", "c_startEndPartID", "p_vort", "u_fluidParams", "p_vel" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_XSPH_VISCOSITY, { "p_predPos", "c_startEndPartID", "p_velInViscosity", "u_fluidParams", "p_vel" });
   /// Position update
-  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_UPDATE_POS, { "p_predPos", "", "p_pos" });
+  clContext.createKernel(PROGRAM_CLOUDS, KERNEL_UPDATE_POS, { "p_predPos", "u_cloudParams", "p_pos" });
 
   return true;
 }
 
 void Clouds::updateFluidsParamsInKernels()
 {
-  if (!m_init)
+  if (!m_init || !m_areFluidParamsDirty)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  m_areFluidParamsDirty = false;
+
+  CL::Context& clContext = getCLContext();
 
   m_fluidKernelInputs->dim = (m_dimension == Geometry::Dimension::dim2D) ? 2 : 3;
 
-  clContext.setKernelArg(KERNEL_UPDATE_VEL, 1, sizeof(FluidKernelInputs), m_fluidKernelInputs.get());
-  clContext.setKernelArg(KERNEL_DENSITY, 2, sizeof(FluidKernelInputs), m_fluidKernelInputs.get());
-  clContext.setKernelArg(KERNEL_CONSTRAINT_FACTOR_FLUIDS, 3, sizeof(FluidKernelInputs), m_fluidKernelInputs.get());
-  clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION_FLUIDS, 3, sizeof(FluidKernelInputs), m_fluidKernelInputs.get());
-  clContext.setKernelArg(KERNEL_COMPUTE_VORTICITY, 3, sizeof(FluidKernelInputs), m_fluidKernelInputs.get());
-  clContext.setKernelArg(KERNEL_VORTICITY_CONFINEMENT, 3, sizeof(FluidKernelInputs), m_fluidKernelInputs.get());
-  clContext.setKernelArg(KERNEL_XSPH_VISCOSITY, 3, sizeof(FluidKernelInputs), m_fluidKernelInputs.get());
+  *m_stepFluidKernelInputs = *m_fluidKernelInputs;
+  m_stepFluidKernelInputs->timeStep = m_fluidKernelInputs->timeStep / (cl_float)std::max(m_nbSubsteps, (size_t)1);
+
+  // Enqueued before the kernels of the step, finished with them before parameters can be changed again
+  clContext.loadBufferFromHost("u_fluidParams", 0, sizeof(FluidKernelInputs), m_stepFluidKernelInputs.get(), false);
+
+  cl_uint maxNbPartsInCell = (cl_uint)m_maxNbPartsInCell;
+  clContext.setKernelArg(KERNEL_ADJUST_END_CELL, 0, sizeof(cl_uint), &maxNbPartsInCell);
+
+  // Artificial pressure is only disabled during the warm start pass
+  cl_uint isArtPressureApplied = 1;
+  clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION_FLUIDS, 5, sizeof(cl_uint), &isArtPressureApplied);
 }
 
 void Clouds::updateCloudsParamsInKernels()
 {
-  if (!m_init)
+  if (!m_init || !m_areCloudParamsDirty)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  m_areCloudParamsDirty = false;
+
+  CL::Context& clContext = getCLContext();
 
   m_cloudKernelInputs->dim = (m_dimension == Geometry::Dimension::dim2D) ? 2 : 3;
 
-  clContext.setKernelArg(KERNEL_INIT_VAPOR_DENSITY, 0, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_HEAT_GROUND, 2, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_BUOYANCY, 3, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_ADIABATIC_COOLING, 2, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_CLOUD_GENERATION, 3, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_PHASE_TRANSITION, 3, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_LATENT_HEAT, 2, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_PREDICT_POS, 3, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_LAPLACIAN_TEMP, 3, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_CONSTRAINT_FACTOR_TEMP, 3, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION_TEMP, 3, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
-  clContext.setKernelArg(KERNEL_UPDATE_POS, 1, sizeof(CloudKernelInputs), m_cloudKernelInputs.get());
+  // Cloud time step follows the fluid one
+  *m_stepCloudKernelInputs = *m_cloudKernelInputs;
+  m_stepCloudKernelInputs->timeStep = m_fluidKernelInputs->timeStep / (cl_float)std::max(m_nbSubsteps, (size_t)1);
+
+  clContext.loadBufferFromHost("u_cloudParams", 0, sizeof(CloudKernelInputs), m_stepCloudKernelInputs.get(), false);
 }
 
 void Clouds::reset()
@@ -345,8 +386,11 @@ void Clouds::reset()
   if (!m_init)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
+  // Dimension may have changed
+  m_areFluidParamsDirty = true;
+  m_areCloudParamsDirty = true;
   updateFluidsParamsInKernels();
   updateCloudsParamsInKernels();
 
@@ -359,6 +403,32 @@ void Clouds::reset()
 
   clContext.runKernel(KERNEL_RESET_CELL_ID, m_maxNbParticles);
   clContext.runKernel(KERNEL_RESET_CAMERA_DIST, m_maxNbParticles);
+
+  resetConstraintFactors();
+}
+
+void Clouds::resetConstraintFactors()
+{
+  CL::Context& clContext = getCLContext();
+
+  clContext.setKernelArg(KERNEL_RESET_FLOAT, 0, "p_constFactorFld");
+  clContext.runKernel(KERNEL_RESET_FLOAT, m_maxNbParticles);
+  clContext.setKernelArg(KERNEL_RESET_FLOAT, 0, "p_constFactorTemp");
+  clContext.runKernel(KERNEL_RESET_FLOAT, m_maxNbParticles);
+}
+
+std::vector<std::string> Clouds::carriedFloatBuffers() const
+{
+  std::vector<std::string> bufferNames = { "p_partID" };
+
+  // Constraint factors reused as initial guess by the next step
+  if (m_isWarmStartEnabled)
+  {
+    bufferNames.push_back("p_constFactorFld");
+    bufferNames.push_back("p_constFactorTemp");
+  }
+
+  return bufferNames;
 }
 
 void Clouds::initCloudsParticles()
@@ -366,7 +436,7 @@ void Clouds::initCloudsParticles()
   if (!m_init)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   clContext.acquireGLBuffers({ "p_pos", "p_col" });
 
@@ -384,13 +454,13 @@ void Clouds::initCloudsParticles()
     switch (m_initialCase)
     {
     case CaseType::CUMULUS:
-      m_currNbParticles = Utils::NbParticles::P8K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P8K);
       shape = Geometry::Shape2D::Rectangle;
       startFluidPos = { 0.0f, m_boxSize.y / -2.0f, m_boxSize.z / -2.0f };
       endFluidPos = { 0.0f, 0.0f, m_boxSize.z / 2.0f };
       break;
     case CaseType::HOMOGENEOUS:
-      m_currNbParticles = Utils::NbParticles::P8K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P8K);
       shape = Geometry::Shape2D::Rectangle;
       startFluidPos = { 0.0f, m_boxSize.y / -2.0f, m_boxSize.z / -2.0f };
       endFluidPos = { 0.0f, m_boxSize.y / 2.0f, m_boxSize.z / 2.0f };
@@ -400,7 +470,7 @@ void Clouds::initCloudsParticles()
       break;
     }
 
-    const auto& subdiv2D = Utils::GetNbParticlesSubdiv2D((Utils::NbParticles)m_currNbParticles);
+    const auto& subdiv2D = Utils::GetNbParticlesSubdiv2D(m_currNbParticles);
     Math::int2 grid2DRes = { subdiv2D[0], subdiv2D[1] };
 
     gridVerts = Geometry::Generate2DGrid(shape, Geometry::Plane::YZ, grid2DRes, startFluidPos, endFluidPos, distribution);
@@ -412,13 +482,13 @@ void Clouds::initCloudsParticles()
     switch (m_initialCase)
     {
     case CaseType::CUMULUS:
-      m_currNbParticles = Utils::NbParticles::P65K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P65K);
       shape = Geometry::Shape3D::Box;
       startFluidPos = { m_boxSize.x / -2.0f, m_boxSize.y / -2.0f, m_boxSize.z / -2.0f };
       endFluidPos = { m_boxSize.x / 2.0f, m_boxSize.y / -4.0f, m_boxSize.z / 2.0f };
       break;
     case CaseType::HOMOGENEOUS:
-      m_currNbParticles = Utils::NbParticles::P65K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P65K);
       shape = Geometry::Shape3D::Box;
       startFluidPos = { m_boxSize.x / -2.0f, m_boxSize.y / -2.0f, m_boxSize.z / -2.0f };
       endFluidPos = { m_boxSize.x / 2.0f, m_boxSize.y / 2.0f, m_boxSize.z / 2.0f };
@@ -428,7 +498,7 @@ void Clouds::initCloudsParticles()
       break;
     }
 
-    const auto& subdiv3D = Utils::GetNbParticlesSubdiv3D((Utils::NbParticles)m_currNbParticles);
+    const auto& subdiv3D = Utils::GetNbParticlesSubdiv3D(m_currNbParticles);
     Math::int3 grid3DRes = { subdiv3D[0], subdiv3D[1], subdiv3D[2] };
 
     gridVerts = Geometry::Generate3DGrid(shape, grid3DRes, startFluidPos, endFluidPos, distribution);
@@ -437,28 +507,34 @@ void Clouds::initCloudsParticles()
   float inf = std::numeric_limits<float>::infinity();
   std::vector<std::array<float, 4>> pos(m_maxNbParticles, std::array<float, 4>({ inf, inf, inf, 0.0f }));
 
-  std::transform(gridVerts.cbegin(), gridVerts.cend(), pos.begin(),
+  // Derived lattices may hold a bit less particles than requested
+  m_currNbParticles = std::min(gridVerts.size(), m_maxNbParticles);
+
+  std::transform(gridVerts.cbegin(), gridVerts.cbegin() + m_currNbParticles, pos.begin(),
       [](const Math::float3& vertPos) -> std::array<float, 4> { return { vertPos.x, vertPos.y, vertPos.z, 0.0f }; });
   clContext.loadBufferFromHost("p_pos", 0, 4 * sizeof(float) * pos.size(), pos.data());
 
-  std::vector<std::array<float, 4>> vel(m_maxNbParticles, std::array<float, 4>({ 0.0f, 0.0f, 0.0f, 0.0f }));
-  clContext.loadBufferFromHost("p_vel", 0, 4 * sizeof(float) * vel.size(), vel.data());
+  // Buffers not shared with OpenGL are written in place on host unified memory
+  auto* vel = static_cast<std::array<float, 4>*>(clContext.mapBuffer("p_vel", CL_MAP_WRITE_INVALIDATE_REGION));
+  if (vel != nullptr)
+  {
+    std::fill(vel, vel + m_maxNbParticles, std::array<float, 4>({ 0.0f, 0.0f, 0.0f, 0.0f }));
+    clContext.unmapBuffer("p_vel");
+  }
 
   std::vector<std::array<float, 4>> col(m_maxNbParticles, std::array<float, 4>({ 0.0f, 0.1f, 1.0f, 0.0f }));
   clContext.loadBufferFromHost("p_col", 0, 4 * sizeof(float) * col.size(), col.data());
 
-  std::vector<float> cloudDens(m_maxNbParticles, 0.0f);
-  clContext.loadBufferFromHost("p_cloudDens", 0, sizeof(float) * cloudDens.size(), cloudDens.data());
-
-  std::vector<float> partID(m_maxNbParticles, 0.0f);
-  for (int i = 0; i != partID.size(); ++i)
-    partID[i] = (float)i;
-  clContext.loadBufferFromHost("p_partID", 0, sizeof(float) * partID.size(), partID.data());
-
-  // Temperature field must be initialized before vapor density
-  clContext.runKernel(KERNEL_INIT_TEMP, m_maxNbParticles);
+  auto* partID = static_cast<float*>(clContext.mapBuffer("p_partID", CL_MAP_WRITE_INVALIDATE_REGION));
+  if (partID != nullptr)
+  {
+    for (size_t i = 0; i != m_maxNbParticles; ++i)
+      partID[i] = (float)i;
+    clContext.unmapBuffer("p_partID");
+  }
 
-  clContext.runKernel(KERNEL_INIT_VAPOR_DENSITY, m_maxNbParticles);
+  // Temperature, vapor and cloud density fields
+  clContext.runKernel(KERNEL_INIT_THERMODYNAMICS, m_maxNbParticles);
 
   clContext.releaseGLBuffers({ "p_pos", "p_col" });
 }
@@ -468,104 +544,145 @@ void Clouds::update()
   if (!m_init)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
+
+  // Parameters changed since the last step are written at once
+  updateFluidsParamsInKernels();
+  updateCloudsParamsInKernels();
 
   clContext.acquireGLBuffers({ "p_pos", "p_col", "c_partDetector", "u_cameraPos" });
 
   if (!m_pause)
   {
-    // Clouds thermodynamics
-    // Copying temperature to other buffer as HeatGround kernel need it as both input and output
-    clContext.copyBuffer("p_temp", "p_tempIn");
-    clContext.runKernel(KERNEL_HEAT_GROUND, m_currNbParticles);
-    // Computing buoyancy and gravity forces exerced on particles
-    clContext.runKernel(KERNEL_BUOYANCY, m_currNbParticles);
-    // Computing adiabatic cooling due to altitude increase
-    clContext.runKernel(KERNEL_ADIABATIC_COOLING, m_currNbParticles);
-    // Computing cloud generation value
-    clContext.runKernel(KERNEL_CLOUD_GENERATION, m_currNbParticles);
-    // Copying vapor and cloud density values to other buffers before running phase transition kernel using them as input/output
-    clContext.copyBuffer("p_vaporDens", "p_vaporDensIn");
-    clContext.copyBuffer("p_cloudDens", "p_cloudDensIn");
-    clContext.runKernel(KERNEL_PHASE_TRANSITION, m_currNbParticles);
-    //
-    clContext.runKernel(KERNEL_LATENT_HEAT, m_currNbParticles);
-
-    // Predicting velocity and position
-    // Step coupling fluids and clouds physics
-    // where we apply clouds buoyancy and gravity forces on fluids particles
-    clContext.runKernel(KERNEL_PREDICT_POS, m_currNbParticles);
-
-    // Applying boundary limits before doing the spatial partioning, some parts could move from one wall to another
-    clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 0, "p_predPos");
-    clContext.runKernel(KERNEL_APPLY_BOUNDARY, m_currNbParticles);
-
-    // NNS - spatial partitioning
-    clContext.runKernel(KERNEL_FILL_CELL_ID, m_currNbParticles);
-
-    m_radixSort.sort("p_cellID", { "p_pos", "p_col", "p_vel", "p_predPos", "p_totCorrPos" }, { "p_temp", "p_buoyancy", "p_vaporDens", "p_cloudDens", "p_partID" });
-
-    clContext.runKernel(KERNEL_RESET_START_END_CELL, m_nbCells);
-    clContext.runKernel(KERNEL_FILL_START_CELL, m_currNbParticles);
-    clContext.runKernel(KERNEL_FILL_END_CELL, m_currNbParticles);
-
-    if (m_simplifiedMode)
-      clContext.runKernel(KERNEL_ADJUST_END_CELL, m_nbCells);
-
-    // Apply constraint on temperature field in a similar way than position based fluids constraint on mass
-    // This time, the constraint aims to homogenize temperature field, forcing its Laplacian field to be null
-    if (m_cloudKernelInputs->isTempSmoothingEnabled)
+    // Several simulation steps per frame can be run, tuned by the quality governor
+    for (size_t step = 0; step < m_nbSubsteps; ++step)
     {
-      for (int iter = 0; iter < 1; ++iter)
+      // Clouds thermodynamics
+      // Heat from ground, buoyancy and gravity forces, adiabatic cooling, phase transition and latent heat
+      clContext.runKernel(KERNEL_UPDATE_THERMODYNAMICS, m_currNbParticles);
+
+      // Predicting velocity and position
+      // Step coupling fluids and clouds physics
+      // where we apply clouds buoyancy and gravity forces on fluids particles
+      clContext.runKernel(KERNEL_PREDICT_POS, m_currNbParticles);
+
+      // Applying boundary limits before doing the spatial partioning, some parts could move from one wall to another
+      clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 0, "p_predPos");
+      clContext.runKernel(KERNEL_APPLY_BOUNDARY, m_currNbParticles);
+
+      // NNS - spatial partitioning
+      clContext.runKernel(KERNEL_FILL_CELL_ID, m_currNbParticles);
+
+      m_radixSort.sort("p_cellID", { "p_pos", "p_col", "p_vel", "p_predPos", "p_totCorrPos", "p_thermo" }, carriedFloatBuffers());
+
+      clContext.runKernel(KERNEL_RESET_START_END_CELL, m_nbCells);
+      clContext.runKernel(KERNEL_FILL_START_CELL, m_currNbParticles);
+      clContext.runKernel(KERNEL_FILL_END_CELL, m_currNbParticles);
+
+      if (m_simplifiedMode)
+        clContext.runKernel(KERNEL_ADJUST_END_CELL, m_nbCells);
+
+      // Apply constraint on temperature field in a similar way than position based fluids constraint on mass
+      // This time, the constraint aims to homogenize temperature field, forcing its Laplacian field to be null
+      if (m_cloudKernelInputs->isTempSmoothingEnabled && m_isTempSmoothingOnGrid)
+      {
+        // Splatting temperature onto the grid
+        clContext.runKernel(KERNEL_SPLAT_TEMP_TO_GRID, m_nbCells);
+        // Applying constraint on the grid with ping-pong buffers
+        std::string gridTempIn = "c_tempInit";
+        std::string gridTempOut = "c_tempA";
+        for (int iter = 0; iter < m_nbTempGridIters; ++iter)
+        {
+          clContext.setKernelArg(KERNEL_SMOOTH_TEMP_ON_GRID, 0, gridTempIn);
+          clContext.setKernelArg(KERNEL_SMOOTH_TEMP_ON_GRID, 1, gridTempOut);
+          clContext.runKernel(KERNEL_SMOOTH_TEMP_ON_GRID, m_nbCells);
+
+          gridTempIn = gridTempOut;
+          gridTempOut = (gridTempOut == "c_tempA") ? "c_tempB" : "c_tempA";
+        }
+        // Gathering temperature correction back to particles
+        clContext.setKernelArg(KERNEL_GATHER_TEMP_FROM_GRID, 2, gridTempIn);
+        clContext.runKernel(KERNEL_GATHER_TEMP_FROM_GRID, m_currNbParticles);
+      }
+      else if (m_cloudKernelInputs->isTempSmoothingEnabled)
+      {
+        // Warm start, correcting temperature with the constraint factors of the previous step before solving again
+        if (m_isWarmStartEnabled)
+        {
+          clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION_TEMP, m_currNbParticles);
+          clContext.runKernel(KERNEL_CORRECT_TEMP, m_currNbParticles);
+        }
+
+        for (int iter = 0; iter < 1; ++iter)
+        {
+          // Computing Laplacian of temperature field using SPH method, it is the constrained variable
+          clContext.runKernel(KERNEL_LAPLACIAN_TEMP, m_currNbParticles);
+          // Computing constraint factor Lambda
+          clContext.runKernel(KERNEL_CONSTRAINT_FACTOR_TEMP, m_currNbParticles);
+          // Computing constraint correction
+          clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION_TEMP, m_currNbParticles);
+          // Applying correction on temperature field
+          clContext.runKernel(KERNEL_CORRECT_TEMP, m_currNbParticles);
+        }
+      }
+
+      // Warm start, correcting positions with the constraint factors of the previous step before solving again
+      if (m_isWarmStartEnabled)
+      {
+        // Carried factors replay the correction of the previous step, artificial pressure being applied by the solve only
+        const cl_uint isArtPressureApplied = 1;
+        const cl_uint isArtPressureNotApplied = 0;
+        clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION_FLUIDS, 5, sizeof(cl_uint), &isArtPressureNotApplied);
+        clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION_FLUIDS, m_currNbParticles);
+        clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION_FLUIDS, 5, sizeof(cl_uint), &isArtPressureApplied);
+        clContext.setKernelArg(KERNEL_CORRECT_POS, 1, "p_predPos");
+        clContext.runKernel(KERNEL_CORRECT_POS, m_currNbParticles);
+        clContext.setKernelArg(KERNEL_CORRECT_POS, 1, "p_totCorrPos");
+        clContext.runKernel(KERNEL_CORRECT_POS, m_currNbParticles);
+        clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 0, "p_predPos");
+        clContext.runKernel(KERNEL_APPLY_BOUNDARY, m_currNbParticles);
+      }
+
+      // Correcting positions to fit constraints
+      for (int iter = 0; iter < m_nbJacobiIters; ++iter)
       {
-        // Computing Laplacian of temperature field using SPH method, it is the constrained variable
-        clContext.runKernel(KERNEL_LAPLACIAN_TEMP, m_currNbParticles);
+        // Computing density using SPH method
+        clContext.runKernel(KERNEL_DENSITY, m_currNbParticles);
         // Computing constraint factor Lambda
-        clContext.runKernel(KERNEL_CONSTRAINT_FACTOR_TEMP, m_currNbParticles);
-        // Computing constraint correction
-        clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION_TEMP, m_currNbParticles);
-        // Applying correction on temperature field
-        clContext.runKernel(KERNEL_CORRECT_TEMP, m_currNbParticles);
+        clContext.runKernel(KERNEL_CONSTRAINT_FACTOR_FLUIDS, m_currNbParticles);
+        // Computing position correction
+        clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION_FLUIDS, m_currNbParticles);
+        // Correcting predicted position
+        clContext.setKernelArg(KERNEL_CORRECT_POS, 1, "p_predPos");
+        clContext.runKernel(KERNEL_CORRECT_POS, m_currNbParticles);
+        // Correcting unclamped predicted position used for velocity
+        clContext.setKernelArg(KERNEL_CORRECT_POS, 1, "p_totCorrPos");
+        clContext.runKernel(KERNEL_CORRECT_POS, m_currNbParticles);
+        // Clamping to boundary
+        clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 0, "p_predPos");
+        clContext.runKernel(KERNEL_APPLY_BOUNDARY, m_currNbParticles);
       }
-    }
 
-    // Correcting positions to fit constraints
-    for (int iter = 0; iter < m_nbJacobiIters; ++iter)
-    {
-      // Computing density using SPH method
-      clContext.runKernel(KERNEL_DENSITY, m_currNbParticles);
-      // Computing constraint factor Lambda
-      clContext.runKernel(KERNEL_CONSTRAINT_FACTOR_FLUIDS, m_currNbParticles);
-      // Computing position correction
-      clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION_FLUIDS, m_currNbParticles);
-      // Correcting predicted position
-      clContext.setKernelArg(KERNEL_CORRECT_POS, 1, "p_predPos");
-      clContext.runKernel(KERNEL_CORRECT_POS, m_currNbParticles);
-      // Correcting unclamped predicted position used for velocity
-      clContext.setKernelArg(KERNEL_CORRECT_POS, 1, "p_totCorrPos");
-      clContext.runKernel(KERNEL_CORRECT_POS, m_currNbParticles);
-      // Clamping to boundary
-      clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 0, "p_predPos");
-      clContext.runKernel(KERNEL_APPLY_BOUNDARY, m_currNbParticles);
-    }
+      // Updating velocity
+      clContext.runKernel(KERNEL_UPDATE_VEL, m_currNbParticles);
 
-    // Updating velocity
-    clContext.runKernel(KERNEL_UPDATE_VEL, m_currNbParticles);
+      if (m_fluidKernelInputs->isVorticityConfEnabled)
+      {
+        // Computing vorticity
+        clContext.runKernel(KERNEL_COMPUTE_VORTICITY, m_currNbParticles);
+        // Applying vorticity confinement to attenue virtual damping
+        clContext.runKernel(KERNEL_VORTICITY_CONFINEMENT, m_currNbParticles);
+        // Copying velocity buffer as input for vorticity confinement correction
+        clContext.copyBuffer("p_vel", "p_velInViscosity");
+        // Applying xsph viscosity correction for a more coherent motion
+        clContext.runKernel(KERNEL_XSPH_VISCOSITY, m_currNbParticles);
+      }
 
-    if (m_fluidKernelInputs->isVorticityConfEnabled)
-    {
-      // Computing vorticity
-      clContext.runKernel(KERNEL_COMPUTE_VORTICITY, m_currNbParticles);
-      // Applying vorticity confinement to attenue virtual damping
-      clContext.runKernel(KERNEL_VORTICITY_CONFINEMENT, m_currNbParticles);
-      // Copying velocity buffer as input for vorticity confinement correction
-      clContext.copyBuffer("p_vel", "p_velInViscosity");
-      // Applying xsph viscosity correction for a more coherent motion
-      clContext.runKernel(KERNEL_XSPH_VISCOSITY, m_currNbParticles);
+      // Updating pos
+      clContext.runKernel(KERNEL_UPDATE_POS, m_currNbParticles);
     }
 
-    // Updating pos
-    clContext.runKernel(KERNEL_UPDATE_POS, m_currNbParticles);
+    m_statistics->record(m_currNbParticles, m_fluidKernelInputs->restDensity);
 
     // Rendering purpose
     clContext.runKernel(KERNEL_RESET_PART_DETECTOR, m_nbCells);
@@ -576,15 +693,27 @@ void Clouds::update()
   const auto& currentPhysicalQuantity = currentDisplayedPhysicalQuantity();
   cl_float minVal = (cl_float)currentPhysicalQuantity.userRange.first;
   cl_float maxVal = (cl_float)currentPhysicalQuantity.userRange.second;
-  clContext.setKernelArg(KERNEL_FILL_COLOR, 0, currentPhysicalQuantity.bufferName);
-  clContext.setKernelArg(KERNEL_FILL_COLOR, 1, sizeof(cl_float), &minVal);
-  clContext.setKernelArg(KERNEL_FILL_COLOR, 2, sizeof(cl_float), &maxVal);
-  clContext.runKernel(KERNEL_FILL_COLOR, m_currNbParticles);
+  if (currentPhysicalQuantity.bufferComponent < 0)
+  {
+    clContext.setKernelArg(KERNEL_FILL_COLOR, 0, currentPhysicalQuantity.bufferName);
+    clContext.setKernelArg(KERNEL_FILL_COLOR, 1, sizeof(cl_float), &minVal);
+    clContext.setKernelArg(KERNEL_FILL_COLOR, 2, sizeof(cl_float), &maxVal);
+    clContext.runKernel(KERNEL_FILL_COLOR, m_currNbParticles);
+  }
+  else
+  {
+    cl_uint component = (cl_uint)currentPhysicalQuantity.bufferComponent;
+    clContext.setKernelArg(KERNEL_FILL_COLOR_PACKED, 0, currentPhysicalQuantity.bufferName);
+    clContext.setKernelArg(KERNEL_FILL_COLOR_PACKED, 1, sizeof(cl_uint), &component);
+    clContext.setKernelArg(KERNEL_FILL_COLOR_PACKED, 2, sizeof(cl_float), &minVal);
+    clContext.setKernelArg(KERNEL_FILL_COLOR_PACKED, 3, sizeof(cl_float), &maxVal);
+    clContext.runKernel(KERNEL_FILL_COLOR_PACKED, m_currNbParticles);
+  }
 
   // Rendering purpose
   clContext.runKernel(KERNEL_FILL_CAMERA_DIST, m_currNbParticles);
 
-  m_radixSort.sort("p_cameraDist", { "p_pos", "p_col", "p_vel", "p_predPos" }, { "p_temp", "p_buoyancy", "p_vaporDens", "p_cloudDens", "p_partID" });
+  m_radixSort.sort("p_cameraDist", { "p_pos", "p_col", "p_vel", "p_predPos", "p_thermo" }, carriedFloatBuffers());
 
   clContext.releaseGLBuffers({ "p_pos", "p_col", "c_partDetector", "u_cameraPos" });
 }
@@ -595,7 +724,7 @@ void Clouds::setRestDensity(float restDensity)
   if (!m_init)
     return;
   m_fluidKernelInputs->restDensity = (cl_float)restDensity;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -604,7 +733,7 @@ void Clouds::setRelaxCFM(float relaxCFM)
   if (!m_init)
     return;
   m_fluidKernelInputs->relaxCFM = (cl_float)relaxCFM;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -613,7 +742,8 @@ void Clouds::setTimeStep(float timeStep)
   if (!m_init)
     return;
   m_fluidKernelInputs->timeStep = (cl_float)timeStep;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
+  m_areCloudParamsDirty = true;
 }
 
 //
@@ -624,13 +754,32 @@ void Clouds::setNbJacobiIters(size_t nbIters)
   m_nbJacobiIters = nbIters;
 }
 
+//
+void Clouds::setMaxNbPartsInCell(size_t nbParts)
+{
+  if (!m_init)
+    return;
+  m_maxNbPartsInCell = nbParts;
+  m_areFluidParamsDirty = true;
+}
+
+//
+void Clouds::setNbSubsteps(size_t nbSubsteps)
+{
+  if (!m_init)
+    return;
+  m_nbSubsteps = nbSubsteps;
+  m_areFluidParamsDirty = true;
+  m_areCloudParamsDirty = true;
+}
+
 //
 void Clouds::enableArtPressure(bool enable)
 {
   if (!m_init)
     return;
   m_fluidKernelInputs->isArtPressureEnabled = (cl_uint)enable;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -639,7 +788,7 @@ void Clouds::setArtPressureRadius(float radius)
   if (!m_init)
     return;
   m_fluidKernelInputs->artPressureRadius = (cl_float)radius;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -648,7 +797,7 @@ void Clouds::setArtPressureExp(size_t exp)
   if (!m_init)
     return;
   m_fluidKernelInputs->artPressureExp = (cl_uint)exp;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -657,7 +806,7 @@ void Clouds::setArtPressureCoeff(float coeff)
   if (!m_init)
     return;
   m_fluidKernelInputs->artPressureCoeff = (cl_float)coeff;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -666,7 +815,7 @@ void Clouds::enableVorticityConfinement(bool enable)
   if (!m_init)
     return;
   m_fluidKernelInputs->isVorticityConfEnabled = (cl_uint)enable;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -675,7 +824,43 @@ void Clouds::enableTempSmoothing(bool enable)
   if (!m_init)
     return;
   m_cloudKernelInputs->isTempSmoothingEnabled = (cl_uint)enable;
-  updateCloudsParamsInKernels();
+  m_areCloudParamsDirty = true;
+
+  // Temperature constraint factors of the last particle smoothing are out of date
+  if (m_isWarmStartEnabled)
+    resetConstraintFactors();
+}
+
+//
+void Clouds::enableTempGridSmoothing(bool enable)
+{
+  if (!m_init)
+    return;
+  m_isTempSmoothingOnGrid = enable;
+
+  if (m_isWarmStartEnabled)
+    resetConstraintFactors();
+}
+
+//
+void Clouds::setNbTempGridIters(size_t nbIters)
+{
+  if (!m_init)
+    return;
+  m_nbTempGridIters = nbIters;
+}
+
+//
+void Clouds::enableWarmStart(bool enable)
+{
+  if (!m_init || enable == m_isWarmStartEnabled)
+    return;
+
+  // Constraint factors have not followed particles while disabled
+  if (enable)
+    resetConstraintFactors();
+
+  m_isWarmStartEnabled = enable;
 }
 
 //
@@ -684,7 +869,7 @@ void Clouds::setVorticityConfinementCoeff(float coeff)
   if (!m_init)
     return;
   m_fluidKernelInputs->vorticityConfCoeff = (cl_float)coeff;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -693,7 +878,7 @@ void Clouds::setXsphViscosityCoeff(float coeff)
   if (!m_init)
     return;
   m_fluidKernelInputs->xsphViscosityCoeff = (cl_float)coeff;
-  updateFluidsParamsInKernels();
+  m_areFluidParamsDirty = true;
 }
 
 //
@@ -702,7 +887,7 @@ void Clouds::setGroundHeatCoeff(float coeff)
   if (!m_init)
     return;
   m_cloudKernelInputs->groundHeatCoeff = (cl_float)coeff;
-  updateCloudsParamsInKernels();
+  m_areCloudParamsDirty = true;
 }
 
 //
@@ -711,7 +896,7 @@ void Clouds::setBuoyancyCoeff(float coeff)
   if (!m_init)
     return;
   m_cloudKernelInputs->buoyancyCoeff = (cl_float)coeff;
-  updateCloudsParamsInKernels();
+  m_areCloudParamsDirty = true;
 }
 
 //
@@ -720,7 +905,7 @@ void Clouds::setAdiabaticLapseRate(float rate)
   if (!m_init)
     return;
   m_cloudKernelInputs->adiabaticLapseRate = (cl_float)rate;
-  updateCloudsParamsInKernels();
+  m_areCloudParamsDirty = true;
 }
 
 //
@@ -729,7 +914,7 @@ void Clouds::setPhaseTransitionRate(float rate)
   if (!m_init)
     return;
   m_cloudKernelInputs->phaseTransitionRate = (cl_float)rate;
-  updateCloudsParamsInKernels();
+  m_areCloudParamsDirty = true;
 }
 
 //
@@ -738,7 +923,7 @@ void Clouds::setLatentHeatCoeff(float coeff)
   if (!m_init)
     return;
   m_cloudKernelInputs->latentHeatCoeff = (cl_float)coeff;
-  updateCloudsParamsInKernels();
+  m_areCloudParamsDirty = true;
 }
 
 //
@@ -747,7 +932,7 @@ void Clouds::setGravCoeff(float coeff)
   if (!m_init)
     return;
   m_cloudKernelInputs->gravCoeff = (cl_float)coeff;
-  updateCloudsParamsInKernels();
+  m_areCloudParamsDirty = true;
 }
 
 //
@@ -756,7 +941,7 @@ void Clouds::setWindCoeff(float coeff)
   if (!m_init)
     return;
   m_cloudKernelInputs->windCoeff = (cl_float)coeff;
-  updateCloudsParamsInKernels();
+  m_areCloudParamsDirty = true;
 }
 
 //
@@ -783,6 +968,24 @@ size_t Clouds::getNbJacobiIters() const
   return m_init ? m_nbJacobiIters : 0;
 }
 
+//
+size_t Clouds::getMaxNbPartsInCell() const
+{
+  return m_init ? m_maxNbPartsInCell : 0;
+}
+
+//
+bool Clouds::isMaxNbPartsInCellApplied() const
+{
+  return m_init ? m_simplifiedMode : false;
+}
+
+//
+size_t Clouds::getNbSubsteps() const
+{
+  return m_init ? m_nbSubsteps : 0;
+}
+
 //
 bool Clouds::isArtPressureEnabled() const
 {
@@ -867,6 +1070,18 @@ bool Clouds::isTempSmoothingEnabled() const
   return m_init ? (bool)m_cloudKernelInputs->isTempSmoothingEnabled : 0.0f;
 }
 
+//
+bool Clouds::isTempGridSmoothingEnabled() const
+{
+  return m_init ? m_isTempSmoothingOnGrid : false;
+}
+
+//
+size_t Clouds::getNbTempGridIters() const
+{
+  return m_init ? m_nbTempGridIters : 0;
+}
+
 //
 float Clouds::getWindCoeff() const
 {
@@ -39,6 +39,9 @@ class Clouds : public Model
   void update() override;
   void reset() override;
 
+  // Build programs in background before the model is created
+  static void PrebuildPrograms(const ModelParams& params);
+
   void setInitialCase(CaseType caseT) { m_initialCase = caseT; }
   const CaseType getInitialCase() const { return m_initialCase; }
 
@@ -52,8 +55,15 @@ class Clouds : public Model
   void setTimeStep(float timeStep);
   float getTimeStep() const;
   //
-  void setNbJacobiIters(size_t nbIters);
-  size_t getNbJacobiIters() const;
+  void setNbJacobiIters(size_t nbIters) override;
+  size_t getNbJacobiIters() const override;
+  // Cap on the number of particles taken into account in a single cell, in simplified mode
+  void setMaxNbPartsInCell(size_t nbParts) override;
+  size_t getMaxNbPartsInCell() const override;
+  bool isMaxNbPartsInCellApplied() const override;
+  // Number of simulation steps run for each update
+  void setNbSubsteps(size_t nbSubsteps) override;
+  size_t getNbSubsteps() const override;
   //
   void enableArtPressure(bool enable);
   bool isArtPressureEnabled() const;
@@ -67,8 +77,8 @@ class Clouds : public Model
   void setArtPressureCoeff(float coeff);
   float getArtPressureCoeff() const;
   //
-  void enableVorticityConfinement(bool enable);
-  bool isVorticityConfinementEnabled() const;
+  void enableVorticityConfinement(bool enable) override;
+  bool isVorticityConfinementEnabled() const override;
   //
   void setVorticityConfinementCoeff(float coeff);
   float getVorticityConfinementCoeff() const;
@@ -99,6 +109,17 @@ class Clouds : public Model
   //
   void enableTempSmoothing(bool enable);
   bool isTempSmoothingEnabled() const;
+  // Smoothing temperature on the grid instead of using particles neighborhood
+  void enableTempGridSmoothing(bool enable);
+  bool isTempGridSmoothingEnabled() const;
+  // Number of stencil iterations of the grid smoothing
+  void setNbTempGridIters(size_t nbIters);
+  size_t getNbTempGridIters() const;
+
+  // Constraint factors of fluids and temperature are carried across steps along with particles,
+  // the solvers first correcting with them to start from the previous solution
+  void enableWarmStart(bool enable);
+  bool isWarmStartEnabled() const { return m_isWarmStartEnabled; }
 
   private:
   bool createProgram() const;
@@ -107,19 +128,38 @@ class Clouds : public Model
 
   void initCloudsParticles();
 
+  // Write parameters to the constant buffers if changed since the last step
   void updateFluidsParamsInKernels();
   void updateCloudsParamsInKernels();
 
+  void resetConstraintFactors();
+  // Float buffers moved along with particles by the sorts, depending on enabled features
+  std::vector<std::string> carriedFloatBuffers() const;
+
   bool m_simplifiedMode;
 
   size_t m_maxNbPartsInCell;
 
   size_t m_nbJacobiIters;
 
+  size_t m_nbSubsteps;
+
+  bool m_isTempSmoothingOnGrid;
+
+  size_t m_nbTempGridIters;
+
+  bool m_isWarmStartEnabled;
+
   RadixSort m_radixSort;
 
   std::unique_ptr<FluidKernelInputs> m_fluidKernelInputs;
   std::unique_ptr<CloudKernelInputs> m_cloudKernelInputs;
+  // Inputs written to the device, with the time step split over substeps
+  std::unique_ptr<FluidKernelInputs> m_stepFluidKernelInputs;
+  std::unique_ptr<CloudKernelInputs> m_stepCloudKernelInputs;
+  // Setters only flag parameters, written once at the start of the next step
+  bool m_areFluidParamsDirty;
+  bool m_areCloudParamsDirty;
 
   CaseType m_initialCase;
 };
@@ -12,9 +12,11 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <numeric>
 #include <sstream>
 
 #include <chrono>
+#include <future>
 #include <thread>
 
 using namespace Physics;
@@ -25,6 +27,7 @@ using namespace Physics;
 #define KERNEL_INFINITE_POS "infPosVerts"
 #define KERNEL_RESET_CAMERA_DIST "resetCameraDist"
 #define KERNEL_FILL_CAMERA_DIST "fillCameraDist"
+#define KERNEL_RESET_FLOAT "resetFloat"
 
 // grid.cl
 #define KERNEL_RESET_PART_DETECTOR "resetGridDetector"
@@ -49,6 +52,31 @@ using namespace Physics;
 #define KERNEL_XSPH_VISCOSITY "fld_applyXsphViscosityCorrection"
 #define KERNEL_UPDATE_POS "fld_updatePosition"
 #define KERNEL_FILL_COLOR "fld_fillFluidColor"
+#define KERNEL_RESET_CELL_ACTIVITY "fld_resetCellActivity"
+#define KERNEL_FILL_CELL_ACTIVITY "fld_fillCellActivity"
+#define KERNEL_EXCLUDE_SLEEPING "fld_excludeSleepingParticles"
+#define KERNEL_FILL_ACTIVE_LIST "fld_fillActiveList"
+#define KERNEL_UPDATE_REST_STEPS "fld_updateRestSteps"
+#define KERNEL_WAKE_PARTICLES "fld_wakeParticles"
+#define KERNEL_RESET_CONSTRAINED_CELLS "fld_resetConstrainedCells"
+#define KERNEL_FILL_CONSTRAINED_LIST "fld_fillConstrainedList"
+#define KERNEL_FILL_CORRECTED_LIST "fld_fillCorrectedList"
+#define KERNEL_FLAG_WARM_STARTED_CELLS "fld_flagWarmStartedCells"
+
+// Events the kernels run asynchronously depend on
+#define EVENT_GL_ACQUIRED "glAcquired"
+#define EVENT_STEP_DONE "stepDone"
+#define EVENT_DENSITY_DONE "densityDone"
+#define EVENT_HEALTH_READ "healthRead"
+
+// Health counters, same order as in fluids.cl
+#define HEALTH_NON_FINITE 0
+#define HEALTH_SPEED_CAPPED 1
+#define HEALTH_WALL_CLAMPED 2
+// Blow-up if any particle is not finite, or if too many of them are speed capped at each step
+#define BLOW_UP_SPEED_CAPPED_RATIO 0.01f
+#define NB_UPDATES_BETWEEN_SNAPSHOTS 60
+#define NO_SNAPSHOT std::numeric_limits<size_t>::max()
 
 namespace Physics
 {
@@ -67,6 +95,10 @@ struct FluidKernelInputs
   cl_uint isVorticityConfEnabled = 1;
   cl_float vorticityConfCoeff = 0.0004f;
   cl_float xsphViscosityCoeff = 0.0001f;
+  // Sleeping if enabled excludes particles at rest from the step
+  cl_uint isSleepingEnabled = 0;
+  // Unilateral constraint if enabled only constrains compressed particles, skipping free-surface ones
+  cl_uint isUnilateralEnabled = 0;
 };
 
 const std::map<Fluids::CaseType, std::string, Fluids::CompareCaseType> Fluids::ALL_CASES {
@@ -74,23 +106,121 @@ const std::map<Fluids::CaseType, std::string, Fluids::CompareCaseType> Fluids::A
   { CaseType::BOMB, "Bomb" },
   { CaseType::DROP, "Drop" },
 };
+
+const std::map<Fluids::HealthCheck, std::string> Fluids::ALL_HEALTH_CHECKS {
+  { HealthCheck::DISABLED, "Disabled" },
+  { HealthCheck::WARN, "Warn" },
+  { HealthCheck::ROLLBACK, "Rollback" },
+};
+}
+
+namespace
+{
+// file.cl order matters, define.cl must be first
+const std::vector<std::string> PROGRAM_FILES = { "define.cl", "sph.cl", "fluids.cl", "utils.cl", "grid.cl" };
+
+std::string ProgramBuildOptions(const Geometry::BoxSize3D& boxSize, const Geometry::BoxSize3D& gridRes, size_t nbInstances)
+{
+  assert(boxSize.x / gridRes.x == boxSize.y / gridRes.y);
+  assert(boxSize.z / gridRes.z == boxSize.y / gridRes.y);
+
+  float effectRadius = ((float)boxSize.x) / gridRes.x;
+
+  std::ostringstream clBuildOptions;
+  clBuildOptions << "-DEFFECT_RADIUS=" << Utils::FloatToStr(effectRadius);
+  clBuildOptions << " -DABS_WALL_X=" << Utils::FloatToStr(boxSize.x / 2.0f);
+  clBuildOptions << " -DABS_WALL_Y=" << Utils::FloatToStr(boxSize.y / 2.0f);
+  clBuildOptions << " -DABS_WALL_Z=" << Utils::FloatToStr(boxSize.z / 2.0f);
+  clBuildOptions << " -DGRID_RES_X=" << gridRes.x;
+  clBuildOptions << " -DGRID_RES_Y=" << gridRes.y;
+  clBuildOptions << " -DGRID_RES_Z=" << gridRes.z;
+  clBuildOptions << " -DGRID_CELL_SIZE_XYZ=" << Utils::FloatToStr((float)boxSize.x / gridRes.x);
+  clBuildOptions << " -DGRID_NUM_CELLS=" << gridRes.x * gridRes.y * gridRes.z;
+  clBuildOptions << " -DNUM_INSTANCES=" << nbInstances;
+  clBuildOptions << " -DPOLY6_COEFF=" << Utils::FloatToStr(315.0f / (64.0f * Math::PI_F * std::pow(effectRadius, 9.f)));
+  clBuildOptions << " -DSPIKY_COEFF=" << Utils::FloatToStr(15.0f / (Math::PI_F * std::pow(effectRadius, 6.f)));
+  clBuildOptions << " -DMAX_VEL=" << Utils::FloatToStr(30.0f);
+
+  return clBuildOptions.str();
+}
 }
 
 Fluids::Fluids(ModelParams params)
     : Model(params)
     , m_simplifiedMode(true)
     , m_maxNbPartsInCell(100)
-    , m_radixSort(params.maxNbParticles)
+    , m_radixSort(clNamespace(), params.maxNbParticles)
     , m_kernelInputs(std::make_unique<FluidKernelInputs>())
+    , m_stepKernelInputs(std::make_unique<FluidKernelInputs>())
+    , m_areParamsDirty(true)
     , m_initialCase(CaseType::DAM)
     , m_nbJacobiIters(2)
+    , m_nbSubsteps(1)
+    , m_nbInstances(std::max(params.nbInstances, (size_t)1))
+    , m_isOutOfCore(params.nbOutOfCoreParticles > params.maxNbParticles)
+    , m_maxNbOutOfCoreParticles(params.nbOutOfCoreParticles)
+    , m_nbPartitions(std::max(params.nbPartitions, (size_t)1))
+    , m_healthCheck(HealthCheck::DISABLED)
+    , m_healthCounts({ 0, 0, 0, 0 })
+    , m_isHealthReadPending(false)
+    , m_isBlownUp(false)
+    , m_nbStepsSinceHealthRead(0)
+    , m_nbPendingHealthSteps(0)
+    , m_nbUpdates(0)
+    , m_nbCheckedUpdates(0)
+    , m_pendingHealthUpdate(0)
+    , m_snapshotUpdates({ NO_SNAPSHOT, NO_SNAPSHOT })
+    , m_latestSnapshot(0)
+    , m_hasSnapshotBuffers(false)
+    , m_nbActiveParticles(0)
+    , m_isWarmStartEnabled(false)
 {
+  if (m_isOutOfCore && m_nbInstances > 1)
+  {
+    LOG_ERROR("Out-of-core mode not supported with several instances, disabling it");
+    m_isOutOfCore = false;
+  }
+
+  if (m_nbPartitions > 1)
+  {
+    if (m_nbInstances > 1)
+    {
+      LOG_ERROR("Domain decomposition not supported with several instances, disabling it");
+      m_nbPartitions = 1;
+    }
+    else
+    {
+      m_nbPartitions = std::min(getCLContext().createPartitions(m_nbPartitions), m_nbPartitions);
+      if (m_nbPartitions < 2)
+      {
+        LOG_ERROR("Device cannot be partitioned, disabling domain decomposition");
+        m_nbPartitions = 1;
+      }
+    }
+  }
+
+  m_chunks.resize(2 * m_nbPartitions);
+
+  m_instanceParams.resize(m_nbInstances,
+      { m_kernelInputs->restDensity, m_kernelInputs->relaxCFM, m_kernelInputs->vorticityConfCoeff, m_kernelInputs->xsphViscosityCoeff });
+
   createProgram();
 
   createBuffers();
 
   createKernels();
 
+  // Only the particles of the last slab are in device buffers when streamed from host
+  if (!isStreamedFromHost())
+    m_statistics = std::make_unique<Statistics>(clNamespace(), "p_vel", "p_density");
+
+  // Each partition sorts its own slab
+  for (size_t partition = 0; m_nbPartitions > 1 && partition < m_nbPartitions; ++partition)
+  {
+    getPartitionCLContext(partition);
+    m_partitionRadixSorts.push_back(std::make_unique<RadixSort>(partitionCLNamespace(partition), m_maxNbParticles));
+  }
+
   m_init = (m_kernelInputs != nullptr);
 
   reset();
@@ -99,74 +229,118 @@ Fluids::Fluids(ModelParams params)
 // Must be on implementation side as FluidKernelInputs must be complete
 Fluids::~Fluids() {};
 
-bool Fluids::createProgram() const
+void Fluids::PrebuildPrograms(const ModelParams& params)
 {
-  CL::Context& clContext = CL::Context::Get();
-
-  assert(m_boxSize.x / m_gridRes.x == m_boxSize.y / m_gridRes.y);
-  assert(m_boxSize.z / m_gridRes.z == m_boxSize.y / m_gridRes.y);
+  CL::Context::Get().prebuildProgram(PROGRAM_FILES, ProgramBuildOptions(params.boxSize, params.gridRes, std::max(params.nbInstances, (size_t)1)));
+}
 
-  float effectRadius = ((float)m_boxSize.x) / m_gridRes.x;
+bool Fluids::createProgram() const
+{
+  const std::string clBuildOptions = ProgramBuildOptions(m_boxSize, m_gridRes, m_nbInstances);
+  LOG_INFO(clBuildOptions);
 
-  std::ostringstream clBuildOptions;
-  clBuildOptions << "-DEFFECT_RADIUS=" << Utils::FloatToStr(effectRadius);
-  clBuildOptions << " -DABS_WALL_X=" << Utils::FloatToStr(m_boxSize.x / 2.0f);
-  clBuildOptions << " -DABS_WALL_Y=" << Utils::FloatToStr(m_boxSize.y / 2.0f);
-  clBuildOptions << " -DABS_WALL_Z=" << Utils::FloatToStr(m_boxSize.z / 2.0f);
-  clBuildOptions << " -DGRID_RES_X=" << m_gridRes.x;
-  clBuildOptions << " -DGRID_RES_Y=" << m_gridRes.y;
-  clBuildOptions << " -DGRID_RES_Z=" << m_gridRes.z;
-  clBuildOptions << " -DGRID_CELL_SIZE_XYZ=" << Utils::FloatToStr((float)m_boxSize.x / m_gridRes.x);
-  clBuildOptions << " -DGRID_NUM_CELLS=" << m_nbCells;
-  clBuildOptions << " -DNUM_MAX_PARTS_IN_CELL=" << m_maxNbPartsInCell;
-  clBuildOptions << " -DPOLY6_COEFF=" << Utils::FloatToStr(315.0f / (64.0f * Math::PI_F * std::pow(effectRadius, 9.f)));
-  clBuildOptions << " -DSPIKY_COEFF=" << Utils::FloatToStr(15.0f / (Math::PI_F * std::pow(effectRadius, 6.f)));
-  clBuildOptions << " -DMAX_VEL=" << Utils::FloatToStr(30.0f);
+  getCLContext().createProgram(PROGRAM_FLUIDS, PROGRAM_FILES, clBuildOptions);
 
-  LOG_INFO(clBuildOptions.str());
-  // file.cl order matters, define.cl must be first
-  clContext.createProgram(PROGRAM_FLUIDS, std::vector<std::string>({ "define.cl", "sph.cl", "fluids.cl", "utils.cl", "grid.cl" }), clBuildOptions.str());
+  for (size_t partition = 0; m_nbPartitions > 1 && partition < m_nbPartitions; ++partition)
+    getPartitionCLContext(partition).createProgram(PROGRAM_FLUIDS, PROGRAM_FILES, clBuildOptions);
 
   return true;
 }
 
 bool Fluids::createBuffers() const
 {
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   clContext.createGLBuffer("u_cameraPos", m_cameraVBO, CL_MEM_READ_ONLY);
   clContext.createGLBuffer("p_pos", m_particlePosVBO, CL_MEM_READ_WRITE);
   clContext.createGLBuffer("p_col", m_particleColVBO, CL_MEM_READ_WRITE);
   clContext.createGLBuffer("c_partDetector", m_gridVBO, CL_MEM_READ_WRITE);
 
+  bool isCreated = createSimulationBuffers(clContext, m_isOutOfCore);
+
+  // Partitions cannot share OpenGL buffers, each one gets plain position and color buffers
+  for (size_t partition = 0; m_nbPartitions > 1 && partition < m_nbPartitions; ++partition)
+  {
+    CL::Context& partitionContext = getPartitionCLContext(partition);
+    partitionContext.createBuffer("p_pos", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+    partitionContext.createBuffer("p_col", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+    isCreated &= createSimulationBuffers(partitionContext, true);
+  }
+
+  return isCreated;
+}
+
+bool Fluids::createSimulationBuffers(CL::Context& clContext, bool hasChunkIndex) const
+{
+  // Non GL buffers are carved from a single device allocation
+  // Corrections, vorticity and viscosity input are scratch buffers used one after the other within a step, they share memory
+  clContext.beginArena("FluidsArena");
+
   clContext.createBuffer("p_density", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_predPos", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_corrPos", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+  clContext.createBuffer("p_corrPos", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE, "Float4Scratch");
   clContext.createBuffer("p_constFactor", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_vel", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_velInViscosity", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
-  clContext.createBuffer("p_vort", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+  clContext.createBuffer("p_velInViscosity", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE, "Float4Scratch");
+  clContext.createBuffer("p_vort", 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE, "Float4Scratch");
   clContext.createBuffer("p_cellID", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
   clContext.createBuffer("p_cameraDist", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
 
-  clContext.createBuffer("c_startEndPartID", 2 * m_nbCells * sizeof(unsigned int), CL_MEM_READ_WRITE);
+  // Each instance has its own set of cells in ensemble mode
+  clContext.createBuffer("c_startEndPartID", 2 * m_nbCells * m_nbInstances * sizeof(unsigned int), CL_MEM_READ_WRITE);
 
-  return true;
+  clContext.createBuffer("i_fluidParams", 4 * m_nbInstances * sizeof(float), CL_MEM_READ_ONLY);
+  // Parameters shared by all particles, read from constant memory
+  clContext.createBuffer("u_fluidParams", sizeof(FluidKernelInputs), CL_MEM_READ_ONLY);
+
+  // Counters of faulty particles, see HEALTH_* defines
+  clContext.createBuffer("s_health", 4 * sizeof(unsigned int), CL_MEM_READ_WRITE);
+
+  // Sleeping particles, rest steps are carried through the sorts as float values
+  clContext.createBuffer("p_restSteps", m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+  clContext.createBuffer("p_activeIDs", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
+  clContext.createBuffer("c_isActive", m_nbCells * m_nbInstances * sizeof(unsigned int), CL_MEM_READ_WRITE, "CellFlagsScratch");
+  clContext.createBuffer("s_nbActive", sizeof(unsigned int), CL_MEM_READ_WRITE);
+
+  // Unilateral constraint, lists are filled again at each Jacobi iteration
+  // Cells holding constrained particles are flagged once cell activity has been used
+  clContext.createBuffer("p_constrainedIDs", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
+  clContext.createBuffer("p_correctedIDs", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
+  clContext.createBuffer("c_isConstrained", m_nbCells * m_nbInstances * sizeof(unsigned int), CL_MEM_READ_WRITE, "CellFlagsScratch");
+  clContext.createBuffer("s_nbConstrained", sizeof(unsigned int), CL_MEM_READ_WRITE);
+  clContext.createBuffer("s_nbCorrected", sizeof(unsigned int), CL_MEM_READ_WRITE);
+
+  if (hasChunkIndex)
+    clContext.createBuffer("p_chunkIndex", m_maxNbParticles * sizeof(unsigned int), CL_MEM_READ_WRITE);
+
+  return clContext.endArena();
 }
 
 bool Fluids::createKernels() const
 {
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   // Init only
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_INFINITE_POS, { "p_pos" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_RESET_FLOAT, { "p_constFactor" });
 
   // For rendering purpose only
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_RESET_PART_DETECTOR, { "c_partDetector" });
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_PART_DETECTOR, { "p_pos", "c_partDetector" });
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_RESET_CAMERA_DIST, { "p_cameraDist" });
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_CAMERA_DIST, { "p_pos", "u_cameraPos", "p_cameraDist" });
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_COLOR, { "p_density", "", "p_col" });
+
+  bool isCreated = createSimulationKernels(clContext);
+
+  for (size_t partition = 0; m_nbPartitions > 1 && partition < m_nbPartitions; ++partition)
+    isCreated &= createSimulationKernels(getPartitionCLContext(partition));
+
+  return isCreated;
+}
+
+bool Fluids::createSimulationKernels(CL::Context& clContext) const
+{
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_COLOR, { "p_density", "u_fluidParams", "p_col" });
 
   // Radix Sort based on 3D grid, using predicted positions, not corrected ones
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_RESET_CELL_ID, { "p_cellID" });
@@ -175,47 +349,101 @@ bool Fluids::createKernels() const
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_RESET_START_END_CELL, { "c_startEndPartID" });
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_START_CELL, { "p_cellID", "c_startEndPartID" });
   clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_END_CELL, { "p_cellID", "c_startEndPartID" });
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_ADJUST_END_CELL, { "c_startEndPartID" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_ADJUST_END_CELL, { "", "c_startEndPartID" });
+
+  // Sleeping particles, excluded ones are skipped by the kernels dispatched over active ones
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_RESET_CELL_ACTIVITY, { "c_isActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_CELL_ACTIVITY, { "p_pos", "p_restSteps", "c_isActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_EXCLUDE_SLEEPING, { "p_pos", "c_isActive", "p_restSteps", "p_vel" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_ACTIVE_LIST, { "p_restSteps", "s_nbActive", "p_activeIDs", "p_constFactor" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_UPDATE_REST_STEPS, { "p_predPos", "p_vel", "p_density", "u_fluidParams", "i_fluidParams", "p_restSteps", "p_activeIDs", "s_nbActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_WAKE_PARTICLES, { "p_restSteps" });
+
+  // Unilateral constraint, constraint kernels are bound to the lists along with parameters
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_RESET_CONSTRAINED_CELLS, { "c_isConstrained", "s_nbConstrained", "s_nbCorrected" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_CONSTRAINED_LIST, { "p_density", "p_predPos", "p_cellID", "u_fluidParams", "i_fluidParams", "s_nbConstrained", "p_constrainedIDs", "c_isConstrained", "p_constFactor", "p_activeIDs", "s_nbActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FILL_CORRECTED_LIST, { "p_predPos", "c_isConstrained", "u_fluidParams", "s_nbCorrected", "p_correctedIDs", "p_activeIDs", "s_nbActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_FLAG_WARM_STARTED_CELLS, { "p_constFactor", "p_cellID", "u_fluidParams", "c_isConstrained", "p_activeIDs", "s_nbActive" });
 
   // Position Based Fluids
   /// Position prediction
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_PREDICT_POS, { "p_pos", "p_vel", "", "p_predPos" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_PREDICT_POS, { "p_pos", "p_vel", "p_restSteps", "u_fluidParams", "p_predPos" });
   /// Boundary conditions
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_APPLY_BOUNDARY, { "p_predPos" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_APPLY_BOUNDARY, { "p_predPos", "s_health", "u_fluidParams", "p_activeIDs", "s_nbActive" });
   /// Jacobi solver to correct position
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_DENSITY, { "p_predPos", "c_startEndPartID", "", "p_density" });
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_CONSTRAINT_FACTOR, { "p_predPos", "p_density", "c_startEndPartID", "", "p_constFactor" });
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_CONSTRAINT_CORRECTION, { "p_constFactor", "c_startEndPartID", "p_predPos", "", "p_corrPos" });
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_CORRECT_POS, { "p_corrPos", "p_predPos" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_DENSITY, { "p_predPos", "c_startEndPartID", "u_fluidParams", "p_density", "p_activeIDs", "s_nbActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_CONSTRAINT_FACTOR, { "p_predPos", "p_density", "c_startEndPartID", "u_fluidParams", "i_fluidParams", "p_constFactor", "p_activeIDs", "s_nbActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_CONSTRAINT_CORRECTION, { "p_constFactor", "c_startEndPartID", "p_predPos", "u_fluidParams", "i_fluidParams", "p_corrPos", "p_activeIDs", "s_nbActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_CORRECT_POS, { "p_corrPos", "u_fluidParams", "p_predPos", "p_activeIDs", "s_nbActive" });
   /// Velocity update and correction using vorticity confinement and xsph viscosity
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_UPDATE_VEL, { "p_predPos", "p_pos", "", "p_vel" });
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_COMPUTE_VORTICITY, { "p_predPos", "c_startEndPartID", "p_vel", "", "p_vort" });
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_VORTICITY_CONFINEMENT, { "p_predPos", "c_startEndPartID", "p_vort", "", "p_vel" });
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_XSPH_VISCOSITY, { "p_predPos", "c_startEndPartID", "p_velInViscosity", "", "p_vel" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_UPDATE_VEL, { "p_predPos", "p_pos", "u_fluidParams", "p_vel", "s_health", "p_activeIDs", "s_nbActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_COMPUTE_VORTICITY, { "p_predPos", "c_startEndPartID", "p_vel", "u_fluidParams", "p_vort", "p_activeIDs", "s_nbActive" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_VORTICITY_CONFINEMENT, { "p_predPos", "c_startEndPartID", "p_vort", "u_fluidParams", "i_fluidParams", "p_vel", "p_activeIDs", "s_nbActive", "p_restSteps" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_XSPH_VISCOSITY, { "p_predPos", "c_startEndPartID", "p_velInViscosity", "u_fluidParams", "i_fluidParams", "p_vel", "p_activeIDs", "s_nbActive" });
   /// Position update
-  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_UPDATE_POS, { "p_predPos", "p_pos" });
+  clContext.createKernel(PROGRAM_FLUIDS, KERNEL_UPDATE_POS, { "p_predPos", "u_fluidParams", "p_pos", "p_activeIDs", "s_nbActive" });
 
   return true;
 }
 
 void Fluids::updateFluidsParamsInKernels()
 {
-  if (!m_init)
+  if (!m_init || !m_areParamsDirty)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  m_areParamsDirty = false;
 
   m_kernelInputs->dim = (m_dimension == Geometry::Dimension::dim2D) ? 2 : 3;
 
-  clContext.setKernelArg(KERNEL_PREDICT_POS, 2, sizeof(FluidKernelInputs), m_kernelInputs.get());
-  clContext.setKernelArg(KERNEL_UPDATE_VEL, 2, sizeof(FluidKernelInputs), m_kernelInputs.get());
-  clContext.setKernelArg(KERNEL_DENSITY, 2, sizeof(FluidKernelInputs), m_kernelInputs.get());
-  clContext.setKernelArg(KERNEL_CONSTRAINT_FACTOR, 3, sizeof(FluidKernelInputs), m_kernelInputs.get());
-  clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION, 3, sizeof(FluidKernelInputs), m_kernelInputs.get());
-  clContext.setKernelArg(KERNEL_FILL_COLOR, 1, sizeof(FluidKernelInputs), m_kernelInputs.get());
-  clContext.setKernelArg(KERNEL_COMPUTE_VORTICITY, 3, sizeof(FluidKernelInputs), m_kernelInputs.get());
-  clContext.setKernelArg(KERNEL_VORTICITY_CONFINEMENT, 3, sizeof(FluidKernelInputs), m_kernelInputs.get());
-  clContext.setKernelArg(KERNEL_XSPH_VISCOSITY, 3, sizeof(FluidKernelInputs), m_kernelInputs.get());
+  *m_stepKernelInputs = *m_kernelInputs;
+  m_stepKernelInputs->timeStep = m_kernelInputs->timeStep / (cl_float)std::max(m_nbSubsteps, (size_t)1);
+
+  setFluidsParamsInKernels(getCLContext());
+
+  for (size_t partition = 0; m_nbPartitions > 1 && partition < m_nbPartitions; ++partition)
+    setFluidsParamsInKernels(getPartitionCLContext(partition));
+
+  // Particles at rest with the former parameters may not be anymore, sleeping ones would never see the change
+  if (m_kernelInputs->isSleepingEnabled)
+    getCLContext().runKernel(KERNEL_WAKE_PARTICLES, m_maxNbParticles);
+}
+
+void Fluids::setFluidsParamsInKernels(CL::Context& clContext)
+{
+  // Enqueued before the kernels of the step, finished with them before parameters can be changed again
+  clContext.loadBufferFromHost("u_fluidParams", 0, sizeof(FluidKernelInputs), m_stepKernelInputs.get(), false);
+
+  cl_uint maxNbPartsInCell = (cl_uint)m_maxNbPartsInCell;
+  clContext.setKernelArg(KERNEL_ADJUST_END_CELL, 0, sizeof(cl_uint), &maxNbPartsInCell);
+
+  // Health counters cost nothing when disabled, boundary ones are only enabled on the first pass of each step
+  cl_uint isHealthChecked = (m_healthCheck != HealthCheck::DISABLED) ? 1 : 0;
+  clContext.setKernelArg(KERNEL_UPDATE_VEL, 7, sizeof(cl_uint), &isHealthChecked);
+  cl_uint isClampCounted = 0;
+  clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 5, sizeof(cl_uint), &isClampCounted);
+  // Artificial pressure is only disabled during the warm start pass
+  cl_uint isArtPressureApplied = 1;
+  clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION, 8, sizeof(cl_uint), &isArtPressureApplied);
+
+  // Constraint is solved over the compacted constrained particles and their neighbors in unilateral mode, over active ones otherwise
+  const bool isUnilateral = (bool)m_kernelInputs->isUnilateralEnabled;
+  clContext.setKernelArg(KERNEL_CONSTRAINT_FACTOR, 6, isUnilateral ? "p_constrainedIDs" : "p_activeIDs");
+  clContext.setKernelArg(KERNEL_CONSTRAINT_FACTOR, 7, isUnilateral ? "s_nbConstrained" : "s_nbActive");
+  clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION, 6, isUnilateral ? "p_correctedIDs" : "p_activeIDs");
+  clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION, 7, isUnilateral ? "s_nbCorrected" : "s_nbActive");
+  clContext.setKernelArg(KERNEL_CORRECT_POS, 3, isUnilateral ? "p_correctedIDs" : "p_activeIDs");
+  clContext.setKernelArg(KERNEL_CORRECT_POS, 4, isUnilateral ? "s_nbCorrected" : "s_nbActive");
+}
+
+void Fluids::updateInstanceParamsInKernels()
+{
+  if (!m_init)
+    return;
+
+  getCLContext().loadBufferFromHost("i_fluidParams", 0, 4 * sizeof(float) * m_instanceParams.size(), m_instanceParams.data());
+
+  for (size_t partition = 0; m_nbPartitions > 1 && partition < m_nbPartitions; ++partition)
+    getPartitionCLContext(partition).loadBufferFromHost("i_fluidParams", 0, 4 * sizeof(float) * m_instanceParams.size(), m_instanceParams.data());
 }
 
 void Fluids::reset()
@@ -223,9 +451,12 @@ void Fluids::reset()
   if (!m_init)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
+  // Dimension may have changed
+  m_areParamsDirty = true;
   updateFluidsParamsInKernels();
+  updateInstanceParamsInKernels();
 
   initFluidsParticles();
 
@@ -236,6 +467,18 @@ void Fluids::reset()
 
   clContext.runKernel(KERNEL_RESET_CELL_ID, m_maxNbParticles);
   clContext.runKernel(KERNEL_RESET_CAMERA_DIST, m_maxNbParticles);
+  clContext.runKernel(KERNEL_WAKE_PARTICLES, m_maxNbParticles);
+  m_nbActiveParticles = 0;
+  clContext.runKernel(KERNEL_RESET_FLOAT, m_maxNbParticles);
+
+  // Snapshots and counters of the previous simulation are not relevant anymore
+  resetHealthCounters();
+  m_lastHealth = Health();
+  m_isHealthReadPending = false;
+  m_isBlownUp = false;
+  m_nbUpdates = 0;
+  m_nbCheckedUpdates = 0;
+  m_snapshotUpdates = { NO_SNAPSHOT, NO_SNAPSHOT };
 }
 
 void Fluids::initFluidsParticles()
@@ -243,7 +486,7 @@ void Fluids::initFluidsParticles()
   if (!m_init)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
 
   clContext.acquireGLBuffers({ "p_pos", "p_col" });
 
@@ -259,20 +502,20 @@ void Fluids::initFluidsParticles()
     switch (m_initialCase)
     {
     case CaseType::DAM:
-      m_currNbParticles = Utils::NbParticles::P4K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P4K);
 
       shape = Geometry::Shape2D::Rectangle;
       startFluidPos = { 0.0f, m_boxSize.y / -2.0f, m_boxSize.z / -2.0f };
       endFluidPos = { 0.0f, 0.0f, 0.0f };
       break;
     case CaseType::BOMB:
-      m_currNbParticles = Utils::NbParticles::P4K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P4K);
       shape = Geometry::Shape2D::Rectangle;
       startFluidPos = { 0.0f, m_boxSize.y / -6.0f, m_boxSize.z / -6.0f };
       endFluidPos = { 0.0f, m_boxSize.y / 6.0f, m_boxSize.z / 6.0f };
       break;
     case CaseType::DROP:
-      m_currNbParticles = Utils::NbParticles::P512;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P512);
       shape = Geometry::Shape2D::Rectangle;
       startFluidPos = { 0.0f, 2.0f * m_boxSize.y / 10.0f, m_boxSize.z / -10.0f };
       endFluidPos = { 0.0f, 4.0f * m_boxSize.y / 10.0f, m_boxSize.z / 10.0f };
@@ -282,7 +525,7 @@ void Fluids::initFluidsParticles()
       break;
     }
 
-    const auto& subdiv2D = Utils::GetNbParticlesSubdiv2D((Utils::NbParticles)m_currNbParticles);
+    const auto& subdiv2D = Utils::GetNbParticlesSubdiv2D(m_currNbParticles);
     Math::int2 grid2DRes = { subdiv2D[0], subdiv2D[1] };
 
     gridVerts = Geometry::Generate2DGrid(shape, Geometry::Plane::YZ, grid2DRes, startFluidPos, endFluidPos);
@@ -290,8 +533,8 @@ void Fluids::initFluidsParticles()
     // Specific case
     if (m_initialCase == CaseType::DROP)
     {
-      m_currNbParticles += Utils::NbParticles::P4K;
-      Math::int2 grid2DRes = { 64, 128 };
+      m_currNbParticles += scaledNbParticles(Utils::NbParticles::P4K);
+      Math::int2 grid2DRes = { scaledSubdiv(64), scaledSubdiv(128) };
       startFluidPos = { 0.0f, m_boxSize.y / -2.0f, m_boxSize.z / -2.0f };
       endFluidPos = { 0.0f, 0.0f, m_boxSize.z / 2.0f };
 
@@ -307,19 +550,19 @@ void Fluids::initFluidsParticles()
     switch (m_initialCase)
     {
     case CaseType::DAM:
-      m_currNbParticles = Utils::NbParticles::P130K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P130K);
       shape = Geometry::Shape3D::Box;
       startFluidPos = { m_boxSize.x / -2.0f, m_boxSize.y / -2.0f, m_boxSize.z / -2.0f };
       endFluidPos = { m_boxSize.x / 2.0f, 0.0f, 0.0f };
       break;
     case CaseType::BOMB:
-      m_currNbParticles = Utils::NbParticles::P65K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P65K);
       shape = Geometry::Shape3D::Sphere;
       startFluidPos = { m_boxSize.x / -6.0f, m_boxSize.y / -6.0f, m_boxSize.z / -6.0f };
       endFluidPos = { m_boxSize.x / 6.0f, m_boxSize.y / 6.0f, m_boxSize.z / 6.0f };
       break;
     case CaseType::DROP:
-      m_currNbParticles = Utils::NbParticles::P4K;
+      m_currNbParticles = scaledNbParticles(Utils::NbParticles::P4K);
       shape = Geometry::Shape3D::Box;
       startFluidPos = { m_boxSize.x / -10.0f, 2.0f * m_boxSize.y / 10.0f, m_boxSize.z / -10.0f };
       endFluidPos = { m_boxSize.x / 10.0f, 4.0f * m_boxSize.y / 10.0f, m_boxSize.z / 10.0f };
@@ -329,7 +572,7 @@ void Fluids::initFluidsParticles()
       break;
     }
 
-    const auto& subdiv3D = Utils::GetNbParticlesSubdiv3D((Utils::NbParticles)m_currNbParticles);
+    const auto& subdiv3D = Utils::GetNbParticlesSubdiv3D(m_currNbParticles);
     Math::int3 grid3DRes = { subdiv3D[0], subdiv3D[1], subdiv3D[2] };
 
     gridVerts = Geometry::Generate3DGrid(shape, grid3DRes, startFluidPos, endFluidPos);
@@ -337,8 +580,8 @@ void Fluids::initFluidsParticles()
     // Specific case
     if (m_initialCase == CaseType::DROP)
     {
-      m_currNbParticles += Utils::NbParticles::P65K;
-      Math::int3 grid3DRes = { 64, 16, 64 };
+      m_currNbParticles += scaledNbParticles(Utils::NbParticles::P65K);
+      Math::int3 grid3DRes = { scaledSubdiv(64), scaledSubdiv(16), scaledSubdiv(64) };
       startFluidPos = { m_boxSize.x / -2.0f, m_boxSize.y / -2.0f, m_boxSize.z / -2.0f };
       endFluidPos = { m_boxSize.x / 2.0f, m_boxSize.y / -2.55f, m_boxSize.z / 2.0f };
 
@@ -348,16 +591,53 @@ void Fluids::initFluidsParticles()
     }
   }
 
+  if (isStreamedFromHost())
+  {
+    m_hostPos.resize(gridVerts.size());
+    std::transform(gridVerts.cbegin(), gridVerts.cend(), m_hostPos.begin(),
+        [](const Math::float3& vertPos) -> std::array<float, 4> { return { vertPos.x, vertPos.y, vertPos.z, 0.0f }; });
+    m_hostVel.assign(m_hostPos.size(), { 0.0f, 0.0f, 0.0f, 0.0f });
+    m_hostCol.assign(m_hostPos.size(), { 0.0f, 0.1f, 1.0f, 0.0f });
+    m_nextHostPos.resize(m_hostPos.size());
+    m_nextHostVel.resize(m_hostPos.size());
+
+    if (m_isOutOfCore)
+      LOG_INFO("Out-of-core mode, {} particles streamed through device buffers of {} particles", m_hostPos.size(), m_maxNbParticles);
+    if (m_nbPartitions > 1)
+      LOG_INFO("Domain decomposition, {} particles simulated by slabs on {} partitions", m_hostPos.size(), m_nbPartitions);
+
+    uploadOutOfCoreSubsample();
+
+    clContext.releaseGLBuffers({ "p_pos", "p_col" });
+    return;
+  }
+
   float inf = std::numeric_limits<float>::infinity();
   std::vector<std::array<float, 4>> pos(m_maxNbParticles, std::array<float, 4>({ inf, inf, inf, 0.0f }));
 
-  std::transform(gridVerts.cbegin(), gridVerts.cend(), pos.begin(),
-      [](const Math::float3& vertPos) -> std::array<float, 4> { return { vertPos.x, vertPos.y, vertPos.z, 0.0f }; });
+  // Ensemble mode, replicating the case for each instance, whose ID is stored in w coordinate
+  size_t nbFilledInstances = std::min(m_nbInstances, m_maxNbParticles / std::max(gridVerts.size(), (size_t)1));
+  if (nbFilledInstances < m_nbInstances)
+    LOG_ERROR("Only {} instances out of {} can be filled with {} particles each", nbFilledInstances, m_nbInstances, gridVerts.size());
+
+  for (size_t instance = 0; instance < nbFilledInstances; ++instance)
+  {
+    const float instanceID = (float)instance;
+    std::transform(gridVerts.cbegin(), gridVerts.cend(), pos.begin() + instance * gridVerts.size(),
+        [instanceID](const Math::float3& vertPos) -> std::array<float, 4> { return { vertPos.x, vertPos.y, vertPos.z, instanceID }; });
+  }
+
+  m_currNbParticles = nbFilledInstances * gridVerts.size();
 
   clContext.loadBufferFromHost("p_pos", 0, 4 * sizeof(float) * pos.size(), pos.data());
 
-  std::vector<std::array<float, 4>> vel(m_maxNbParticles, std::array<float, 4>({ 0.0f, 0.0f, 0.0f, 0.0f }));
-  clContext.loadBufferFromHost("p_vel", 0, 4 * sizeof(float) * vel.size(), vel.data());
+  // Velocity is not shared with OpenGL, it is written in place on host unified memory
+  auto* vel = static_cast<std::array<float, 4>*>(clContext.mapBuffer("p_vel", CL_MAP_WRITE_INVALIDATE_REGION));
+  if (vel != nullptr)
+  {
+    std::fill(vel, vel + m_maxNbParticles, std::array<float, 4>({ 0.0f, 0.0f, 0.0f, 0.0f }));
+    clContext.unmapBuffer("p_vel");
+  }
 
   std::vector<std::array<float, 4>> col(m_maxNbParticles, std::array<float, 4>({ 0.0f, 0.1f, 1.0f, 0.0f }));
   clContext.loadBufferFromHost("p_col", 0, 4 * sizeof(float) * col.size(), col.data());
@@ -370,72 +650,558 @@ void Fluids::update()
   if (!m_init)
     return;
 
-  CL::Context& clContext = CL::Context::Get();
+  CL::Context& clContext = getCLContext();
+
+  // Parameters changed since the last step are written at once
+  updateFluidsParamsInKernels();
 
   clContext.acquireGLBuffers({ "p_pos", "p_col", "c_partDetector", "u_cameraPos" });
 
   if (!m_pause)
   {
-    // Predicting velocity and position
-    clContext.runKernel(KERNEL_PREDICT_POS, m_currNbParticles);
+    // Particles are rolled back with OpenGL buffers acquired
+    if (m_healthCheck != HealthCheck::DISABLED)
+      checkHealth();
 
-    // NNS - spatial partitioning
-    clContext.runKernel(KERNEL_FILL_CELL_ID, m_currNbParticles);
+    // Rendering purpose, grid detector only depends on OpenGL buffers acquisition, it is reset while the step runs
+    clContext.enqueueMarker(EVENT_GL_ACQUIRED);
+    clContext.runKernelAsync(KERNEL_RESET_PART_DETECTOR, m_nbCells, { EVENT_GL_ACQUIRED });
 
-    m_radixSort.sort("p_cellID", { "p_pos", "p_col", "p_vel", "p_predPos" });
+    // Several simulation steps per frame can be run, tuned by the quality governor
+    for (size_t step = 0; step < m_nbSubsteps; ++step)
+    {
+      // Colors of out-of-core particles are filled slab by slab
+      if (isStreamedFromHost())
+        updateOutOfCore();
+      else
+        runSimulationStep(clContext, m_radixSort, m_currNbParticles, false, step + 1 == m_nbSubsteps);
+    }
+
+    m_nbStepsSinceHealthRead += m_nbSubsteps;
+    ++m_nbUpdates;
+
+    if (m_statistics)
+      m_statistics->record(m_currNbParticles, m_kernelInputs->restDensity);
+
+    // Only a subsample of out-of-core particles fits device buffers to be displayed
+    if (isStreamedFromHost())
+      uploadOutOfCoreSubsample();
+
+    // Rendering purpose, grid detector is filled while camera distances are computed
+    clContext.enqueueMarker(EVENT_STEP_DONE);
+    clContext.runKernelAsync(KERNEL_FILL_PART_DETECTOR, m_currNbParticles, { EVENT_STEP_DONE, KERNEL_RESET_PART_DETECTOR });
+  }
+
+  // Rendering purpose
+  clContext.runKernel(KERNEL_FILL_CAMERA_DIST, m_currNbParticles);
+
+  // Particles are moved by the sort, and OpenGL buffers released after it
+  if (!m_pause)
+    clContext.enqueueBarrier({ KERNEL_FILL_PART_DETECTOR });
+
+  m_radixSort.sort("p_cameraDist", { "p_pos", "p_col", "p_vel", "p_predPos" }, carriedFloatBuffers());
+
+  // Complete once OpenGL buffers are released
+  if (m_kernelInputs->isSleepingEnabled && !m_pause)
+    clContext.unloadBufferFromDevice("s_nbActive", 0, sizeof(m_nbActiveParticles), &m_nbActiveParticles, false);
+
+  clContext.releaseGLBuffers({ "p_pos", "p_col", "c_partDetector", "u_cameraPos" });
+}
+
+void Fluids::runSimulationStep(CL::Context& clContext, RadixSort& radixSort, size_t nbParticles, bool hasChunkIndex, bool isFillingColor)
+{
+  // Only supported in-core, sleeping is refused when streamed from host
+  const bool isSleepingEnabled = (bool)m_kernelInputs->isSleepingEnabled;
+  const bool isUnilateralEnabled = (bool)m_kernelInputs->isUnilateralEnabled;
+
+  // Excluding sleeping particles far from any moving one, before they are given gravity
+  if (isSleepingEnabled)
+  {
+    clContext.runKernel(KERNEL_RESET_CELL_ACTIVITY, m_nbCells * m_nbInstances);
+    clContext.runKernel(KERNEL_FILL_CELL_ACTIVITY, nbParticles);
+    clContext.runKernel(KERNEL_EXCLUDE_SLEEPING, nbParticles);
+  }
+
+  // Predicting velocity and position
+  clContext.runKernel(KERNEL_PREDICT_POS, nbParticles);
 
-    clContext.runKernel(KERNEL_RESET_START_END_CELL, m_nbCells);
-    clContext.runKernel(KERNEL_FILL_START_CELL, m_currNbParticles);
-    clContext.runKernel(KERNEL_FILL_END_CELL, m_currNbParticles);
+  // NNS - spatial partitioning
+  clContext.runKernel(KERNEL_FILL_CELL_ID, nbParticles);
 
-    if (m_simplifiedMode)
-      clContext.runKernel(KERNEL_ADJUST_END_CELL, m_nbCells);
+  // Index of out-of-core particles inside their chunk
+  std::vector<std::string> carriedUintBuffers;
+  if (hasChunkIndex)
+    carriedUintBuffers.push_back("p_chunkIndex");
 
-    // Correcting positions to fit constraints
-    for (int iter = 0; iter < m_nbJacobiIters; ++iter)
+  radixSort.sort("p_cellID", { "p_pos", "p_col", "p_vel", "p_predPos" }, carriedFloatBuffers(), carriedUintBuffers);
+
+  clContext.runKernel(KERNEL_RESET_START_END_CELL, m_nbCells * m_nbInstances);
+  clContext.runKernel(KERNEL_FILL_START_CELL, nbParticles);
+  clContext.runKernel(KERNEL_FILL_END_CELL, nbParticles);
+
+  if (m_simplifiedMode)
+    clContext.runKernel(KERNEL_ADJUST_END_CELL, m_nbCells * m_nbInstances);
+
+  // Wall clamps are only counted by the first boundary pass of the step, other ones
+  // clamping the same particles again, arguments being copied when set
+  const cl_uint isClampCounted = (m_healthCheck != HealthCheck::DISABLED) ? 1 : 0;
+  const cl_uint isClampNotCounted = 0;
+  // Same for artificial pressure, carried factors replaying the correction of the previous step without it
+  const cl_uint isArtPressureApplied = 1;
+  const cl_uint isArtPressureNotApplied = 0;
+  clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 5, sizeof(cl_uint), &isClampCounted);
+
+  // Compacted list of the particles sorted by cell which are not excluded
+  // There is no indirect dispatch, the kernels below are launched over all particles and skip items past the list
+  if (isSleepingEnabled)
+  {
+    // Host memory must stay valid until the transfer is done
+    static const unsigned int zero = 0;
+    clContext.loadBufferFromHost("s_nbActive", 0, sizeof(zero), &zero, false);
+    clContext.runKernel(KERNEL_FILL_ACTIVE_LIST, nbParticles);
+  }
+
+  // Warm start, correcting positions with the constraint factors of the previous step before solving again
+  if (m_isWarmStartEnabled)
+  {
+    clContext.runKernel(KERNEL_APPLY_BOUNDARY, nbParticles);
+    clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 5, sizeof(cl_uint), &isClampNotCounted);
+
+    // Correction is dispatched over neighbors of particles with a carried factor, the lists of the last iteration being out of date
+    if (isUnilateralEnabled)
     {
-      // Clamping to boundary
-      clContext.runKernel(KERNEL_APPLY_BOUNDARY, m_currNbParticles);
-      // Computing density using SPH method
-      clContext.runKernel(KERNEL_DENSITY, m_currNbParticles);
-      // Computing constraint factor Lambda
-      clContext.runKernel(KERNEL_CONSTRAINT_FACTOR, m_currNbParticles);
-      // Computing position correction
-      clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION, m_currNbParticles);
-      // Correcting predicted position
-      clContext.runKernel(KERNEL_CORRECT_POS, m_currNbParticles);
+      clContext.runKernel(KERNEL_RESET_CONSTRAINED_CELLS, m_nbCells * m_nbInstances);
+      clContext.runKernel(KERNEL_FLAG_WARM_STARTED_CELLS, nbParticles);
+      clContext.runKernel(KERNEL_FILL_CORRECTED_LIST, nbParticles);
     }
 
-    // Updating velocity
-    clContext.runKernel(KERNEL_UPDATE_VEL, m_currNbParticles);
+    clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION, 8, sizeof(cl_uint), &isArtPressureNotApplied);
+    clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION, nbParticles);
+    clContext.setKernelArg(KERNEL_CONSTRAINT_CORRECTION, 8, sizeof(cl_uint), &isArtPressureApplied);
+    clContext.runKernel(KERNEL_CORRECT_POS, nbParticles);
+  }
 
-    if (m_kernelInputs->isVorticityConfEnabled)
+  // Correcting positions to fit constraints
+  for (int iter = 0; iter < m_nbJacobiIters; ++iter)
+  {
+    // Clamping to boundary
+    clContext.runKernel(KERNEL_APPLY_BOUNDARY, nbParticles);
+    clContext.setKernelArg(KERNEL_APPLY_BOUNDARY, 5, sizeof(cl_uint), &isClampNotCounted);
+    // Computing density using SPH method
+    clContext.runKernel(KERNEL_DENSITY, nbParticles);
+
+    // Density is final after last iteration, color is filled from it while the step goes on
+    if (isFillingColor && (size_t)iter + 1 == m_nbJacobiIters)
     {
-      // Computing vorticity
-      clContext.runKernel(KERNEL_COMPUTE_VORTICITY, m_currNbParticles);
-      // Applying vorticity confinement to attenue virtual damping
-      clContext.runKernel(KERNEL_VORTICITY_CONFINEMENT, m_currNbParticles);
-      // Copying velocity buffer as input for vorticity confinement correction
-      clContext.copyBuffer("p_vel", "p_velInViscosity");
-      // Applying xsph viscosity correction for a more coherent motion
-      clContext.runKernel(KERNEL_XSPH_VISCOSITY, m_currNbParticles);
+      clContext.enqueueMarker(EVENT_DENSITY_DONE);
+      clContext.runKernelAsync(KERNEL_FILL_COLOR, nbParticles, { EVENT_DENSITY_DONE });
     }
+    // Compacting compressed particles, the only ones with a unilateral constraint
+    if (isUnilateralEnabled)
+    {
+      clContext.runKernel(KERNEL_RESET_CONSTRAINED_CELLS, m_nbCells * m_nbInstances);
+      clContext.runKernel(KERNEL_FILL_CONSTRAINED_LIST, nbParticles);
+    }
+    // Computing constraint factor Lambda
+    clContext.runKernel(KERNEL_CONSTRAINT_FACTOR, nbParticles);
+    // Compacting particles moved by the constraint of a neighbor
+    if (isUnilateralEnabled)
+      clContext.runKernel(KERNEL_FILL_CORRECTED_LIST, nbParticles);
+    // Computing position correction
+    clContext.runKernel(KERNEL_CONSTRAINT_CORRECTION, nbParticles);
+    // Correcting predicted position
+    clContext.runKernel(KERNEL_CORRECT_POS, nbParticles);
+  }
 
-    // Updating pos
-    clContext.runKernel(KERNEL_UPDATE_POS, m_currNbParticles);
+  // Updating velocity
+  clContext.runKernel(KERNEL_UPDATE_VEL, nbParticles);
 
-    // Rendering purpose
-    clContext.runKernel(KERNEL_RESET_PART_DETECTOR, m_nbCells);
-    clContext.runKernel(KERNEL_FILL_PART_DETECTOR, m_currNbParticles);
-    clContext.runKernel(KERNEL_FILL_COLOR, m_currNbParticles);
+  if (m_kernelInputs->isVorticityConfEnabled)
+  {
+    // Computing vorticity
+    clContext.runKernel(KERNEL_COMPUTE_VORTICITY, nbParticles);
+    // Applying vorticity confinement to attenue virtual damping
+    clContext.runKernel(KERNEL_VORTICITY_CONFINEMENT, nbParticles);
+    // Copying velocity buffer as input for vorticity confinement correction
+    clContext.copyBuffer("p_vel", "p_velInViscosity");
+    // Applying xsph viscosity correction for a more coherent motion
+    clContext.runKernel(KERNEL_XSPH_VISCOSITY, nbParticles);
   }
 
-  // Rendering purpose
-  clContext.runKernel(KERNEL_FILL_CAMERA_DIST, m_currNbParticles);
+  // Counting quiet steps from final velocity and density
+  if (isSleepingEnabled)
+    clContext.runKernel(KERNEL_UPDATE_REST_STEPS, nbParticles);
 
-  m_radixSort.sort("p_cameraDist", { "p_pos", "p_col", "p_vel", "p_predPos" });
+  // Updating pos
+  clContext.runKernel(KERNEL_UPDATE_POS, nbParticles);
 
-  clContext.releaseGLBuffers({ "p_pos", "p_col", "c_partDetector", "u_cameraPos" });
+  if (isFillingColor && m_nbJacobiIters == 0)
+    clContext.runKernel(KERNEL_FILL_COLOR, nbParticles);
+
+  // Colors are moved along with particles by next sort
+  if (isFillingColor)
+    clContext.enqueueBarrier({ KERNEL_FILL_COLOR });
+}
+
+std::vector<std::string> Fluids::carriedFloatBuffers() const
+{
+  std::vector<std::string> bufferNames;
+
+  // Rest steps of sleeping particles, and density of excluded ones as it is not computed again
+  if (m_kernelInputs->isSleepingEnabled)
+  {
+    bufferNames.push_back("p_restSteps");
+    bufferNames.push_back("p_density");
+  }
+
+  // Constraint factors reused as initial guess by the next step
+  if (m_isWarmStartEnabled)
+    bufferNames.push_back("p_constFactor");
+
+  return bufferNames;
+}
+
+void Fluids::resetHealthCounters()
+{
+  // Host memory must stay valid until the transfer is done
+  static const std::array<unsigned int, 4> zeros = { 0, 0, 0, 0 };
+  getCLContext().loadBufferFromHost("s_health", 0, sizeof(zeros), zeros.data(), false);
+
+  m_nbStepsSinceHealthRead = 0;
+}
+
+void Fluids::checkHealth()
+{
+  CL::Context& clContext = getCLContext();
+
+  // Counters are never waited for, they are checked once their read back is complete
+  if (m_isHealthReadPending && clContext.isEventComplete(EVENT_HEALTH_READ))
+  {
+    m_isHealthReadPending = false;
+
+    m_lastHealth.nbSteps = m_nbPendingHealthSteps;
+    m_lastHealth.nbNonFiniteParts = m_healthCounts[HEALTH_NON_FINITE];
+    m_lastHealth.nbSpeedCappedParts = m_healthCounts[HEALTH_SPEED_CAPPED];
+    m_lastHealth.nbWallClamps = m_healthCounts[HEALTH_WALL_CLAMPED];
+
+    if (!isBlownUp(m_lastHealth))
+    {
+      m_nbCheckedUpdates = m_pendingHealthUpdate;
+      m_isBlownUp = false;
+    }
+    else if (m_healthCheck == HealthCheck::ROLLBACK)
+    {
+      LOG_ERROR("Fluids blow-up, {} non finite and {} speed capped particles over {} steps, rolling back",
+          m_lastHealth.nbNonFiniteParts, m_lastHealth.nbSpeedCappedParts, m_lastHealth.nbSteps);
+      rollback();
+      return;
+    }
+    else if (!m_isBlownUp)
+    {
+      LOG_ERROR("Fluids blow-up, {} non finite and {} speed capped particles over {} steps, relaxation CFM or time step may be too extreme",
+          m_lastHealth.nbNonFiniteParts, m_lastHealth.nbSpeedCappedParts, m_lastHealth.nbSteps);
+      m_isBlownUp = true;
+    }
+  }
+
+  // Counters of all the updates run so far, read back without blocking then reset
+  if (!m_isHealthReadPending && m_nbStepsSinceHealthRead > 0)
+  {
+    clContext.unloadBufferFromDevice("s_health", 0, sizeof(m_healthCounts), m_healthCounts.data(), false);
+    m_nbPendingHealthSteps = m_nbStepsSinceHealthRead;
+    m_pendingHealthUpdate = m_nbUpdates;
+    resetHealthCounters();
+    clContext.enqueueMarker(EVENT_HEALTH_READ);
+    m_isHealthReadPending = true;
+  }
+
+  if (m_healthCheck != HealthCheck::ROLLBACK || !m_hasSnapshotBuffers)
+    return;
+
+  // Particles before this update, the latest snapshot is only replaced once known to be good
+  const size_t latestSnapshotUpdate = m_snapshotUpdates[m_latestSnapshot];
+  if (latestSnapshotUpdate == NO_SNAPSHOT
+      || (latestSnapshotUpdate <= m_nbCheckedUpdates && m_nbUpdates >= latestSnapshotUpdate + NB_UPDATES_BETWEEN_SNAPSHOTS))
+  {
+    const size_t snapshot = (latestSnapshotUpdate == NO_SNAPSHOT) ? m_latestSnapshot : 1 - m_latestSnapshot;
+    clContext.copyBuffer("p_pos", "p_snapshotPos" + std::to_string(snapshot));
+    clContext.copyBuffer("p_vel", "p_snapshotVel" + std::to_string(snapshot));
+    m_snapshotUpdates[snapshot] = m_nbUpdates;
+    m_latestSnapshot = snapshot;
+  }
+}
+
+bool Fluids::isBlownUp(const Health& health) const
+{
+  return health.nbNonFiniteParts > 0
+      || health.nbSpeedCappedParts > BLOW_UP_SPEED_CAPPED_RATIO * m_currNbParticles * health.nbSteps;
+}
+
+void Fluids::rollback()
+{
+  // Latest snapshot known to be good
+  size_t snapshot = m_latestSnapshot;
+  if (m_snapshotUpdates[snapshot] == NO_SNAPSHOT || m_snapshotUpdates[snapshot] > m_nbCheckedUpdates)
+    snapshot = 1 - snapshot;
+
+  if (m_snapshotUpdates[snapshot] == NO_SNAPSHOT || m_snapshotUpdates[snapshot] > m_nbCheckedUpdates)
+  {
+    LOG_ERROR("No good snapshot to roll back to");
+    return;
+  }
+
+  CL::Context& clContext = getCLContext();
+  clContext.copyBuffer("p_snapshotPos" + std::to_string(snapshot), "p_pos");
+  clContext.copyBuffer("p_snapshotVel" + std::to_string(snapshot), "p_vel");
+  clContext.runKernel(KERNEL_WAKE_PARTICLES, m_maxNbParticles);
+
+  // Factors carried from the blown-up steps may be non finite, and are not in the order of restored particles
+  if (m_isWarmStartEnabled)
+    clContext.runKernel(KERNEL_RESET_FLOAT, m_maxNbParticles);
+
+  // Restored particles are the new starting point, the other snapshot may hold bad ones
+  m_snapshotUpdates[snapshot] = m_nbUpdates;
+  m_snapshotUpdates[1 - snapshot] = NO_SNAPSHOT;
+  m_latestSnapshot = snapshot;
+  m_nbCheckedUpdates = m_nbUpdates;
+
+  resetHealthCounters();
+}
+
+void Fluids::updateOutOfCore()
+{
+  const size_t nbParts = m_hostPos.size();
+  const size_t nbColumns = m_gridRes.x;
+  const float absWallX = m_boxSize.x / 2.0f;
+  const float cellSize = (float)m_boxSize.x / m_gridRes.x;
+
+  // Bucketing particles by grid column along x axis, with a counting sort
+  std::vector<size_t> particleColumn(nbParts);
+  std::vector<size_t> columnStart(nbColumns + 1, 0);
+  for (size_t i = 0; i < nbParts; ++i)
+  {
+    const float x = std::clamp(m_hostPos[i][0], -absWallX, absWallX) + absWallX;
+    particleColumn[i] = std::min((size_t)(x / cellSize), nbColumns - 1);
+    ++columnStart[particleColumn[i] + 1];
+  }
+  std::partial_sum(columnStart.begin(), columnStart.end(), columnStart.begin());
+
+  std::vector<size_t> sortedIndices(nbParts);
+  std::vector<size_t> columnFill(columnStart.begin(), columnStart.end() - 1);
+  for (size_t i = 0; i < nbParts; ++i)
+    sortedIndices[columnFill[particleColumn[i]]++] = i;
+
+  const size_t haloWidth = outOfCoreHaloWidth();
+
+  // Number of particles of a slab, including its halo
+  const auto nbPartsInSlab = [&columnStart, nbColumns, haloWidth](size_t firstColumn, size_t lastColumn)
+  {
+    const size_t firstHaloColumn = (firstColumn > haloWidth) ? firstColumn - haloWidth : 0;
+    const size_t lastHaloColumn = std::min(lastColumn + haloWidth, nbColumns - 1);
+    return columnStart[lastHaloColumn + 1] - columnStart[firstHaloColumn];
+  };
+
+  // With domain decomposition, particles are balanced between slabs so that each partition gets the same load
+  const size_t maxNbInteriorParts = (nbParts + m_nbPartitions - 1) / m_nbPartitions;
+
+  // Slabs are made of as many contiguous columns as device buffers can hold
+  std::vector<std::pair<size_t, size_t>> slabs;
+  for (size_t firstColumn = 0; firstColumn < nbColumns;)
+  {
+    if (nbPartsInSlab(firstColumn, firstColumn) > m_maxNbParticles)
+    {
+      LOG_ERROR("Column {} and its halo hold more particles than device buffers, out-of-core step skipped", firstColumn);
+      return;
+    }
+
+    size_t lastColumn = firstColumn;
+    while (lastColumn + 1 < nbColumns && nbPartsInSlab(firstColumn, lastColumn + 1) <= m_maxNbParticles
+        && columnStart[lastColumn + 2] - columnStart[firstColumn] <= maxNbInteriorParts)
+      ++lastColumn;
+
+    slabs.push_back({ firstColumn, lastColumn });
+    firstColumn = lastColumn + 1;
+  }
+
+  // Slabs are processed by rounds, one slab per partition
+  // Slabs of a round are gathered in parallel, each one in its own staging memory
+  const size_t nbRounds = (slabs.size() + m_nbPartitions - 1) / m_nbPartitions;
+  const auto gatherRound = [&](size_t round)
+  {
+    std::vector<std::future<void>> gatherings;
+    for (size_t slab = round * m_nbPartitions; slab < std::min((round + 1) * m_nbPartitions, slabs.size()); ++slab)
+    {
+      gatherings.push_back(std::async(std::launch::async, [&, slab]()
+          { gatherOutOfCoreChunk(m_chunks[slab % m_chunks.size()], slabs[slab].first, slabs[slab].second, haloWidth, columnStart, sortedIndices); }));
+    }
+    for (auto& gathering : gatherings)
+      gathering.wait();
+  };
+
+  gatherRound(0);
+
+  for (size_t round = 0; round < nbRounds; ++round)
+  {
+    const size_t firstSlab = round * m_nbPartitions;
+    const size_t lastSlab = std::min(firstSlab + m_nbPartitions, slabs.size());
+
+    // Transfers are not blocking, host gathers next slabs while partitions process current ones
+    for (size_t slab = firstSlab; slab < lastSlab; ++slab)
+      processOutOfCoreChunk(m_chunks[slab % m_chunks.size()], slab - firstSlab);
+
+    if (round + 1 < nbRounds)
+      gatherRound(round + 1);
+
+    getCLContext().finishAllTasks();
+
+    // Migration of the particles crossing slab boundaries is done by next bucketing
+    for (size_t slab = firstSlab; slab < lastSlab; ++slab)
+      scatterOutOfCoreChunk(m_chunks[slab % m_chunks.size()]);
+  }
+
+  std::swap(m_hostPos, m_nextHostPos);
+  std::swap(m_hostVel, m_nextHostVel);
+}
+
+// Each neighbour pass reads results of the previous one one cell further, density then correction
+// of each Jacobi iteration, then vorticity, confinement and xsph viscosity
+// Interior results are exact as long as particles do not cross a cell during the step, halo results being dropped
+size_t Fluids::outOfCoreHaloWidth() const
+{
+  // Constraint factor only reads the own density of a particle, it does not widen the dependencies
+  size_t nbChainedPasses = 2 * m_nbJacobiIters;
+  if (m_kernelInputs->isVorticityConfEnabled)
+    nbChainedPasses += 3;
+  return std::max(nbChainedPasses, (size_t)1);
+}
+
+void Fluids::gatherOutOfCoreChunk(OutOfCoreChunk& chunk, size_t firstColumn, size_t lastColumn, size_t haloWidth,
+    const std::vector<size_t>& columnStart, const std::vector<size_t>& sortedIndices) const
+{
+  const auto itSorted = sortedIndices.cbegin();
+
+  // Interior particles
+  chunk.globalIndices.assign(itSorted + columnStart[firstColumn], itSorted + columnStart[lastColumn + 1]);
+  chunk.nbInteriorParts = chunk.globalIndices.size();
+
+  // Halo particles, only read by interior ones
+  const size_t firstHaloColumn = (firstColumn > haloWidth) ? firstColumn - haloWidth : 0;
+  const size_t lastHaloColumn = std::min(lastColumn + haloWidth, (size_t)m_gridRes.x - 1);
+  chunk.globalIndices.insert(chunk.globalIndices.end(), itSorted + columnStart[firstHaloColumn], itSorted + columnStart[firstColumn]);
+  chunk.globalIndices.insert(chunk.globalIndices.end(), itSorted + columnStart[lastColumn + 1], itSorted + columnStart[lastHaloColumn + 1]);
+
+  const size_t nbParts = chunk.globalIndices.size();
+  chunk.pos.resize(nbParts);
+  chunk.vel.resize(nbParts);
+  chunk.col.resize(nbParts);
+  chunk.localIndices.resize(nbParts);
+
+  for (size_t i = 0; i < nbParts; ++i)
+  {
+    chunk.pos[i] = m_hostPos[chunk.globalIndices[i]];
+    chunk.vel[i] = m_hostVel[chunk.globalIndices[i]];
+    chunk.localIndices[i] = (unsigned int)i;
+  }
+}
+
+void Fluids::processOutOfCoreChunk(OutOfCoreChunk& chunk, size_t partition)
+{
+  // Slab without particles of its own
+  if (chunk.nbInteriorParts == 0)
+    return;
+
+  const bool isPartitioned = (m_nbPartitions > 1);
+  CL::Context& clContext = slabCLContext(partition);
+  RadixSort& radixSort = isPartitioned ? *m_partitionRadixSorts[partition] : m_radixSort;
+
+  const size_t nbParticles = chunk.globalIndices.size();
+
+  // Buffers of partitions are not shared with OpenGL, they can be mapped
+  chunk.partition = partition;
+  chunk.isReadInPlace = isPartitioned && clContext.isHostUnifiedMemory();
+
+  clContext.loadBufferFromHost("p_pos", 0, 4 * sizeof(float) * nbParticles, chunk.pos.data(), false);
+  clContext.loadBufferFromHost("p_vel", 0, 4 * sizeof(float) * nbParticles, chunk.vel.data(), false);
+  clContext.loadBufferFromHost("p_chunkIndex", 0, sizeof(unsigned int) * nbParticles, chunk.localIndices.data(), false);
+
+  // Particles of previous chunk beyond current one must stay out of the cells
+  clContext.runKernel(KERNEL_RESET_CELL_ID, m_maxNbParticles);
+
+  runSimulationStep(clContext, radixSort, nbParticles, true, true);
+
+  if (chunk.isReadInPlace)
+    return;
+
+  // Staging memory is overwritten by the results, queue being in-order uploads are complete by then
+  clContext.unloadBufferFromDevice("p_pos", 0, 4 * sizeof(float) * nbParticles, chunk.pos.data(), false);
+  clContext.unloadBufferFromDevice("p_vel", 0, 4 * sizeof(float) * nbParticles, chunk.vel.data(), false);
+  clContext.unloadBufferFromDevice("p_col", 0, 4 * sizeof(float) * nbParticles, chunk.col.data(), false);
+  clContext.unloadBufferFromDevice("p_chunkIndex", 0, sizeof(unsigned int) * nbParticles, chunk.localIndices.data(), false);
+}
+
+void Fluids::scatterOutOfCoreChunk(const OutOfCoreChunk& chunk)
+{
+  using float4 = std::array<float, 4>;
+
+  const float4* pos = chunk.pos.data();
+  const float4* vel = chunk.vel.data();
+  const float4* col = chunk.col.data();
+  const unsigned int* localIndices = chunk.localIndices.data();
+
+  // Results are read from device buffers without copy on host unified memory
+  CL::Context* clContext = chunk.isReadInPlace ? &slabCLContext(chunk.partition) : nullptr;
+  if (clContext != nullptr)
+  {
+    pos = static_cast<const float4*>(clContext->mapBuffer("p_pos", CL_MAP_READ));
+    vel = static_cast<const float4*>(clContext->mapBuffer("p_vel", CL_MAP_READ));
+    col = static_cast<const float4*>(clContext->mapBuffer("p_col", CL_MAP_READ));
+    localIndices = static_cast<const unsigned int*>(clContext->mapBuffer("p_chunkIndex", CL_MAP_READ));
+  }
+
+  // Results of halo particles are dropped, their own neighbourhood is incomplete
+  for (size_t i = 0; pos && vel && col && localIndices && i < chunk.globalIndices.size(); ++i)
+  {
+    const size_t localIndex = (size_t)localIndices[i];
+    if (localIndex >= chunk.nbInteriorParts)
+      continue;
+
+    const size_t globalIndex = chunk.globalIndices[localIndex];
+    m_nextHostPos[globalIndex] = pos[i];
+    m_nextHostVel[globalIndex] = vel[i];
+    m_hostCol[globalIndex] = col[i];
+  }
+
+  if (clContext != nullptr)
+  {
+    for (const auto& bufferName : { "p_pos", "p_vel", "p_col", "p_chunkIndex" })
+      clContext->unmapBuffer(bufferName);
+  }
+}
+
+CL::Context& Fluids::slabCLContext(size_t partition) const
+{
+  return (m_nbPartitions > 1) ? getPartitionCLContext(partition) : getCLContext();
+}
+
+void Fluids::uploadOutOfCoreSubsample()
+{
+  CL::Context& clContext = getCLContext();
+
+  const size_t stride = (m_hostPos.size() + m_maxNbParticles - 1) / m_maxNbParticles;
+  m_currNbParticles = (m_hostPos.size() + stride - 1) / stride;
+
+  float inf = std::numeric_limits<float>::infinity();
+  std::vector<std::array<float, 4>> pos(m_maxNbParticles, std::array<float, 4>({ inf, inf, inf, 0.0f }));
+  std::vector<std::array<float, 4>> col(m_maxNbParticles, std::array<float, 4>({ 0.0f, 0.1f, 1.0f, 0.0f }));
+
+  for (size_t i = 0; i < m_currNbParticles; ++i)
+  {
+    pos[i] = m_hostPos[i * stride];
+    col[i] = m_hostCol[i * stride];
+  }
+
+  clContext.loadBufferFromHost("p_pos", 0, 4 * sizeof(float) * pos.size(), pos.data());
+  clContext.loadBufferFromHost("p_col", 0, 4 * sizeof(float) * col.size(), col.data());
 }
 
 // Storing definitions here to prevent cl_types in headers
@@ -444,7 +1210,7 @@ void Fluids::setRestDensity(float restDensity)
   if (!m_init)
     return;
   m_kernelInputs->restDensity = (cl_float)restDensity;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -453,7 +1219,7 @@ void Fluids::setRelaxCFM(float relaxCFM)
   if (!m_init)
     return;
   m_kernelInputs->relaxCFM = (cl_float)relaxCFM;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -462,7 +1228,7 @@ void Fluids::setTimeStep(float timeStep)
   if (!m_init)
     return;
   m_kernelInputs->timeStep = (cl_float)timeStep;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -473,13 +1239,31 @@ void Fluids::setNbJacobiIters(size_t nbIters)
   m_nbJacobiIters = nbIters;
 }
 
+//
+void Fluids::setMaxNbPartsInCell(size_t nbParts)
+{
+  if (!m_init)
+    return;
+  m_maxNbPartsInCell = nbParts;
+  m_areParamsDirty = true;
+}
+
+//
+void Fluids::setNbSubsteps(size_t nbSubsteps)
+{
+  if (!m_init)
+    return;
+  m_nbSubsteps = nbSubsteps;
+  m_areParamsDirty = true;
+}
+
 //
 void Fluids::enableArtPressure(bool enable)
 {
   if (!m_init)
     return;
   m_kernelInputs->isArtPressureEnabled = (cl_uint)enable;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -488,7 +1272,7 @@ void Fluids::setArtPressureRadius(float radius)
   if (!m_init)
     return;
   m_kernelInputs->artPressureRadius = (cl_float)radius;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -497,7 +1281,7 @@ void Fluids::setArtPressureExp(size_t exp)
   if (!m_init)
     return;
   m_kernelInputs->artPressureExp = (cl_uint)exp;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -506,7 +1290,7 @@ void Fluids::setArtPressureCoeff(float coeff)
   if (!m_init)
     return;
   m_kernelInputs->artPressureCoeff = (cl_float)coeff;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -515,7 +1299,7 @@ void Fluids::enableVorticityConfinement(bool enable)
   if (!m_init)
     return;
   m_kernelInputs->isVorticityConfEnabled = (cl_uint)enable;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -524,7 +1308,7 @@ void Fluids::setVorticityConfinementCoeff(float coeff)
   if (!m_init)
     return;
   m_kernelInputs->vorticityConfCoeff = (cl_float)coeff;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
 }
 
 //
@@ -533,7 +1317,116 @@ void Fluids::setXsphViscosityCoeff(float coeff)
   if (!m_init)
     return;
   m_kernelInputs->xsphViscosityCoeff = (cl_float)coeff;
-  updateFluidsParamsInKernels();
+  m_areParamsDirty = true;
+}
+
+//
+void Fluids::enableSleeping(bool enable)
+{
+  if (!m_init || enable == (bool)m_kernelInputs->isSleepingEnabled)
+    return;
+
+  if (enable && isStreamedFromHost())
+  {
+    LOG_ERROR("Sleeping particles not supported with particles streamed from host");
+    return;
+  }
+
+  // Rest steps have not followed particles while disabled
+  if (enable)
+    getCLContext().runKernel(KERNEL_WAKE_PARTICLES, m_maxNbParticles);
+
+  m_kernelInputs->isSleepingEnabled = (cl_uint)enable;
+  m_nbActiveParticles = 0;
+  m_areParamsDirty = true;
+}
+
+//
+void Fluids::enableUnilateralConstraint(bool enable)
+{
+  if (!m_init)
+    return;
+  m_kernelInputs->isUnilateralEnabled = (cl_uint)enable;
+  m_areParamsDirty = true;
+}
+
+//
+void Fluids::enableWarmStart(bool enable)
+{
+  if (!m_init || enable == m_isWarmStartEnabled)
+    return;
+
+  if (enable && isStreamedFromHost())
+  {
+    LOG_ERROR("Warm start not supported with particles streamed from host");
+    return;
+  }
+
+  // Constraint factors have not followed particles while disabled
+  if (enable)
+    getCLContext().runKernel(KERNEL_RESET_FLOAT, m_maxNbParticles);
+
+  m_isWarmStartEnabled = enable;
+}
+
+//
+void Fluids::setInstanceParams(size_t instance, float restDensity, float relaxCFM, float vorticityConfCoeff, float xsphViscosityCoeff)
+{
+  if (!m_init)
+    return;
+
+  if (instance >= m_nbInstances)
+  {
+    LOG_ERROR("Instance {} does not exist, only {} instances in ensemble", instance, m_nbInstances);
+    return;
+  }
+
+  m_instanceParams[instance] = { restDensity, relaxCFM, vorticityConfCoeff, xsphViscosityCoeff };
+
+  CL::Context& clContext = getCLContext();
+  clContext.loadBufferFromHost("i_fluidParams", 4 * sizeof(float) * instance, 4 * sizeof(float), m_instanceParams[instance].data());
+
+  // Same as for parameters shared by all instances
+  if (m_kernelInputs->isSleepingEnabled)
+    clContext.runKernel(KERNEL_WAKE_PARTICLES, m_maxNbParticles);
+}
+
+//
+void Fluids::setHealthCheck(HealthCheck healthCheck)
+{
+  if (!m_init || healthCheck == m_healthCheck)
+    return;
+
+  if (healthCheck != HealthCheck::DISABLED && isStreamedFromHost())
+  {
+    LOG_ERROR("Health check not supported with particles streamed from host");
+    return;
+  }
+
+  // Snapshots are only allocated once needed
+  if (healthCheck == HealthCheck::ROLLBACK && !m_hasSnapshotBuffers)
+  {
+    CL::Context& clContext = getCLContext();
+    m_hasSnapshotBuffers = true;
+    for (size_t snapshot = 0; snapshot < m_snapshotUpdates.size(); ++snapshot)
+    {
+      m_hasSnapshotBuffers &= clContext.createBuffer("p_snapshotPos" + std::to_string(snapshot), 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+      m_hasSnapshotBuffers &= clContext.createBuffer("p_snapshotVel" + std::to_string(snapshot), 4 * m_maxNbParticles * sizeof(float), CL_MEM_READ_WRITE);
+    }
+  }
+
+  m_healthCheck = healthCheck;
+  // Counting is switched in the kernels with the parameters
+  m_areParamsDirty = true;
+
+  // Counters and snapshots of the updates run before are not relevant anymore
+  resetHealthCounters();
+  m_isHealthReadPending = false;
+  m_isBlownUp = false;
+  m_nbCheckedUpdates = m_nbUpdates;
+  m_snapshotUpdates = { NO_SNAPSHOT, NO_SNAPSHOT };
+
+  LOG_INFO("Fluids health check switched to {}", ALL_HEALTH_CHECKS.at(healthCheck));
 }
 
 //
@@ -548,6 +1441,15 @@ float Fluids::getTimeStep() const { return m_init ? (float)m_kernelInputs->timeS
 //
 size_t Fluids::getNbJacobiIters() const { return m_init ? m_nbJacobiIters : 0; }
 
+//
+size_t Fluids::getMaxNbPartsInCell() const { return m_init ? m_maxNbPartsInCell : 0; }
+
+//
+bool Fluids::isMaxNbPartsInCellApplied() const { return m_init ? m_simplifiedMode : false; }
+
+//
+size_t Fluids::getNbSubsteps() const { return m_init ? m_nbSubsteps : 0; }
+
 //
 bool Fluids::isArtPressureEnabled() const { return m_init ? (bool)m_kernelInputs->isArtPressureEnabled : false; }
 
@@ -568,3 +1470,9 @@ float Fluids::getVorticityConfinementCoeff() const { return m_init ? (float)m_ke
 
 //
 float Fluids::getXsphViscosityCoeff() const { return m_init ? (float)m_kernelInputs->xsphViscosityCoeff : 0.0f; }
+
+//
+bool Fluids::isSleepingEnabled() const { return m_init ? (bool)m_kernelInputs->isSleepingEnabled : false; }
+
+//
+bool Fluids::isUnilateralConstraintEnabled() const { return m_init ? (bool)m_kernelInputs->isUnilateralEnabled : false; }
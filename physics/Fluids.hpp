@@ -36,12 +36,36 @@ class Fluids : public Model
   // Static member vars must be initialized outside of the class in the global scope
   static const std::map<CaseType, std::string, CompareCaseType> ALL_CASES;
 
+  // Reaction to a blow-up, detected from faulty particles counted on device at each step
+  enum HealthCheck
+  {
+    DISABLED = 0,
+    WARN = 1,
+    ROLLBACK = 2
+  };
+  static const std::map<HealthCheck, std::string> ALL_HEALTH_CHECKS;
+
+  // Faulty particles counted over the steps run between two read backs of the counters
+  struct Health
+  {
+    size_t nbSteps = 0;
+    // NaN or infinite velocity
+    size_t nbNonFiniteParts = 0;
+    // Velocity clamped to MAX_VEL
+    size_t nbSpeedCappedParts = 0;
+    // Position clamped inside the walls, on the first boundary pass of each step
+    size_t nbWallClamps = 0;
+  };
+
   Fluids(ModelParams params);
   ~Fluids();
 
   void update() override;
   void reset() override;
 
+  // Build programs in background before the model is created
+  static void PrebuildPrograms(const ModelParams& params);
+
   void setInitialCase(CaseType caseT) { m_initialCase = caseT; }
   const CaseType getInitialCase() const { return m_initialCase; }
 
@@ -55,8 +79,15 @@ class Fluids : public Model
   void setTimeStep(float timeStep);
   float getTimeStep() const;
   //
-  void setNbJacobiIters(size_t nbIters);
-  size_t getNbJacobiIters() const;
+  void setNbJacobiIters(size_t nbIters) override;
+  size_t getNbJacobiIters() const override;
+  // Cap on the number of particles taken into account in a single cell, in simplified mode
+  void setMaxNbPartsInCell(size_t nbParts) override;
+  size_t getMaxNbPartsInCell() const override;
+  bool isMaxNbPartsInCellApplied() const override;
+  // Number of simulation steps run for each update
+  void setNbSubsteps(size_t nbSubsteps) override;
+  size_t getNbSubsteps() const override;
   //
   void enableArtPressure(bool enable);
   bool isArtPressureEnabled() const;
@@ -70,8 +101,8 @@ class Fluids : public Model
   void setArtPressureCoeff(float coeff);
   float getArtPressureCoeff() const;
   //
-  void enableVorticityConfinement(bool enable);
-  bool isVorticityConfinementEnabled() const;
+  void enableVorticityConfinement(bool enable) override;
+  bool isVorticityConfinementEnabled() const override;
   //
   void setVorticityConfinementCoeff(float coeff);
   float getVorticityConfinementCoeff() const;
@@ -79,13 +110,106 @@ class Fluids : public Model
   void setXsphViscosityCoeff(float coeff);
   float getXsphViscosityCoeff() const;
 
+  // Particles quiet for several steps fall asleep, the step being only dispatched over particles
+  // next to a cell holding an awake one, others being left in place until a neighbor cell wakes up
+  // Only supported in-core
+  void enableSleeping(bool enable);
+  bool isSleepingEnabled() const;
+  // Particles the last step was dispatched over, read back without blocking
+  size_t nbActiveParticles() const { return isSleepingEnabled() ? m_nbActiveParticles : m_currNbParticles; }
+
+  // Only compressed particles are constrained, the constraint factor and correction being dispatched over
+  // the compacted list of them and of their neighbors at each Jacobi iteration, skipping free-surface splashes
+  void enableUnilateralConstraint(bool enable);
+  bool isUnilateralConstraintEnabled() const;
+
+  // Constraint factors are carried across steps along with particles, positions being first corrected with them
+  // so that the solver starts from the previous solution, fewer Jacobi iterations reaching the same density error
+  // Only supported in-core
+  void enableWarmStart(bool enable);
+  bool isWarmStartEnabled() const { return m_isWarmStartEnabled; }
+
+  // Ensemble mode, the initial case is replicated for each instance, all of them advanced by the same kernel launches
+  size_t nbInstances() const { return m_nbInstances; }
+  // Override shared rest density, relaxation CFM, vorticity confinement and xsph viscosity coefficients for one instance
+  void setInstanceParams(size_t instance, float restDensity, float relaxCFM, float vorticityConfCoeff, float xsphViscosityCoeff);
+  // Rest density, relaxation CFM, vorticity confinement and xsph viscosity coefficients of one instance
+  const std::array<float, 4>& getInstanceParams(size_t instance) const { return m_instanceParams.at(instance); }
+
+  // Out-of-core mode, all the particles are kept on host and streamed through device buffers by slabs along x axis
+  // Only a subsample of them is displayed, nbParticles() returning its size
+  bool isOutOfCore() const { return m_isOutOfCore; }
+  size_t nbOutOfCoreParticles() const { return m_hostPos.size(); }
+
+  // Domain decomposition, slabs are simulated concurrently on several device partitions,
+  // particles being kept on host as in out-of-core mode and exchanged with their halo at each step
+  size_t nbPartitions() const { return m_nbPartitions; }
+
+  // Counters are read back asynchronously once per update, a blow-up being reported or rolled back
+  // to the last snapshot of positions and velocities known to be good
+  // Only supported in-core, snapshots doubling the device memory used by positions and velocities
+  void setHealthCheck(HealthCheck healthCheck);
+  HealthCheck getHealthCheck() const { return m_healthCheck; }
+  const Health& lastHealth() const { return m_lastHealth; }
+
   private:
+  // Particles of a slab of grid columns along x axis and of its halo columns on each side
+  struct OutOfCoreChunk
+  {
+    // Global indices of the particles, interior ones first then halo ones
+    std::vector<size_t> globalIndices;
+    size_t nbInteriorParts = 0;
+    // Staging memory, uploaded to device then overwritten by read back
+    std::vector<std::array<float, 4>> pos;
+    std::vector<std::array<float, 4>> vel;
+    std::vector<std::array<float, 4>> col;
+    // Index of each particle inside the chunk, carried through the sort to scatter results back
+    std::vector<unsigned int> localIndices;
+    // Partition the chunk is processed on, results are read in place if it shares memory with host
+    size_t partition = 0;
+    bool isReadInPlace = false;
+  };
+
   bool createProgram() const;
   bool createBuffers() const;
   bool createKernels() const;
 
+  // Simulation resources, created on the main device and on each partition
+  bool createSimulationBuffers(CL::Context& clContext, bool hasChunkIndex) const;
+  bool createSimulationKernels(CL::Context& clContext) const;
+
   void initFluidsParticles();
+  // Out-of-core particles are not limited by the size of device buffers
+  size_t maxNbSimulatedParticles() const override { return m_isOutOfCore ? m_maxNbOutOfCoreParticles : m_maxNbParticles; }
+  // Write parameters to the constant buffers if changed since the last step
   void updateFluidsParamsInKernels();
+  void setFluidsParamsInKernels(CL::Context& clContext);
+  void updateInstanceParamsInKernels();
+
+  // Particles are kept on host and streamed by slabs, either out-of-core or decomposed over partitions
+  bool isStreamedFromHost() const { return m_isOutOfCore || m_nbPartitions > 1; }
+
+  // One simulation step of the particles currently in device buffers of the given context
+  // Color can be filled from density during the step, overlapping the velocity update
+  void runSimulationStep(CL::Context& clContext, RadixSort& radixSort, size_t nbParticles, bool hasChunkIndex, bool isFillingColor);
+  // Float buffers moved along with particles by the sorts, depending on enabled features
+  std::vector<std::string> carriedFloatBuffers() const;
+
+  void resetHealthCounters();
+  // Blow-up detection from the last counters read back, then new read back and snapshot if due
+  void checkHealth();
+  bool isBlownUp(const Health& health) const;
+  void rollback();
+
+  void updateOutOfCore();
+  // Number of halo columns on each side of a slab, one per chained neighbour pass of a step
+  size_t outOfCoreHaloWidth() const;
+  void gatherOutOfCoreChunk(OutOfCoreChunk& chunk, size_t firstColumn, size_t lastColumn, size_t haloWidth,
+      const std::vector<size_t>& columnStart, const std::vector<size_t>& sortedIndices) const;
+  void processOutOfCoreChunk(OutOfCoreChunk& chunk, size_t partition);
+  void scatterOutOfCoreChunk(const OutOfCoreChunk& chunk);
+  CL::Context& slabCLContext(size_t partition) const;
+  void uploadOutOfCoreSubsample();
 
   bool m_simplifiedMode;
 
@@ -93,9 +217,58 @@ class Fluids : public Model
 
   size_t m_nbJacobiIters;
 
+  size_t m_nbSubsteps;
+
+  size_t m_nbInstances;
+
+  // Per instance parameters in ensemble mode: rest density, relaxation CFM, vorticity confinement and xsph viscosity coefficients
+  std::vector<std::array<float, 4>> m_instanceParams;
+
+  bool m_isOutOfCore;
+  size_t m_maxNbOutOfCoreParticles;
+  // Whole particle state in out-of-core mode, next positions and velocities are written apart as all slabs read current ones
+  std::vector<std::array<float, 4>> m_hostPos;
+  std::vector<std::array<float, 4>> m_hostVel;
+  std::vector<std::array<float, 4>> m_hostCol;
+  std::vector<std::array<float, 4>> m_nextHostPos;
+  std::vector<std::array<float, 4>> m_nextHostVel;
+  // Double buffered, next slabs are gathered on host while devices process current ones, one per partition
+  std::vector<OutOfCoreChunk> m_chunks;
+
+  size_t m_nbPartitions;
+
+  HealthCheck m_healthCheck;
+  Health m_lastHealth;
+  // Destination of the asynchronous read back of the counters
+  std::array<unsigned int, 4> m_healthCounts;
+  bool m_isHealthReadPending;
+  // Warned once per blow-up
+  bool m_isBlownUp;
+  size_t m_nbStepsSinceHealthRead;
+  size_t m_nbPendingHealthSteps;
+  // Updates are counted to know which snapshots have been checked, a snapshot taken before update f
+  // being good once the counters of all updates before f have been read back without blow-up
+  size_t m_nbUpdates;
+  size_t m_nbCheckedUpdates;
+  size_t m_pendingHealthUpdate;
+  // Two snapshots, a new one never overwrites the only good one
+  std::array<size_t, 2> m_snapshotUpdates;
+  size_t m_latestSnapshot;
+  bool m_hasSnapshotBuffers;
+
+  // Destination of the asynchronous read back of the number of active particles
+  unsigned int m_nbActiveParticles;
+
+  bool m_isWarmStartEnabled;
+
   RadixSort m_radixSort;
+  std::vector<std::unique_ptr<RadixSort>> m_partitionRadixSorts;
 
   std::unique_ptr<FluidKernelInputs> m_kernelInputs;
+  // Inputs written to the device, with the time step split over substeps
+  std::unique_ptr<FluidKernelInputs> m_stepKernelInputs;
+  // Setters only flag parameters, written once at the start of the next step
+  bool m_areParamsDirty;
 
   CaseType m_initialCase;
 };
@@ -8,6 +8,9 @@
 
 #include "ocl/Context.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 std::unique_ptr<Physics::Model> Physics::CreateModel(Physics::ModelType type, Physics::ModelParams params)
 {
   switch ((int)type)
@@ -24,10 +27,55 @@ std::unique_ptr<Physics::Model> Physics::CreateModel(Physics::ModelType type, Ph
   return nullptr;
 }
 
+void Physics::PrebuildModelPrograms(Physics::ModelType type, Physics::ModelParams params)
+{
+  // Shared by all the models, found cached by the next ones
+  Physics::RadixSort::PrebuildProgram();
+  Physics::Statistics::PrebuildProgram();
+
+  switch ((int)type)
+  {
+  case Physics::ModelType::BOIDS:
+    Physics::Boids::PrebuildPrograms(params);
+    break;
+  case Physics::ModelType::FLUIDS:
+    Physics::Fluids::PrebuildPrograms(params);
+    break;
+  case Physics::ModelType::CLOUDS:
+    Physics::Clouds::PrebuildPrograms(params);
+    break;
+  default:
+    break;
+  }
+}
+
 Physics::Model::~Model()
 {
   // We don't want any CL presence on header side, as it is shared with UI
-  CL::Context::Get().release();
+  // Only releasing resources of this model, other ones may still be alive
+  CL::Context::Get().releaseNamespace(m_namespace);
+}
+
+std::string Physics::Model::CreateNamespace()
+{
+  static size_t nbCreatedModels = 0;
+  return "Model" + std::to_string(nbCreatedModels++);
+}
+
+Physics::CL::Context& Physics::Model::getCLContext() const
+{
+  CL::Context& clContext = CL::Context::Get();
+  clContext.setCurrentNamespace(m_namespace);
+  return clContext;
+}
+
+Physics::CL::Context& Physics::Model::getPartitionCLContext(size_t partition) const
+{
+  CL::Context& clContext = CL::Context::Get();
+  const std::string partitionNamespace = partitionCLNamespace(partition);
+  clContext.bindNamespaceToPartition(partitionNamespace, partition);
+  clContext.setCurrentNamespace(partitionNamespace);
+  return clContext;
 }
 
 bool Physics::Model::isProfilingEnabled() const
@@ -42,6 +90,16 @@ void Physics::Model::enableProfiling(bool enable)
   clContext.enableProfiler(enable);
 }
 
+void Physics::Model::enableKernelTiming(bool enable)
+{
+  CL::Context::Get().enableKernelTiming(enable);
+}
+
+std::map<std::string, double> Physics::Model::kernelTimesMs() const
+{
+  return CL::Context::Get().kernelTimesMs(m_namespace);
+}
+
 bool Physics::Model::isUsingIGPU() const
 {
   const std::string& platformName = Physics::CL::Context::Get().getPlatformName();
@@ -49,6 +107,57 @@ bool Physics::Model::isUsingIGPU() const
   return (platformName.find("Intel") != std::string::npos);
 }
 
+size_t Physics::Model::memoryFootprint() const
+{
+  return CL::Context::Get().memoryFootprint(m_namespace).totalSize;
+}
+
+size_t Physics::Model::maxNbParticlesFittingDevice() const
+{
+  const CL::Context& clContext = CL::Context::Get();
+
+  const CL::MemoryFootprint footprint = clContext.memoryFootprint(m_namespace);
+  if (footprint.totalSize == 0 || footprint.biggestAllocationSize == 0)
+    return 0;
+
+  // Memory already used by the other alive models is not available
+  const size_t otherModelsSize = clContext.totalMemoryFootprint().totalSize - footprint.totalSize;
+  const size_t globalMemSize = clContext.getDeviceGlobalMemSize();
+  const size_t availableMemSize = (globalMemSize > otherModelsSize) ? globalMemSize - otherModelsSize : 0;
+
+  // Grid buffers do not scale with the number of particles, counting them as particle ones keeps the estimation conservative
+  const double nbPartsFittingGlobalMem = (double)m_maxNbParticles * availableMemSize / footprint.totalSize;
+  const double nbPartsFittingMaxAlloc = (double)m_maxNbParticles * clContext.getDeviceMaxMemAllocSize() / footprint.biggestAllocationSize;
+
+  return (size_t)std::min(nbPartsFittingGlobalMem, nbPartsFittingMaxAlloc);
+}
+
+void Physics::Model::reportMemoryFootprint() const
+{
+  CL::Context::Get().reportMemoryFootprint();
+
+  LOG_INFO("Device memory footprint {:.2f} MB for {} particles, up to {} particles could fit in device memory",
+      memoryFootprint() / (1024.0f * 1024.0f), m_maxNbParticles, maxNbParticlesFittingDevice());
+}
+
+double Physics::Model::latticeScale() const
+{
+  return (double)m_gridRes.x / Geometry::GRID_RES_3D.x;
+}
+
+size_t Physics::Model::scaledNbParticles(size_t refNbParticles) const
+{
+  const double scale = latticeScale();
+  const double nbPartsScale = (m_dimension == Geometry::Dimension::dim2D) ? scale * scale : scale * scale * scale;
+
+  return std::min((size_t)(refNbParticles * nbPartsScale), maxNbSimulatedParticles());
+}
+
+int Physics::Model::scaledSubdiv(int refSubdiv) const
+{
+  return std::max((int)std::round(refSubdiv * latticeScale()), 1);
+}
+
 void Physics::Model::setCurrentDisplayedQuantity(const std::string& name)
 {
   auto foundQuantity = m_allDisplayableQuantities.find(name);
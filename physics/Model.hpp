@@ -2,6 +2,7 @@
 
 #include "Geometry.hpp"
 #include "Math.hpp"
+#include "utils/Statistics.hpp"
 
 #include <array>
 #include <map>
@@ -54,6 +55,8 @@ struct PhysicalQuantity
   std::pair<float, float> staticRange;
   // The user-selected values are defined here, umin belongs to [smin, umax] | umax belongs to [umin, smax]
   std::pair<float, float> userRange;
+  // Index of the quantity inside a packed float4 buffer, -1 if the buffer contains a single float per particle
+  int bufferComponent = -1;
 };
 
 struct ModelParams
@@ -68,10 +71,28 @@ struct ModelParams
   unsigned int cameraVBO = 0;
   unsigned int gridVBO = 0;
   Geometry::Dimension dimension = Geometry::Dimension::dim3D;
+  // Ensemble mode, number of independent instances of the same case packed in the same buffers
+  // Only supported by Fluids for now
+  size_t nbInstances = 1;
+  // Out-of-core mode, enabled if bigger than maxNbParticles: number of particles the grid is refined for,
+  // the particles are kept on host and streamed through device buffers slab by slab
+  // Only supported by Fluids for now
+  size_t nbOutOfCoreParticles = 0;
+  // Domain decomposition, enabled if bigger than 1: number of device partitions (NUMA nodes, devices)
+  // slabs of particles are simulated on concurrently, particles being exchanged through host at each step
+  // Only supported by Fluids for now
+  size_t nbPartitions = 1;
 };
 
 class Model;
 std::unique_ptr<Model> CreateModel(ModelType type, ModelParams params);
+// Start building the programs of a model in background, so that creating it does not wait for them
+void PrebuildModelPrograms(ModelType type, ModelParams params);
+
+namespace CL
+{
+class Context;
+}
 
 // Abstract class defining physical model foundations to implement
 // Currently all models are OpenCL-based but that could change
@@ -93,7 +114,12 @@ class Model
       , m_boundary(Boundary::BouncingWall)
       , m_init(false)
       , m_pause(false)
-      , m_currentDisplayedQuantityName("") {};
+      , m_currentDisplayedQuantityName("")
+      , m_namespace(CreateNamespace())
+  {
+    // Resources created from now on by the derived model are scoped by its namespace
+    getCLContext();
+  };
 
   virtual ~Model();
 
@@ -130,6 +156,21 @@ class Model
   virtual bool isTargetActivated() const { return false; }
   virtual bool isTargetVisible() const { return false; }
 
+  // Simulation cost knobs, tuned at runtime by the quality governor to stay on frame budget
+  // Models without the corresponding solver feature keep these default implementations, getters returning 0
+  virtual void setNbJacobiIters(size_t nbIters) {}
+  virtual size_t getNbJacobiIters() const { return 0; }
+  //
+  virtual void enableVorticityConfinement(bool enable) {}
+  virtual bool isVorticityConfinementEnabled() const { return false; }
+  //
+  virtual void setMaxNbPartsInCell(size_t nbParts) {}
+  virtual size_t getMaxNbPartsInCell() const { return 0; }
+  virtual bool isMaxNbPartsInCellApplied() const { return false; }
+  //
+  virtual void setNbSubsteps(size_t nbSubsteps) {}
+  virtual size_t getNbSubsteps() const { return 0; }
+
   void setCurrentDisplayedQuantity(const std::string& name);
   // Name of currently displayed physical quantity, only one for which some specific fields can be modified
   std::string currentDisplayedPhysicalQuantityName() { return m_currentDisplayedQuantityName; }
@@ -148,9 +189,40 @@ class Model
 
   bool isProfilingEnabled() const;
   void enableProfiling(bool enable);
+  // Device times of the last completed run of each kernel of this model, without waiting for the device
+  void enableKernelTiming(bool enable);
+  std::map<std::string, double> kernelTimesMs() const;
   bool isUsingIGPU() const;
 
+  // Device memory used by this model, in bytes
+  size_t memoryFootprint() const;
+  // Estimation of the biggest maxNbParticles fitting in device memory next to the other alive models,
+  // assuming the footprint scales linearly with the number of particles
+  size_t maxNbParticlesFittingDevice() const;
+  // Log the device memory footprint of all alive models and the estimation above
+  void reportMemoryFootprint() const;
+
+  // Physical diagnostics of the last updates, null if not supported by the model
+  const Statistics* statistics() const { return m_statistics.get(); }
+
   protected:
+  // OpenCL context with the namespace of this model set as current one
+  // Must be used by derived models instead of CL::Context::Get(), as several models can be alive at the same time
+  CL::Context& getCLContext() const;
+  // Same for one of the device partitions, resources created in the returned context live on that partition
+  CL::Context& getPartitionCLContext(size_t partition) const;
+  // Namespaces given to the helpers owning their own resources, as radix sorts and statistics
+  const std::string& clNamespace() const { return m_namespace; }
+  std::string partitionCLNamespace(size_t partition) const { return m_namespace + "/Part" + std::to_string(partition); }
+
+  // Initial cases are designed for the reference number of particles,
+  // with more particles their lattices are refined as much as the grid, keeping the same density in the smaller cells
+  // Capped by maxNbSimulatedParticles, so that the cases fit in the particle buffers
+  size_t scaledNbParticles(size_t refNbParticles) const;
+  int scaledSubdiv(int refSubdiv) const;
+  // Size of the particle buffers, unless particles are kept on host
+  virtual size_t maxNbSimulatedParticles() const { return m_maxNbParticles; }
+
   bool m_init;
   bool m_pause;
 
@@ -178,5 +250,17 @@ class Model
   std::string m_currentDisplayedQuantityName;
   // All PhysicalQuantities that can be rendered
   std::map<const std::string, PhysicalQuantity> m_allDisplayableQuantities;
+
+  // Destroyed after the resources of the model are released, its read backs being complete by then
+  std::unique_ptr<Statistics> m_statistics;
+
+  private:
+  static std::string CreateNamespace();
+
+  // Ratio between the grid resolution and the reference one
+  double latticeScale() const;
+
+  // Unique namespace scoping all the OpenCL resources of this model
+  std::string m_namespace;
 };
 }
@@ -0,0 +1,189 @@
+#include "QualityGovernor.hpp"
+
+#include "Model.hpp"
+
+#include "Logging.hpp"
+
+#include <algorithm>
+
+using namespace Physics;
+
+// Weight of the last measurement in the smoothed step time
+#define STEP_TIME_SMOOTHING 0.1f
+// Simulation is degraded above this ratio of the budget, and upgraded below the other one
+#define DEGRADE_BUDGET_RATIO 1.0f
+#define UPGRADE_BUDGET_RATIO 0.6f
+// Number of steps to wait after an adaptation before measuring its effect
+#define NB_STEPS_COOLDOWN 30
+// Upgrading is slower than degrading, to avoid oscillating around the budget
+#define NB_STEPS_COOLDOWN_UPGRADE 120
+
+QualityGovernor::QualityGovernor(QualityRanges ranges)
+    : m_isEnabled(false)
+    , m_ranges(ranges)
+    , m_frameBudgetMs(1000.0f / 60.0f)
+    , m_smoothedStepTimeMs(0.0f)
+    , m_nbStepsSinceChange(0)
+    , m_hasDisabledVorticity(false)
+    , m_hasUserSettings(false)
+{
+}
+
+void QualityGovernor::enable(bool enable)
+{
+  m_isEnabled = enable;
+  reset();
+
+  LOG_INFO("Quality governor {}", enable ? "enabled" : "disabled");
+}
+
+void QualityGovernor::reset()
+{
+  m_smoothedStepTimeMs = 0.0f;
+  m_nbStepsSinceChange = 0;
+  m_hasDisabledVorticity = false;
+  m_hasUserSettings = false;
+}
+
+QualityGovernor::Settings QualityGovernor::readSettings(const Model& model) const
+{
+  Settings settings;
+  settings.nbJacobiIters = model.getNbJacobiIters();
+  settings.maxNbPartsInCell = model.getMaxNbPartsInCell();
+  settings.nbSubsteps = model.getNbSubsteps();
+  return settings;
+}
+
+void QualityGovernor::updateUserSettings(const Model& model)
+{
+  const Settings settings = readSettings(model);
+
+  if (!m_hasUserSettings)
+  {
+    m_userSettings = settings;
+    m_governedSettings = settings;
+    m_hasUserSettings = true;
+    return;
+  }
+
+  if (settings.nbJacobiIters != m_governedSettings.nbJacobiIters)
+    m_userSettings.nbJacobiIters = settings.nbJacobiIters;
+  if (settings.maxNbPartsInCell != m_governedSettings.maxNbPartsInCell)
+    m_userSettings.maxNbPartsInCell = settings.maxNbPartsInCell;
+  if (settings.nbSubsteps != m_governedSettings.nbSubsteps)
+    m_userSettings.nbSubsteps = settings.nbSubsteps;
+
+  m_governedSettings = settings;
+}
+
+void QualityGovernor::update(Model& model, float stepTimeMs)
+{
+  if (!m_isEnabled || !model.isInit() || model.onPause())
+    return;
+
+  updateUserSettings(model);
+
+  m_smoothedStepTimeMs = (m_nbStepsSinceChange == 0)
+      ? stepTimeMs
+      : (1.0f - STEP_TIME_SMOOTHING) * m_smoothedStepTimeMs + STEP_TIME_SMOOTHING * stepTimeMs;
+
+  ++m_nbStepsSinceChange;
+
+  if (m_nbStepsSinceChange < NB_STEPS_COOLDOWN)
+    return;
+
+  if (m_smoothedStepTimeMs > DEGRADE_BUDGET_RATIO * m_frameBudgetMs)
+  {
+    if (degrade(model))
+      m_nbStepsSinceChange = 0;
+    m_governedSettings = readSettings(model);
+  }
+  else if (m_smoothedStepTimeMs < UPGRADE_BUDGET_RATIO * m_frameBudgetMs && m_nbStepsSinceChange >= NB_STEPS_COOLDOWN_UPGRADE)
+  {
+    if (upgrade(model))
+      m_nbStepsSinceChange = 0;
+    m_governedSettings = readSettings(model);
+  }
+}
+
+// Knobs are degraded from the least to the most visible one
+bool QualityGovernor::degrade(Model& model)
+{
+  const size_t nbSubsteps = model.getNbSubsteps();
+  if (nbSubsteps > m_ranges.minNbSubsteps)
+  {
+    model.setNbSubsteps(nbSubsteps - 1);
+    LOG_INFO("Step time {:.2f} ms over budget {:.2f} ms, substeps {} -> {}", m_smoothedStepTimeMs, m_frameBudgetMs, nbSubsteps, nbSubsteps - 1);
+    return true;
+  }
+
+  const size_t nbJacobiIters = model.getNbJacobiIters();
+  if (nbJacobiIters > m_ranges.minNbJacobiIters)
+  {
+    model.setNbJacobiIters(nbJacobiIters - 1);
+    LOG_INFO("Step time {:.2f} ms over budget {:.2f} ms, Jacobi iterations {} -> {}", m_smoothedStepTimeMs, m_frameBudgetMs, nbJacobiIters, nbJacobiIters - 1);
+    return true;
+  }
+
+  if (m_ranges.canDisableVorticity && model.isVorticityConfinementEnabled())
+  {
+    model.enableVorticityConfinement(false);
+    m_hasDisabledVorticity = true;
+    LOG_INFO("Step time {:.2f} ms over budget {:.2f} ms, vorticity confinement and xsph viscosity disabled", m_smoothedStepTimeMs, m_frameBudgetMs);
+    return true;
+  }
+
+  // Cap is only applied to the cells in simplified mode, lowering it would save nothing otherwise
+  const size_t maxNbPartsInCell = model.getMaxNbPartsInCell();
+  if (model.isMaxNbPartsInCellApplied() && maxNbPartsInCell > m_ranges.minMaxNbPartsInCell)
+  {
+    const size_t newMaxNbPartsInCell = std::max(maxNbPartsInCell / 2, m_ranges.minMaxNbPartsInCell);
+    model.setMaxNbPartsInCell(newMaxNbPartsInCell);
+    LOG_INFO("Step time {:.2f} ms over budget {:.2f} ms, max particles in cell {} -> {}", m_smoothedStepTimeMs, m_frameBudgetMs, maxNbPartsInCell, newMaxNbPartsInCell);
+    return true;
+  }
+
+  return false;
+}
+
+// Knobs are upgraded in the reverse order of degradation, up to the user settings
+bool QualityGovernor::upgrade(Model& model)
+{
+  const size_t maxMaxNbPartsInCell = std::min(m_ranges.maxMaxNbPartsInCell, m_userSettings.maxNbPartsInCell);
+  const size_t maxNbPartsInCell = model.getMaxNbPartsInCell();
+  if (model.isMaxNbPartsInCellApplied() && maxNbPartsInCell > 0 && maxNbPartsInCell < maxMaxNbPartsInCell)
+  {
+    const size_t newMaxNbPartsInCell = std::min(maxNbPartsInCell * 2, maxMaxNbPartsInCell);
+    model.setMaxNbPartsInCell(newMaxNbPartsInCell);
+    LOG_INFO("Step time {:.2f} ms under budget {:.2f} ms, max particles in cell {} -> {}", m_smoothedStepTimeMs, m_frameBudgetMs, maxNbPartsInCell, newMaxNbPartsInCell);
+    return true;
+  }
+
+  if (m_hasDisabledVorticity)
+  {
+    model.enableVorticityConfinement(true);
+    m_hasDisabledVorticity = false;
+    LOG_INFO("Step time {:.2f} ms under budget {:.2f} ms, vorticity confinement and xsph viscosity enabled", m_smoothedStepTimeMs, m_frameBudgetMs);
+    return true;
+  }
+
+  const size_t maxNbJacobiIters = std::min(m_ranges.maxNbJacobiIters, m_userSettings.nbJacobiIters);
+  const size_t nbJacobiIters = model.getNbJacobiIters();
+  if (nbJacobiIters > 0 && nbJacobiIters < maxNbJacobiIters)
+  {
+    model.setNbJacobiIters(nbJacobiIters + 1);
+    LOG_INFO("Step time {:.2f} ms under budget {:.2f} ms, Jacobi iterations {} -> {}", m_smoothedStepTimeMs, m_frameBudgetMs, nbJacobiIters, nbJacobiIters + 1);
+    return true;
+  }
+
+  const size_t maxNbSubsteps = std::min(m_ranges.maxNbSubsteps, m_userSettings.nbSubsteps);
+  const size_t nbSubsteps = model.getNbSubsteps();
+  if (nbSubsteps > 0 && nbSubsteps < maxNbSubsteps)
+  {
+    model.setNbSubsteps(nbSubsteps + 1);
+    LOG_INFO("Step time {:.2f} ms under budget {:.2f} ms, substeps {} -> {}", m_smoothedStepTimeMs, m_frameBudgetMs, nbSubsteps, nbSubsteps + 1);
+    return true;
+  }
+
+  return false;
+}
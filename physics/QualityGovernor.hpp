@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Physics
+{
+class Model;
+
+// Ranges inside which the governor is allowed to move each simulation cost knob
+struct QualityRanges
+{
+  size_t minNbJacobiIters = 1;
+  size_t maxNbJacobiIters = 4;
+  size_t minMaxNbPartsInCell = 25;
+  size_t maxMaxNbPartsInCell = 100;
+  size_t minNbSubsteps = 1;
+  size_t maxNbSubsteps = 2;
+  bool canDisableVorticity = true;
+};
+
+// Watches the measured duration of each simulation step and adapts the model cost knobs
+// (substeps, Jacobi iterations, vorticity confinement and xsph viscosity, neighbour cap)
+// to keep it inside the frame budget, with hysteresis to prevent oscillations
+class QualityGovernor
+{
+  public:
+  QualityGovernor(QualityRanges ranges = {});
+  ~QualityGovernor() = default;
+
+  void enable(bool enable);
+  bool isEnabled() const { return m_isEnabled; }
+
+  void setFrameBudget(float budgetMs) { m_frameBudgetMs = budgetMs; }
+  float frameBudget() const { return m_frameBudgetMs; }
+
+  void setRanges(const QualityRanges& ranges) { m_ranges = ranges; }
+  const QualityRanges& ranges() const { return m_ranges; }
+
+  // Smoothed duration of the last simulation steps, in ms
+  float smoothedStepTime() const { return m_smoothedStepTimeMs; }
+
+  // To be called after each simulation step with its measured duration
+  void update(Model& model, float stepTimeMs);
+
+  // Forget measurements, to be called when the model changes
+  void reset();
+
+  private:
+  // Values of the knobs the governor moves
+  struct Settings
+  {
+    size_t nbJacobiIters = 0;
+    size_t maxNbPartsInCell = 0;
+    size_t nbSubsteps = 0;
+  };
+
+  Settings readSettings(const Model& model) const;
+  void updateUserSettings(const Model& model);
+
+  bool degrade(Model& model);
+  bool upgrade(Model& model);
+
+  bool m_isEnabled;
+
+  QualityRanges m_ranges;
+
+  float m_frameBudgetMs;
+  float m_smoothedStepTimeMs;
+
+  // Number of steps since last adaptation, knobs are not moved again before a cooldown
+  size_t m_nbStepsSinceChange;
+
+  // Vorticity confinement is only restored if the governor disabled it
+  bool m_hasDisabledVorticity;
+
+  // Knobs are never upgraded above the values set by the user
+  Settings m_userSettings;
+  // Values left by the last adaptation, any other value comes from the user
+  Settings m_governedSettings;
+  bool m_hasUserSettings;
+};
+}
@@ -10,43 +10,127 @@
 #endif
 #ifdef __APPLE__
 #include <OpenGL/OpenGL.h>
+#include <dlfcn.h>
 #endif
 
 #include "ErrorCode.hpp"
 #include "Logging.hpp"
+#include "Tracing.hpp"
 #include "Utils.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <vector>
 
+// Separates the namespace from the resource name in maps keys
+#define NAMESPACE_SEPARATOR "/"
+
+// Number of contiguous items processed by each work-item of coarsened kernels on CPU devices
+#define CPU_COARSENING_FACTOR 16
+
+// OpenGL buffers copied through host when the context is not shared with OpenGL
+#ifdef _WIN32
+#define GL_ENTRY __stdcall
+#else
+#define GL_ENTRY
+#endif
+#define GL_ARRAY_BUFFER_TARGET 0x8892
+#define GL_BUFFER_SIZE_PARAM 0x8764
+
+// Work-group sizes found by the autotuner, in the working directory
+#define TUNING_CACHE_FILE "workGroupSizes.cache"
+// Number of timed runs of each candidate work-group size
+#define NB_TUNING_SAMPLES 4
+#define MAX_TUNED_LOCAL_SIZE 1024
+
 Physics::CL::Context& Physics::CL::Context::Get()
 {
   static Context context;
   return context;
 }
 
+namespace
+{
+// Entry points of the current OpenGL context, loaded at first use as the physics do not link an OpenGL loader
+struct GLBufferFunctions
+{
+  void(GL_ENTRY* bindBuffer)(unsigned int target, unsigned int buffer);
+  void(GL_ENTRY* getBufferParameteriv)(unsigned int target, unsigned int name, int* params);
+  void(GL_ENTRY* getBufferSubData)(unsigned int target, std::ptrdiff_t offset, std::ptrdiff_t size, void* data);
+  void(GL_ENTRY* bufferSubData)(unsigned int target, std::ptrdiff_t offset, std::ptrdiff_t size, const void* data);
+};
+
+void* GetGLProcAddress(const char* name)
+{
+#ifdef _WIN32
+  return (void*)wglGetProcAddress(name);
+#endif
+#ifdef __linux__
+  return (void*)glXGetProcAddress((const GLubyte*)name);
+#endif
+#ifdef __APPLE__
+  return dlsym(RTLD_DEFAULT, name);
+#endif
+}
+
+const GLBufferFunctions& GetGLBufferFunctions()
+{
+  static const GLBufferFunctions functions = {
+    (decltype(GLBufferFunctions::bindBuffer))GetGLProcAddress("glBindBuffer"),
+    (decltype(GLBufferFunctions::getBufferParameteriv))GetGLProcAddress("glGetBufferParameteriv"),
+    (decltype(GLBufferFunctions::getBufferSubData))GetGLProcAddress("glGetBufferSubData"),
+    (decltype(GLBufferFunctions::bufferSubData))GetGLProcAddress("glBufferSubData")
+  };
+  return functions;
+}
+
+bool IsGLBufferAccessible()
+{
+  const GLBufferFunctions& gl = GetGLBufferFunctions();
+  return gl.bindBuffer && gl.getBufferParameteriv && gl.getBufferSubData && gl.bufferSubData;
+}
+}
+
 Physics::CL::Context::Context()
     : m_isKernelProfilingEnabled(false)
+    , m_isKernelTimingEnabled(false)
+    , m_isGLInteropEnabled(false)
+    , m_isRecordingArena(false)
+    , m_isTuningCacheDirty(false)
     , m_init(false)
 {
   if (!findPlatforms())
     return;
 
-  if (!findGPUDevices())
-    return;
+  // Falling back to a CPU device if no GPU can share buffers with OpenGL
+  findGPUDevices();
 
-  if (!createContext())
+  if (!createContext() && !createCPUContext())
     return;
 
+  cacheDeviceInfo();
+
   if (!createCommandQueue())
     return;
 
+  loadTuningCache();
+
   m_init = true;
 }
 
+Physics::CL::Context::~Context()
+{
+  // Tunings still in progress are done again at next run
+  if (m_isTuningCacheDirty)
+    saveTuningCache();
+}
+
 bool Physics::CL::Context::findPlatforms()
 {
   LOG_INFO("Searching for OpenCL platforms");
@@ -116,7 +200,7 @@ bool Physics::CL::Context::findGPUDevices()
 
   if (m_allGPUsWithInteropCLGL.empty())
   {
-    LOG_ERROR("No GPU found with Interop OpenCL-OpenGL extension, cannot create an OpenCL context");
+    LOG_INFO("No GPU found with Interop OpenCL-OpenGL extension");
     return false;
   }
 
@@ -175,12 +259,57 @@ bool Physics::CL::Context::createContext()
         cl_device = GPU;
 
         LOG_INFO("Success! Created an OpenCL context with platform {} and GPU {}", platformName, deviceName);
+
+        m_isGLInteropEnabled = true;
+
+        cl_bool isHostUnifiedMemory = CL_FALSE;
+        GPU.getInfo(CL_DEVICE_HOST_UNIFIED_MEMORY, &isHostUnifiedMemory);
+        if (isHostUnifiedMemory == CL_TRUE)
+          LOG_INFO("Device shares memory with host, buffers can be mapped without copy");
+
         return true;
       }
     }
   }
 
-  LOG_ERROR("Error while creating OpenCL context");
+  LOG_INFO("Cannot create an OpenCL context shared with OpenGL");
+  return false;
+}
+
+bool Physics::CL::Context::createCPUContext()
+{
+  LOG_INFO("Trying to create an OpenCL context on a CPU device, OpenGL buffers being copied through host");
+
+  if (!IsGLBufferAccessible())
+  {
+    LOG_ERROR("Cannot load OpenGL buffer functions, no OpenGL context current");
+    return false;
+  }
+
+  for (const auto& platform : m_allPlatforms)
+  {
+    std::vector<cl::Device> CPUs;
+    if (platform.getDevices(CL_DEVICE_TYPE_CPU, &CPUs) != CL_SUCCESS || CPUs.empty())
+      continue;
+
+    cl_int err;
+    cl_context = cl::Context(CPUs.front(), nullptr, nullptr, nullptr, &err);
+    if (err != CL_SUCCESS)
+      continue;
+
+    cl_platform = platform;
+    cl_device = CPUs.front();
+
+    std::string platformName;
+    platform.getInfo(CL_PLATFORM_NAME, &platformName);
+    std::string deviceName;
+    cl_device.getInfo(CL_DEVICE_NAME, &deviceName);
+    LOG_INFO("Success! Created an OpenCL context with platform {} and CPU {}", platformName, deviceName);
+
+    return true;
+  }
+
+  LOG_ERROR("Error while creating OpenCL context, no GPU sharing buffers with OpenGL nor CPU device found");
   return false;
 }
 
@@ -198,6 +327,23 @@ bool Physics::CL::Context::createCommandQueue()
     LOG_ERROR("Cannot create OpenCL queue");
     return false;
   }
+
+  // Without out-of-order support, a second in-order queue still lets the device overlap both queues
+  cl_command_queue_properties supportedProperties = 0;
+  cl_device.getInfo(CL_DEVICE_QUEUE_PROPERTIES, &supportedProperties);
+  const bool isOutOfOrderSupported = (supportedProperties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+  if (isOutOfOrderSupported)
+    properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+
+  cl_asyncQueue = cl::CommandQueue(cl_context, cl_device, properties, &err);
+  if (err != CL_SUCCESS)
+  {
+    LOG_ERROR("Cannot create OpenCL asynchronous queue");
+    return false;
+  }
+
+  LOG_INFO("Asynchronous kernels run on {} queue", isOutOfOrderSupported ? "an out-of-order" : "a second in-order");
+
   return true;
 }
 
@@ -206,278 +352,834 @@ bool Physics::CL::Context::release()
   if (!m_init)
     return true;
 
-  finishTasks();
+  for (auto& mappedView : m_mappedViewsMap)
+    mappedView.second.queue.enqueueUnmapMemObject(mappedView.second.buffer, mappedView.second.hostPtr);
+  m_mappedViewsMap.clear();
+
+  finishAllTasks();
 
   LOG_DEBUG("Physics::CL::Context::release - Context has been cleaned");
 
   m_programsMap.clear();
+  m_programsCache.clear();
   m_kernelsMap.clear();
   m_buffersMap.clear();
   m_GLBuffersMap.clear();
+  m_GLBuffersVBO.clear();
   m_imagesMap.clear();
+  m_arenasMap.clear();
+  m_allocationsMap.clear();
+  m_namespacePartitions.clear();
+  m_partitions.clear();
+  m_eventsMap.clear();
+  m_programsSpecs.clear();
+  m_kernelsLaunch.clear();
+  m_kernelsTuning.clear();
+  m_kernelsTiming.clear();
+  m_tracedCommands.clear();
 
   return true;
 }
 
-bool Physics::CL::Context::finishTasks()
+bool Physics::CL::Context::releaseNamespace(const std::string& nameSpace)
 {
-  cl_int err = cl_queue.flush();
-  if (err != CL_SUCCESS)
+  if (!m_init)
+    return true;
+
+  finishAllTasks();
+
+  const std::string prefix = nameSpace + NAMESPACE_SEPARATOR;
+  const auto isInNamespace = [&prefix](const auto& item) { return item.first.compare(0, prefix.size(), prefix) == 0; };
+
+  const auto eraseNamespace = [&isInNamespace](auto& map)
   {
-    CL_ERROR(err, "Cannot flush queue");
-    return false;
-  }
+    for (auto it = map.begin(); it != map.end();)
+      it = isInNamespace(*it) ? map.erase(it) : std::next(it);
+  };
 
-  err = cl_queue.finish();
-  if (err != CL_SUCCESS)
+  // Views left mapped are unmapped before their buffers are released
+  for (auto& mappedView : m_mappedViewsMap)
   {
-    CL_ERROR(err, "Cannot finish queue");
-    return false;
+    if (isInNamespace(mappedView))
+      mappedView.second.queue.enqueueUnmapMemObject(mappedView.second.buffer, mappedView.second.hostPtr);
   }
+  eraseNamespace(m_mappedViewsMap);
+
+  eraseNamespace(m_programsMap);
+  eraseNamespace(m_kernelsMap);
+  eraseNamespace(m_buffersMap);
+  eraseNamespace(m_GLBuffersMap);
+  eraseNamespace(m_GLBuffersVBO);
+  eraseNamespace(m_imagesMap);
+  eraseNamespace(m_arenasMap);
+  eraseNamespace(m_allocationsMap);
+  eraseNamespace(m_namespacePartitions);
+  eraseNamespace(m_eventsMap);
+  eraseNamespace(m_programsSpecs);
+  eraseNamespace(m_kernelsLaunch);
+  eraseNamespace(m_kernelsTuning);
+  eraseNamespace(m_kernelsTiming);
+
+  if (m_currentNamespace == nameSpace)
+    m_currentNamespace.clear();
+
+  LOG_DEBUG("Physics::CL::Context::releaseNamespace - Namespace {} has been cleaned", nameSpace);
 
-  LOG_DEBUG("Explicitly flushed and finished OpenCL device queue");
   return true;
 }
 
-bool Physics::CL::Context::createProgram(std::string programName, std::vector<std::string> sourceNames, std::string specificBuildOptions)
+std::string Physics::CL::Context::scopedName(const std::string& name) const
 {
-  if (!m_init)
-    return false;
+  return m_currentNamespace.empty() ? name : m_currentNamespace + NAMESPACE_SEPARATOR + name;
+}
 
-  cl::Program::Sources sources;
-  for (const auto& sourceName : sourceNames)
-  {
-    // Little hack to make it work from both installer and local build
-    std::ifstream sourceFile(std::filesystem::path("./kernels/" + sourceName).string());
+void Physics::CL::Context::recordAllocation(const std::string& name, const std::string& kind, size_t size, cl_mem_flags memoryFlags)
+{
+  m_allocationsMap[name] = { kind, size, memoryFlags };
+}
 
-    if (!sourceFile.is_open())
-      sourceFile.open(std::filesystem::path(Utils::GetSrcDir() + "/physics/ocl/kernels/" + sourceName).string());
+Physics::CL::MemoryFootprint Physics::CL::Context::memoryFootprint(const std::string& nameSpace) const
+{
+  const std::string prefix = nameSpace + NAMESPACE_SEPARATOR;
 
-    if (!sourceFile.is_open())
-      LOG_ERROR("Cannot find kernel file {}", sourceName);
+  MemoryFootprint footprint;
+  for (const auto& allocation : m_allocationsMap)
+  {
+    if (allocation.first.compare(0, prefix.size(), prefix) != 0)
+      continue;
 
-    std::string sourceCode(std::istreambuf_iterator<char>(sourceFile), (std::istreambuf_iterator<char>()));
-    sources.push_back(sourceCode);
+    ++footprint.nbAllocations;
+    footprint.totalSize += allocation.second.size;
+    footprint.biggestAllocationSize = std::max(footprint.biggestAllocationSize, allocation.second.size);
   }
 
-  auto program = cl::Program(cl_context, sources);
-
-  std::string options = specificBuildOptions + std::string(" -cl-denorms-are-zero -cl-fast-relaxed-math");
+  return footprint;
+}
 
-  try
-  {
-    program.build({ cl_device }, options.c_str());
-  }
-  catch (...)
+Physics::CL::MemoryFootprint Physics::CL::Context::totalMemoryFootprint() const
+{
+  MemoryFootprint footprint;
+  for (const auto& allocation : m_allocationsMap)
   {
-    cl_int buildErr = CL_SUCCESS;
-    auto buildInfo = program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(&buildErr);
-    for (auto& pair : buildInfo)
-    {
-      std::cerr << pair.second << std::endl;
-    }
-    throw std::runtime_error(" Exiting Program ");
+    ++footprint.nbAllocations;
+    footprint.totalSize += allocation.second.size;
+    footprint.biggestAllocationSize = std::max(footprint.biggestAllocationSize, allocation.second.size);
   }
 
-  m_programsMap.insert(std::make_pair(programName, program));
-
-  return true;
+  return footprint;
 }
 
-bool Physics::CL::Context::createBuffer(std::string bufferName, size_t bufferSize, cl_mem_flags memoryFlags)
+void Physics::CL::Context::reportMemoryFootprint() const
 {
   if (!m_init)
-    return false;
+    return;
 
-  cl_int err;
+  const size_t globalMemSize = getDeviceGlobalMemSize();
+  const size_t maxMemAllocSize = getDeviceMaxMemAllocSize();
 
-  if (m_buffersMap.find(bufferName) != m_buffersMap.end())
+  const auto toMB = [](size_t size) { return (float)size / (1024.0f * 1024.0f); };
+
+  LOG_INFO("Device memory footprint on {}, global memory {:.1f} MB, max allocation {:.1f} MB", getDeviceName(), toMB(globalMemSize), toMB(maxMemAllocSize));
+
+  for (const auto& allocation : m_allocationsMap)
   {
-    LOG_ERROR("Buffer {} already existing", bufferName);
-    return false;
-  }
+    const auto& specs = allocation.second;
+    LOG_DEBUG("{} {} of {:.2f} MB, flags {:#x}", specs.kind, allocation.first, toMB(specs.size), (unsigned long long)specs.memoryFlags);
 
-  auto buffer = cl::Buffer(cl_context, memoryFlags, bufferSize, nullptr, &err);
+    if (specs.size > maxMemAllocSize)
+      LOG_ERROR("{} {} of {:.2f} MB exceeds device max allocation size", specs.kind, allocation.first, toMB(specs.size));
+  }
 
-  if (err != CL_SUCCESS)
+  // Allocations are sorted by scoped name, those of the same namespace are contiguous
+  std::string nameSpace;
+  for (const auto& allocation : m_allocationsMap)
   {
-    LOG_ERROR("Cannot create buffer {}", bufferName);
-    return false;
+    const size_t separatorPos = allocation.first.find(NAMESPACE_SEPARATOR);
+    const std::string allocationNamespace = (separatorPos != std::string::npos) ? allocation.first.substr(0, separatorPos) : "";
+
+    if (separatorPos == std::string::npos || allocationNamespace == nameSpace)
+      continue;
+
+    nameSpace = allocationNamespace;
+    const MemoryFootprint footprint = memoryFootprint(nameSpace);
+    LOG_INFO("{}: {} allocations, {:.2f} MB ({:.1f}% of global memory), biggest one {:.2f} MB",
+        nameSpace, footprint.nbAllocations, toMB(footprint.totalSize), 100.0f * footprint.totalSize / std::max(globalMemSize, (size_t)1), toMB(footprint.biggestAllocationSize));
   }
 
-  m_buffersMap.insert(std::make_pair(bufferName, buffer));
+  const MemoryFootprint total = totalMemoryFootprint();
+  LOG_INFO("Total: {} allocations, {:.2f} MB ({:.1f}% of global memory)", total.nbAllocations, toMB(total.totalSize), 100.0f * total.totalSize / std::max(globalMemSize, (size_t)1));
 
-  return true;
+  if (total.totalSize > globalMemSize)
+    LOG_ERROR("Device memory footprint exceeds device global memory size");
 }
 
-bool Physics::CL::Context::createImage2D(std::string name, imageSpecs specs, cl_mem_flags memoryFlags)
+size_t Physics::CL::Context::createPartitions(size_t nbPartitions)
 {
-  if (!m_init)
-    return false;
-
-  cl_int err;
+  if (!m_init || nbPartitions == 0)
+    return 0;
 
-  if (m_imagesMap.find(name) != m_imagesMap.end())
+  if (!m_partitions.empty())
   {
-    LOG_ERROR("Image {} already existing", name);
-    return false;
+    LOG_ERROR("Partitions already created");
+    return m_partitions.size();
   }
 
-  cl::ImageFormat format(specs.channelOrder, specs.channelType);
+  // The device shared with OpenGL is a GPU, which usually cannot be split, partitions are made of the CPUs of the first platform exposing some
+  // All of them must belong to the same platform, as they share one context
+  std::vector<cl::Device> devices;
+  for (const auto& platform : m_allPlatforms)
+  {
+    std::vector<cl::Device> CPUs;
+    if (platform.getDevices(CL_DEVICE_TYPE_CPU, &CPUs) != CL_SUCCESS || CPUs.empty())
+      continue;
 
-  auto image = cl::Image2D(cl_context, memoryFlags, format, specs.width, specs.height, 0, nullptr, &err);
+    for (const auto& CPU : CPUs)
+    {
+      std::vector<cl::Device> subDevices;
 
-  if (err != CL_SUCCESS)
-  {
-    LOG_ERROR("Cannot create image {}", name);
-    return false;
-  }
+      // One sub-device per NUMA node, as on multi-socket CPUs
+      const cl_device_partition_property numaProperties[] = { CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0 };
+      if (CPU.createSubDevices(numaProperties, &subDevices) != CL_SUCCESS || subDevices.size() < 2)
+      {
+        subDevices.clear();
 
-  m_imagesMap.insert(std::make_pair(name, image));
+        // Otherwise equal sets of compute units, the partitions being spread over all the CPUs
+        cl_uint nbComputeUnits = 0;
+        CPU.getInfo(CL_DEVICE_MAX_COMPUTE_UNITS, &nbComputeUnits);
+        const size_t nbPartitionsPerCPU = (nbPartitions + CPUs.size() - 1) / CPUs.size();
+        const cl_uint nbComputeUnitsPerPartition = std::max(nbComputeUnits / (cl_uint)nbPartitionsPerCPU, (cl_uint)1);
 
-  return true;
-}
+        const cl_device_partition_property equallyProperties[] = { CL_DEVICE_PARTITION_EQUALLY, (cl_device_partition_property)nbComputeUnitsPerPartition, 0 };
+        if (nbPartitionsPerCPU < 2 || CPU.createSubDevices(equallyProperties, &subDevices) != CL_SUCCESS)
+          subDevices = { CPU };
+      }
 
-bool Physics::CL::Context::loadBufferFromHost(std::string bufferName, size_t offset, size_t sizeToFill, const void* hostPtr)
-{
-  if (!m_init)
-    return false;
+      devices.insert(devices.end(), subDevices.begin(), subDevices.end());
+    }
 
-  cl_int err;
+    std::string platformName;
+    platform.getInfo(CL_PLATFORM_NAME, &platformName);
+    LOG_INFO("{} CPU devices available for partitions on platform {}", devices.size(), platformName);
+    break;
+  }
 
-  cl::Buffer destBuffer;
+  if (devices.empty())
+  {
+    LOG_ERROR("No CPU device found on any OpenCL platform, partitions cannot be created");
+    return 0;
+  }
 
-  auto itSrc = m_buffersMap.find(bufferName);
-  if (itSrc == m_buffersMap.end())
+  devices.resize(std::min(devices.size(), nbPartitions));
+
+  cl_int err;
+  cl_partitionsContext = cl::Context(devices, nullptr, nullptr, nullptr, &err);
+  if (err != CL_SUCCESS)
   {
-    auto itSrcGL = m_GLBuffersMap.find(bufferName);
+    CL_ERROR(err, "Cannot create partitions context");
+    return 0;
+  }
 
-    if (itSrcGL == m_GLBuffersMap.end())
-    {
-      LOG_ERROR("Buffer {} not existing", bufferName);
-      return false;
-    }
-    else
+  for (const auto& device : devices)
+  {
+    auto queue = cl::CommandQueue(cl_partitionsContext, device, CL_QUEUE_PROFILING_ENABLE, &err);
+    if (err != CL_SUCCESS)
     {
-      destBuffer = itSrcGL->second;
+      CL_ERROR(err, "Cannot create partition queue");
+      m_partitions.clear();
+      return 0;
     }
+
+    std::string deviceName;
+    device.getInfo(CL_DEVICE_NAME, &deviceName);
+    LOG_INFO("Partition {} created on {}", m_partitions.size(), deviceName);
+
+    m_partitions.push_back({ device, queue });
   }
-  else
-    destBuffer = itSrc->second;
 
-  err = cl_queue.enqueueWriteBuffer(destBuffer, CL_TRUE, offset, sizeToFill, hostPtr);
+  if (m_partitions.size() < nbPartitions)
+    LOG_ERROR("Only {} partitions out of {} could be created", m_partitions.size(), nbPartitions);
 
-  if (err != CL_SUCCESS)
+  return m_partitions.size();
+}
+
+bool Physics::CL::Context::bindNamespaceToPartition(const std::string& nameSpace, size_t partition)
+{
+  if (partition >= m_partitions.size())
   {
-    LOG_ERROR("Cannot load buffer {}", bufferName);
+    LOG_ERROR("Cannot bind namespace {} to partition {}, not existing", nameSpace, partition);
     return false;
   }
 
+  m_namespacePartitions[nameSpace] = partition;
+
   return true;
 }
 
-bool Physics::CL::Context::unloadBufferFromDevice(std::string bufferName, size_t offset, size_t sizeToFill, void* hostPtr)
+const cl::Context& Physics::CL::Context::currentContext() const
 {
-  if (!m_init)
-    return false;
+  return (m_namespacePartitions.find(m_currentNamespace) != m_namespacePartitions.end()) ? cl_partitionsContext : cl_context;
+}
 
-  cl_int err;
+const cl::Device& Physics::CL::Context::currentDevice() const
+{
+  const auto it = m_namespacePartitions.find(m_currentNamespace);
+  return (it != m_namespacePartitions.end()) ? m_partitions[it->second].device : cl_device;
+}
 
-  cl::Buffer srcBuffer;
+cl::CommandQueue& Physics::CL::Context::currentQueue()
+{
+  const auto it = m_namespacePartitions.find(m_currentNamespace);
+  return (it != m_namespacePartitions.end()) ? m_partitions[it->second].queue : cl_queue;
+}
 
-  auto itSrc = m_buffersMap.find(bufferName);
-  if (itSrc == m_buffersMap.end())
+cl::CommandQueue& Physics::CL::Context::currentAsyncQueue()
+{
+  const auto it = m_namespacePartitions.find(m_currentNamespace);
+  return (it != m_namespacePartitions.end()) ? m_partitions[it->second].queue : cl_asyncQueue;
+}
+
+bool Physics::CL::Context::finishAllTasks()
+{
+  const std::string currentNamespace = m_currentNamespace;
+
+  m_currentNamespace.clear();
+  bool isFinished = finishTasks();
+
+  for (const auto& namespacePartition : m_namespacePartitions)
   {
-    auto itSrcGL = m_GLBuffersMap.find(bufferName);
+    m_currentNamespace = namespacePartition.first;
+    isFinished &= finishTasks();
+  }
 
-    if (itSrcGL == m_GLBuffersMap.end())
+  m_currentNamespace = currentNamespace;
+
+  return isFinished;
+}
+
+bool Physics::CL::Context::finishTasks()
+{
+  // Asynchronous queue first, in-order one may be waiting for its events
+  for (cl::CommandQueue* queue : { &currentAsyncQueue(), &currentQueue() })
+  {
+    cl_int err = queue->flush();
+    if (err != CL_SUCCESS)
     {
-      LOG_ERROR("Buffer {} not existing", bufferName);
+      CL_ERROR(err, "Cannot flush queue");
       return false;
     }
-    else
+
+    err = queue->finish();
+    if (err != CL_SUCCESS)
     {
-      srcBuffer = itSrcGL->second;
+      CL_ERROR(err, "Cannot finish queue");
+      return false;
     }
   }
-  else
-    srcBuffer = itSrc->second;
 
-  err = cl_queue.enqueueReadBuffer(srcBuffer, CL_TRUE, offset, sizeToFill, hostPtr);
+  LOG_DEBUG("Explicitly flushed and finished OpenCL device queue");
 
-  if (err != CL_SUCCESS)
-  {
-    LOG_ERROR("Cannot unload buffer {}", bufferName);
-    return false;
-  }
+  collectTracedCommands();
 
   return true;
 }
 
-bool Physics::CL::Context::swapBuffers(std::string bufferNameA, std::string bufferNameB)
+bool Physics::CL::Context::createProgram(std::string programName, std::vector<std::string> sourceNames, std::string specificBuildOptions)
 {
   if (!m_init)
     return false;
 
-  const auto& itA = m_buffersMap.find(bufferNameA);
-  if (itA == m_buffersMap.end())
-  {
-    LOG_ERROR("Cannot swap buffers, buffer {} not existing", bufferNameA);
-    return false;
-  }
+  programName = scopedName(programName);
 
-  const auto& itB = m_buffersMap.find(bufferNameB);
-  if (itB == m_buffersMap.end())
-  {
-    LOG_ERROR("Cannot swap buffers, buffer {} not existing", bufferNameB);
-    return false;
-  }
+  size_t coarseningFactor = 0;
+  const std::string options = programBuildOptions(currentDevice(), sourceNames, specificBuildOptions, coarseningFactor);
 
-  auto tempBuffer = itA->second;
-  itA->second = itB->second;
-  itB->second = tempBuffer;
+  if (coarseningFactor > 0)
+    m_programsSpecs[programName] = { options, coarseningFactor };
+
+  // Waited for when the first kernel of the program is created
+  m_programsMap.insert(std::make_pair(programName, buildProgram(currentContext(), currentDevice(), sourceNames, options)));
 
   return true;
 }
 
-bool Physics::CL::Context::copyBuffer(std::string srcBufferName, std::string dstBufferName)
+bool Physics::CL::Context::prebuildProgram(std::vector<std::string> sourceNames, std::string specificBuildOptions)
 {
   if (!m_init)
     return false;
 
-  cl_int err;
+  // Models are created on the main context unless bound to a partition
+  size_t coarseningFactor = 0;
+  const std::string options = programBuildOptions(cl_device, sourceNames, specificBuildOptions, coarseningFactor);
 
-  cl::Buffer srcBuffer;
+  buildProgram(cl_context, cl_device, sourceNames, options);
 
-  const auto& itSrc = m_buffersMap.find(srcBufferName);
+  return true;
+}
 
-  if (itSrc == m_buffersMap.end())
-  {
-    auto itSrcGL = m_GLBuffersMap.find(srcBufferName);
+std::string Physics::CL::Context::programBuildOptions(const cl::Device& device, const std::vector<std::string>& sourceNames,
+    const std::string& specificBuildOptions, size_t& coarseningFactor) const
+{
+  std::string options = specificBuildOptions + std::string(" -cl-denorms-are-zero -cl-fast-relaxed-math");
 
-    if (itSrcGL == m_GLBuffersMap.end())
-    {
-      LOG_ERROR("Cannot copy buffers, source buffer {} not existing", srcBufferName);
-      return false;
-    }
-    else
-    {
-      srcBuffer = itSrcGL->second;
-    }
-  }
-  else
-  {
-    srcBuffer = itSrc->second;
+  // Kernels of programs built on define.cl loop over their items, CPU devices run fewer but bigger work-items
+  // Main context is on a CPU device when no GPU shares buffers with OpenGL, partitions always are
+  cl_device_type deviceType = 0;
+  device.getInfo(CL_DEVICE_TYPE, &deviceType);
+  const bool isCoarsenable = std::find(sourceNames.cbegin(), sourceNames.cend(), "define.cl") != sourceNames.cend();
+  const bool isCoarsened = isCoarsenable && (deviceType & CL_DEVICE_TYPE_CPU);
+  if (isCoarsened)
+    options += " -DCOARSENING_FACTOR=" + std::to_string(CPU_COARSENING_FACTOR);
+
+  coarseningFactor = isCoarsenable ? (isCoarsened ? CPU_COARSENING_FACTOR : 1) : 0;
+
+  return options;
+}
+
+std::shared_future<cl::Program> Physics::CL::Context::buildProgram(const cl::Context& context, const cl::Device& device,
+    const std::vector<std::string>& sourceNames, const std::string& options)
+{
+  // Same sources built with the same options for the same device give the same program, whatever the model
+  std::string cacheKey = std::to_string((uintptr_t)context()) + " " + std::to_string((uintptr_t)device()) + "|" + options;
+  for (const auto& sourceName : sourceNames)
+    cacheKey += "|" + sourceName;
+
+  auto itCached = m_programsCache.find(cacheKey);
+  if (itCached != m_programsCache.end())
+    return itCached->second;
+
+  // Sources are read and built on a worker thread, build calls being blocking on most drivers even with a callback
+  auto program = std::async(std::launch::async, [context, device, sourceNames, options]()
+      {
+        const auto startTime = std::chrono::steady_clock::now();
+
+        cl::Program::Sources sources;
+        for (const auto& sourceName : sourceNames)
+        {
+          // Little hack to make it work from both installer and local build
+          std::ifstream sourceFile(std::filesystem::path("./kernels/" + sourceName).string());
+
+          if (!sourceFile.is_open())
+            sourceFile.open(std::filesystem::path(Utils::GetSrcDir() + "/physics/ocl/kernels/" + sourceName).string());
+
+          if (!sourceFile.is_open())
+            LOG_ERROR("Cannot find kernel file {}", sourceName);
+
+          std::string sourceCode(std::istreambuf_iterator<char>(sourceFile), (std::istreambuf_iterator<char>()));
+          sources.push_back(sourceCode);
+        }
+
+        auto program = cl::Program(context, sources);
+
+        try
+        {
+          program.build({ device }, options.c_str());
+        }
+        catch (...)
+        {
+          cl_int buildErr = CL_SUCCESS;
+          auto buildInfo = program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(&buildErr);
+          for (auto& pair : buildInfo)
+          {
+            std::cerr << pair.second << std::endl;
+          }
+          // Rethrown to the thread creating the first kernel of the program
+          throw std::runtime_error(" Exiting Program ");
+        }
+
+        LOG_DEBUG("Program {} built in {} ms", sourceNames.back(),
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+
+        return program;
+      }).share();
+
+  m_programsCache.insert(std::make_pair(cacheKey, program));
+
+  return program;
+}
+
+bool Physics::CL::Context::createBuffer(std::string bufferName, size_t bufferSize, cl_mem_flags memoryFlags, std::string transientSlot)
+{
+  if (!m_init)
+    return false;
+
+  cl_int err;
+
+  bufferName = scopedName(bufferName);
+
+  if (m_buffersMap.find(bufferName) != m_buffersMap.end())
+  {
+    LOG_ERROR("Buffer {} already existing", bufferName);
+    return false;
+  }
+
+  // Allocation is delayed until the whole arena is known
+  if (m_isRecordingArena)
+  {
+    m_pendingArenaBuffers.push_back({ bufferName, bufferSize, memoryFlags, transientSlot });
+    return true;
+  }
+
+  // Host accessible memory on devices sharing it, mapping is then done in place
+  if (isHostUnifiedMemory())
+    memoryFlags |= CL_MEM_ALLOC_HOST_PTR;
+
+  auto buffer = cl::Buffer(currentContext(), memoryFlags, bufferSize, nullptr, &err);
+
+  if (err != CL_SUCCESS)
+  {
+    LOG_ERROR("Cannot create buffer {}", bufferName);
+    return false;
+  }
+
+  m_buffersMap.insert(std::make_pair(bufferName, buffer));
+  recordAllocation(bufferName, "Buffer", bufferSize, memoryFlags);
+
+  return true;
+}
+
+bool Physics::CL::Context::beginArena(std::string arenaName)
+{
+  if (!m_init)
+    return false;
+
+  if (m_isRecordingArena)
+  {
+    LOG_ERROR("Cannot begin arena {}, arena {} not ended", arenaName, m_pendingArenaName);
+    return false;
+  }
+
+  m_pendingArenaName = scopedName(arenaName);
+  m_pendingArenaBuffers.clear();
+  m_isRecordingArena = true;
+
+  return true;
+}
+
+bool Physics::CL::Context::endArena()
+{
+  if (!m_init || !m_isRecordingArena)
+    return false;
+
+  m_isRecordingArena = false;
+
+  cl_uint baseAddrAlignBits = 0;
+  currentDevice().getInfo(CL_DEVICE_MEM_BASE_ADDR_ALIGN, &baseAddrAlignBits);
+  const size_t alignment = std::max((size_t)baseAddrAlignBits / 8, (size_t)1);
+  const auto alignUp = [alignment](size_t size) { return (size + alignment - 1) / alignment * alignment; };
+
+  // Transient slots are sized by their biggest buffer
+  std::map<std::string, size_t> slotSizes;
+  for (const auto& buffer : m_pendingArenaBuffers)
+  {
+    if (!buffer.transientSlot.empty())
+      slotSizes[buffer.transientSlot] = std::max(slotSizes[buffer.transientSlot], buffer.size);
+  }
+
+  std::map<std::string, size_t> slotOffsets;
+  std::vector<size_t> offsets;
+  size_t arenaSize = 0;
+  size_t totalBuffersSize = 0;
+  for (const auto& buffer : m_pendingArenaBuffers)
+  {
+    totalBuffersSize += buffer.size;
+
+    if (buffer.transientSlot.empty())
+    {
+      offsets.push_back(arenaSize);
+      arenaSize += alignUp(buffer.size);
+      continue;
+    }
+
+    auto itSlot = slotOffsets.find(buffer.transientSlot);
+    if (itSlot == slotOffsets.end())
+    {
+      itSlot = slotOffsets.insert(std::make_pair(buffer.transientSlot, arenaSize)).first;
+      arenaSize += alignUp(slotSizes[buffer.transientSlot]);
+    }
+    offsets.push_back(itSlot->second);
+  }
+
+  // Sub-buffers inherit host accessible memory of the arena
+  const cl_mem_flags arenaFlags = CL_MEM_READ_WRITE | (isHostUnifiedMemory() ? CL_MEM_ALLOC_HOST_PTR : 0);
+
+  cl_int err;
+  auto arena = cl::Buffer(currentContext(), arenaFlags, std::max(arenaSize, (size_t)1), nullptr, &err);
+
+  if (err != CL_SUCCESS)
+  {
+    CL_ERROR(err, "Cannot allocate arena " + m_pendingArenaName);
+    return false;
+  }
+
+  for (size_t i = 0; i < m_pendingArenaBuffers.size(); ++i)
+  {
+    const auto& buffer = m_pendingArenaBuffers[i];
+
+    cl_buffer_region region = { offsets[i], buffer.size };
+    // Host pointer flags are not allowed for sub-buffers, access ones are
+    const cl_mem_flags accessFlags = buffer.memoryFlags & (CL_MEM_READ_WRITE | CL_MEM_READ_ONLY | CL_MEM_WRITE_ONLY);
+    auto subBuffer = arena.createSubBuffer(accessFlags, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+
+    if (err != CL_SUCCESS)
+    {
+      CL_ERROR(err, "Cannot create buffer " + buffer.name + " in arena " + m_pendingArenaName);
+      return false;
+    }
+
+    m_buffersMap.insert(std::make_pair(buffer.name, subBuffer));
+
+    LOG_DEBUG("Buffer {} of {} bytes created at offset {} of arena {}{}", buffer.name, buffer.size, offsets[i], m_pendingArenaName,
+        buffer.transientSlot.empty() ? "" : ", sharing transient slot " + buffer.transientSlot);
+  }
+
+  m_arenasMap.insert(std::make_pair(m_pendingArenaName, arena));
+  recordAllocation(m_pendingArenaName, "Arena", arenaSize, arenaFlags);
+
+  LOG_INFO("Arena {} allocated with {} buffers, {} bytes for {} bytes of buffers", m_pendingArenaName, m_pendingArenaBuffers.size(), arenaSize, totalBuffersSize);
+
+  m_pendingArenaBuffers.clear();
+
+  return true;
+}
+
+bool Physics::CL::Context::createImage2D(std::string name, imageSpecs specs, cl_mem_flags memoryFlags)
+{
+  if (!m_init)
+    return false;
+
+  cl_int err;
+
+  name = scopedName(name);
+
+  if (m_imagesMap.find(name) != m_imagesMap.end())
+  {
+    LOG_ERROR("Image {} already existing", name);
+    return false;
+  }
+
+  cl::ImageFormat format(specs.channelOrder, specs.channelType);
+
+  auto image = cl::Image2D(currentContext(), memoryFlags, format, specs.width, specs.height, 0, nullptr, &err);
+
+  if (err != CL_SUCCESS)
+  {
+    LOG_ERROR("Cannot create image {}", name);
+    return false;
+  }
+
+  m_imagesMap.insert(std::make_pair(name, image));
+
+  size_t imageSize = 0;
+  image.getInfo(CL_MEM_SIZE, &imageSize);
+  recordAllocation(name, "Image", imageSize, memoryFlags);
+
+  return true;
+}
+
+bool Physics::CL::Context::loadBufferFromHost(std::string bufferName, size_t offset, size_t sizeToFill, const void* hostPtr, bool isBlocking)
+{
+  if (!m_init)
+    return false;
+
+  cl_int err;
+
+  cl::Buffer destBuffer;
+
+  bufferName = scopedName(bufferName);
+
+  auto itSrc = m_buffersMap.find(bufferName);
+  if (itSrc == m_buffersMap.end())
+  {
+    auto itSrcGL = m_GLBuffersMap.find(bufferName);
+
+    if (itSrcGL == m_GLBuffersMap.end())
+    {
+      LOG_ERROR("Buffer {} not existing", bufferName);
+      return false;
+    }
+    else
+    {
+      destBuffer = itSrcGL->second;
+    }
   }
+  else
+    destBuffer = itSrc->second;
+
+  err = currentQueue().enqueueWriteBuffer(destBuffer, isBlocking ? CL_TRUE : CL_FALSE, offset, sizeToFill, hostPtr);
+
+  if (err != CL_SUCCESS)
+  {
+    LOG_ERROR("Cannot load buffer {}", bufferName);
+    return false;
+  }
+
+  return true;
+}
+
+bool Physics::CL::Context::unloadBufferFromDevice(std::string bufferName, size_t offset, size_t sizeToFill, void* hostPtr, bool isBlocking)
+{
+  if (!m_init)
+    return false;
+
+  return enqueueUnload(scopedName(bufferName), offset, sizeToFill, hostPtr, isBlocking, nullptr);
+}
+
+bool Physics::CL::Context::unloadBufferFromDevice(std::string bufferName, size_t offset, size_t sizeToFill, void* hostPtr, std::function<void()> onComplete)
+{
+  if (!m_init)
+    return false;
+
+  bufferName = scopedName(bufferName);
+
+  cl::Event event;
+  if (!enqueueUnload(bufferName, offset, sizeToFill, hostPtr, false, &event))
+    return false;
+
+  // Owned by the callback, deleted once called
+  auto* callback = new std::function<void()>(std::move(onComplete));
+  cl_int err = event.setCallback(
+      CL_COMPLETE,
+      [](cl_event, cl_int, void* userData)
+      {
+        auto* callback = static_cast<std::function<void()>*>(userData);
+        (*callback)();
+        delete callback;
+      },
+      callback);
+
+  if (err != CL_SUCCESS)
+  {
+    delete callback;
+    CL_ERROR(err, "Cannot set completion callback of buffer " + bufferName);
+    return false;
+  }
+
+  // Submitted now so that the callback does not wait for the next finish
+  currentQueue().flush();
+
+  return true;
+}
+
+bool Physics::CL::Context::enqueueUnload(const std::string& bufferName, size_t offset, size_t sizeToFill, void* hostPtr, bool isBlocking, cl::Event* event)
+{
+  cl_int err;
+
+  cl::Buffer srcBuffer;
+
+  auto itSrc = m_buffersMap.find(bufferName);
+  if (itSrc == m_buffersMap.end())
+  {
+    auto itSrcGL = m_GLBuffersMap.find(bufferName);
+
+    if (itSrcGL == m_GLBuffersMap.end())
+    {
+      LOG_ERROR("Buffer {} not existing", bufferName);
+      return false;
+    }
+    else
+    {
+      srcBuffer = itSrcGL->second;
+    }
+  }
+  else
+    srcBuffer = itSrc->second;
+
+  err = currentQueue().enqueueReadBuffer(srcBuffer, isBlocking ? CL_TRUE : CL_FALSE, offset, sizeToFill, hostPtr, nullptr, event);
+
+  if (err != CL_SUCCESS)
+  {
+    LOG_ERROR("Cannot unload buffer {}", bufferName);
+    return false;
+  }
+
+  return true;
+}
+
+bool Physics::CL::Context::swapBuffers(std::string bufferNameA, std::string bufferNameB)
+{
+  if (!m_init)
+    return false;
+
+  bufferNameA = scopedName(bufferNameA);
+  bufferNameB = scopedName(bufferNameB);
+
+  const auto& itA = m_buffersMap.find(bufferNameA);
+  if (itA == m_buffersMap.end())
+  {
+    LOG_ERROR("Cannot swap buffers, buffer {} not existing", bufferNameA);
+    return false;
+  }
+
+  const auto& itB = m_buffersMap.find(bufferNameB);
+  if (itB == m_buffersMap.end())
+  {
+    LOG_ERROR("Cannot swap buffers, buffer {} not existing", bufferNameB);
+    return false;
+  }
+
+  auto tempBuffer = itA->second;
+  itA->second = itB->second;
+  itB->second = tempBuffer;
+
+  return true;
+}
+
+bool Physics::CL::Context::copyBuffer(std::string srcBufferName, std::string dstBufferName)
+{
+  if (!m_init)
+    return false;
+
+  cl_int err;
+
+  cl::Buffer srcBuffer;
+
+  srcBufferName = scopedName(srcBufferName);
+  dstBufferName = scopedName(dstBufferName);
+
+  const auto& itSrc = m_buffersMap.find(srcBufferName);
+
+  if (itSrc == m_buffersMap.end())
+  {
+    auto itSrcGL = m_GLBuffersMap.find(srcBufferName);
+
+    if (itSrcGL == m_GLBuffersMap.end())
+    {
+      LOG_ERROR("Cannot copy buffers, source buffer {} not existing", srcBufferName);
+      return false;
+    }
+    else
+    {
+      srcBuffer = itSrcGL->second;
+    }
+  }
+  else
+  {
+    srcBuffer = itSrc->second;
+  }
+
+  cl::Buffer dstBuffer;
 
   const auto& itDst = m_buffersMap.find(dstBufferName);
+
   if (itDst == m_buffersMap.end())
   {
-    LOG_ERROR("Cannot copy buffers, destination buffer {} not existing", dstBufferName);
-    return false;
+    auto itDstGL = m_GLBuffersMap.find(dstBufferName);
+
+    if (itDstGL == m_GLBuffersMap.end())
+    {
+      LOG_ERROR("Cannot copy buffers, destination buffer {} not existing", dstBufferName);
+      return false;
+    }
+    else
+    {
+      dstBuffer = itDstGL->second;
+    }
+  }
+  else
+  {
+    dstBuffer = itDst->second;
   }
 
-  cl::Buffer dstBuffer = itDst->second;
   size_t dstBufferSize;
   err = dstBuffer.getInfo(CL_MEM_SIZE, &dstBufferSize);
 
@@ -503,7 +1205,7 @@ bool Physics::CL::Context::copyBuffer(std::string srcBufferName, std::string dst
   }
 
   // Only copying the amount of data which can fit into the destination buffer
-  err = cl_queue.enqueueCopyBuffer(srcBuffer, dstBuffer, 0, 0, dstBufferSize);
+  err = currentQueue().enqueueCopyBuffer(srcBuffer, dstBuffer, 0, 0, dstBufferSize);
 
   if (err != CL_SUCCESS)
   {
@@ -521,13 +1223,35 @@ bool Physics::CL::Context::createGLBuffer(std::string GLBufferName, unsigned int
 
   cl_int err;
 
+  GLBufferName = scopedName(GLBufferName);
+
   if (m_GLBuffersMap.find(GLBufferName) != m_GLBuffersMap.end())
   {
     LOG_ERROR("GL buffer {} already existing", GLBufferName);
     return false;
   }
 
-  auto GLBuffer = cl::BufferGL(cl_context, memoryFlags, (cl_GLuint)VBOIndex, &err);
+  cl::BufferGL GLBuffer;
+  if (m_isGLInteropEnabled)
+  {
+    GLBuffer = cl::BufferGL(cl_context, memoryFlags, (cl_GLuint)VBOIndex, &err);
+  }
+  else
+  {
+    // Regular buffer as big as the VBO, wrapped as a GL one so that it is used the same way by kernels and copies
+    const GLBufferFunctions& gl = GetGLBufferFunctions();
+    int VBOSize = 0;
+    gl.bindBuffer(GL_ARRAY_BUFFER_TARGET, VBOIndex);
+    gl.getBufferParameteriv(GL_ARRAY_BUFFER_TARGET, GL_BUFFER_SIZE_PARAM, &VBOSize);
+    gl.bindBuffer(GL_ARRAY_BUFFER_TARGET, 0);
+
+    cl::Buffer buffer(cl_context, memoryFlags, (size_t)std::max(VBOSize, 1), nullptr, &err);
+    if (err == CL_SUCCESS)
+    {
+      GLBuffer = cl::BufferGL(buffer(), true);
+      m_GLBuffersVBO[GLBufferName] = VBOIndex;
+    }
+  }
 
   if (err != CL_SUCCESS)
   {
@@ -537,6 +1261,11 @@ bool Physics::CL::Context::createGLBuffer(std::string GLBufferName, unsigned int
 
   m_GLBuffersMap.insert(std::make_pair(GLBufferName, GLBuffer));
 
+  // Storage is owned by OpenGL but lives in device memory as well
+  size_t GLBufferSize = 0;
+  GLBuffer.getInfo(CL_MEM_SIZE, &GLBufferSize);
+  recordAllocation(GLBufferName, "GL buffer", GLBufferSize, memoryFlags);
+
   return true;
 }
 
@@ -549,19 +1278,25 @@ bool Physics::CL::Context::createKernel(std::string programName, std::string ker
 
   cl_int err;
 
-  if (m_programsMap.find(programName) == m_programsMap.end())
+  // Kernel name in the program is not scoped, only the key used to store it
+  const std::string kernelKey = scopedName(kernelName);
+  programName = scopedName(programName);
+
+  auto itProgram = m_programsMap.find(programName);
+  if (itProgram == m_programsMap.end())
   {
     LOG_ERROR("OpenCL program not existing {}", programName);
     return false;
   }
 
-  if (m_kernelsMap.find(kernelName) != m_kernelsMap.end())
+  if (m_kernelsMap.find(kernelKey) != m_kernelsMap.end())
   {
     LOG_ERROR("OpenCL kernel already existing {}", kernelName);
     return false;
   }
 
-  auto kernel = cl::Kernel(m_programsMap.at(programName), kernelName.c_str(), &err);
+  // Waits for the program if still being built
+  auto kernel = cl::Kernel(itProgram->second.get(), kernelName.c_str(), &err);
 
   if (err != CL_SUCCESS)
   {
@@ -574,9 +1309,11 @@ bool Physics::CL::Context::createKernel(std::string programName, std::string ker
     if (argNames[i].empty())
       continue;
 
-    auto it = m_buffersMap.find(argNames[i]);
-    auto itGL = m_GLBuffersMap.find(argNames[i]);
-    auto itIm = m_imagesMap.find(argNames[i]);
+    const std::string argName = scopedName(argNames[i]);
+
+    auto it = m_buffersMap.find(argName);
+    auto itGL = m_GLBuffersMap.find(argName);
+    auto itIm = m_imagesMap.find(argName);
     if (it != m_buffersMap.end())
     {
       kernel.setArg(i, it->second);
@@ -591,12 +1328,50 @@ bool Physics::CL::Context::createKernel(std::string programName, std::string ker
     }
     else
     {
-      LOG_ERROR("For kernel {} arg not existing {}", kernelName, argNames[i]);
-      return false;
+      LOG_ERROR("For kernel {} arg not existing {}", kernelName, argName);
+      return false;
+    }
+  }
+
+  auto itSpecs = m_programsSpecs.find(programName);
+  if (itSpecs != m_programsSpecs.end())
+  {
+    size_t simdWidth = 1, maxLocalSize = 1;
+    kernel.getWorkGroupInfo(currentDevice(), CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, &simdWidth);
+    kernel.getWorkGroupInfo(currentDevice(), CL_KERNEL_WORK_GROUP_SIZE, &maxLocalSize);
+    simdWidth = std::max(simdWidth, (size_t)1);
+    maxLocalSize = std::min(std::max(maxLocalSize, simdWidth), (size_t)MAX_TUNED_LOCAL_SIZE);
+
+    // Work-groups of coarsened kernels are as wide as the device SIMD until tuned, others are left to the driver
+    const size_t coarseningFactor = itSpecs->second.coarseningFactor;
+    KernelLaunch launch;
+    launch.coarseningFactor = coarseningFactor;
+    launch.localSize = (coarseningFactor > 1) ? simdWidth : 0;
+
+    std::string deviceName;
+    cl_uint nbComputeUnits = 0;
+    currentDevice().getInfo(CL_DEVICE_NAME, &deviceName);
+    currentDevice().getInfo(CL_DEVICE_MAX_COMPUTE_UNITS, &nbComputeUnits);
+    launch.cacheKey = deviceName.c_str() + std::string(" ") + std::to_string(nbComputeUnits)
+        + "|" + kernelName + "|" + itSpecs->second.buildOptions;
+
+    // Legal sizes are multiples of the SIMD width up to the kernel limit, driver choice being one of them
+    if (coarseningFactor == 1)
+      launch.candidates.push_back(0);
+    for (size_t localSize = simdWidth; localSize <= maxLocalSize; localSize *= 2)
+      launch.candidates.push_back(localSize);
+
+    for (size_t nbFilled = 2; nbFilled <= launch.candidates.size(); ++nbFilled)
+    {
+      auto itTuned = m_tunedLocalSizes.find(launch.cacheKey + "|" + std::to_string(nbFilled));
+      if (itTuned != m_tunedLocalSizes.end())
+        launch.tunedLocalSizes[nbFilled] = itTuned->second;
     }
+
+    m_kernelsLaunch[kernelKey] = launch;
   }
 
-  m_kernelsMap.insert(std::make_pair(kernelName, kernel));
+  m_kernelsMap.insert(std::make_pair(kernelKey, kernel));
 
   return true;
 }
@@ -606,6 +1381,8 @@ bool Physics::CL::Context::setKernelArg(std::string kernelName, cl_uint argIndex
   if (!m_init)
     return false;
 
+  kernelName = scopedName(kernelName);
+
   auto it = m_kernelsMap.find(kernelName);
   if (it == m_kernelsMap.end())
   {
@@ -625,11 +1402,14 @@ bool Physics::CL::Context::setKernelArg(std::string kernelName, cl_uint argIndex
   return true;
 }
 
-bool Physics::CL::Context::setKernelArg(std::string kernelName, cl_uint argIndex, const std::string& argName)
+bool Physics::CL::Context::setKernelArg(std::string kernelName, cl_uint argIndex, const std::string& bufferName)
 {
   if (!m_init)
     return false;
 
+  kernelName = scopedName(kernelName);
+  const std::string argName = scopedName(bufferName);
+
   auto itK = m_kernelsMap.find(kernelName);
   if (itK == m_kernelsMap.end())
   {
@@ -669,6 +1449,301 @@ bool Physics::CL::Context::runKernel(std::string kernelName, size_t numGlobalWor
   if (!m_init)
     return false;
 
+  return enqueueKernel(scopedName(kernelName), numGlobalWorkItems, numLocalWorkItems, currentQueue(), nullptr, false);
+}
+
+bool Physics::CL::Context::runKernelAsync(std::string kernelName, size_t numGlobalWorkItems, const std::vector<std::string>& waitEventNames, size_t numLocalWorkItems)
+{
+  if (!m_init)
+    return false;
+
+  const std::vector<cl::Event> waitEvents = findEvents(waitEventNames);
+
+  return enqueueKernel(scopedName(kernelName), numGlobalWorkItems, numLocalWorkItems, currentAsyncQueue(), waitEvents.empty() ? nullptr : &waitEvents, true);
+}
+
+bool Physics::CL::Context::enqueueMarker(const std::string& eventName)
+{
+  if (!m_init)
+    return false;
+
+  cl::Event event;
+  cl_int err = currentQueue().enqueueMarkerWithWaitList(nullptr, &event);
+  if (err != CL_SUCCESS)
+  {
+    CL_ERROR(err, "Cannot enqueue marker " + eventName);
+    return false;
+  }
+
+  m_eventsMap[scopedName(eventName)] = event;
+
+  return true;
+}
+
+bool Physics::CL::Context::enqueueBarrier(const std::vector<std::string>& eventNames)
+{
+  if (!m_init)
+    return false;
+
+  const std::vector<cl::Event> waitEvents = findEvents(eventNames);
+  if (waitEvents.empty())
+    return true;
+
+  // Kernels waited for must have been submitted to the device
+  currentAsyncQueue().flush();
+
+  cl_int err = currentQueue().enqueueBarrierWithWaitList(&waitEvents);
+  if (err != CL_SUCCESS)
+  {
+    CL_ERROR(err, "Cannot enqueue barrier");
+    return false;
+  }
+
+  return true;
+}
+
+Physics::CL::Context::KernelTuning* Physics::CL::Context::updateKernelTuning(const std::string& kernelName, size_t nbItems, size_t& localSize)
+{
+  KernelLaunch& launch = m_kernelsLaunch[kernelName];
+  localSize = launch.localSize;
+
+  // Candidates are sorted by size, runs with a work-group bigger than their items only launch remaining items and cannot be timed
+  const size_t nbFilled = std::count_if(launch.candidates.cbegin(), launch.candidates.cend(),
+      [&launch, nbItems](size_t candidate) { return nbItems >= launch.coarseningFactor * candidate; });
+  if (nbFilled == 0)
+    return nullptr;
+  if (nbFilled == 1)
+  {
+    localSize = launch.candidates.front();
+    return nullptr;
+  }
+
+  auto itTuned = launch.tunedLocalSizes.find(nbFilled);
+  if (itTuned != launch.tunedLocalSizes.end())
+  {
+    localSize = itTuned->second;
+    return nullptr;
+  }
+
+  const std::string tuningKey = kernelName + "|" + std::to_string(nbFilled);
+  auto itTuning = m_kernelsTuning.find(tuningKey);
+  if (itTuning == m_kernelsTuning.end())
+  {
+    KernelTuning tuning;
+    tuning.candidates.assign(launch.candidates.cbegin(), launch.candidates.cbegin() + nbFilled);
+    tuning.totalTimesPerItem.assign(nbFilled, 0.0);
+    tuning.nbSamples.assign(nbFilled, 0);
+    itTuning = m_kernelsTuning.emplace(tuningKey, tuning).first;
+  }
+
+  KernelTuning& tuning = itTuning->second;
+
+  // Runs not complete yet are not waited for, they are just not timed
+  cl_int status = CL_QUEUED;
+  if (tuning.pendingEvent() != nullptr)
+    tuning.pendingEvent.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &status);
+  if (tuning.pendingEvent() != nullptr && status == CL_COMPLETE)
+  {
+    cl_ulong start = 0, end = 0;
+    tuning.pendingEvent.getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
+    tuning.pendingEvent.getProfilingInfo(CL_PROFILING_COMMAND_END, &end);
+
+    // Time per item, the number of items can change from one run to the other
+    tuning.totalTimesPerItem[tuning.currentCandidate] += (double)(end - start) / (double)tuning.pendingNbItems;
+    if (++tuning.nbSamples[tuning.currentCandidate] == NB_TUNING_SAMPLES)
+      ++tuning.currentCandidate;
+  }
+  tuning.pendingEvent = cl::Event();
+
+  if (tuning.currentCandidate < tuning.candidates.size())
+  {
+    localSize = tuning.candidates[tuning.currentCandidate];
+    return &tuning;
+  }
+
+  const size_t bestCandidate = std::distance(tuning.totalTimesPerItem.cbegin(),
+      std::min_element(tuning.totalTimesPerItem.cbegin(), tuning.totalTimesPerItem.cend()));
+  localSize = tuning.candidates[bestCandidate];
+
+  LOG_INFO("Work-group size of kernel {} tuned to {} for runs filling {} candidates", kernelName,
+      (localSize > 0) ? std::to_string(localSize) : "driver choice", nbFilled);
+
+  launch.tunedLocalSizes[nbFilled] = localSize;
+  m_tunedLocalSizes[launch.cacheKey + "|" + std::to_string(nbFilled)] = localSize;
+  m_kernelsTuning.erase(itTuning);
+
+  // Written once all tunings in progress are done, instead of after each kernel
+  m_isTuningCacheDirty = true;
+  if (m_kernelsTuning.empty())
+    m_isTuningCacheDirty = !saveTuningCache();
+
+  return nullptr;
+}
+
+void Physics::CL::Context::enableKernelTiming(bool enable)
+{
+  m_isKernelTimingEnabled = enable;
+
+  if (!enable)
+    m_kernelsTiming.clear();
+}
+
+void Physics::CL::Context::updateKernelTiming(const std::string& kernelName)
+{
+  auto itTiming = m_kernelsTiming.find(kernelName);
+  if (itTiming == m_kernelsTiming.end())
+    return;
+
+  KernelTiming& timing = itTiming->second;
+  if (timing.lastEvent() == nullptr)
+    return;
+
+  // Last launch being complete, all the previous ones are too
+  cl_int status = CL_QUEUED;
+  timing.lastEvent.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &status);
+  if (status != CL_COMPLETE)
+    return;
+
+  cl_ulong start = 0, end = 0;
+  timing.firstEvent.getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
+  timing.lastEvent.getProfilingInfo(CL_PROFILING_COMMAND_END, &end);
+  timing.lastTimeMs = (double)(end - start) * 1e-06;
+
+  timing.firstEvent = cl::Event();
+  timing.lastEvent = cl::Event();
+}
+
+std::map<std::string, double> Physics::CL::Context::kernelTimesMs(const std::string& nameSpace)
+{
+  std::map<std::string, double> timesMs;
+
+  const std::string prefix = nameSpace.empty() ? "" : nameSpace + NAMESPACE_SEPARATOR;
+  for (auto& timing : m_kernelsTiming)
+  {
+    if (timing.first.compare(0, prefix.size(), prefix) != 0)
+      continue;
+
+    updateKernelTiming(timing.first);
+    if (timing.second.lastTimeMs >= 0.0)
+      timesMs[timing.first.substr(prefix.size())] = timing.second.lastTimeMs;
+  }
+
+  return timesMs;
+}
+
+void Physics::CL::Context::traceCommand(const std::string& name, const cl::Event& event, double enqueueTimeUs)
+{
+  if (!Utils::Tracer::Get().isCapturing() || event() == nullptr)
+    return;
+
+  m_tracedCommands.push_back({ name, event, enqueueTimeUs });
+}
+
+void Physics::CL::Context::collectTracedCommands()
+{
+  if (m_tracedCommands.empty())
+    return;
+
+  Utils::Tracer& tracer = Utils::Tracer::Get();
+
+  for (auto it = m_tracedCommands.begin(); it != m_tracedCommands.end();)
+  {
+    // Commands of queues not finished yet are collected later
+    cl_int status = CL_QUEUED;
+    it->event.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &status);
+    if (status != CL_COMPLETE)
+    {
+      ++it;
+      continue;
+    }
+
+    cl_ulong queued = 0, submit = 0, start = 0, end = 0;
+    it->event.getProfilingInfo(CL_PROFILING_COMMAND_QUEUED, &queued);
+    it->event.getProfilingInfo(CL_PROFILING_COMMAND_SUBMIT, &submit);
+    it->event.getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
+    it->event.getProfilingInfo(CL_PROFILING_COMMAND_END, &end);
+
+    // Device clock in ns, each command being anchored to its own enqueue time as devices do not share a clock with host
+    const auto toHostUs = [&](cl_ulong deviceTime) { return it->enqueueTimeUs + (double)(cl_long)(deviceTime - queued) * 1e-03; };
+
+    tracer.addTrackSpan("OpenCL queue", it->name, "cl_queue", toHostUs(queued), toHostUs(submit));
+    tracer.addTrackSpan("OpenCL device", it->name, "cl_device", toHostUs(start), toHostUs(end));
+
+    it = m_tracedCommands.erase(it);
+  }
+}
+
+// One line per tuned kernel, its work-group size followed by its key
+bool Physics::CL::Context::loadTuningCache()
+{
+  std::ifstream cacheFile(TUNING_CACHE_FILE);
+  if (!cacheFile.is_open())
+    return false;
+
+  std::string line;
+  while (std::getline(cacheFile, line))
+  {
+    const size_t separator = line.find(' ');
+    if (separator == std::string::npos)
+      continue;
+
+    try
+    {
+      m_tunedLocalSizes[line.substr(separator + 1)] = std::stoul(line.substr(0, separator));
+    }
+    catch (...)
+    {
+      LOG_ERROR("Invalid line in {}", TUNING_CACHE_FILE);
+    }
+  }
+
+  LOG_INFO("{} tuned work-group sizes loaded from {}", m_tunedLocalSizes.size(), TUNING_CACHE_FILE);
+
+  return true;
+}
+
+bool Physics::CL::Context::saveTuningCache() const
+{
+  std::ofstream cacheFile(TUNING_CACHE_FILE, std::ios::trunc);
+  if (!cacheFile.is_open())
+  {
+    LOG_ERROR("Cannot write tuned work-group sizes in {}", TUNING_CACHE_FILE);
+    return false;
+  }
+
+  for (const auto& tunedLocalSize : m_tunedLocalSizes)
+    cacheFile << tunedLocalSize.second << " " << tunedLocalSize.first << "\n";
+
+  return true;
+}
+
+bool Physics::CL::Context::isEventComplete(const std::string& eventName) const
+{
+  auto it = m_eventsMap.find(scopedName(eventName));
+  if (it == m_eventsMap.end())
+    return true;
+
+  cl_int status = CL_QUEUED;
+  it->second.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &status);
+
+  return status == CL_COMPLETE;
+}
+
+std::vector<cl::Event> Physics::CL::Context::findEvents(const std::vector<std::string>& eventNames) const
+{
+  std::vector<cl::Event> events;
+  for (const auto& eventName : eventNames)
+  {
+    auto it = m_eventsMap.find(scopedName(eventName));
+    if (it != m_eventsMap.end())
+      events.push_back(it->second);
+  }
+  return events;
+}
+
+bool Physics::CL::Context::enqueueKernel(const std::string& kernelName, size_t numGlobalWorkItems, size_t numLocalWorkItems,
+    cl::CommandQueue& queue, const std::vector<cl::Event>* waitEvents, bool isRecordingEvent)
+{
   auto it = m_kernelsMap.find(kernelName);
   if (it == m_kernelsMap.end())
   {
@@ -676,19 +1751,88 @@ bool Physics::CL::Context::runKernel(std::string kernelName, size_t numGlobalWor
     return false;
   }
 
+  // First launch of the kernel if split in several ones, timed along with the last one
   cl::Event event;
-  cl::NDRange global(numGlobalWorkItems);
-  cl::NDRange local = (numLocalWorkItems > 0) ? cl::NDRange(numLocalWorkItems) : cl::NullRange;
+  cl::Event mainEvent;
+  cl_int err = CL_SUCCESS;
 
-  cl_int err;
+  const double enqueueTimeUs = Utils::Tracer::Get().isCapturing() ? Utils::Tracer::Get().nowUs() : 0.0;
+
+  auto itLaunch = m_kernelsLaunch.find(kernelName);
+  if (itLaunch != m_kernelsLaunch.end() && numLocalWorkItems == 0 && numGlobalWorkItems > 0)
+  {
+    size_t localSize = 0;
+    KernelTuning* tuning = updateKernelTuning(kernelName, numGlobalWorkItems, localSize);
+    const size_t coarseningFactor = itLaunch->second.coarseningFactor;
+
+    size_t nbWorkItems = 0;
+    if (localSize == 0)
+    {
+      nbWorkItems = numGlobalWorkItems;
+      err = queue.enqueueNDRangeKernel(it->second, cl::NullRange, cl::NDRange(nbWorkItems), cl::NullRange, waitEvents, &event);
+      mainEvent = event;
+    }
+    else
+    {
+      // Blocks of contiguous items in full work-groups, then remaining items one per work-item,
+      // no padding of the global size is needed
+      nbWorkItems = numGlobalWorkItems / (coarseningFactor * localSize) * localSize;
+      const size_t nbBlockItems = nbWorkItems * coarseningFactor;
+
+      std::vector<cl::Event> blockEvents;
+      if (nbWorkItems > 0)
+      {
+        err = queue.enqueueNDRangeKernel(it->second, cl::NullRange, cl::NDRange(nbWorkItems), cl::NDRange(localSize), waitEvents, &event);
+        mainEvent = event;
+        blockEvents.push_back(event);
+        waitEvents = &blockEvents;
+      }
+
+      if (err == CL_SUCCESS && nbBlockItems < numGlobalWorkItems)
+        err = queue.enqueueNDRangeKernel(it->second, cl::NDRange(nbBlockItems, 0), cl::NDRange(numGlobalWorkItems - nbBlockItems, 1), cl::NullRange, waitEvents, &event);
+    }
+
+    // Timed once complete, at the next run of the kernel
+    if (err == CL_SUCCESS && tuning != nullptr && nbWorkItems > 0)
+    {
+      tuning->pendingEvent = mainEvent;
+      tuning->pendingNbItems = nbWorkItems * coarseningFactor;
+    }
+  }
+  else
+  {
+    cl::NDRange global(numGlobalWorkItems);
+    cl::NDRange local = (numLocalWorkItems > 0) ? cl::NDRange(numLocalWorkItems) : cl::NullRange;
+
+    err = queue.enqueueNDRangeKernel(it->second, cl::NullRange, global, local, waitEvents, &event);
+  }
 
-  err = cl_queue.enqueueNDRangeKernel(it->second, cl::NullRange, global, local, nullptr, &event);
   if (err != CL_SUCCESS)
   {
     CL_ERROR(err, "Failure of kernel " + kernelName + " while running");
     return false;
   }
 
+  // Kernels of the asynchronous queue can be waited for by name
+  if (isRecordingEvent)
+    m_eventsMap[kernelName] = event;
+
+  if (mainEvent() != nullptr && mainEvent() != event())
+    traceCommand(kernelName, mainEvent, enqueueTimeUs);
+  traceCommand(kernelName, event, enqueueTimeUs);
+
+  if (m_isKernelTimingEnabled)
+  {
+    updateKernelTiming(kernelName);
+
+    KernelTiming& timing = m_kernelsTiming[kernelName];
+    if (timing.lastEvent() == nullptr)
+    {
+      timing.firstEvent = (mainEvent() != nullptr) ? mainEvent : event;
+      timing.lastEvent = event;
+    }
+  }
+
   if (m_isKernelProfilingEnabled)
   {
     if (!finishTasks())
@@ -712,11 +1856,14 @@ bool Physics::CL::Context::interactWithGLBuffers(const std::vector<std::string>&
   if (!m_init)
     return false;
 
+  if (!m_isGLInteropEnabled)
+    return copyGLBuffers(GLBufferNames, interaction);
+
   std::vector<cl::Memory> GLBuffers;
 
   for (const auto& GLBufferName : GLBufferNames)
   {
-    auto it = m_GLBuffersMap.find(GLBufferName);
+    auto it = m_GLBuffersMap.find(scopedName(GLBufferName));
     if (it == m_GLBuffersMap.end())
     {
       LOG_ERROR("error GL buffer not existing");
@@ -728,7 +1875,12 @@ bool Physics::CL::Context::interactWithGLBuffers(const std::vector<std::string>&
     }
   }
 
-  cl_int err = (interaction == interOpCLGL::ACQUIRE) ? cl_queue.enqueueAcquireGLObjects(&GLBuffers) : cl_queue.enqueueReleaseGLObjects(&GLBuffers);
+  TRACE_SCOPE((interaction == interOpCLGL::ACQUIRE) ? "acquireGLBuffers" : "releaseGLBuffers");
+
+  cl::Event event;
+  const double enqueueTimeUs = Utils::Tracer::Get().isCapturing() ? Utils::Tracer::Get().nowUs() : 0.0;
+  cl_int err = (interaction == interOpCLGL::ACQUIRE) ? currentQueue().enqueueAcquireGLObjects(&GLBuffers, nullptr, &event)
+                                                     : currentQueue().enqueueReleaseGLObjects(&GLBuffers, nullptr, &event);
   if (err != CL_SUCCESS)
   {
     CL_ERROR(err, "Cannot interact with GL buffers");
@@ -740,6 +1892,8 @@ bool Physics::CL::Context::interactWithGLBuffers(const std::vector<std::string>&
     std::for_each(GLBufferNames.cbegin(), GLBufferNames.cend(), [&](const std::string& name)
         { return allNames += name + " "; });
     LOG_DEBUG(interaction == interOpCLGL::ACQUIRE ? "GL buffers acquired {}" : "GL buffers released {}", allNames);
+
+    traceCommand((interaction == interOpCLGL::ACQUIRE) ? "acquireGLObjects" : "releaseGLObjects", event, enqueueTimeUs);
   }
 
   // Must flush and finish queue to make sure GL buffers have been released
@@ -749,11 +1903,64 @@ bool Physics::CL::Context::interactWithGLBuffers(const std::vector<std::string>&
   return true;
 }
 
+bool Physics::CL::Context::copyGLBuffers(const std::vector<std::string>& GLBufferNames, interOpCLGL interaction)
+{
+  TRACE_SCOPE((interaction == interOpCLGL::ACQUIRE) ? "acquireGLBuffers" : "releaseGLBuffers");
+
+  // OpenGL may read the VBOs as soon as they are released, device work on them must be complete
+  if (interaction == interOpCLGL::RELEASE)
+    finishTasks();
+
+  const GLBufferFunctions& gl = GetGLBufferFunctions();
+  std::vector<char> hostCopy;
+
+  for (const auto& GLBufferName : GLBufferNames)
+  {
+    const std::string scopedGLBufferName = scopedName(GLBufferName);
+    auto it = m_GLBuffersMap.find(scopedGLBufferName);
+    auto itVBO = m_GLBuffersVBO.find(scopedGLBufferName);
+    if (it == m_GLBuffersMap.end() || itVBO == m_GLBuffersVBO.end())
+    {
+      LOG_ERROR("error GL buffer not existing");
+      return false;
+    }
+
+    size_t size = 0;
+    it->second.getInfo(CL_MEM_SIZE, &size);
+    hostCopy.resize(size);
+
+    cl_int err = CL_SUCCESS;
+    gl.bindBuffer(GL_ARRAY_BUFFER_TARGET, itVBO->second);
+    if (interaction == interOpCLGL::ACQUIRE)
+    {
+      gl.getBufferSubData(GL_ARRAY_BUFFER_TARGET, 0, (std::ptrdiff_t)size, hostCopy.data());
+      err = currentQueue().enqueueWriteBuffer(it->second, CL_TRUE, 0, size, hostCopy.data());
+    }
+    else
+    {
+      err = currentQueue().enqueueReadBuffer(it->second, CL_TRUE, 0, size, hostCopy.data());
+      if (err == CL_SUCCESS)
+        gl.bufferSubData(GL_ARRAY_BUFFER_TARGET, 0, (std::ptrdiff_t)size, hostCopy.data());
+    }
+    gl.bindBuffer(GL_ARRAY_BUFFER_TARGET, 0);
+
+    if (err != CL_SUCCESS)
+    {
+      CL_ERROR(err, "Cannot copy GL buffer " + GLBufferName);
+      return false;
+    }
+  }
+
+  return true;
+}
+
 bool Physics::CL::Context::mapAndSendBufferToDevice(std::string bufferName, const void* bufferPtr, size_t bufferSize)
 {
   if (!m_init || bufferPtr == nullptr)
     return false;
 
+  bufferName = scopedName(bufferName);
+
   auto it = m_buffersMap.find(bufferName);
   if (it == m_buffersMap.end())
   {
@@ -762,14 +1969,14 @@ bool Physics::CL::Context::mapAndSendBufferToDevice(std::string bufferName, cons
   }
 
   cl_int err;
-  void* mappedMemory = cl_queue.enqueueMapBuffer(it->second, CL_TRUE, CL_MAP_WRITE, 0, bufferSize, nullptr, nullptr, &err);
+  void* mappedMemory = currentQueue().enqueueMapBuffer(it->second, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, bufferSize, nullptr, nullptr, &err);
   if (err < 0)
   {
     CL_ERROR(err, "Cannot map buffer " + bufferName + " to host memory");
     return false;
   }
   memcpy(mappedMemory, bufferPtr, bufferSize);
-  err = cl_queue.enqueueUnmapMemObject(it->second, mappedMemory);
+  err = currentQueue().enqueueUnmapMemObject(it->second, mappedMemory);
   if (err < 0)
   {
     CL_ERROR(err, "Cannot unmap buffer" + bufferName);
@@ -779,16 +1986,88 @@ bool Physics::CL::Context::mapAndSendBufferToDevice(std::string bufferName, cons
   return true;
 }
 
-std::string Physics::CL::Context::getPlatformName() const
+bool Physics::CL::Context::isHostUnifiedMemory() const
+{
+  if (!m_init)
+    return false;
+
+  cl_bool isHostUnifiedMemory = CL_FALSE;
+  currentDevice().getInfo(CL_DEVICE_HOST_UNIFIED_MEMORY, &isHostUnifiedMemory);
+
+  return isHostUnifiedMemory == CL_TRUE;
+}
+
+void* Physics::CL::Context::mapBuffer(std::string bufferName, cl_map_flags mapFlags)
+{
+  if (!m_init)
+    return nullptr;
+
+  bufferName = scopedName(bufferName);
+
+  auto itMapped = m_mappedViewsMap.find(bufferName);
+  if (itMapped != m_mappedViewsMap.end())
+    return itMapped->second.hostPtr;
+
+  auto it = m_buffersMap.find(bufferName);
+  if (it == m_buffersMap.end())
+  {
+    LOG_ERROR("Cannot map buffer {}, not existing", bufferName);
+    return nullptr;
+  }
+
+  size_t bufferSize = 0;
+  it->second.getInfo(CL_MEM_SIZE, &bufferSize);
+
+  cl_int err;
+  void* hostPtr = currentQueue().enqueueMapBuffer(it->second, CL_TRUE, mapFlags, 0, bufferSize, nullptr, nullptr, &err);
+  if (err != CL_SUCCESS)
+  {
+    CL_ERROR(err, "Cannot map buffer " + bufferName + " to host memory");
+    return nullptr;
+  }
+
+  m_mappedViewsMap.insert(std::make_pair(bufferName, MappedView { it->second, currentQueue(), hostPtr }));
+
+  return hostPtr;
+}
+
+bool Physics::CL::Context::unmapBuffer(std::string bufferName)
 {
-  std::string platformName;
-  cl_platform.getInfo(CL_PLATFORM_NAME, &platformName);
-  return platformName;
+  if (!m_init)
+    return false;
+
+  bufferName = scopedName(bufferName);
+
+  auto it = m_mappedViewsMap.find(bufferName);
+  if (it == m_mappedViewsMap.end())
+  {
+    LOG_ERROR("Cannot unmap buffer {}, not mapped", bufferName);
+    return false;
+  }
+
+  cl_int err = it->second.queue.enqueueUnmapMemObject(it->second.buffer, it->second.hostPtr);
+  m_mappedViewsMap.erase(it);
+
+  if (err != CL_SUCCESS)
+  {
+    CL_ERROR(err, "Cannot unmap buffer " + bufferName);
+    return false;
+  }
+
+  return true;
 }
 
-std::string Physics::CL::Context::getDeviceName() const
+void Physics::CL::Context::cacheDeviceInfo()
 {
-  std::string deviceName;
-  cl_device.getInfo(CL_DEVICE_NAME, &deviceName);
-  return deviceName;
+  // Queried on every frame by the UI otherwise
+  cl_platform.getInfo(CL_PLATFORM_NAME, &m_deviceInfo.platformName);
+  cl_device.getInfo(CL_DEVICE_NAME, &m_deviceInfo.deviceName);
+
+  cl_ulong globalMemSize = 0;
+  cl_device.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &globalMemSize);
+  m_deviceInfo.globalMemSize = (size_t)globalMemSize;
+
+  cl_ulong maxMemAllocSize = 0;
+  cl_device.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE, &maxMemAllocSize);
+  m_deviceInfo.maxMemAllocSize = (size_t)maxMemAllocSize;
 }
\ No newline at end of file
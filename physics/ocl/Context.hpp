@@ -2,6 +2,8 @@
 
 #include "opencl.hpp"
 
+#include <functional>
+#include <future>
 #include <map>
 #include <string>
 #include <vector>
@@ -18,6 +20,14 @@ struct imageSpecs
   size_t height;
 };
 
+// Device memory used by a set of allocations, in bytes
+struct MemoryFootprint
+{
+  size_t nbAllocations = 0;
+  size_t totalSize = 0;
+  size_t biggestAllocationSize = 0;
+};
+
 class Context
 {
   public:
@@ -28,19 +38,71 @@ class Context
   // Release every programs and kernels/buffers/datas on GPU side
   bool release();
 
-  // Send all the tasks to device queue and wait for them to be complete
+  // Programs, kernels, buffers and images names are scoped by the current namespace
+  // so that several models can own resources with the same names and be kept alive together
+  void setCurrentNamespace(const std::string& nameSpace) { m_currentNamespace = nameSpace; }
+  const std::string& currentNamespace() const { return m_currentNamespace; }
+  // Set a namespace as current one for the lifetime of the guard, the previous one being restored afterwards
+  class NamespaceGuard
+  {
+    public:
+    NamespaceGuard(Context& context, const std::string& nameSpace)
+        : m_context(context)
+        , m_previousNamespace(context.currentNamespace())
+    {
+      m_context.setCurrentNamespace(nameSpace);
+    }
+    ~NamespaceGuard() { m_context.setCurrentNamespace(m_previousNamespace); }
+
+    private:
+    Context& m_context;
+    std::string m_previousNamespace;
+  };
+  // Release every programs and kernels/buffers/datas of the given namespace only
+  bool releaseNamespace(const std::string& nameSpace);
+
+  // Device memory arena, buffers created between beginArena and endArena are carved as sub-buffers
+  // of a single allocation, at offsets aligned on device base address alignment
+  // Buffers can only be used once endArena has been called
+  bool beginArena(std::string arenaName);
+  bool endArena();
+
+  // Domain decomposition, the CPUs of the first platform exposing some are split into partitions, one sub-device per NUMA node
+  // if supported, otherwise equal sets of compute units, each partition having its own queue
+  // Resources of a namespace bound to a partition are created and run on it, OpenGL buffers cannot be shared with them
+  size_t createPartitions(size_t nbPartitions);
+  size_t nbPartitions() const { return m_partitions.size(); }
+  bool bindNamespaceToPartition(const std::string& nameSpace, size_t partition);
+
+  // Send all the tasks to the device queue of the current namespace and wait for them to be complete
   bool finishTasks();
+  // Same for the queues of all the partitions
+  bool finishAllTasks();
 
   bool isProfiling() const { return m_isKernelProfilingEnabled; }
   void enableProfiler(bool enable) { m_isKernelProfilingEnabled = enable; }
 
+  // Unlike the profiler, timing never waits for kernels, their times are read once they are complete
+  bool isKernelTiming() const { return m_isKernelTimingEnabled; }
+  void enableKernelTiming(bool enable);
+  // Device time in ms of the last completed run of each kernel of the namespace, by unscoped kernel name
+  std::map<std::string, double> kernelTimesMs(const std::string& nameSpace);
+
+  // Programs are built on worker threads, kernels of a program waiting for its build when created
+  // Built programs are cached by sources and build options, models created again sharing them
   bool createProgram(std::string name, std::vector<std::string> sourceNames, std::string specificBuildOptions);
   bool createProgram(std::string name, std::string sourceName, std::string specificBuildOptions) { return createProgram(name, std::vector<std::string>({ sourceName }), specificBuildOptions); }
+  // Start building a program in background, so that a model creating it later on finds it cached
+  bool prebuildProgram(std::vector<std::string> sourceNames, std::string specificBuildOptions);
   bool createGLBuffer(std::string name, unsigned int VBOIndex, cl_mem_flags memoryFlags);
-  bool createBuffer(std::string name, size_t bufferSize, cl_mem_flags memoryFlags);
+  // Buffers sharing the same non empty transient slot inside an arena share the same memory, their lifetimes must not overlap
+  bool createBuffer(std::string name, size_t bufferSize, cl_mem_flags memoryFlags, std::string transientSlot = "");
   bool createImage2D(std::string name, imageSpecs specs, cl_mem_flags memoryFlags);
-  bool loadBufferFromHost(std::string name, size_t offset, size_t sizeToFill, const void* hostPtr);
-  bool unloadBufferFromDevice(std::string name, size_t offset, size_t sizeToFill, void* hostPtr);
+  // Non blocking transfers return once enqueued, host memory must stay valid until tasks are finished
+  bool loadBufferFromHost(std::string name, size_t offset, size_t sizeToFill, const void* hostPtr, bool isBlocking = true);
+  bool unloadBufferFromDevice(std::string name, size_t offset, size_t sizeToFill, void* hostPtr, bool isBlocking = true);
+  // Non blocking transfer whose completion is signaled by a callback, called from an OpenCL thread
+  bool unloadBufferFromDevice(std::string name, size_t offset, size_t sizeToFill, void* hostPtr, std::function<void()> onComplete);
   bool swapBuffers(std::string bufferNameA, std::string bufferNameB);
   bool copyBuffer(std::string srcBufferName, std::string dstBufferName);
   bool createKernel(std::string programName, std::string kernelName, std::vector<std::string> argNames);
@@ -48,17 +110,45 @@ class Context
   bool setKernelArg(std::string kernelName, cl_uint argIndex, const std::string& bufferName);
   bool runKernel(std::string kernelName, size_t numFlobalWorkItems, size_t numLocalWorkItems = 0);
 
+  // Kernel run on a second queue, out-of-order if supported by the device, once the events named in waitEventNames are complete
+  // Its completion is recorded as an event named after the kernel, work of this queue being only ordered by events,
+  // models must declare all the data dependencies of such kernels, transient slots included
+  bool runKernelAsync(std::string kernelName, size_t numGlobalWorkItems, const std::vector<std::string>& waitEventNames, size_t numLocalWorkItems = 0);
+  // Event completed once all the work enqueued so far in the in-order queue is complete
+  bool enqueueMarker(const std::string& eventName);
+  // Work enqueued from now on in the in-order queue waits for the given events
+  bool enqueueBarrier(const std::vector<std::string>& eventNames);
+  // Polled without waiting, an event never recorded is considered complete
+  bool isEventComplete(const std::string& eventName) const;
+
   bool acquireGLBuffers(const std::vector<std::string>& GLBufferNames) { return interactWithGLBuffers(GLBufferNames, interOpCLGL::ACQUIRE); }
   bool releaseGLBuffers(const std::vector<std::string>& GLBufferNames) { return interactWithGLBuffers(GLBufferNames, interOpCLGL::RELEASE); }
 
   bool mapAndSendBufferToDevice(std::string bufferName, const void* bufferPtr, size_t bufferSize);
 
-  std::string getPlatformName() const;
-  std::string getDeviceName() const;
+  // Devices sharing memory with host (CPUs, integrated GPUs), buffers are then allocated in host accessible memory
+  bool isHostUnifiedMemory() const;
+  // Persistent host view of a buffer, available once device work on it is complete
+  // On host unified memory data is read and written in place without copy
+  // Device must not use the buffer until the view is unmapped
+  void* mapBuffer(std::string name, cl_map_flags mapFlags = CL_MAP_READ | CL_MAP_WRITE);
+  bool unmapBuffer(std::string name);
+
+  // Read once when the context is created
+  const std::string& getPlatformName() const { return m_deviceInfo.platformName; }
+  const std::string& getDeviceName() const { return m_deviceInfo.deviceName; }
+  size_t getDeviceGlobalMemSize() const { return m_deviceInfo.globalMemSize; }
+  size_t getDeviceMaxMemAllocSize() const { return m_deviceInfo.maxMemAllocSize; }
+
+  // Every device allocation (buffers, GL buffers, images, arenas) is recorded with its owner namespace, size and flags
+  MemoryFootprint memoryFootprint(const std::string& nameSpace) const;
+  MemoryFootprint totalMemoryFootprint() const;
+  // Log all allocations per namespace and compare them against device limits
+  void reportMemoryFootprint() const;
 
   private:
   Context();
-  ~Context() = default;
+  ~Context();
   Context(const Context&) = delete;
   Context& operator=(const Context&) = delete;
   Context(Context&&) = delete;
@@ -67,7 +157,10 @@ class Context
   bool findPlatforms();
   bool findGPUDevices();
   bool createContext();
+  // Without GPU sharing buffers with OpenGL, as on GPU-less nodes rendering with a software OpenGL
+  bool createCPUContext();
   bool createCommandQueue();
+  void cacheDeviceInfo();
 
   enum class interOpCLGL
   {
@@ -75,19 +168,175 @@ class Context
     RELEASE
   };
   bool interactWithGLBuffers(const std::vector<std::string>& GLBufferNames, interOpCLGL interaction);
+  // Same without interop, GL buffers being regular buffers copied from and to their VBO through host
+  bool copyGLBuffers(const std::vector<std::string>& GLBufferNames, interOpCLGL interaction);
+
+  std::string scopedName(const std::string& name) const;
+
+  // Options of a program and its coarsening factor, 0 if it is not built on define.cl
+  std::string programBuildOptions(const cl::Device& device, const std::vector<std::string>& sourceNames,
+      const std::string& specificBuildOptions, size_t& coarseningFactor) const;
+  // Cached program, its build being started if not found
+  std::shared_future<cl::Program> buildProgram(const cl::Context& context, const cl::Device& device,
+      const std::vector<std::string>& sourceNames, const std::string& options);
+
+  // Context, device and queue of the partition bound to current namespace, main ones if none
+  const cl::Context& currentContext() const;
+  const cl::Device& currentDevice() const;
+  cl::CommandQueue& currentQueue();
+  // Queue of kernels with explicit dependencies, same as the in-order one for partitions
+  cl::CommandQueue& currentAsyncQueue();
+
+  bool enqueueUnload(const std::string& bufferName, size_t offset, size_t sizeToFill, void* hostPtr, bool isBlocking, cl::Event* event);
+
+  bool enqueueKernel(const std::string& kernelName, size_t numGlobalWorkItems, size_t numLocalWorkItems,
+      cl::CommandQueue& queue, const std::vector<cl::Event>* waitEvents, bool isRecordingEvent);
+
+  struct KernelTuning;
+  // Work-group size of a run of nbItems items, tuned or candidate being tuned
+  // Time the last tuning run of the kernel if complete, and keep the best candidate once all of them are timed
+  // Candidates whose work-groups cannot be filled by the run are left out, only for runs of that size
+  // Tuning of the run is returned if it is to be timed, null otherwise
+  KernelTuning* updateKernelTuning(const std::string& kernelName, size_t nbItems, size_t& localSize);
+  bool loadTuningCache();
+  bool saveTuningCache() const;
+  // Read the time of the last timed run of the kernel if complete
+  void updateKernelTiming(const std::string& kernelName);
+  // Commands are traced only while a trace is captured, and added to it once complete
+  void traceCommand(const std::string& name, const cl::Event& event, double enqueueTimeUs);
+  void collectTracedCommands();
+  // Recorded events with the given names, not recorded ones being skipped
+  std::vector<cl::Event> findEvents(const std::vector<std::string>& eventNames) const;
+
+  void recordAllocation(const std::string& name, const std::string& kind, size_t size, cl_mem_flags memoryFlags);
 
   cl::Platform cl_platform;
   cl::Device cl_device;
   cl::Context cl_context;
   cl::CommandQueue cl_queue;
+  cl::CommandQueue cl_asyncQueue;
+
+  struct DeviceInfo
+  {
+    std::string platformName;
+    std::string deviceName;
+    size_t globalMemSize = 0;
+    size_t maxMemAllocSize = 0;
+  };
+  DeviceInfo m_deviceInfo;
+
+  struct Partition
+  {
+    cl::Device device;
+    cl::CommandQueue queue;
+  };
+  // All partitions share the same context, apart from the one shared with OpenGL
+  cl::Context cl_partitionsContext;
+  std::vector<Partition> m_partitions;
+  std::map<std::string, size_t> m_namespacePartitions;
 
-  std::map<std::string, cl::Program> m_programsMap;
+  std::map<std::string, std::shared_future<cl::Program>> m_programsMap;
+  // Keyed by context, device, build options and sources, not scoped by namespace
+  std::map<std::string, std::shared_future<cl::Program>> m_programsCache;
   std::map<std::string, cl::Kernel> m_kernelsMap;
+
+  // Programs built on define.cl, their kernels loop over their items and can be launched with any work-group size
+  struct ProgramSpecs
+  {
+    std::string buildOptions;
+    size_t coarseningFactor;
+  };
+  // Coarsening factor and work-group size of kernels of such programs, 0 letting the driver choose it
+  // Work-group sizes are tuned apart for each number of candidates a run can fill, small runs not ruling out big work-groups
+  struct KernelLaunch
+  {
+    size_t coarseningFactor;
+    size_t localSize;
+    std::string cacheKey;
+    std::vector<size_t> candidates;
+    std::map<size_t, size_t> tunedLocalSizes;
+  };
+  std::map<std::string, ProgramSpecs> m_programsSpecs;
+  std::map<std::string, KernelLaunch> m_kernelsLaunch;
+
+  // Work-group size autotuning, each candidate is used by the next runs of the kernel until enough of them have been timed
+  // Keyed by kernel and number of candidates filled by the runs
+  struct KernelTuning
+  {
+    std::vector<size_t> candidates;
+    std::vector<double> totalTimesPerItem;
+    std::vector<size_t> nbSamples;
+    size_t currentCandidate = 0;
+    cl::Event pendingEvent;
+    size_t pendingNbItems = 0;
+  };
+  std::map<std::string, KernelTuning> m_kernelsTuning;
+  // Best work-group sizes found so far, keyed by device, kernel, build options and number of filled candidates, persisted across runs
+  std::map<std::string, size_t> m_tunedLocalSizes;
+  // Cache is written once no tuning is left, or at exit
+  bool m_isTuningCacheDirty;
   std::map<std::string, cl::Buffer> m_buffersMap;
   std::map<std::string, cl::BufferGL> m_GLBuffersMap;
+  // VBO of each GL buffer, only when they are copied through host
+  std::map<std::string, unsigned int> m_GLBuffersVBO;
   std::map<std::string, cl::Image2D> m_imagesMap;
+  std::map<std::string, cl::Buffer> m_arenasMap;
+  // Last occurrence of each kernel run asynchronously and of each marker
+  std::map<std::string, cl::Event> m_eventsMap;
+
+  // Last run of each kernel, split in several launches for tuned work-group sizes
+  struct KernelTiming
+  {
+    cl::Event firstEvent;
+    cl::Event lastEvent;
+    double lastTimeMs = -1.0;
+  };
+  std::map<std::string, KernelTiming> m_kernelsTiming;
+
+  // Device timestamps are converted to host time from the time of the enqueue call, matching the queued timestamp
+  struct TracedCommand
+  {
+    std::string name;
+    cl::Event event;
+    double enqueueTimeUs;
+  };
+  std::vector<TracedCommand> m_tracedCommands;
+
+  struct MappedView
+  {
+    cl::Buffer buffer;
+    cl::CommandQueue queue;
+    void* hostPtr;
+  };
+  std::map<std::string, MappedView> m_mappedViewsMap;
+
+  struct ArenaBufferSpecs
+  {
+    std::string name;
+    size_t size;
+    cl_mem_flags memoryFlags;
+    std::string transientSlot;
+  };
+  // Buffers waiting for the arena to be allocated
+  std::string m_pendingArenaName;
+  std::vector<ArenaBufferSpecs> m_pendingArenaBuffers;
+  bool m_isRecordingArena;
+
+  struct MemoryAllocation
+  {
+    std::string kind;
+    size_t size;
+    cl_mem_flags memoryFlags;
+  };
+  // Keyed by scoped name, buffers carved from an arena are accounted through their arena
+  std::map<std::string, MemoryAllocation> m_allocationsMap;
 
   bool m_isKernelProfilingEnabled;
+  bool m_isKernelTimingEnabled;
+  // Context shared with OpenGL, otherwise created on a CPU device
+  bool m_isGLInteropEnabled;
+
+  std::string m_currentNamespace;
 
   bool m_init;
 
@@ -25,7 +25,10 @@ inline uint getCell1DIndexFromPos(float4 pos);
 */
 __kernel void bd_fillBoidsColor(__global float4 *col)
 {
-  col[ID] = (float4)(1.0f, 0.02f, 0.02f, 0.5f);
+  FOR_EACH_ITEM
+  {
+    col[ID] = (float4)(1.0f, 0.02f, 0.02f, 0.5f);
+  }
 }
 
 /*
@@ -36,88 +39,93 @@ __kernel void bd_applyBoidsRulesWithGrid3D(//Input
                                            const __global float4 *velocity,     // 1
                                            const __global uint2  *startEndCell, // 2
                                            //Param
-                                           const          float8 params,        // 3
+                                           __constant     float8 *boidsParams,  // 3
                                            //Output
                                                  __global float4 *acc)          // 4
 {
-  const float4 pos = position[ID];
-  const float4 vel = velocity[ID];
+  const float8 params = *boidsParams;
 
-  const uint currCellIndex1D = getCell1DIndexFromPos(pos);
-  const uint3 currCellIndex3D = getCell3DIndexFromPos(pos);
-  const uint2 startEnd = startEndCell[currCellIndex1D];
+  FOR_EACH_ITEM
+  {
+    const float4 pos = position[ID];
+    const float4 vel = velocity[ID];
 
-  int count = 0;
+    const uint currCellIndex1D = getCell1DIndexFromPos(pos);
+    const uint3 currCellIndex3D = getCell3DIndexFromPos(pos);
+    const uint2 startEnd = startEndCell[currCellIndex1D];
 
-  float4 newAcc = (float4)(0.0f);
-  float4 averageBoidsPos = (float4)(0.0f);
-  float4 averageBoidsVel = (float4)(0.0f);
-  float4 repulseHeading  = (float4)(0.0f);
+    int count = 0;
 
-  float squaredDist = 0.0f;
-  float4 vec = (float4)(0.0f);
+    float4 newAcc = (float4)(0.0f);
+    float4 averageBoidsPos = (float4)(0.0f);
+    float4 averageBoidsVel = (float4)(0.0f);
+    float4 repulseHeading  = (float4)(0.0f);
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  uint2 startEndN = (uint2)(0);
-  float4 posN = (float4)(0.0f);
+    float squaredDist = 0.0f;
+    float4 vec = (float4)(0.0f);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    uint2 startEndN = (uint2)(0);
+    float4 posN = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        cellNIndex3D = convert_int3(currCellIndex3D) + (int3)(iX, iY, iZ);
-        
-        // Removing out of range cells
-        if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
-          continue;
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          cellNIndex3D = convert_int3(currCellIndex3D) + (int3)(iX, iY, iZ);
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Removing out of range cells
+          if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
+            continue;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          posN = position[e];
+          startEndN = startEndCell[cellNIndex1D];
 
-          vec = pos - posN;
-          squaredDist = dot(vec, vec);
-
-          // Second condition to deal with almost identical points and i == e
-          if (squaredDist < EFFECT_RADIUS_SQUARED
-           && squaredDist > FLOAT_EPS)
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
           {
-            averageBoidsPos += posN;
-            averageBoidsVel += fast_normalize(velocity[e]);
-            repulseHeading  += vec / squaredDist;
-            ++count;
+            posN = position[e];
+
+            vec = pos - posN;
+            squaredDist = dot(vec, vec);
+
+            // Second condition to deal with almost identical points and i == e
+            if (squaredDist < EFFECT_RADIUS_SQUARED
+             && squaredDist > FLOAT_EPS)
+            {
+              averageBoidsPos += posN;
+              averageBoidsVel += fast_normalize(velocity[e]);
+              repulseHeading  += vec / squaredDist;
+              ++count;
+            }
           }
         }
       }
     }
-  }
 
-  // params 0 = vel - 1 = cohesion - 2 = alignement - 3 = separation - 4 = target
-  if (count != 0)
-  {
-    // cohesion
-    averageBoidsPos /= count;
-    averageBoidsPos -= pos;
-    averageBoidsPos  = fast_normalize(averageBoidsPos) * params.s0;
-    // alignment
-    averageBoidsVel  = fast_normalize(averageBoidsVel) * params.s0;
-    // separation
-    repulseHeading   = fast_normalize(repulseHeading)  * params.s0;
+    // params 0 = vel - 1 = cohesion - 2 = alignement - 3 = separation - 4 = target
+    if (count != 0)
+    {
+      // cohesion
+      averageBoidsPos /= count;
+      averageBoidsPos -= pos;
+      averageBoidsPos  = fast_normalize(averageBoidsPos) * params.s0;
+      // alignment
+      averageBoidsVel  = fast_normalize(averageBoidsVel) * params.s0;
+      // separation
+      repulseHeading   = fast_normalize(repulseHeading)  * params.s0;
+
+      newAcc = averageBoidsPos * params.s1
+             + averageBoidsVel * params.s2
+             + repulseHeading  * params.s3;
+    }
 
-    newAcc = averageBoidsPos * params.s1
-           + averageBoidsVel * params.s2
-           + repulseHeading  * params.s3;
+    acc[ID] = newAcc;
   }
-
-  acc[ID] = newAcc;
 }
 
 /*
@@ -128,86 +136,91 @@ __kernel void bd_applyBoidsRulesWithGrid2D(//Input
                                            const __global float4 *velocity,     // 1
                                            const __global uint2  *startEndCell, // 2
                                            //Param
-                                           const          float8 params,        // 3
+                                           __constant     float8 *boidsParams,  // 3
                                            //Output
                                                  __global float4 *acc)          // 4
 
 {
-  const float4 pos = position[ID];
-  const float4 vel = velocity[ID];
+  const float8 params = *boidsParams;
 
-  const uint currCellIndex1D = getCell1DIndexFromPos(pos);
-  const uint3 currCellIndex3D = getCell3DIndexFromPos(pos);
-  const uint2 startEnd = startEndCell[currCellIndex1D];
+  FOR_EACH_ITEM
+  {
+    const float4 pos = position[ID];
+    const float4 vel = velocity[ID];
 
-  int count = 0;
+    const uint currCellIndex1D = getCell1DIndexFromPos(pos);
+    const uint3 currCellIndex3D = getCell3DIndexFromPos(pos);
+    const uint2 startEnd = startEndCell[currCellIndex1D];
 
-  float4 newAcc = (float4)(0.0f);
-  float4 averageBoidsPos = (float4)(0.0f);
-  float4 averageBoidsVel = (float4)(0.0f);
-  float4 repulseHeading  = (float4)(0.0f);
+    int count = 0;
 
-  float squaredDist = 0.0f;
-  float4 vec = (float4)(0.0f);
+    float4 newAcc = (float4)(0.0f);
+    float4 averageBoidsPos = (float4)(0.0f);
+    float4 averageBoidsVel = (float4)(0.0f);
+    float4 repulseHeading  = (float4)(0.0f);
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  uint2 startEndN = (uint2)(0);
-  float4 posN = (float4)(0.0f);
+    float squaredDist = 0.0f;
+    float4 vec = (float4)(0.0f);
 
-  // 9 cells to visit, current one + 2D YZ neighbors
-  for (int iY = -1; iY <= 1; ++iY)
-  {
-    for (int iZ = -1; iZ <= 1; ++iZ)
-    {
-      cellNIndex3D = convert_int3(currCellIndex3D) + (int3)(0, iY, iZ);
-      
-      // Removing out of range cells
-      if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X)))
-        continue;
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    uint2 startEndN = (uint2)(0);
+    float4 posN = (float4)(0.0f);
 
-      cellNIndex1D = (GRID_RES_X / 2 * GRID_RES_X + cellNIndex3D.y) * GRID_RES_Y + cellNIndex3D.z;
+    // 9 cells to visit, current one + 2D YZ neighbors
+    for (int iY = -1; iY <= 1; ++iY)
+    {
+      for (int iZ = -1; iZ <= 1; ++iZ)
+      {
+        cellNIndex3D = convert_int3(currCellIndex3D) + (int3)(0, iY, iZ);
 
-      startEndN = startEndCell[cellNIndex1D];
+        // Removing out of range cells
+        if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X)))
+          continue;
 
-      for (uint e = startEndN.x; e <= startEndN.y; ++e)
-      {
-        posN = position[e];
+        cellNIndex1D = (GRID_RES_X / 2 * GRID_RES_X + cellNIndex3D.y) * GRID_RES_Y + cellNIndex3D.z;
 
-        vec = pos - posN;
-        squaredDist = dot(vec, vec);
+        startEndN = startEndCell[cellNIndex1D];
 
-        // Second condition to deal with almost identical points and i == e
-        if (squaredDist < EFFECT_RADIUS_SQUARED
-         && squaredDist > FLOAT_EPS)
+        for (uint e = startEndN.x; e <= startEndN.y; ++e)
         {
-          averageBoidsPos += posN;
-          averageBoidsVel += fast_normalize(velocity[e]);
-          repulseHeading += vec / squaredDist;
-          ++count;
+          posN = position[e];
+
+          vec = pos - posN;
+          squaredDist = dot(vec, vec);
+
+          // Second condition to deal with almost identical points and i == e
+          if (squaredDist < EFFECT_RADIUS_SQUARED
+           && squaredDist > FLOAT_EPS)
+          {
+            averageBoidsPos += posN;
+            averageBoidsVel += fast_normalize(velocity[e]);
+            repulseHeading += vec / squaredDist;
+            ++count;
+          }
         }
       }
     }
-  }
 
-  // params 0 = vel - 1 = cohesion - 2 = alignement - 3 = separation - 4 = target
-  if (count != 0)
-  {
-    // cohesion
-    averageBoidsPos /= count;
-    averageBoidsPos -= pos;
-    averageBoidsPos  = fast_normalize(averageBoidsPos) * params.s0;
-    // alignment
-    averageBoidsVel  = fast_normalize(averageBoidsVel) * params.s0;
-    // separation
-    repulseHeading   = fast_normalize(repulseHeading)  * params.s0;
+    // params 0 = vel - 1 = cohesion - 2 = alignement - 3 = separation - 4 = target
+    if (count != 0)
+    {
+      // cohesion
+      averageBoidsPos /= count;
+      averageBoidsPos -= pos;
+      averageBoidsPos  = fast_normalize(averageBoidsPos) * params.s0;
+      // alignment
+      averageBoidsVel  = fast_normalize(averageBoidsVel) * params.s0;
+      // separation
+      repulseHeading   = fast_normalize(repulseHeading)  * params.s0;
+
+      newAcc = averageBoidsPos * params.s1
+             + averageBoidsVel * params.s2
+             + repulseHeading  * params.s3;
+    }
 
-    newAcc = averageBoidsPos * params.s1
-           + averageBoidsVel * params.s2
-           + repulseHeading  * params.s3;
+    acc[ID] = newAcc;
   }
-
-  acc[ID] = newAcc;
 }
 
 /*
@@ -223,13 +236,16 @@ __kernel void bd_addTargetRule(//Input
                                      __global float4 *acc)                      // 4
         
 {
-  const float4 currPos = pos[ID];
+  FOR_EACH_ITEM
+  {
+    const float4 currPos = pos[ID];
 
-  const float4 vec = targetPos - currPos;
-  const float  dist = fast_length(vec);
+    const float4 vec = targetPos - currPos;
+    const float  dist = fast_length(vec);
 
-  if (dist < half_sqrt(targetSquaredRadiusEffect))
-    acc[ID] += targetSignEffect * vec * clamp(1.3f / dist, 0.0f, 1.4f * MAX_STEERING);
+    if (dist < half_sqrt(targetSquaredRadiusEffect))
+      acc[ID] += targetSignEffect * vec * clamp(1.3f / dist, 0.0f, 1.4f * MAX_STEERING);
+  }
 }
 
 /*
@@ -244,10 +260,13 @@ __kernel void bd_updateVel(//Input
                                  __global float4 *vel)        // 3
    
 {
-  const float4 newVel = vel[ID] + acc[ID] * timeStep;
-  const float  newVelNorm = clamp(fast_length(newVel), 0.2f * maxVelocity, maxVelocity);
-  
-  vel[ID] = fast_normalize(newVel) * newVelNorm;
+  FOR_EACH_ITEM
+  {
+    const float4 newVel = vel[ID] + acc[ID] * timeStep;
+    const float  newVelNorm = clamp(fast_length(newVel), 0.2f * maxVelocity, maxVelocity);
+
+    vel[ID] = fast_normalize(newVel) * newVelNorm;
+  }
 }
 
 /*
@@ -261,17 +280,20 @@ __kernel void bd_updatePosAndApplyWallBC(//Input/output
                                          __global float4 *pos)     // 2
 
 {
-  const float4 newPos = pos[ID] + vel[ID] * timeStep;
+  FOR_EACH_ITEM
+  {
+    const float4 newPos = pos[ID] + vel[ID] * timeStep;
 
-  const float4 clampedNewPos = clamp(newPos, (float4)(-ABS_WALL_X, -ABS_WALL_Y, -ABS_WALL_Z, 0.0f),
-                                             (float4)( ABS_WALL_X,  ABS_WALL_Y,  ABS_WALL_Z, 0.0f));
-  
-  pos[ID] = clampedNewPos;
+    const float4 clampedNewPos = clamp(newPos, (float4)(-ABS_WALL_X, -ABS_WALL_Y, -ABS_WALL_Z, 0.0f),
+                                               (float4)( ABS_WALL_X,  ABS_WALL_Y,  ABS_WALL_Z, 0.0f));
 
-  // Bouncing particle will have its velocity reversed and divided by half
-  if (!all(isequal(clampedNewPos.xyz, newPos.xyz)))
-  {
-    vel[ID] *= -0.5f;
+    pos[ID] = clampedNewPos;
+
+    // Bouncing particle will have its velocity reversed and divided by half
+    if (!all(isequal(clampedNewPos.xyz, newPos.xyz)))
+    {
+      vel[ID] *= -0.5f;
+    }
   }
 }
 
@@ -285,25 +307,28 @@ __kernel void bd_updatePosAndApplyPeriodicBC(//Input
                                              //Input/output
                                                    __global float4 *pos)     // 2
 {
-  const float4 newPos = pos[ID] + vel[ID] * timeStep;
-
-  float4 clampedNewPos = clamp(newPos, (float4)(-ABS_WALL_X, -ABS_WALL_Y, -ABS_WALL_Z, 0.0f),
-                                       (float4)( ABS_WALL_X,  ABS_WALL_Y,  ABS_WALL_Z, 0.0f));
- 
-  if (!isequal(clampedNewPos.x, newPos.x))
+  FOR_EACH_ITEM
   {
-    clampedNewPos.x *= -1.0f;
-  }
-  if (!isequal(clampedNewPos.y, newPos.y))
-  {
-    clampedNewPos.y *= -1.0f;
-  }
-  if (!isequal(clampedNewPos.z, newPos.z))
-  {
-    clampedNewPos.z *= -1.0f;
-  }
+    const float4 newPos = pos[ID] + vel[ID] * timeStep;
 
-  pos[ID] = clampedNewPos;
+    float4 clampedNewPos = clamp(newPos, (float4)(-ABS_WALL_X, -ABS_WALL_Y, -ABS_WALL_Z, 0.0f),
+                                         (float4)( ABS_WALL_X,  ABS_WALL_Y,  ABS_WALL_Z, 0.0f));
+
+    if (!isequal(clampedNewPos.x, newPos.x))
+    {
+      clampedNewPos.x *= -1.0f;
+    }
+    if (!isequal(clampedNewPos.y, newPos.y))
+    {
+      clampedNewPos.y *= -1.0f;
+    }
+    if (!isequal(clampedNewPos.z, newPos.z))
+    {
+      clampedNewPos.z *= -1.0f;
+    }
+
+    pos[ID] = clampedNewPos;
+  }
 }
 
 //
@@ -6,7 +6,6 @@
 // ABS_WALL_X            - absolute position of the walls in x,y,z
 // GRID_RES_X                - resolution of the grid
 // GRID_NUM_CELLS          - total number of cells in the grid
-// NUM_MAX_PARTS_IN_CELL   - maximum number of particles taking into account in a single cell in simplified mode
 // REST_DENSITY            - rest density of the fluid
 // POLY6_COEFF             - coefficient of the Poly6 kernel, depending on EFFECT_RADIUS
 // SPIKY_COEFF             - coefficient of the Spiky kernel, depending on EFFECT_RADIUS
@@ -111,144 +110,107 @@ inline float artPressure(const float4 vec, FluidParams fluid)
 }
 
 /*
-  Initialize environment temperature field using linear function defined above, same one used for buoyancy computation
+  Initialize thermodynamic state of air parcels
+  Temperature is the environment one, using linear function defined above, same one used for buoyancy computation
+  Vapor density depends on temperature, cloud density and buoyancy are set to 0
 */
-__kernel void cld_initTemperature(//Input
-                                  const __global float4 *pos,    // 0
-                                  //Output
-                                        __global float  *temp)   // 1
+__kernel void cld_initThermodynamics(//Param
+                                     __constant CloudParams *cloudParams, // 0
+                                     //Input
+                                     const __global float4 *pos,    // 1
+                                     //Output
+                                           __global float4 *thermo) // 2
 {
-  temp[ID] = environmentTemp(pos[ID].y);
-}
+  const CloudParams cloud = *cloudParams;
 
-/*
-  Initialize vapor density value (cloud density init to 0)
-*/
- __kernel void cld_initVaporDensity(//Param
-                                    const CloudParams cloud, // 0
-                                    //Input
-                                    const __global float *temp,        // 1
-                                    //Output
-                                          __global float *vaporDens)   // 2
-{
-  vaporDens[ID] = cloud.initVaporDensityCoeff * saturationVaporDensity(temp[ID]);
+  FOR_EACH_ITEM
+  {
+    const float temp = environmentTemp(pos[ID].y);
+
+    thermo[ID] = (float4)(temp, cloud.initVaporDensityCoeff * saturationVaporDensity(temp), 0.0f, 0.0f);
+  }
 }
 
 /*
   Fill position buffer with random positions
 */
 __kernel void cld_randPosVertsClouds(//Param
-                                     const FluidParams fluid, // 0
+                                     __constant FluidParams *fluidParams, // 0
                                      //Output
                                      __global   float4 *pos,  // 1
                                      __global   float4 *vel)  // 2
 {
-  const float3 randNormFloat3 = genRandomNormalizedFloat3(ID);
-  
-  pos[ID].xyz = (float3)(ABS_WALL_X, ABS_WALL_Y / 2.0f, ABS_WALL_Z) * (2.0f * randNormFloat3 - 1.0f);  
-  pos[ID].y -= ABS_WALL_Y / 2.0f;
-  pos[ID].w = 0.0f;
-
-  vel[ID].xyz = 0.5f * randNormFloat3;
-  vel[ID].w = 0.0f;
-}
+  const FluidParams fluid = *fluidParams;
 
-/*
-  Heat up air parcels from the ground up to 313K = 40C
-*/
-__kernel void cld_heatFromGround(//Input
-                                 const __global float  *tempIn, // 0
-                                 const __global float4 *pos,    // 1
-                                 //Param
-                                 const     CloudParams cloud,   // 2
-                                 //Output
-                                       __global float  *temp)   // 3
-{
-  temp[ID] = min(tempIn[ID] + externalHeatSource(pos[ID].y) * cloud.groundHeatCoeff * cloud.timeStep, 313.0f);
-}
+  FOR_EACH_ITEM
+  {
+    const float3 randNormFloat3 = genRandomNormalizedFloat3(ID);
 
-/*
-  Compute buoyancy and gravitational force
-*/
-__kernel void cld_computeBuoyancy(//Input
-                                  const __global float  *tempIn,    // 0
-                                  const __global float4 *pos,       // 1
-                                  const __global float  *cloudDens, // 2
-                                  //Param
-                                  const     CloudParams cloud,      // 3
-                                  //Output
-                                        __global float  *buoyancy)  // 4
-{
-  float envTemp = environmentTemp(pos[ID].y);
-  buoyancy[ID] = cloud.buoyancyCoeff * (tempIn[ID] - envTemp) / envTemp - cloud.gravCoeff * ABS_GRAVITY_ACC_Y * cloudDens[ID];
-}
+    pos[ID].xyz = (float3)(ABS_WALL_X, ABS_WALL_Y / 2.0f, ABS_WALL_Z) * (2.0f * randNormFloat3 - 1.0f);  
+    pos[ID].y -= ABS_WALL_Y / 2.0f;
+    pos[ID].w = 0.0f;
 
-/*
-  Cool down parcels of air when they go up, minimal temperature is the one at the tropopause 223K = -50C
-*/
-__kernel void cld_applyAdiabaticCooling(//Input
-                                        const __global float  *tempIn,  // 0
-                                        const __global float4 *vel,     // 1
-                                        //Param
-                                        const     CloudParams cloud,    // 2
-                                        //Output
-                                              __global float  *temp)    // 3
-{
-  temp[ID] = max(tempIn[ID] - cloud.adiabaticLapseRate * vel[ID].y * cloud.timeStep, 223.0f);
-}
-
-/*
-  Compute cloud generation from the transition rate and the difference between saturation vapor density and current vapor density
-  - If vapor density (VD) == saturation vapor density (SVD), no transition, system is at equilibrium
-  - If VD < SVD, not enough vapor in the air, clouds disappear, liquid/droplets transitions to vapor
-  - If VD > SVD, too much vapor in the air, clouds appear, vapor transitions to liquid/droplets
-  Note that saturation vapor density depends on temperature, cold air can't contain as much vapor as warmer one
-*/
-__kernel void cld_generateCloud(//Input
-                                const __global float  *tempIn,    // 0
-                                const __global float  *vaporDens, // 1
-                                const __global float  *cloudDens, // 2
-                                //Param
-                                const     CloudParams cloud,      // 3
-                                //Output
-                                      __global float  *cloudGen)  // 4
-{
-  cloudGen[ID] = cloud.phaseTransitionRate * (vaporDens[ID] - saturationVaporDensity(tempIn[ID]));
- // Article CWF Barbora use this formula which doesn't make much sense,
- // previous article Miyazaki Dobashi 2002 uses max instead of min
- // and the initial one Miyazaki Dobashi 2001 doesn't use neither max or min...
- // cloudGen[ID] = cloud.phaseTransitionRate * (vaporDens[ID] - min(saturationVaporDensity(tempIn[ID]), cloudDens[ID] + vaporDens[ID]));
+    vel[ID].xyz = 0.5f * randNormFloat3;
+    vel[ID].w = 0.0f;
+  }
 }
 
 /*
-  Applying phase transition rate to compute new phase density in air parcels, density can't be negative
+  Update thermodynamic state of air parcels
+  Thermodynamic state is packed as (temperature, vapor density, cloud density, buoyancy)
+  All steps below only depend on the particle itself, so they are done in a single pass:
+  1/ Heat up air parcels from the ground up to 313K = 40C
+  2/ Compute buoyancy and gravitational force
+  3/ Cool down parcels of air when they go up, minimal temperature is the one at the tropopause 223K = -50C
+  4/ Compute cloud generation from the transition rate and the difference between saturation vapor density and current vapor density
+    - If vapor density (VD) == saturation vapor density (SVD), no transition, system is at equilibrium
+    - If VD < SVD, not enough vapor in the air, clouds disappear, liquid/droplets transitions to vapor
+    - If VD > SVD, too much vapor in the air, clouds appear, vapor transitions to liquid/droplets
+    Note that saturation vapor density depends on temperature, cold air can't contain as much vapor as warmer one
+  5/ Apply phase transition rate to compute new phase density in air parcels, density can't be negative
+  6/ Cloud generation generates latent heat, making the air parcels going up some more
 */
-__kernel void cld_applyPhaseTransition(//Input
-                                       const __global float  *vaporDensIn,  // 0
-                                       const __global float  *cloudDensIn,  // 1
-                                       const __global float  *cloudGen,     // 2
+__kernel void cld_updateThermodynamics(//Input
+                                       const __global float4 *pos,    // 0
+                                       const __global float4 *vel,    // 1
                                        //Param
-                                       const     CloudParams cloud,         // 3
-                                       //Output
-                                             __global float  *vaporDens,    // 4
-                                             __global float  *cloudDens)    // 5
+                                       __constant CloudParams *cloudParams, // 2
+                                       //Input/Output
+                                             __global float4 *thermo) // 3
 {
-  cloudDens[ID] = max(cloudDensIn[ID] + cloudGen[ID] * cloud.timeStep, 0.0f);
-  vaporDens[ID] = max(vaporDensIn[ID] - cloudGen[ID] * cloud.timeStep, 0.0f);
-}
+  const CloudParams cloud = *cloudParams;
 
-/*
-  Cloud generation generates latent heat, making the air parcels going up some more
-*/
-__kernel void cld_applyLatentHeat(//Input
-                                  const __global float  *tempIn,   // 0
-                                  const __global float  *cloudGen, // 1
-                                  //Param
-                                  const     CloudParams cloud,     // 2
-                                  //Output
-                                        __global float  *temp)     // 3
-{
-  temp[ID] = tempIn[ID] + max(cloud.latentHeatCoeff * cloudGen[ID] * cloud.timeStep, 0.0f);
+  FOR_EACH_ITEM
+  {
+    const float altitude = pos[ID].y;
+    float4 state = thermo[ID];
+
+    // 1/ Heat from ground
+    state.x = min(state.x + externalHeatSource(altitude) * cloud.groundHeatCoeff * cloud.timeStep, 313.0f);
+
+    // 2/ Buoyancy, using cloud density before phase transition
+    const float envTemp = environmentTemp(altitude);
+    state.w = cloud.buoyancyCoeff * (state.x - envTemp) / envTemp - cloud.gravCoeff * ABS_GRAVITY_ACC_Y * state.z;
+
+    // 3/ Adiabatic cooling
+    state.x = max(state.x - cloud.adiabaticLapseRate * vel[ID].y * cloud.timeStep, 223.0f);
+
+    // 4/ Cloud generation
+    const float cloudGen = cloud.phaseTransitionRate * (state.y - saturationVaporDensity(state.x));
+    // Article CWF Barbora use this formula which doesn't make much sense,
+    // previous article Miyazaki Dobashi 2002 uses max instead of min
+    // and the initial one Miyazaki Dobashi 2001 doesn't use neither max or min...
+    // cloudGen = cloud.phaseTransitionRate * (state.y - min(saturationVaporDensity(state.x), state.z + state.y));
+
+    // 5/ Phase transition
+    state.z = max(state.z + cloudGen * cloud.timeStep, 0.0f);
+    state.y = max(state.y - cloudGen * cloud.timeStep, 0.0f);
+
+    // 6/ Latent heat
+    state.x += max(cloud.latentHeatCoeff * cloudGen * cloud.timeStep, 0.0f);
+
+    thermo[ID] = state;
+  }
 }
 
 /*
@@ -257,19 +219,24 @@ __kernel void cld_applyLatentHeat(//Input
 __kernel void cld_predictPosition(//Input
                                   const __global float4 *pos,        // 0
                                   const __global float4 *vel,        // 1
-                                  const __global float  *buoyancy,   // 2
+                                  const __global float4 *thermo,     // 2
                                   //Param
-                                  const     CloudParams cloud,       // 3
+                                  __constant CloudParams *cloudParams, // 3
                                   //Output
                                         __global float4 *predPos,     // 4
                                         __global float4 *totCorrPos)    // 5
 {
-  // No need to update global vel, as it will be reset later on
-  const float4 predVel = vel[ID] + (float4)(0.0f, buoyancy[ID], 0.0f, 0.0f) * cloud.timeStep;
-  
-  totCorrPos[ID] = predVel * cloud.timeStep;
+  const CloudParams cloud = *cloudParams;
 
-  predPos[ID] = pos[ID] + predVel * cloud.timeStep;
+  FOR_EACH_ITEM
+  {
+    // No need to update global vel, as it will be reset later on
+    const float4 predVel = vel[ID] + (float4)(0.0f, thermo[ID].w, 0.0f, 0.0f) * cloud.timeStep;
+
+    totCorrPos[ID] = predVel * cloud.timeStep;
+
+    predPos[ID] = pos[ID] + predVel * cloud.timeStep;
+  }
 }
 
 /*
@@ -279,22 +246,25 @@ __kernel void cld_predictPosition(//Input
 __kernel void cld_applyMixedBoundaryConditions(//Input/output
                                                __global float4 *predPos) // 0
 {
-  const float4 newPos = predPos[ID];
-
-  const float4 clampedNewPos = clamp(newPos, (float4)(-ABS_WALL_X, -ABS_WALL_Y, -ABS_WALL_Z, 0.0f),
-                                             (float4)( ABS_WALL_X,  ABS_WALL_Y,  ABS_WALL_Z, 0.0f));
-  
-  if (fabs(newPos.x) > ABS_WALL_X)
-  {
-    predPos[ID].x = newPos.x - 2 * clampedNewPos.x;
-  }
-  if (fabs(newPos.y) > ABS_WALL_Y)
+  FOR_EACH_ITEM
   {
-    predPos[ID].y = clampedNewPos.y;
-  }  
-  if (fabs(newPos.z) > ABS_WALL_Z)
-  {
-    predPos[ID].z = newPos.z - 2 * clampedNewPos.z;
+    const float4 newPos = predPos[ID];
+
+    const float4 clampedNewPos = clamp(newPos, (float4)(-ABS_WALL_X, -ABS_WALL_Y, -ABS_WALL_Z, 0.0f),
+                                               (float4)( ABS_WALL_X,  ABS_WALL_Y,  ABS_WALL_Z, 0.0f));
+
+    if (fabs(newPos.x) > ABS_WALL_X)
+    {
+      predPos[ID].x = newPos.x - 2 * clampedNewPos.x;
+    }
+    if (fabs(newPos.y) > ABS_WALL_Y)
+    {
+      predPos[ID].y = clampedNewPos.y;
+    }  
+    if (fabs(newPos.z) > ABS_WALL_Z)
+    {
+      predPos[ID].z = newPos.z - 2 * clampedNewPos.z;
+    }
   }
 }
 
@@ -306,57 +276,62 @@ __kernel void cld_computeDensity(//Input
                                  const __global float4 *predPos,      // 0
                                  const __global uint2  *startEndCell, // 1
                                  //Param
-                                 const     FluidParams fluid,         // 2
+                                 __constant FluidParams *fluidParams, // 2
                                  //Output
                                        __global float  *density)      // 3
 {
-  const float4 pos = predPos[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+  const FluidParams fluid = *fluidParams;
+
+  FOR_EACH_ITEM
+  {
+    const float4 pos = predPos[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
 
-  float fluidDensity = 0.0f;
+    float fluidDensity = 0.0f;
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
-  uint2 startEndN = (uint2)(0, 0);
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+    uint2 startEndN = (uint2)(0, 0);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        signAbsWall = (float4)(0.0f);
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          fluidDensity += poly6(pos - predPos[e] - absWallXYZ * signAbsWall, EFFECT_RADIUS);
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            fluidDensity += poly6(pos - predPos[e] - absWallXYZ * signAbsWall, EFFECT_RADIUS);
+          }
         }
       }
     }
-  }
 
-  density[ID] = fluidDensity;
+    density[ID] = fluidDensity;
+  }
 }
 
 /*
@@ -367,72 +342,77 @@ __kernel void cld_computeConstraintFactor(//Input
                                           const __global float  *density,       // 1
                                           const __global uint2  *startEndCell,  // 2
                                           //Param
-                                          const     FluidParams fluid,          // 3
+                                          __constant FluidParams *fluidParams,  // 3
                                           //Output
                                                 __global float  *constFactor)   // 4
 {
-  const float4 pos = predPos[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
-  const float densityC = density[ID] / fluid.restDensity - 1.0f;
-
-  float4 vec = (float4)(0.0f);
-  float4 grad = (float4)(0.0f);
-  float4 sumGradCi = (float4)(0.0f);
-  float  sumSqGradC = 0.0f;
-
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
-   
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
-
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
+  const FluidParams fluid = *fluidParams;
+
+  FOR_EACH_ITEM
   {
-    for (int iY = -1; iY <= 1; ++iY)
+    const float4 pos = predPos[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+    const float densityC = density[ID] / fluid.restDensity - 1.0f;
+
+    float4 vec = (float4)(0.0f);
+    float4 grad = (float4)(0.0f);
+    float4 sumGradCi = (float4)(0.0f);
+    float  sumSqGradC = 0.0f;
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
+
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        signAbsWall = (float4)(0.0f);
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vec = pos - predPos[e] - absWallXYZ * signAbsWall;
-
-          // Supposed to be null if vec = 0.0f;
-          grad = gradSpiky(vec, EFFECT_RADIUS);
-          // Contribution from the ID particle
-          sumGradCi += grad;
-          // Contribution from its neighbors
-          sumSqGradC += dot(grad, grad);
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vec = pos - predPos[e] - absWallXYZ * signAbsWall;
+
+            // Supposed to be null if vec = 0.0f;
+            grad = gradSpiky(vec, EFFECT_RADIUS);
+            // Contribution from the ID particle
+            sumGradCi += grad;
+            // Contribution from its neighbors
+            sumSqGradC += dot(grad, grad);
+          }
         }
       }
     }
-  }
 
-  sumSqGradC += dot(sumGradCi, sumGradCi);
-  sumSqGradC /= fluid.restDensity * fluid.restDensity;
+    sumSqGradC += dot(sumGradCi, sumGradCi);
+    sumSqGradC /= fluid.restDensity * fluid.restDensity;
 
-  constFactor[ID] = - densityC / (sumSqGradC + fluid.relaxCFM);
+    constFactor[ID] = - densityC / (sumSqGradC + fluid.relaxCFM);
+  }
 }
 
 /*
@@ -443,62 +423,71 @@ __kernel void cld_computeConstraintCorrection(//Input
                                               const __global uint2  *startEndCell, // 1
                                               const __global float4 *predPos,      // 2
                                               //Param
-                                              const     FluidParams fluid,         // 3
+                                              __constant FluidParams *fluidParams, // 3
                                               //Output
-                                                    __global float4 *corrPos)      // 4
+                                                    __global float4 *corrPos,      // 4
+                                              //Artificial pressure, not applied by the warm start pass
+                                              const uint isArtPressureApplied)     // 5
 {
-  const float4 pos = predPos[ID];
-  const float lambdaI = constFactor[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+  const FluidParams fluid = *fluidParams;
 
-  float4 vec = (float4)(0.0f);
-  float4 corr = (float4)(0.0f);
+  FOR_EACH_ITEM
+  {
+    const float4 pos = predPos[ID];
+    const float lambdaI = constFactor[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
+    float4 vec = (float4)(0.0f);
+    float4 corr = (float4)(0.0f);
 
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        signAbsWall = (float4)(0.0f);
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vec = pos - predPos[e] - absWallXYZ * signAbsWall;
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vec = pos - predPos[e] - absWallXYZ * signAbsWall;
 
-          corr += (lambdaI + constFactor[e] + artPressure(vec, fluid)) * gradSpiky(vec, EFFECT_RADIUS);
+            const float sCorr = isArtPressureApplied ? artPressure(vec, fluid) : 0.0f;
+
+            corr += (lambdaI + constFactor[e] + sCorr) * gradSpiky(vec, EFFECT_RADIUS);
+          }
         }
       }
     }
-  }
 
-  corrPos[ID] = corr / fluid.restDensity;
+    corrPos[ID] = corr / fluid.restDensity;
+  }
 }
 
 //
@@ -507,65 +496,70 @@ __kernel void cld_computeConstraintCorrection(//Input
 //
 __kernel void cld_computeLaplacianTemp(//Input
                                        const __global float4 *posP,           // 0
-                                       const __global float  *tempP,          // 1
+                                       const __global float4 *thermo,         // 1
                                        const __global uint2  *startEndCell,   // 2
                                        //Param
-                                       const     CloudParams cloud,           // 3
+                                       __constant CloudParams *cloudParams,   // 3
                                        //Output
                                              __global float  *laplacianTemp)  // 4
 {
-  const float4 pos = posP[ID];
-  const float temp = tempP[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
-  
-  float4 vec = (float4)(0.0f);
-  float laplacian = 0.0f;
-
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
-
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
-
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
+  const CloudParams cloud = *cloudParams;
+
+  FOR_EACH_ITEM
   {
-    for (int iY = -1; iY <= 1; ++iY)
+    const float4 pos = posP[ID];
+    const float temp = thermo[ID].x;
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+
+    float4 vec = (float4)(0.0f);
+    float laplacian = 0.0f;
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
+
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        signAbsWall = (float4)(0.0f);
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vec = pos - posP[e] - absWallXYZ * signAbsWall;
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vec = pos - posP[e] - absWallXYZ * signAbsWall;
 
-          laplacian += (temp - tempP[e]) * dot(vec, gradSpiky(vec, EFFECT_RADIUS)) / (dot(vec, vec) + FLOAT_EPS);
+            laplacian += (temp - thermo[e].x) * dot(vec, gradSpiky(vec, EFFECT_RADIUS)) / (dot(vec, vec) + FLOAT_EPS);
+          }
         }
       }
     }
-  }
 
-  laplacianTemp[ID] = laplacian / cloud.restDensity;
+    laplacianTemp[ID] = laplacian / cloud.restDensity;
+  }
 }
 
 
@@ -577,74 +571,79 @@ __kernel void cld_computeConstraintFactorTemp(//Input
                                               const __global float  *laplacianTemp,    // 1
                                               const __global uint2  *startEndCell,     // 2
                                               //Param
-                                              const     CloudParams cloud,             // 3
+                                              __constant CloudParams *cloudParams,     // 3
                                               //Output
                                                     __global float  *constFactorTemp)  // 4
 {
-  const float4 pos = posP[ID];
-  const float laplacian = laplacianTemp[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
-
-  float4 vec = (float4)(0.0f);
-  float4 grad = (float4)(0.0f);
-  float derivativeTemp = 0.0f;
-  float sumGradCi = 0.0f;
-  float sumSqGradC = 0.0f;
-
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
-
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
-
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
+  const CloudParams cloud = *cloudParams;
+
+  FOR_EACH_ITEM
   {
-    for (int iY = -1; iY <= 1; ++iY)
+    const float4 pos = posP[ID];
+    const float laplacian = laplacianTemp[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+
+    float4 vec = (float4)(0.0f);
+    float4 grad = (float4)(0.0f);
+    float derivativeTemp = 0.0f;
+    float sumGradCi = 0.0f;
+    float sumSqGradC = 0.0f;
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
+
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
-      {        
-        signAbsWall = (float4)(0.0f);
+      for (int iY = -1; iY <= 1; ++iY)
+      {
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {        
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vec = pos - posP[e] - absWallXYZ * signAbsWall;
+          startEndN = startEndCell[cellNIndex1D];
 
-          // Supposed to be null if vec = 0.0f;
-          grad = gradSpiky(vec, EFFECT_RADIUS);
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vec = pos - posP[e] - absWallXYZ * signAbsWall;
 
-          derivativeTemp = dot(vec, grad) / (dot(vec, vec) * cloud.restDensity + FLOAT_EPS);
-          // Contribution from the ID particle
-          sumGradCi += derivativeTemp;
-          // Contribution from its neighbors
-          sumSqGradC += derivativeTemp * derivativeTemp;
+            // Supposed to be null if vec = 0.0f;
+            grad = gradSpiky(vec, EFFECT_RADIUS);
+
+            derivativeTemp = dot(vec, grad) / (dot(vec, vec) * cloud.restDensity + FLOAT_EPS);
+            // Contribution from the ID particle
+            sumGradCi += derivativeTemp;
+            // Contribution from its neighbors
+            sumSqGradC += derivativeTemp * derivativeTemp;
+          }
         }
       }
     }
-  }
 
-  sumSqGradC += sumGradCi * sumGradCi;
+    sumSqGradC += sumGradCi * sumGradCi;
 
-  constFactorTemp[ID] = - laplacian / (sumSqGradC + cloud.relaxCFM);
+    constFactorTemp[ID] = - laplacian / (sumSqGradC + cloud.relaxCFM);
+  }
 }
 
 
@@ -656,69 +655,74 @@ __kernel void cld_computeConstraintCorrectionTemp(//Input
                                                   const __global uint2  *startEndCell,   // 1
                                                   const __global float4 *posP,           // 2
                                                   //Param
-                                                  const     CloudParams cloud,           // 3
+                                                  __constant CloudParams *cloudParams,   // 3
                                                   //Output
                                                         __global float *corrTemp)       // 4
 {
-  const float4 pos = posP[ID];
-  const float lambdaI = constFactorTemp[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
-
-  float4 vec = (float4)(0.0f);
-  float4 grad = (float4)(0.0f);
-  float derivativeTemp = 0.0f;
-  float corr = 0.0f;
-
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
-  
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
-
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
+  const CloudParams cloud = *cloudParams;
+
+  FOR_EACH_ITEM
   {
-    for (int iY = -1; iY <= 1; ++iY)
+    const float4 pos = posP[ID];
+    const float lambdaI = constFactorTemp[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+
+    float4 vec = (float4)(0.0f);
+    float4 grad = (float4)(0.0f);
+    float derivativeTemp = 0.0f;
+    float corr = 0.0f;
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
+
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        signAbsWall = (float4)(0.0f);
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vec = pos - posP[e] - absWallXYZ * signAbsWall;
-          
-          // Supposed to be null if vec = 0.0f;
-          grad = gradSpiky(vec, EFFECT_RADIUS);
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vec = pos - posP[e] - absWallXYZ * signAbsWall;
+
+            // Supposed to be null if vec = 0.0f;
+            grad = gradSpiky(vec, EFFECT_RADIUS);
 
-          derivativeTemp = dot(vec, grad) / (dot(vec, vec) * cloud.restDensity + FLOAT_EPS);
+            derivativeTemp = dot(vec, grad) / (dot(vec, vec) * cloud.restDensity + FLOAT_EPS);
 
-          corr += (lambdaI + constFactorTemp[e]) * derivativeTemp;
+            corr += (lambdaI + constFactorTemp[e]) * derivativeTemp;
+          }
         }
       }
     }
-  }
 
-  corrTemp[ID] = corr;
+    corrTemp[ID] = corr;
+  }
 }
 
 /*
@@ -729,59 +733,64 @@ __kernel void cld_computeVorticity(//Input
                                    const __global uint2  *startEndCell, // 1
                                    const __global float4 *vel,          // 2
                                    //Param
-                                   const     FluidParams fluid,         // 3
+                                   __constant FluidParams *fluidParams, // 3
                                    //Output
                                          __global float4 *vorticity)    // 4
 {
-  const float4 pos = predPos[ID];
-  const float4 velocity = vel[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+  const FluidParams fluid = *fluidParams;
+
+  FOR_EACH_ITEM
+  {
+    const float4 pos = predPos[ID];
+    const float4 velocity = vel[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
 
-  float4 vort = (float4)(0.0f);
+    float4 vort = (float4)(0.0f);
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0);
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0);
 
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        signAbsWall = (float4)(0.0f);
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vort += cross((vel[e] - velocity), gradSpiky(pos - predPos[e] - absWallXYZ * signAbsWall, EFFECT_RADIUS));
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vort += cross((vel[e] - velocity), gradSpiky(pos - predPos[e] - absWallXYZ * signAbsWall, EFFECT_RADIUS));
+          }
         }
       }
     }
-  }
 
-  vorticity[ID] = vort;
+    vorticity[ID] = vort;
+  }
 }
 
 /*
@@ -792,61 +801,66 @@ __kernel void cld_applyVorticityConfinement(//Input
                                             const __global uint2  *startEndCell, // 1
                                             const __global float4 *vort,         // 2
                                             //Param
-                                            const     FluidParams fluid,         // 3
+                                            __constant FluidParams *fluidParams, // 3
                                             //Output
                                                   __global float4 *vel)          // 4
 {
-  const float4 pos = predPos[ID];
-  const float4 vorticity = vort[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+  const FluidParams fluid = *fluidParams;
 
-  // vorticity confinement
-  float4 n = (float4)(0.0f);
+  FOR_EACH_ITEM
+  {
+    const float4 pos = predPos[ID];
+    const float4 vorticity = vort[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
+    // vorticity confinement
+    float4 n = (float4)(0.0f);
 
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        signAbsWall = (float4)(0.0f);
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          n += fast_length(vort[e]) * gradSpiky(pos - predPos[e] - absWallXYZ * signAbsWall, EFFECT_RADIUS);
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            n += fast_length(vort[e]) * gradSpiky(pos - predPos[e] - absWallXYZ * signAbsWall, EFFECT_RADIUS);
+          }
         }
       }
     }
-  }
 
-  // Adding vorticity confinement to attenue virtual damping
-  vel[ID] += fluid.vorticityConfCoeff * cross(normalize(n), vorticity) * fluid.timeStep;
+    // Adding vorticity confinement to attenue virtual damping
+    vel[ID] += fluid.vorticityConfCoeff * cross(normalize(n), vorticity) * fluid.timeStep;
+  }
 }
 
 
@@ -858,60 +872,65 @@ __kernel void cld_applyXsphViscosityCorrection(//Input
                                                const __global uint2  *startEndCell, // 1
                                                const __global float4 *velIn,        // 2
                                                //Param
-                                               const     FluidParams fluid,         // 3
+                                               __constant FluidParams *fluidParams, // 3
                                                //Output
                                                      __global float4 *velOut)       // 4
 {
-  const float4 pos = predPos[ID];
-  const float4 velocity = velIn[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+  const FluidParams fluid = *fluidParams;
 
-  float4 viscosity = (float4)(0.0f);
+  FOR_EACH_ITEM
+  {
+    const float4 pos = predPos[ID];
+    const float4 velocity = velIn[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
+    float4 viscosity = (float4)(0.0f);
 
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        signAbsWall = (float4)(0.0f);
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          signAbsWall = (float4)(0.0f);
 
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Periodic BC for x, periodic neighbors must be considered
-        if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
-        else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
+          // Periodic BC for x, periodic neighbors must be considered
+          if((cellIndex3D.x + iX) >= GRID_RES_X) signAbsWall.x = 2.0f;
+          else if((cellIndex3D.x + iX) < 0) signAbsWall.x = -2.0f;
 
-        // Wall BC for y, out of domain cells are discarded
-        if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
-        
-        // Periodic BC for z, periodic neighbors must be considered
-        if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
-        else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
+          // Wall BC for y, out of domain cells are discarded
+          if(((cellIndex3D.y + iY) >= GRID_RES_Y) || ((cellIndex3D.y + iY) < 0)) continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Periodic BC for z, periodic neighbors must be considered
+          if((cellIndex3D.z + iZ) >= GRID_RES_Z) signAbsWall.z = 2.0f;
+          else if((cellIndex3D.z + iZ) < 0) signAbsWall.z = -2.0f;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          viscosity += (velIn[e] - velocity) * poly6(pos - predPos[e] - absWallXYZ * signAbsWall, EFFECT_RADIUS);
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            viscosity += (velIn[e] - velocity) * poly6(pos - predPos[e] - absWallXYZ * signAbsWall, EFFECT_RADIUS);
+          }
         }
       }
     }
-  }
 
-  // Adding xsph viscosity for a more coherent motion
-  velOut[ID] = velocity + fluid.xsphViscosityCoeff * viscosity;
+    // Adding xsph viscosity for a more coherent motion
+    velOut[ID] = velocity + fluid.xsphViscosityCoeff * viscosity;
+  }
 }
 
 /*
@@ -922,18 +941,123 @@ __kernel void cld_correctPosition(//Input
                                   //Output
                                         __global float4 *predPos) // 1
 {
-  predPos[ID] += corrPos[ID];
+  FOR_EACH_ITEM
+  {
+    predPos[ID] += corrPos[ID];
+  }
 }
 
 //
 // Correction on temperature field using Constraint correction value
 //
 __kernel void cld_correctTemperature(//Input
-                                     const __global float *corrTemp, // 0
+                                     const __global float  *corrTemp, // 0
                                      //Output
-                                           __global float *temp)     // 2
+                                           __global float4 *thermo)  // 1
 {
-  temp[ID] += 0.3f * corrTemp[ID]; // We only partially use the correction, visual results are too homogeneous otherwise
+  FOR_EACH_ITEM
+  {
+    thermo[ID].x += 0.3f * corrTemp[ID]; // We only partially use the correction, visual results are too homogeneous otherwise
+  }
+}
+
+/*
+  Splat particles temperature onto the grid, one work-item per cell
+  Particles are sorted by cell, so the mean temperature of a cell is computed without atomics
+  Output x is the mean temperature of the cell, y is 1 if the cell contains particles, 0 otherwise
+*/
+__kernel void cld_splatTempToGrid(//Input
+                                  const __global uint2  *startEndCell, // 0
+                                  const __global float4 *thermo,       // 1
+                                  //Output
+                                        __global float2 *gridTemp)     // 2
+{
+  FOR_EACH_ITEM
+  {
+    const uint2 startEnd = startEndCell[ID];
+
+    float sumTemp = 0.0f;
+    float nbParts = 0.0f;
+
+    for (uint e = startEnd.x; e <= startEnd.y; ++e)
+    {
+      sumTemp += thermo[e].x;
+      nbParts += 1.0f;
+    }
+
+    gridTemp[ID] = (nbParts > 0.0f) ? (float2)(sumTemp / nbParts, 1.0f) : (float2)(0.0f, 0.0f);
+  }
+}
+
+/*
+  Apply constraint on temperature field on the grid, forcing its Laplacian to be null
+  Discrete Laplacian computed with a 6-neighbor stencil on non-empty cells
+  Periodic BC for x and z, wall BC for y
+*/
+__kernel void cld_smoothTempOnGrid(//Input
+                                   const __global float2 *gridTempIn,  // 0
+                                   //Output
+                                         __global float2 *gridTempOut) // 1
+{
+  FOR_EACH_ITEM
+  {
+    const float2 tempC = gridTempIn[ID];
+
+    if (tempC.y == 0.0f)
+    {
+      gridTempOut[ID] = tempC;
+      continue;
+    }
+
+    const int cellIndex1D = (int)ID;
+    const int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    const int3 cellIndex3D = (int3)(cellIndex1D / (GRID_RES_Y * GRID_RES_Z), (cellIndex1D / GRID_RES_Z) % GRID_RES_Y, cellIndex1D % GRID_RES_Z);
+    const int3 offsets[6] = { (int3)(-1, 0, 0), (int3)(1, 0, 0), (int3)(0, -1, 0), (int3)(0, 1, 0), (int3)(0, 0, -1), (int3)(0, 0, 1) };
+
+    int3 cellNIndex3D = (int3)(0);
+    float2 tempN = (float2)(0.0f);
+    float laplacian = 0.0f;
+    float nbNeighbors = 0.0f;
+
+    for (int i = 0; i < 6; ++i)
+    {
+      // Wall BC for y, out of domain cells are discarded
+      if (((cellIndex3D.y + offsets[i].y) >= GRID_RES_Y) || ((cellIndex3D.y + offsets[i].y) < 0)) continue;
+
+      // Periodic BC for x and z
+      cellNIndex3D = (cellIndex3D + offsets[i] + gridResXYZ) % gridResXYZ;
+
+      tempN = gridTempIn[(cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z];
+
+      laplacian += tempN.y * (tempN.x - tempC.x);
+      nbNeighbors += tempN.y;
+    }
+
+    // Jacobi projection of the constraint, gradient of the discrete Laplacian with respect to the cell is -nbNeighbors
+    // Correction is relaxed by half to keep the solver stable
+    gridTempOut[ID] = (float2)(tempC.x + 0.5f * laplacian / max(nbNeighbors, 1.0f), 1.0f);
+  }
+}
+
+/*
+  Gather temperature correction computed on the grid back to particles
+*/
+__kernel void cld_gatherTempFromGrid(//Input
+                                     const __global float4 *predPos,       // 0
+                                     const __global float2 *gridTempInit,  // 1
+                                     const __global float2 *gridTempCorr,  // 2
+                                     //Output
+                                           __global float4 *thermo)        // 3
+{
+  FOR_EACH_ITEM
+  {
+    const uint cellIndex1D = getCell1DIndexFromPos(predPos[ID]);
+    if (cellIndex1D >= GRID_NUM_CELLS)
+      continue;
+
+    // Same partial correction as the particle based solver
+    thermo[ID].x += 0.3f * (gridTempCorr[cellIndex1D].x - gridTempInit[cellIndex1D].x);
+  }
 }
 
 /*
@@ -942,14 +1066,19 @@ __kernel void cld_correctTemperature(//Input
 __kernel void cld_updatePosition(//Input
                                  const  __global float4 *predPos, // 0
                                  //Param
-                                 const     CloudParams cloud,     // 1
+                                 __constant CloudParams *cloudParams, // 1
                                  //Output
                                         __global float4 *pos)     // 2
 {
-  pos[ID] = predPos[ID];
-  // We also update position based on the wind factor depending on the altitude, it is null at ground level
-  pos[ID].x += (1 - exp(- (predPos[ID].y + ABS_WALL_Y) * 0.2f)) * cloud.windCoeff * cloud.timeStep * (float)(cloud.dim - 2); //0.02f;
-  pos[ID].z += (1 - exp(- (predPos[ID].y + ABS_WALL_Y) * 0.3f)) * 0.7f * cloud.windCoeff * cloud.timeStep; //0.015f;
+  const CloudParams cloud = *cloudParams;
+
+  FOR_EACH_ITEM
+  {
+    pos[ID] = predPos[ID];
+    // We also update position based on the wind factor depending on the altitude, it is null at ground level
+    pos[ID].x += (1 - exp(- (predPos[ID].y + ABS_WALL_Y) * 0.2f)) * cloud.windCoeff * cloud.timeStep * (float)(cloud.dim - 2); //0.02f;
+    pos[ID].z += (1 - exp(- (predPos[ID].y + ABS_WALL_Y) * 0.3f)) * 0.7f * cloud.windCoeff * cloud.timeStep; //0.015f;
+  }
 }
 
 /*
@@ -958,10 +1087,15 @@ __kernel void cld_updatePosition(//Input
 __kernel void cld_updateVel(//Input
                             const __global float4 *totCorrPos,    // 0
                             //Param
-                            const     FluidParams fluid,       // 1
+                            __constant FluidParams *fluidParams, // 1
                             //Output
                                   __global float4 *vel)        // 2
 {
-  // Clamping velocity and preventing division by 0
-  vel[ID] = clamp((totCorrPos[ID]) / (fluid.timeStep + FLOAT_EPS), -MAX_VEL, MAX_VEL);
+  const FluidParams fluid = *fluidParams;
+
+  FOR_EACH_ITEM
+  {
+    // Clamping velocity and preventing division by 0
+    vel[ID] = clamp((totCorrPos[ID]) / (fluid.timeStep + FLOAT_EPS), -MAX_VEL, MAX_VEL);
+  }
 }
\ No newline at end of file
@@ -1,7 +1,20 @@
 
 // Commonly used defined variables
 // define.cl must be set as the first .cl file to create the OpenCL program
-#define ID            get_global_id(0)
+
+// Work-item coarsening, the factor is chosen by the context for each device type
+// Each work-item processes a block of COARSENING_FACTOR contiguous items, ID being the index of current item
+// Remaining items are run by a second 2D launch, offset to the first of them, with one item per work-item
+#ifndef COARSENING_FACTOR
+#define COARSENING_FACTOR 1
+#endif
+#define ITEMS_PER_WORK_ITEM ((get_work_dim() == 1) ? COARSENING_FACTOR : 1)
+#define FIRST_ITEM_ID (get_global_offset(0) + (get_global_id(0) - get_global_offset(0)) * ITEMS_PER_WORK_ITEM)
+#define FOR_EACH_ITEM for (uint ID = FIRST_ITEM_ID, lastID = ID + ITEMS_PER_WORK_ITEM; ID < lastID; ++ID)
+// Same over a compacted list of nbListed IDs if isListed, launched as FOR_EACH_ITEM, items past the list being skipped
+#define FOR_EACH_LISTED_ITEM(isListed, listedIDs, nbListed) \
+  for (uint item = FIRST_ITEM_ID, lastItem = (isListed) ? min(item + ITEMS_PER_WORK_ITEM, *(nbListed)) : item + ITEMS_PER_WORK_ITEM, ID = item; \
+       item < lastItem && ((ID = (isListed) ? (listedIDs)[item] : item), true); ++item)
 
 #define FLOAT_EPS     0.00000001f
 
@@ -9,6 +22,18 @@
 #define GRAVITY_ACC   (float4)(0.0f, -ABS_GRAVITY_ACC_Y, 0.0f, 0.0f)
 #define FAR_DIST      1000000.0f
 
+// Ensemble mode, several independent instances of a model share the same buffers
+// The instance ID of a particle is stored in the w coordinate of its position
+#ifndef NUM_INSTANCES
+#define NUM_INSTANCES 1
+#endif
+
+#if NUM_INSTANCES > 1
+#define INSTANCE_ID(pos) ((uint)(pos).w)
+#else
+#define INSTANCE_ID(pos) 0
+#endif
+
 // See FluidsKernelInputs in Fluids.cpp / Clouds.cpp
 typedef struct defFluidParams{
   float restDensity;
@@ -22,4 +47,6 @@ typedef struct defFluidParams{
   uint  isVorticityConfEnabled;
   float vorticityConfCoeff;
   float xsphViscosityCoeff;
+  uint  isSleepingEnabled;
+  uint  isUnilateralEnabled;
 } FluidParams;
@@ -7,7 +7,7 @@
 // ABS_WALL_X            - absolute position of the walls in x,y,z
 // GRID_RES_X                - resolution of the grid
 // GRID_NUM_CELLS          - total number of cells in the grid
-// NUM_MAX_PARTS_IN_CELL   - maximum number of particles taking into account in a single cell in simplified mode
+// NUM_INSTANCES           - number of independent fluid instances in ensemble mode
 // REST_DENSITY            - rest density of the fluid
 // POLY6_COEFF             - coefficient of the Poly6 kernel, depending on EFFECT_RADIUS
 // SPIKY_COEFF             - coefficient of the Spiky kernel, depending on EFFECT_RADIUS
@@ -16,6 +16,26 @@
 // define.cl must be included as first file.cl to create OpenCL program
 #define WALL_COEFF 1000.0f
 
+// Health counters of a step, same order as in Fluids.cpp
+#define HEALTH_NON_FINITE 0
+#define HEALTH_SPEED_CAPPED 1
+#define HEALTH_WALL_CLAMPED 2
+
+// Counters are reduced in local memory by the first work-item of each work-group, in 1D and 2D launches
+#define IS_FIRST_LOCAL_ITEM (get_local_id(0) == 0 && get_local_id(1) == 0)
+
+// NaN or infinite, checked on bits as fast relaxed math lets the compiler assume finite values
+#define IS_NON_FINITE(v) any((as_uint4(v) & 0x7f800000) == 0x7f800000)
+
+// Sleeping particles, a particle is quiet below both thresholds and falls asleep after SLEEP_STEPS quiet steps
+// Sleeping particles whose 27 neighbor cells only hold sleeping ones are excluded from the step,
+// they keep their position and act as static neighbors
+#define SLEEP_SPEED 0.1f
+#define SLEEP_DENSITY_ERROR 0.05f
+#define SLEEP_STEPS 30.0f
+// Rest steps of excluded particles, until the activity of their neighbor cells is checked again
+#define SLEEP_EXCLUDED (SLEEP_STEPS + 1.0f)
+
 // Defined in sph.cl
 /*
   Poly6 kernel introduced in
@@ -44,6 +64,22 @@ inline uint3 getCell3DIndexFromPos(float4 pos);
 inline uint getCell1DIndexFromPos(float4 pos);
 //
 
+/*
+  In ensemble mode, override shared fluid parameters with the ones of the instance the particle belongs to
+  instanceParams stores for each instance: rest density, relaxation CFM, vorticity confinement coeff and xsph viscosity coeff
+*/
+inline FluidParams getInstanceFluidParams(FluidParams fluid, const __global float4 *instanceParams, const uint instanceID)
+{
+#if NUM_INSTANCES > 1
+  const float4 params = instanceParams[instanceID];
+  fluid.restDensity = params.x;
+  fluid.relaxCFM = params.y;
+  fluid.vorticityConfCoeff = params.z;
+  fluid.xsphViscosityCoeff = params.w;
+#endif
+  return fluid;
+}
+
 /*
   Artificial pressure to remove tensile instability
   Preventing particle clustering and improving surface tension
@@ -62,15 +98,28 @@ inline float artPressure(const float4 vec, FluidParams fluid)
 __kernel void fld_predictPosition(//Input
                                   const __global float4 *pos,        // 0
                                   const __global float4 *vel,        // 1
+                                  const __global float  *restSteps,  // 2
                                   //Param
-                                  const     FluidParams fluid,       // 2
+                                  __constant FluidParams *fluidParams, // 3
                                   //Output
-                                        __global float4 *predPos)    // 3
+                                        __global float4 *predPos)    // 4
 {
-  // No need to update global vel, as it will be reset later on
-  const float4 newVel = vel[ID] + GRAVITY_ACC * fluid.timeStep;
+  const FluidParams fluid = *fluidParams;
+
+  FOR_EACH_ITEM
+  {
+    // Excluded particles stay in place, not pulled down by gravity
+    if (fluid.isSleepingEnabled && restSteps[ID] >= SLEEP_EXCLUDED)
+    {
+      predPos[ID] = pos[ID];
+      continue;
+    }
+
+    // No need to update global vel, as it will be reset later on
+    const float4 newVel = vel[ID] + GRAVITY_ACC * fluid.timeStep;
 
-  predPos[ID] = pos[ID] + newVel * fluid.timeStep;
+    predPos[ID] = pos[ID] + newVel * fluid.timeStep;
+  }
 }
 
 /*
@@ -81,169 +130,202 @@ __kernel void fld_computeDensity(//Input
                                  const __global float4 *predPos,      // 0
                                  const __global uint2  *startEndCell, // 1
                                  //Param
-                                 const     FluidParams fluid,         // 2
+                                 __constant FluidParams *fluidParams, // 2
                                  //Output
-                                       __global float  *density)      // 3
+                                       __global float  *density,      // 3
+                                 //Active particles
+                                 const __global uint   *activeIDs,    // 4
+                                 const __global uint   *nbActive)     // 5
 {
-  const float4 pos = predPos[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+  const FluidParams fluid = *fluidParams;
+
+  FOR_EACH_LISTED_ITEM(fluid.isSleepingEnabled, activeIDs, nbActive)
+  {
+    const float4 pos = predPos[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+    const uint instanceOffset = INSTANCE_ID(pos) * GRID_NUM_CELLS;
 
-  float fluidDensity = 0.0f;
+    float fluidDensity = 0.0f;
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
-  uint2 startEndN = (uint2)(0, 0);
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+    uint2 startEndN = (uint2)(0, 0);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Removing out of range cells
-        if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
-          continue;
+          // Removing out of range cells
+          if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
+            continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          cellNIndex1D = instanceOffset + (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        startEndN = startEndCell[cellNIndex1D];
+          startEndN = startEndCell[cellNIndex1D];
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          fluidDensity += poly6(pos - predPos[e], EFFECT_RADIUS);
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            fluidDensity += poly6(pos - predPos[e], EFFECT_RADIUS);
+          }
         }
       }
     }
-  }
 
-  density[ID] = fluidDensity;
+    density[ID] = fluidDensity;
+  }
 }
 
 /*
   Compute Constraint Factor (Lambda), coefficient along jacobian
 */
 __kernel void fld_computeConstraintFactor(//Input
-                                          const __global float4 *predPos,       // 0
-                                          const __global float  *density,       // 1
-                                          const __global uint2  *startEndCell,  // 2
+                                          const __global float4 *predPos,        // 0
+                                          const __global float  *density,        // 1
+                                          const __global uint2  *startEndCell,   // 2
                                           //Param
-                                          const     FluidParams fluid,          // 3
+                                          __constant FluidParams *fluidShared,   // 3
+                                          const __global float4 *instanceParams, // 4
                                           //Output
-                                                __global float  *constFactor)   // 4
+                                                __global float  *constFactor,    // 5
+                                          //Active particles
+                                          const __global uint   *activeIDs,      // 6
+                                          const __global uint   *nbActive)       // 7
 {
-  const float4 pos = predPos[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
-  const float densityC = density[ID] / fluid.restDensity - 1.0f;
-
-  float4 vec = (float4)(0.0f);
-  float4 grad = (float4)(0.0f);
-  float4 sumGradCi = (float4)(0.0f);
-  float  sumSqGradC = 0.0f;
-
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0);
-
-  float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
-  float4 signAbsWall = (float4)(0.0f);
-
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
+  // Only dispatched over constrained particles in unilateral mode, see fld_fillConstrainedList
+  FOR_EACH_LISTED_ITEM(fluidShared->isSleepingEnabled || fluidShared->isUnilateralEnabled, activeIDs, nbActive)
   {
-    for (int iY = -1; iY <= 1; ++iY)
+    const float4 pos = predPos[ID];
+    const FluidParams fluid = getInstanceFluidParams(*fluidShared, instanceParams, INSTANCE_ID(pos));
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+    const uint instanceOffset = INSTANCE_ID(pos) * GRID_NUM_CELLS;
+    const float densityC = density[ID] / fluid.restDensity - 1.0f;
+
+    float4 vec = (float4)(0.0f);
+    float4 grad = (float4)(0.0f);
+    float4 sumGradCi = (float4)(0.0f);
+    float  sumSqGradC = 0.0f;
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0);
+
+    float4 absWallXYZ = (float4)(ABS_WALL_X, ABS_WALL_Y, ABS_WALL_Z, 0.0f);
+    float4 signAbsWall = (float4)(0.0f);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
-        
-        // Removing out of range cells
-        if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
-          continue;
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          // Removing out of range cells
+          if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
+            continue;
 
-        startEndN = startEndCell[cellNIndex1D];
+          cellNIndex1D = instanceOffset + (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vec = pos - predPos[e];
-
-          // Supposed to be null if vec = 0.0f;
-          grad = gradSpiky(vec, EFFECT_RADIUS);
-          // Contribution from the ID particle
-          sumGradCi += grad;
-          // Contribution from its neighbors
-          sumSqGradC += dot(grad, grad);
+          startEndN = startEndCell[cellNIndex1D];
+
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vec = pos - predPos[e];
+
+            // Supposed to be null if vec = 0.0f;
+            grad = gradSpiky(vec, EFFECT_RADIUS);
+            // Contribution from the ID particle
+            sumGradCi += grad;
+            // Contribution from its neighbors
+            sumSqGradC += dot(grad, grad);
+          }
         }
       }
     }
-  }
 
-  sumSqGradC += dot(sumGradCi, sumGradCi);
-  sumSqGradC /= fluid.restDensity * fluid.restDensity;
+    sumSqGradC += dot(sumGradCi, sumGradCi);
+    sumSqGradC /= fluid.restDensity * fluid.restDensity;
 
-  constFactor[ID] = - densityC / (sumSqGradC + fluid.relaxCFM);
+    constFactor[ID] = - densityC / (sumSqGradC + fluid.relaxCFM);
+  }
 }
 
 /*
   Compute Constraint Correction
 */
 __kernel void fld_computeConstraintCorrection(//Input
-                                              const __global float  *constFactor,  // 0
-                                              const __global uint2  *startEndCell, // 1
-                                              const __global float4 *predPos,      // 2
+                                              const __global float  *constFactor,    // 0
+                                              const __global uint2  *startEndCell,   // 1
+                                              const __global float4 *predPos,        // 2
                                               //Param
-                                              const     FluidParams fluid,         // 3
+                                              __constant FluidParams *fluidShared,   // 3
+                                              const __global float4 *instanceParams, // 4
                                               //Output
-                                                    __global float4 *corrPos)      // 4
+                                                    __global float4 *corrPos,        // 5
+                                              //Active particles
+                                              const __global uint   *activeIDs,      // 6
+                                              const __global uint   *nbActive,       // 7
+                                              //Artificial pressure, not applied by the warm start pass
+                                              const uint isArtPressureApplied)       // 8
 {
-  const float4 pos = predPos[ID];
-  const float lambdaI = constFactor[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
-
-  float4 vec = (float4)(0.0f);
-  float4 corr = (float4)(0.0f);
-
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
-
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
+  // Only dispatched over particles next to a constrained one in unilateral mode, see fld_fillCorrectedList
+  FOR_EACH_LISTED_ITEM(fluidShared->isSleepingEnabled || fluidShared->isUnilateralEnabled, activeIDs, nbActive)
   {
-    for (int iY = -1; iY <= 1; ++iY)
+    const float4 pos = predPos[ID];
+    const FluidParams fluid = getInstanceFluidParams(*fluidShared, instanceParams, INSTANCE_ID(pos));
+    const float lambdaI = constFactor[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+    const uint instanceOffset = INSTANCE_ID(pos) * GRID_NUM_CELLS;
+
+    float4 vec = (float4)(0.0f);
+    float4 corr = (float4)(0.0f);
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Removing out of range cells
-        if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
-          continue;
+          // Removing out of range cells
+          if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
+            continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          cellNIndex1D = instanceOffset + (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        startEndN = startEndCell[cellNIndex1D];
+          startEndN = startEndCell[cellNIndex1D];
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vec = pos - predPos[e];
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vec = pos - predPos[e];
 
-          corr += (lambdaI + constFactor[e] + artPressure(vec, fluid)) * gradSpiky(vec, EFFECT_RADIUS);
+            const float sCorr = isArtPressureApplied ? artPressure(vec, fluid) : 0.0f;
+
+            corr += (lambdaI + constFactor[e] + sCorr) * gradSpiky(vec, EFFECT_RADIUS);
+          }
         }
       }
     }
-  }
 
-  corrPos[ID] = corr / fluid.restDensity;
+    corrPos[ID] = corr / fluid.restDensity;
+  }
 }
 
 /*
@@ -251,10 +333,18 @@ __kernel void fld_computeConstraintCorrection(//Input
 */
 __kernel void fld_correctPosition(//Input
                                   const __global float4 *corrPos, // 0
+                                  //Param
+                                  __constant FluidParams *fluidParams, // 1
                                   //Output
-                                        __global float4 *predPos) // 1
+                                        __global float4 *predPos, // 2
+                                  //Active particles
+                                  const __global uint   *activeIDs, // 3
+                                  const __global uint   *nbActive)  // 4
 {
-  predPos[ID] += corrPos[ID];
+  FOR_EACH_LISTED_ITEM(fluidParams->isSleepingEnabled || fluidParams->isUnilateralEnabled, activeIDs, nbActive)
+  {
+    predPos[ID] += corrPos[ID];
+  }
 }
 
 /*
@@ -264,12 +354,51 @@ __kernel void fld_updateVel(//Input
                             const __global float4 *newPos,    // 0
                             const __global float4 *prevPos,   // 1
                             //Param
-                            const     FluidParams fluid,      // 2
+                            __constant FluidParams *fluidParams, // 2
                             //Output
-                                  __global float4 *vel)       // 3
+                                  __global float4 *vel,       // 3
+                         volatile __global uint   *health,    // 4
+                            //Active particles
+                            const __global uint   *activeIDs, // 5
+                            const __global uint   *nbActive,  // 6
+                            //Health check
+                            const uint isHealthChecked)       // 7
 {
-  // Preventing division by 0
-  vel[ID] = clamp((newPos[ID] - prevPos[ID]) / (fluid.timeStep + FLOAT_EPS), -MAX_VEL, MAX_VEL);
+  const FluidParams fluid = *fluidParams;
+
+  // Faulty particles are counted per work-group, then added to the global counters with one atomic each
+  volatile __local uint groupHealth[2];
+  if (isHealthChecked)
+  {
+    if (IS_FIRST_LOCAL_ITEM)
+    {
+      groupHealth[HEALTH_NON_FINITE] = 0;
+      groupHealth[HEALTH_SPEED_CAPPED] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  FOR_EACH_LISTED_ITEM(fluid.isSleepingEnabled, activeIDs, nbActive)
+  {
+    // Preventing division by 0
+    const float4 newVel = (newPos[ID] - prevPos[ID]) / (fluid.timeStep + FLOAT_EPS);
+
+    if (isHealthChecked && IS_NON_FINITE(newVel))
+      atomic_inc(&groupHealth[HEALTH_NON_FINITE]);
+    else if (isHealthChecked && any(fabs(newVel) > MAX_VEL))
+      atomic_inc(&groupHealth[HEALTH_SPEED_CAPPED]);
+
+    vel[ID] = clamp(newVel, -MAX_VEL, MAX_VEL);
+  }
+
+  if (isHealthChecked)
+  {
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (IS_FIRST_LOCAL_ITEM && groupHealth[HEALTH_NON_FINITE] > 0)
+      atomic_add(&health[HEALTH_NON_FINITE], groupHealth[HEALTH_NON_FINITE]);
+    if (IS_FIRST_LOCAL_ITEM && groupHealth[HEALTH_SPEED_CAPPED] > 0)
+      atomic_add(&health[HEALTH_SPEED_CAPPED], groupHealth[HEALTH_SPEED_CAPPED]);
+  }
 }
 
 /*
@@ -280,100 +409,123 @@ __kernel void fld_computeVorticity(//Input
                                    const __global uint2  *startEndCell, // 1
                                    const __global float4 *vel,          // 2
                                    //Param
-                                   const     FluidParams fluid,         // 3
+                                   __constant FluidParams *fluidParams, // 3
                                    //Output
-                                         __global float4 *vorticity)    // 4
+                                         __global float4 *vorticity,    // 4
+                                   //Active particles
+                                   const __global uint   *activeIDs,    // 5
+                                   const __global uint   *nbActive)     // 6
 {
-  const float4 pos = predPos[ID];
-  const float4 velocity = vel[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+  const FluidParams fluid = *fluidParams;
 
-  float4 vort = (float4)(0.0f);
+  FOR_EACH_LISTED_ITEM(fluid.isSleepingEnabled, activeIDs, nbActive)
+  {
+    const float4 pos = predPos[ID];
+    const float4 velocity = vel[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+    const uint instanceOffset = INSTANCE_ID(pos) * GRID_NUM_CELLS;
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
+    float4 vort = (float4)(0.0f);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Removing out of range cells
-        if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
-          continue;
+          // Removing out of range cells
+          if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
+            continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          cellNIndex1D = instanceOffset + (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        startEndN = startEndCell[cellNIndex1D];
+          startEndN = startEndCell[cellNIndex1D];
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          vort += cross((vel[e] - velocity), gradSpiky(pos - predPos[e], EFFECT_RADIUS));
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            vort += cross((vel[e] - velocity), gradSpiky(pos - predPos[e], EFFECT_RADIUS));
+          }
         }
       }
     }
-  }
 
-  vorticity[ID] = vort;
+    vorticity[ID] = vort;
+  }
 }
 
 /*
   Apply vorticity confinement
 */
 __kernel void fld_applyVorticityConfinement(//Input
-                                            const __global float4 *predPos,      // 0
-                                            const __global uint2  *startEndCell, // 1
-                                            const __global float4 *vort,         // 2
+                                            const __global float4 *predPos,        // 0
+                                            const __global uint2  *startEndCell,   // 1
+                                            const __global float4 *vort,           // 2
                                             //Param
-                                            const     FluidParams fluid,         // 3
+                                            __constant FluidParams *fluidShared,   // 3
+                                            const __global float4 *instanceParams, // 4
                                             //Output
-                                                  __global float4 *vel)          // 4
+                                                  __global float4 *vel,            // 5
+                                            //Active particles
+                                            const __global uint   *activeIDs,      // 6
+                                            const __global uint   *nbActive,       // 7
+                                            const __global float  *restSteps)      // 8
 {
-  const float4 pos = predPos[ID];
-  const float4 vorticity = vort[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
-
-  // vorticity confinement
-  float4 n = (float4)(0.0f);
-
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0);
-
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
+  FOR_EACH_LISTED_ITEM(fluidShared->isSleepingEnabled, activeIDs, nbActive)
   {
-    for (int iY = -1; iY <= 1; ++iY)
+    const float4 pos = predPos[ID];
+    const FluidParams fluid = getInstanceFluidParams(*fluidShared, instanceParams, INSTANCE_ID(pos));
+    const float4 vorticity = vort[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+    const uint instanceOffset = INSTANCE_ID(pos) * GRID_NUM_CELLS;
+
+    // vorticity confinement
+    float4 n = (float4)(0.0f);
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Removing out of range cells
-        if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
-          continue;
+          // Removing out of range cells
+          if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
+            continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          cellNIndex1D = instanceOffset + (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        startEndN = startEndCell[cellNIndex1D];
+          startEndN = startEndCell[cellNIndex1D];
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          n += fast_length(vort[e]) * gradSpiky(pos - predPos[e], EFFECT_RADIUS);
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            // Vorticity of excluded particles is not computed, they are at rest
+            if (fluid.isSleepingEnabled && restSteps[e] >= SLEEP_EXCLUDED)
+              continue;
+
+            n += fast_length(vort[e]) * gradSpiky(pos - predPos[e], EFFECT_RADIUS);
+          }
         }
       }
     }
-  }
 
-  // Adding vorticity confinement to attenue virtual damping
-  vel[ID] += fluid.vorticityConfCoeff * cross(normalize(n), vorticity) * fluid.timeStep;
+    // Adding vorticity confinement to attenue virtual damping
+    vel[ID] += fluid.vorticityConfCoeff * cross(normalize(n), vorticity) * fluid.timeStep;
+  }
 }
 
 
@@ -381,61 +533,104 @@ __kernel void fld_applyVorticityConfinement(//Input
   Apply xsph viscosity correction
 */
 __kernel void fld_applyXsphViscosityCorrection(//Input
-                                               const __global float4 *predPos,      // 0
-                                               const __global uint2  *startEndCell, // 1
-                                               const __global float4 *velIn,        // 2
+                                               const __global float4 *predPos,        // 0
+                                               const __global uint2  *startEndCell,   // 1
+                                               const __global float4 *velIn,          // 2
                                                //Param
-                                               const     FluidParams fluid,         // 3
+                                               __constant FluidParams *fluidShared,   // 3
+                                               const __global float4 *instanceParams, // 4
                                                //Output
-                                                     __global float4 *velOut)       // 4
+                                                     __global float4 *velOut,         // 5
+                                               //Active particles
+                                               const __global uint   *activeIDs,      // 6
+                                               const __global uint   *nbActive)       // 7
 {
-  const float4 pos = predPos[ID];
-  const float4 velocity = velIn[ID];
-  const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+  FOR_EACH_LISTED_ITEM(fluidShared->isSleepingEnabled, activeIDs, nbActive)
+  {
+    const float4 pos = predPos[ID];
+    const FluidParams fluid = getInstanceFluidParams(*fluidShared, instanceParams, INSTANCE_ID(pos));
+    const float4 velocity = velIn[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+    const uint instanceOffset = INSTANCE_ID(pos) * GRID_NUM_CELLS;
 
-  float4 viscosity = (float4)(0.0f);
+    float4 viscosity = (float4)(0.0f);
 
-  uint cellNIndex1D = 0;
-  int3 cellNIndex3D = (int3)(0);
-  int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
-  uint2 startEndN = (uint2)(0, 0);
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+    uint2 startEndN = (uint2)(0, 0);
 
-  // 27 cells to visit, current one + 3D neighbors
-  for (int iX = -1; iX <= 1; ++iX)
-  {
-    for (int iY = -1; iY <= 1; ++iY)
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1; ++iX)
     {
-      for (int iZ = -1; iZ <= 1; ++iZ)
+      for (int iY = -1; iY <= 1; ++iY)
       {
-        cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+        for (int iZ = -1; iZ <= 1; ++iZ)
+        {
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
 
-        // Removing out of range cells
-        if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
-          continue;
+          // Removing out of range cells
+          if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
+            continue;
 
-        cellNIndex1D = (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+          cellNIndex1D = instanceOffset + (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
 
-        startEndN = startEndCell[cellNIndex1D];
+          startEndN = startEndCell[cellNIndex1D];
 
-        for (uint e = startEndN.x; e <= startEndN.y; ++e)
-        {
-          viscosity += (velIn[e] - velocity) * poly6(pos - predPos[e], EFFECT_RADIUS);
+          for (uint e = startEndN.x; e <= startEndN.y; ++e)
+          {
+            viscosity += (velIn[e] - velocity) * poly6(pos - predPos[e], EFFECT_RADIUS);
+          }
         }
       }
     }
-  }
 
-  // Adding xsph viscosity for a more coherent motion
-  velOut[ID] = velocity + fluid.xsphViscosityCoeff * viscosity;
+    // Adding xsph viscosity for a more coherent motion
+    velOut[ID] = velocity + fluid.xsphViscosityCoeff * viscosity;
+  }
 }
 
 /*
   Apply Bouncing wall boundary conditions on position
 */
-__kernel void fld_applyBoundaryCondition(__global float4 *predPos)
+__kernel void fld_applyBoundaryCondition(         __global float4 *predPos,   // 0
+                                         volatile __global uint   *health,    // 1
+                                         //Param
+                                         __constant FluidParams *fluidParams, // 2
+                                         //Active particles
+                                         const __global uint   *activeIDs,    // 3
+                                         const __global uint   *nbActive,     // 4
+                                         //Health check, only on the first pass of a step
+                                         const uint isHealthChecked)          // 5
 {
-  predPos[ID] = clamp(predPos[ID], (float4)(-ABS_WALL_X + 0.01f, -ABS_WALL_Y + 0.01f, -ABS_WALL_Z + 0.01f, 0.0f)
-                                 , (float4)(ABS_WALL_X - 0.1f, ABS_WALL_Y - 0.1f, ABS_WALL_Z - 0.1f, 0.0f)); //WIP, hack to deal with boundary conditions
+  // Clamped particles are counted per work-group, then added to the global counter with one atomic
+  volatile __local uint nbGroupClamps;
+  if (isHealthChecked)
+  {
+    if (IS_FIRST_LOCAL_ITEM)
+      nbGroupClamps = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  FOR_EACH_LISTED_ITEM(fluidParams->isSleepingEnabled, activeIDs, nbActive)
+  {
+    const float4 pos = predPos[ID];
+    const float3 clampedPos = clamp(pos.xyz, (float3)(-ABS_WALL_X + 0.01f, -ABS_WALL_Y + 0.01f, -ABS_WALL_Z + 0.01f)
+                                           , (float3)(ABS_WALL_X - 0.1f, ABS_WALL_Y - 0.1f, ABS_WALL_Z - 0.1f)); //WIP, hack to deal with boundary conditions
+
+    if (isHealthChecked && any(clampedPos != pos.xyz))
+      atomic_inc(&nbGroupClamps);
+
+    // w coordinate stores the instance ID in ensemble mode, it must be kept
+    predPos[ID] = (float4)(clampedPos, pos.w);
+  }
+
+  if (isHealthChecked)
+  {
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (IS_FIRST_LOCAL_ITEM && nbGroupClamps > 0)
+      atomic_add(&health[HEALTH_WALL_CLAMPED], nbGroupClamps);
+  }
 }
 
 /*
@@ -443,10 +638,299 @@ __kernel void fld_applyBoundaryCondition(__global float4 *predPos)
 */
 __kernel void fld_updatePosition(//Input
                                  const  __global float4 *predPos, // 0
+                                 //Param
+                                 __constant FluidParams *fluidParams, // 1
+                                 //Output
+                                        __global float4 *pos,     // 2
+                                 //Active particles
+                                 const __global uint   *activeIDs, // 3
+                                 const __global uint   *nbActive)  // 4
+{
+  FOR_EACH_LISTED_ITEM(fluidParams->isSleepingEnabled, activeIDs, nbActive)
+  {
+    pos[ID] = predPos[ID];
+  }
+}
+
+/*
+  Reset activity of cells, before sleeping particles are excluded
+*/
+__kernel void fld_resetCellActivity(__global uint *cellIsActive) // 0
+{
+  FOR_EACH_ITEM
+  {
+    cellIsActive[ID] = 0;
+  }
+}
+
+/*
+  Flag the cells holding at least one particle which is not asleep
+  Using current positions, as particles are excluded before their position is predicted
+*/
+__kernel void fld_fillCellActivity(//Input
+                                   const __global float4 *pos,          // 0
+                                   const __global float  *restSteps,    // 1
+                                   //Output
+                                         __global uint   *cellIsActive) // 2
+{
+  FOR_EACH_ITEM
+  {
+    if (restSteps[ID] >= SLEEP_STEPS)
+      continue;
+
+    const float4 position = pos[ID];
+    const uint cell1DIndex = getCell1DIndexFromPos(position);
+
+    if (cell1DIndex < GRID_NUM_CELLS)
+      cellIsActive[INSTANCE_ID(position) * GRID_NUM_CELLS + cell1DIndex] = 1;
+  }
+}
+
+/*
+  Exclude sleeping particles without any active cell among their 27 neighbor cells
+  Others are woken up if excluded at previous step, being asleep until they move again
+*/
+__kernel void fld_excludeSleepingParticles(//Input
+                                           const __global float4 *pos,          // 0
+                                           const __global uint   *cellIsActive, // 1
+                                           //Output
+                                                 __global float  *restSteps,    // 2
+                                                 __global float4 *vel)          // 3
+{
+  FOR_EACH_ITEM
+  {
+    if (restSteps[ID] < SLEEP_STEPS)
+      continue;
+
+    const float4 position = pos[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(position));
+    const uint instanceOffset = INSTANCE_ID(position) * GRID_NUM_CELLS;
+
+    bool isNextToActiveCell = false;
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1 && !isNextToActiveCell; ++iX)
+    {
+      for (int iY = -1; iY <= 1 && !isNextToActiveCell; ++iY)
+      {
+        for (int iZ = -1; iZ <= 1 && !isNextToActiveCell; ++iZ)
+        {
+          cellNIndex3D = cellIndex3D + (int3)(iX, iY, iZ);
+
+          // Removing out of range cells
+          if(any(cellNIndex3D < (int3)(0)) || any(cellNIndex3D >= (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z)))
+            continue;
+
+          cellNIndex1D = instanceOffset + (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+
+          isNextToActiveCell = (cellIsActive[cellNIndex1D] != 0);
+        }
+      }
+    }
+
+    if (isNextToActiveCell)
+    {
+      restSteps[ID] = SLEEP_STEPS;
+    }
+    else
+    {
+      restSteps[ID] = SLEEP_EXCLUDED;
+      // Read as neighbor velocity by vorticity and viscosity
+      vel[ID] = (float4)(0.0f);
+    }
+  }
+}
+
+/*
+  Append particles which are not excluded to the list the step is dispatched over
+  Particles are sorted by cell at this point, list is only locally ordered as it is filled by atomics
+*/
+__kernel void fld_fillActiveList(//Input
+                                 const __global float *restSteps,   // 0
                                  //Output
-                                        __global float4 *pos)     // 1
+                                 volatile __global uint *nbActive,  // 1
+                                       __global uint  *activeIDs,   // 2
+                                       __global float *constFactor) // 3
+{
+  FOR_EACH_ITEM
+  {
+    if (restSteps[ID] < SLEEP_EXCLUDED)
+      activeIDs[atomic_inc(nbActive)] = ID;
+    else
+      // Read as neighbor constraint factor by the correction
+      constFactor[ID] = 0.0f;
+  }
+}
+
+/*
+  Count the steps each active particle has been quiet for, moving particles being reset
+*/
+__kernel void fld_updateRestSteps(//Input
+                                  const __global float4 *predPos,        // 0
+                                  const __global float4 *vel,            // 1
+                                  const __global float  *density,        // 2
+                                  //Param
+                                  __constant FluidParams *fluidShared,   // 3
+                                  const __global float4 *instanceParams, // 4
+                                  //Output
+                                        __global float  *restSteps,      // 5
+                                  //Active particles
+                                  const __global uint   *activeIDs,      // 6
+                                  const __global uint   *nbActive)       // 7
 {
-  pos[ID] = predPos[ID];
+  FOR_EACH_LISTED_ITEM(true, activeIDs, nbActive)
+  {
+    const FluidParams fluid = getInstanceFluidParams(*fluidShared, instanceParams, INSTANCE_ID(predPos[ID]));
+
+    // Only compression is an error, density is lower than rest one on the surface
+    const float densityError = fmax(density[ID] / fluid.restDensity - 1.0f, 0.0f);
+    const bool isQuiet = (fast_length(vel[ID].xyz) < SLEEP_SPEED) && (densityError < SLEEP_DENSITY_ERROR);
+
+    restSteps[ID] = isQuiet ? fmin(restSteps[ID] + 1.0f, SLEEP_STEPS) : 0.0f;
+  }
+}
+
+/*
+  Wake up all particles, a rest step count being meaningless once they have been moved by the host
+*/
+__kernel void fld_wakeParticles(__global float *restSteps) // 0
+{
+  FOR_EACH_ITEM
+  {
+    restSteps[ID] = 0.0f;
+  }
+}
+
+/*
+  Reset cells holding constrained particles and the counts of the lists, at each Jacobi iteration
+*/
+__kernel void fld_resetConstrainedCells(__global uint *cellIsConstrained, // 0
+                                        __global uint *nbConstrained,     // 1
+                                        __global uint *nbCorrected)       // 2
+{
+  FOR_EACH_ITEM
+  {
+    cellIsConstrained[ID] = 0;
+
+    if (ID == 0)
+    {
+      *nbConstrained = 0;
+      *nbCorrected = 0;
+    }
+  }
+}
+
+/*
+  Unilateral density constraint, only compressed particles are constrained
+  Append them to the list the constraint factor is computed over, and flag their cell
+  Constraint factor of the others is null
+*/
+__kernel void fld_fillConstrainedList(//Input
+                                      const __global float  *density,           // 0
+                                      const __global float4 *predPos,           // 1
+                                      const __global uint   *cellID,            // 2
+                                      //Param
+                                      __constant FluidParams *fluidShared,      // 3
+                                      const __global float4 *instanceParams,    // 4
+                                      //Output
+                                      volatile __global uint *nbConstrained,    // 5
+                                            __global uint   *constrainedIDs,    // 6
+                                            __global uint   *cellIsConstrained, // 7
+                                            __global float  *constFactor,       // 8
+                                      //Active particles
+                                      const __global uint   *activeIDs,         // 9
+                                      const __global uint   *nbActive)          // 10
+{
+  FOR_EACH_LISTED_ITEM(fluidShared->isSleepingEnabled, activeIDs, nbActive)
+  {
+    const FluidParams fluid = getInstanceFluidParams(*fluidShared, instanceParams, INSTANCE_ID(predPos[ID]));
+
+    if (density[ID] >= fluid.restDensity)
+    {
+      constrainedIDs[atomic_inc(nbConstrained)] = ID;
+
+      if (cellID[ID] < GRID_NUM_CELLS * NUM_INSTANCES)
+        cellIsConstrained[cellID[ID]] = 1;
+    }
+    else
+    {
+      constFactor[ID] = 0.0f;
+    }
+  }
+}
+
+/*
+  Flag the cells holding particles with a constraint factor carried from the previous step
+  Warm-started correction is then dispatched over their neighbors as in unilateral mode
+*/
+__kernel void fld_flagWarmStartedCells(//Input
+                                       const __global float *constFactor,       // 0
+                                       const __global uint  *cellID,            // 1
+                                       //Param
+                                       __constant FluidParams *fluidParams,     // 2
+                                       //Output
+                                             __global uint  *cellIsConstrained, // 3
+                                       //Active particles
+                                       const __global uint  *activeIDs,         // 4
+                                       const __global uint  *nbActive)          // 5
+{
+  FOR_EACH_LISTED_ITEM(fluidParams->isSleepingEnabled, activeIDs, nbActive)
+  {
+    if (constFactor[ID] != 0.0f && cellID[ID] < GRID_NUM_CELLS * NUM_INSTANCES)
+      cellIsConstrained[cellID[ID]] = 1;
+  }
+}
+
+/*
+  Append particles with a constrained particle among their neighbors to the list the correction is computed over
+  Using the same 27 cells as the correction, the others are not moved by the constraint
+*/
+__kernel void fld_fillCorrectedList(//Input
+                                    const __global float4 *predPos,           // 0
+                                    const __global uint   *cellIsConstrained, // 1
+                                    //Param
+                                    __constant FluidParams *fluidParams,      // 2
+                                    //Output
+                                    volatile __global uint *nbCorrected,      // 3
+                                          __global uint   *correctedIDs,      // 4
+                                    //Active particles
+                                    const __global uint   *activeIDs,         // 5
+                                    const __global uint   *nbActive)          // 6
+{
+  FOR_EACH_LISTED_ITEM(fluidParams->isSleepingEnabled, activeIDs, nbActive)
+  {
+    const float4 pos = predPos[ID];
+    const int3 cellIndex3D = convert_int3(getCell3DIndexFromPos(pos));
+    const uint instanceOffset = INSTANCE_ID(pos) * GRID_NUM_CELLS;
+
+    bool isNextToConstrainedCell = false;
+
+    uint cellNIndex1D = 0;
+    int3 cellNIndex3D = (int3)(0);
+    int3 gridResXYZ = (int3)(GRID_RES_X, GRID_RES_Y, GRID_RES_Z);
+
+    // 27 cells to visit, current one + 3D neighbors
+    for (int iX = -1; iX <= 1 && !isNextToConstrainedCell; ++iX)
+    {
+      for (int iY = -1; iY <= 1 && !isNextToConstrainedCell; ++iY)
+      {
+        for (int iZ = -1; iZ <= 1 && !isNextToConstrainedCell; ++iZ)
+        {
+          cellNIndex3D = (cellIndex3D + (int3)(iX, iY, iZ) + gridResXYZ) % gridResXYZ;
+
+          cellNIndex1D = instanceOffset + (cellNIndex3D.x * GRID_RES_Y + cellNIndex3D.y) * GRID_RES_Z + cellNIndex3D.z;
+
+          isNextToConstrainedCell = (cellIsConstrained[cellNIndex1D] != 0);
+        }
+      }
+    }
+
+    if (isNextToConstrainedCell)
+      correctedIDs[atomic_inc(nbCorrected)] = ID;
+  }
 }
 
 /*
@@ -458,22 +942,27 @@ __kernel void fld_updatePosition(//Input
 __kernel void fld_fillFluidColor(//Input
                                  const  __global float  *density, // 0
                                  //Param
-                                 const      FluidParams fluid,    // 1
+                                 __constant FluidParams *fluidParams, // 1
                                  //Output
                                         __global float4 *col)     // 2
 {
-  float4 blue      = (float4)(0.0f, 0.1f, 1.0f, 0.5f);
-  float4 lightBlue = (float4)(0.7f, 0.7f, 1.0f, 0.5f);
-  float4 darkBlue  = (float4)(0.0f, 0.0f, 0.8f, 0.5f);
+  const FluidParams fluid = *fluidParams;
 
-  float constraint = (1.0f - density[ID] / fluid.restDensity);
+  FOR_EACH_ITEM
+  {
+    float4 blue      = (float4)(0.0f, 0.1f, 1.0f, 0.5f);
+    float4 lightBlue = (float4)(0.7f, 0.7f, 1.0f, 0.5f);
+    float4 darkBlue  = (float4)(0.0f, 0.0f, 0.8f, 0.5f);
+
+    float constraint = (1.0f - density[ID] / fluid.restDensity);
 
-  float4 color = blue;
+    float4 color = blue;
 
-  if(constraint > 0.0f)
-    color += constraint * (lightBlue - blue) / 0.35f;
-  else if(constraint < 0.0f)
-    color += constraint * (blue - darkBlue) / 0.35f;
+    if(constraint > 0.0f)
+      color += constraint * (lightBlue - blue) / 0.35f;
+    else if(constraint < 0.0f)
+      color += constraint * (blue - darkBlue) / 0.35f;
 
-  col[ID] = color;
+    col[ID] = color;
+  }
 }
\ No newline at end of file
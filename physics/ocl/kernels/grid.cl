@@ -3,7 +3,7 @@
 // GRID_RES_X                - resolution of the grid
 // GRID_CELL_SIZE_XYZ          - size of a cell, size / res of grid
 // GRID_NUM_CELLS          - total number of cells in the grid
-// NUM_MAX_PARTS_IN_CELL   - maximum number of particles taking into account in a single cell in simplified mode
+// NUM_INSTANCES           - number of instances sharing the buffers in ensemble mode, each one with its own set of cells
 
 // Most defines are in define.cl
 // define.cl must be included as first file.cl to create OpenCL program
@@ -42,7 +42,10 @@ inline uint getCell1DIndexFromPos(float4 pos)
 */
 __kernel void resetGridDetector(__global float8* gridDetector)
 {
-  gridDetector[ID] = (float8)(0.0f);
+  FOR_EACH_ITEM
+  {
+    gridDetector[ID] = (float8)(0.0f);
+  }
 }
 
 /*
@@ -51,12 +54,15 @@ __kernel void resetGridDetector(__global float8* gridDetector)
 __kernel void fillGridDetector(__global float4 *pPos,
                                __global float8 *gridDetector)
 {
-  const float4 pos = pPos[ID];
+  FOR_EACH_ITEM
+  {
+    const float4 pos = pPos[ID];
 
-  const uint gridDetectorIndex = getCell1DIndexFromPos(pos);
+    const uint gridDetectorIndex = getCell1DIndexFromPos(pos);
 
-  if (gridDetectorIndex < GRID_NUM_CELLS)
-    gridDetector[gridDetectorIndex] = 1.0f;
+    if (gridDetectorIndex < GRID_NUM_CELLS)
+      gridDetector[gridDetectorIndex] = 1.0f;
+  }
 }
 
 /*
@@ -64,10 +70,13 @@ __kernel void fillGridDetector(__global float4 *pPos,
 */
 __kernel void resetCellIDs(__global uint *pCellID)
 {
-  // For all particles, giving cell ID above any available one
-  // the ones not filled later (i.e not processed because index > nbParticles displayed)
-  // will be sorted at the end and not considered after sorting
-  pCellID[ID] = GRID_NUM_CELLS * 2 + ID;
+  FOR_EACH_ITEM
+  {
+    // For all particles, giving cell ID above any available one
+    // the ones not filled later (i.e not processed because index > nbParticles displayed)
+    // will be sorted at the end and not considered after sorting
+    pCellID[ID] = GRID_NUM_CELLS * NUM_INSTANCES * 2 + ID;
+  }
 }
 
 /*
@@ -78,11 +87,15 @@ __kernel void fillCellIDs(//Input
                           //Output
                                 __global uint   *pCellID)
 {
-  const float4 pos = pPos[ID];
+  FOR_EACH_ITEM
+  {
+    const float4 pos = pPos[ID];
 
-  const uint cell1DIndex = getCell1DIndexFromPos(pos);
+    const uint cell1DIndex = getCell1DIndexFromPos(pos);
 
-  pCellID[ID] = cell1DIndex;
+    // In ensemble mode, each instance has its own range of cells
+    pCellID[ID] = INSTANCE_ID(pos) * GRID_NUM_CELLS + cell1DIndex;
+  }
 }
 
 /*
@@ -90,9 +103,12 @@ __kernel void fillCellIDs(//Input
 */
 __kernel void resetStartEndCell(__global uint2 *cStartEndPartID)
 {
-  // Resetting with 1 as starting index and 0 as ending index
-  // Little hack to bypass empty cell further
-  cStartEndPartID[ID] = (uint2)(1, 0);
+  FOR_EACH_ITEM
+  {
+    // Resetting with 1 as starting index and 0 as ending index
+    // Little hack to bypass empty cell further
+    cStartEndPartID[ID] = (uint2)(1, 0);
+  }
 }
 
 /*
@@ -103,15 +119,18 @@ __kernel void fillStartCell(//Input
                             //Output
                                   __global uint2 *cStartEndPartID)
 {
-  const uint currentCellID = pCellID[ID];
-
-  if (ID > 0 && currentCellID < GRID_NUM_CELLS)
+  FOR_EACH_ITEM
   {
-    uint leftCellID = pCellID[ID - 1];
-    if (currentCellID != leftCellID)
+    const uint currentCellID = pCellID[ID];
+
+    if (ID > 0 && currentCellID < GRID_NUM_CELLS * NUM_INSTANCES)
     {
-      // Found start
-      cStartEndPartID[currentCellID].x = ID;
+      uint leftCellID = pCellID[ID - 1];
+      if (currentCellID != leftCellID)
+      {
+        // Found start
+        cStartEndPartID[currentCellID].x = ID;
+      }
     }
   }
 }
@@ -124,29 +143,39 @@ __kernel void fillEndCell(//Input
                           //Output
                                 __global uint2 *cStartEndPartID)
 {
-  const uint currentCellID = pCellID[ID];
-
-  if (ID != get_global_size(0) && currentCellID < GRID_NUM_CELLS)
+  FOR_EACH_ITEM
   {
-    const uint rightCellID = pCellID[ID + 1];
-    if (currentCellID != rightCellID)
+    const uint currentCellID = pCellID[ID];
+
+    if (currentCellID < GRID_NUM_CELLS * NUM_INSTANCES)
     {
-      // Found end
-      cStartEndPartID[currentCellID].y = ID;
+      const uint rightCellID = pCellID[ID + 1];
+      if (currentCellID != rightCellID)
+      {
+        // Found end
+        cStartEndPartID[currentCellID].y = ID;
+      }
     }
   }
 }
 
 /* 
   Adjust last partID for each cell, capping it with max number of parts in cell in simplified mode.
+  The cap is a kernel argument so that it can be tuned at runtime without rebuilding the program.
 */
-__kernel void adjustEndCell(__global uint2 *cStartEndPartID)
+__kernel void adjustEndCell(//Param
+                            const uint maxNbPartsInCell,
+                            //Output
+                            __global uint2 *cStartEndPartID)
 {
-  const uint2 startEnd = cStartEndPartID[ID];
-
-  if (startEnd.y > startEnd.x)
+  FOR_EACH_ITEM
   {
-    const uint newEnd = startEnd.x + min(startEnd.y - startEnd.x, (uint)NUM_MAX_PARTS_IN_CELL);
-    cStartEndPartID[ID] = (uint2)(startEnd.x, newEnd);
+    const uint2 startEnd = cStartEndPartID[ID];
+
+    if (startEnd.y > startEnd.x)
+    {
+      const uint newEnd = startEnd.x + min(startEnd.y - startEnd.x, maxNbPartsInCell);
+      cStartEndPartID[ID] = (uint2)(startEnd.x, newEnd);
+    }
   }
 }
@@ -0,0 +1,58 @@
+// Preprocessor defines following constant variables in Statistics.cpp
+// _GROUPS           - number of work groups, one partial reduction each
+// _ITEMS            - number of work items per group, power of two
+
+/*
+  Partial reduction of particle statistics, one per work group, finished on host
+  x: sum of density errors |1 - density / restDensity|
+  y: sum of kinetic energies per unit mass
+  z: max speed
+  w: number of particles holding cloud droplets
+  Work items loop over particles with a stride of the global size, density and thermo can be null
+*/
+__kernel void reduceStats(//Input
+                          const __global float4 *vel,          // 0
+                          const __global float  *density,      // 1
+                          const __global float4 *thermo,       // 2
+                          //Param
+                          const          float   restDensity,  // 3
+                          const          uint    nbParticles,  // 4
+                          //Output
+                                __global float4 *partialStats, // 5
+                          //Local
+                                __local  float4 *localStats)   // 6
+{
+  float4 stats = (float4)(0.0f);
+
+  for (uint i = get_global_id(0); i < nbParticles; i += get_global_size(0))
+  {
+    const float speed = fast_length(vel[i].xyz);
+    stats.y += 0.5f * speed * speed;
+    stats.z = fmax(stats.z, speed);
+
+    if (density)
+      stats.x += fabs(1.0f - density[i] / restDensity);
+
+    // z coordinate stores cloud droplets density
+    if (thermo && thermo[i].z > 0.0f)
+      stats.w += 1.0f;
+  }
+
+  const uint item = get_local_id(0);
+  localStats[item] = stats;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for (uint offset = _ITEMS / 2; offset > 0; offset /= 2)
+  {
+    if (item < offset)
+    {
+      const float4 other = localStats[item + offset];
+      stats = localStats[item];
+      localStats[item] = (float4)(stats.xy + other.xy, fmax(stats.z, other.z), stats.w + other.w);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  if (item == 0)
+    partialStats[get_group_id(0)] = localStats[0];
+}
@@ -34,7 +34,21 @@ inline float3 genRandomNormalizedFloat3(unsigned int i)
 */
 __kernel void resetCameraDist(__global uint *cameraDist)
 {
-  cameraDist[ID] = (uint)(FAR_DIST);
+  FOR_EACH_ITEM
+  {
+    cameraDist[ID] = (uint)(FAR_DIST);
+  }
+}
+
+/*
+  Reset float buffer, for values carried across steps
+*/
+__kernel void resetFloat(__global float *values)
+{
+  FOR_EACH_ITEM
+  {
+    values[ID] = 0.0f;
+  }
 }
 
 /*
@@ -46,9 +60,12 @@ __kernel void fillCameraDist(//Input
                              //Output
                                    __global uint   *cameraDist)   // 2
 {
-  // Hack to be able to sort the cameraDist buffer using radix sort with closest particles coming last to be drawn on top using blending
-  // We multiply squared length by 100 to have more precision before switching to uint
-  cameraDist[ID] = (uint)(max(FAR_DIST - length(pos[ID].xyz - cameraPos[0].xyz) * 100.0f, 0.0f));
+  FOR_EACH_ITEM
+  {
+    // Hack to be able to sort the cameraDist buffer using radix sort with closest particles coming last to be drawn on top using blending
+    // We multiply squared length by 100 to have more precision before switching to uint
+    cameraDist[ID] = (uint)(max(FAR_DIST - length(pos[ID].xyz - cameraPos[0].xyz) * 100.0f, 0.0f));
+  }
 }
 
 /*
@@ -56,7 +73,10 @@ __kernel void fillCameraDist(//Input
 */
 __kernel void infPosVerts(__global float4 *pos)
 {
-  pos[ID] = (float4)(FAR_DIST, FAR_DIST, FAR_DIST, 0.0f);
+  FOR_EACH_ITEM
+  {
+    pos[ID] = (float4)(FAR_DIST, FAR_DIST, FAR_DIST, 0.0f);
+  }
 }
 
 /*
@@ -70,9 +90,32 @@ __kernel void fillColorFloat(//Input
                             //Output
                                     __global float4 *col)  // 3
 {
-  float val = (physicalQuantity[ID] - minVal) / (maxVal - minVal);
-  val *= step(0.0f, val);
-  val *= step(val, 1.0f);
-  //col[ID] = (float4)(val, 0.0f, 0.3f, 1.0f);
-  col[ID] = (float4)(val, val, val, val);
-}
\ No newline at end of file
+  FOR_EACH_ITEM
+  {
+    float val = (physicalQuantity[ID] - minVal) / (maxVal - minVal);
+    val *= step(0.0f, val);
+    val *= step(val, 1.0f);
+    //col[ID] = (float4)(val, 0.0f, 0.3f, 1.0f);
+    col[ID] = (float4)(val, val, val, val);
+  }
+}
+/*
+  Fill color buffer with one component of a packed float4 physical buffer for display and analysis
+*/
+__kernel void fillColorFloat4(//Input
+                              const  __global float  *physicalQuantity, // 0
+                             //Param
+                              const           uint  component, // 1
+                              const           float minVal,    // 2
+                              const           float maxVal,    // 3
+                             //Output
+                                     __global float4 *col)     // 4
+{
+  FOR_EACH_ITEM
+  {
+    float val = (physicalQuantity[4 * ID + component] - minVal) / (maxVal - minVal);
+    val *= step(0.0f, val);
+    val *= step(val, 1.0f);
+    col[ID] = (float4)(val, val, val, val);
+  }
+}
@@ -19,18 +19,45 @@ using namespace Physics;
 #define KERNEL_REORDER "reorder"
 #define KERNEL_PERMUTATE_FLOAT4 "permutateFloat4"
 #define KERNEL_PERMUTATE_FLOAT "permutateFloat"
+#define KERNEL_PERMUTATE_UINT "permutateInt"
 
-RadixSort::RadixSort(size_t numEntities)
-    : m_numEntities(numEntities)
-    , m_numRadix(256)
-    , m_numRadixBits(8)
+#define NUM_RADIX 256
+#define NUM_RADIX_BITS 8
+#define NUM_GROUPS 128
+#define NUM_ITEMS 4
+
+namespace
+{
+std::string ProgramBuildOptions()
+{
+  std::ostringstream clBuildOptions;
+  clBuildOptions << " -D_RADIX=" << NUM_RADIX;
+  clBuildOptions << " -D_BITS=" << NUM_RADIX_BITS;
+  clBuildOptions << " -D_GROUPS=" << NUM_GROUPS;
+  clBuildOptions << " -D_ITEMS=" << NUM_ITEMS;
+  if (sizeof(void*) < 8)
+  {
+    clBuildOptions << " -DHOST_PTR_IS_32bit";
+  }
+
+  return clBuildOptions.str();
+}
+}
+
+RadixSort::RadixSort(const std::string& nameSpace, size_t numEntities)
+    : m_namespace(nameSpace)
+    , m_numEntities(numEntities)
+    , m_numRadix(NUM_RADIX)
+    , m_numRadixBits(NUM_RADIX_BITS)
     , m_numTotalBits(32)
-    , m_numGroups(128)
-    , m_numItems(4)
+    , m_numGroups(NUM_GROUPS)
+    , m_numItems(NUM_ITEMS)
     , m_histoSplit(256)
 {
   m_numRadixPasses = m_numTotalBits / m_numRadixBits;
 
+  CL::Context::NamespaceGuard namespaceGuard(CL::Context::Get(), m_namespace);
+
   if (m_numEntities % (m_numGroups * m_numItems) != 0)
     LOG_ERROR("Radix sort not supporting arrays of size {}, only ones whose size is multiple of {} ", m_numEntities, m_numGroups * m_numItems);
 
@@ -55,21 +82,16 @@ RadixSort::RadixSort(size_t numEntities)
   LOG_INFO("Radix sort correctly initialized");
 }
 
+void RadixSort::PrebuildProgram()
+{
+  CL::Context::Get().prebuildProgram({ "radixSort.cl" }, ProgramBuildOptions());
+}
+
 bool RadixSort::createProgram() const
 {
   CL::Context& clContext = CL::Context::Get();
 
-  std::ostringstream clBuildOptions;
-  clBuildOptions << " -D_RADIX=" << m_numRadix;
-  clBuildOptions << " -D_BITS=" << m_numRadixBits;
-  clBuildOptions << " -D_GROUPS=" << m_numGroups;
-  clBuildOptions << " -D_ITEMS=" << m_numItems;
-  if (sizeof(void*) < 8)
-  {
-    clBuildOptions << " -DHOST_PTR_IS_32bit";
-  }
-
-  if (!clContext.createProgram(PROGRAM_RADIXSORT, "radixSort.cl", clBuildOptions.str()))
+  if (!clContext.createProgram(PROGRAM_RADIXSORT, "radixSort.cl", ProgramBuildOptions()))
     return false;
 
   return true;
@@ -79,6 +101,8 @@ bool RadixSort::createBuffers() const
 {
   CL::Context& clContext = CL::Context::Get();
 
+  clContext.beginArena("RadixSortArena");
+
   clContext.createBuffer("RadixSortKeysTemp", sizeof(unsigned int) * m_numEntities, CL_MEM_READ_WRITE);
 
   clContext.createBuffer("RadixSortHistogram", sizeof(unsigned int) * m_numRadix * m_numGroups * m_numItems, CL_MEM_READ_WRITE);
@@ -89,10 +113,12 @@ bool RadixSort::createBuffers() const
   clContext.createBuffer("RadixSortIndices", sizeof(unsigned int) * m_numEntities, CL_MEM_READ_WRITE);
   clContext.createBuffer("RadixSortIndicesTemp", sizeof(unsigned int) * m_numEntities, CL_MEM_READ_WRITE);
 
-  clContext.createBuffer("RadixSortPermutateTempFloat4", 4 * sizeof(float) * m_numEntities, CL_MEM_READ_WRITE);
-  clContext.createBuffer("RadixSortPermutateTempFloat", sizeof(float) * m_numEntities, CL_MEM_READ_WRITE);
+  // Float4, float and uint permutations are never run at the same time, they share the same temporary memory
+  clContext.createBuffer("RadixSortPermutateTempFloat4", 4 * sizeof(float) * m_numEntities, CL_MEM_READ_WRITE, "RadixSortPermutateTemp");
+  clContext.createBuffer("RadixSortPermutateTempFloat", sizeof(float) * m_numEntities, CL_MEM_READ_WRITE, "RadixSortPermutateTemp");
+  clContext.createBuffer("RadixSortPermutateTempUint", sizeof(unsigned int) * m_numEntities, CL_MEM_READ_WRITE, "RadixSortPermutateTemp");
 
-  return true;
+  return clContext.endArena();
 }
 
 bool RadixSort::createKernels() const
@@ -116,17 +142,20 @@ bool RadixSort::createKernels() const
 
   clContext.createKernel(PROGRAM_RADIXSORT, KERNEL_PERMUTATE_FLOAT4, { "RadixSortIndices" });
   clContext.createKernel(PROGRAM_RADIXSORT, KERNEL_PERMUTATE_FLOAT, { "RadixSortIndices" });
+  clContext.createKernel(PROGRAM_RADIXSORT, KERNEL_PERMUTATE_UINT, { "RadixSortIndices" });
   return true;
 }
 
 void RadixSort::sort(const std::string& inputKeyBufferName,
     const std::vector<std::string>& optionalInputBufferNamesFloat4,
-    const std::vector<std::string>& optionalInputBufferNamesFloat)
+    const std::vector<std::string>& optionalInputBufferNamesFloat,
+    const std::vector<std::string>& optionalInputBufferNamesUint)
 {
   // First sorting main input key buffer
   // Then sorting optional input buffers based on indices permutation of the main input key buffer
 
   CL::Context& clContext = CL::Context::Get();
+  CL::Context::NamespaceGuard namespaceGuard(clContext, m_namespace);
 
   size_t totalScan = m_numRadix * m_numGroups * m_numItems / 2;
   size_t localScan = totalScan / m_histoSplit;
@@ -187,4 +216,18 @@ void RadixSort::sort(const std::string& inputKeyBufferName,
     clContext.setKernelArg(KERNEL_PERMUTATE_FLOAT, 2, bufferToPermutateFloat);
     clContext.runKernel(KERNEL_PERMUTATE_FLOAT, m_numEntities);
   }
+
+  // Uint
+  for (const auto& bufferToPermutateUint : optionalInputBufferNamesUint)
+  {
+    if (!clContext.copyBuffer(bufferToPermutateUint, "RadixSortPermutateTempUint"))
+    {
+      LOG_ERROR("Cannot sort {}", bufferToPermutateUint);
+      continue;
+    }
+
+    clContext.setKernelArg(KERNEL_PERMUTATE_UINT, 1, "RadixSortPermutateTempUint");
+    clContext.setKernelArg(KERNEL_PERMUTATE_UINT, 2, bufferToPermutateUint);
+    clContext.runKernel(KERNEL_PERMUTATE_UINT, m_numEntities);
+  }
 }
\ No newline at end of file
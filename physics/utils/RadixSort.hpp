@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <string>
 #include <vector>
 
 #include <algorithm>
@@ -36,18 +37,25 @@ auto makeRng(T upperBound)
 class RadixSort
 {
   public:
-  RadixSort(size_t numEntities);
+  // OpenCL resources of the sort are scoped by the given namespace, whichever one is current when it is used
+  RadixSort(const std::string& nameSpace, size_t numEntities);
   ~RadixSort() = default;
 
+  // Build the program in background, it does not depend on the number of entities
+  static void PrebuildProgram();
+
   void sort(const std::string& inputKeyBufferName,
       const std::vector<std::string>& optionalInputBufferNamesFloat4 = {},
-      const std::vector<std::string>& optionalInputBufferNamesFloat = {});
+      const std::vector<std::string>& optionalInputBufferNamesFloat = {},
+      const std::vector<std::string>& optionalInputBufferNamesUint = {});
 
   private:
   bool createProgram() const;
   bool createBuffers() const;
   bool createKernels() const;
 
+  std::string m_namespace;
+
   size_t m_numEntities;
 
   unsigned int m_numRadix;
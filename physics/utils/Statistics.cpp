@@ -0,0 +1,178 @@
+#include "Statistics.hpp"
+
+#include "../ocl/Context.hpp"
+
+#include "Logging.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace Physics;
+
+#define PROGRAM_STATISTICS "Statistics"
+
+#define KERNEL_REDUCE_STATS "reduceStats"
+
+// Number of partial reductions finished on host, and size of the work groups computing them
+#define NB_STATS_GROUPS 64
+#define NB_STATS_ITEMS 64
+// Read backs in flight at the same time, the device being a few updates ahead of the host at most
+#define NB_STATS_SLOTS 4
+// Number of updates kept for plotting
+#define STATS_HISTORY_SIZE 256
+
+namespace
+{
+std::string ProgramBuildOptions()
+{
+  std::ostringstream clBuildOptions;
+  clBuildOptions << " -D_GROUPS=" << NB_STATS_GROUPS;
+  clBuildOptions << " -D_ITEMS=" << NB_STATS_ITEMS;
+
+  return clBuildOptions.str();
+}
+}
+
+Statistics::Statistics(const std::string& nameSpace, const std::string& velBufferName, const std::string& densityBufferName, const std::string& thermoBufferName)
+    : m_namespace(nameSpace)
+    , m_slots(NB_STATS_SLOTS)
+    , m_nextSlot(0)
+    , m_nbUpdates(0)
+    , m_hasDensity(!densityBufferName.empty())
+    , m_hasThermo(!thermoBufferName.empty())
+    , m_init(false)
+{
+  for (auto& slot : m_slots)
+  {
+    slot.partialStats.resize(NB_STATS_GROUPS);
+    slot.isReady = std::make_shared<std::atomic<bool>>(false);
+  }
+
+  CL::Context::NamespaceGuard namespaceGuard(CL::Context::Get(), m_namespace);
+
+  if (!createProgram())
+  {
+    LOG_ERROR("Failed to initialize statistics program");
+    return;
+  }
+
+  if (!createBuffers())
+  {
+    LOG_ERROR("Failed to initialize statistics buffers");
+    return;
+  }
+
+  if (!createKernels(velBufferName, densityBufferName, thermoBufferName))
+  {
+    LOG_ERROR("Failed to initialize statistics kernels");
+    return;
+  }
+
+  m_init = true;
+}
+
+void Statistics::PrebuildProgram()
+{
+  CL::Context::Get().prebuildProgram({ "statistics.cl" }, ProgramBuildOptions());
+}
+
+bool Statistics::createProgram() const
+{
+  CL::Context& clContext = CL::Context::Get();
+
+  return clContext.createProgram(PROGRAM_STATISTICS, "statistics.cl", ProgramBuildOptions());
+}
+
+bool Statistics::createBuffers() const
+{
+  CL::Context& clContext = CL::Context::Get();
+
+  return clContext.createBuffer("s_partialStats", 4 * sizeof(float) * NB_STATS_GROUPS, CL_MEM_READ_WRITE);
+}
+
+bool Statistics::createKernels(const std::string& velBufferName, const std::string& densityBufferName, const std::string& thermoBufferName) const
+{
+  CL::Context& clContext = CL::Context::Get();
+
+  if (!clContext.createKernel(PROGRAM_STATISTICS, KERNEL_REDUCE_STATS, { velBufferName, densityBufferName, thermoBufferName, "", "", "s_partialStats" }))
+    return false;
+
+  // Missing buffers are passed as null pointers
+  if (!m_hasDensity)
+    clContext.setKernelArg(KERNEL_REDUCE_STATS, 1, sizeof(cl_mem), nullptr);
+  if (!m_hasThermo)
+    clContext.setKernelArg(KERNEL_REDUCE_STATS, 2, sizeof(cl_mem), nullptr);
+
+  clContext.setKernelArg(KERNEL_REDUCE_STATS, 6, 4 * sizeof(float) * NB_STATS_ITEMS, nullptr);
+
+  return true;
+}
+
+void Statistics::record(size_t nbParticles, float restDensity)
+{
+  if (!m_init)
+    return;
+
+  collect();
+
+  const size_t update = m_nbUpdates++;
+
+  Slot& slot = m_slots[m_nextSlot];
+  if (slot.isInFlight)
+    return;
+
+  CL::Context& clContext = CL::Context::Get();
+  CL::Context::NamespaceGuard namespaceGuard(clContext, m_namespace);
+
+  const cl_uint nbParts = (cl_uint)nbParticles;
+  clContext.setKernelArg(KERNEL_REDUCE_STATS, 3, sizeof(float), &restDensity);
+  clContext.setKernelArg(KERNEL_REDUCE_STATS, 4, sizeof(cl_uint), &nbParts);
+  clContext.runKernel(KERNEL_REDUCE_STATS, NB_STATS_GROUPS * NB_STATS_ITEMS, NB_STATS_ITEMS);
+
+  slot.update = update;
+  slot.nbParticles = nbParticles;
+  slot.isReady->store(false);
+
+  auto isReady = slot.isReady;
+  slot.isInFlight = clContext.unloadBufferFromDevice("s_partialStats", 0, 4 * sizeof(float) * NB_STATS_GROUPS, slot.partialStats.data(),
+      [isReady]() { isReady->store(true); });
+
+  m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+}
+
+void Statistics::collect()
+{
+  // Oldest slot first, history stays ordered even if callbacks are not
+  for (size_t i = 0; i < m_slots.size(); ++i)
+  {
+    Slot& slot = m_slots[(m_nextSlot + i) % m_slots.size()];
+    if (!slot.isInFlight)
+      continue;
+    if (!slot.isReady->load())
+      break;
+
+    std::array<float, 4> stats = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (const auto& partialStats : slot.partialStats)
+    {
+      stats[0] += partialStats[0];
+      stats[1] += partialStats[1];
+      stats[2] = std::max(stats[2], partialStats[2]);
+      stats[3] += partialStats[3];
+    }
+
+    const float nbParticles = (float)std::max(slot.nbParticles, (size_t)1);
+
+    SimulationStats simulationStats;
+    simulationStats.update = slot.update;
+    simulationStats.meanDensityError = m_hasDensity ? stats[0] / nbParticles : 0.0f;
+    simulationStats.meanKineticEnergy = stats[1] / nbParticles;
+    simulationStats.maxSpeed = stats[2];
+    simulationStats.cloudCoverage = m_hasThermo ? stats[3] / nbParticles : 0.0f;
+
+    m_history.push_back(simulationStats);
+    if (m_history.size() > STATS_HISTORY_SIZE)
+      m_history.pop_front();
+
+    slot.isInFlight = false;
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Physics
+{
+// Physical diagnostics of a model update, null for quantities the model does not have
+struct SimulationStats
+{
+  size_t update = 0;
+  float meanDensityError = 0.0f;
+  // Per unit mass
+  float meanKineticEnergy = 0.0f;
+  float maxSpeed = 0.0f;
+  // Ratio of particles holding cloud droplets
+  float cloudCoverage = 0.0f;
+};
+
+// Statistics of the particle buffers reduced on device at each update, read back into a host ring without blocking
+// Read backs signal their completion through a callback, stats are only collected once complete
+// so that monitoring never stalls the pipeline
+class Statistics
+{
+  public:
+  // Density and thermo buffers are optional, OpenCL resources are scoped by the given namespace
+  Statistics(const std::string& nameSpace, const std::string& velBufferName, const std::string& densityBufferName = "", const std::string& thermoBufferName = "");
+  ~Statistics() = default;
+
+  // Build the program in background, it is shared by all the models
+  static void PrebuildProgram();
+
+  // Reduce the particles currently in device buffers, skipped if every slot of the ring is still being read back
+  void record(size_t nbParticles, float restDensity = 1.0f);
+
+  // Stats of the most recently completed update
+  bool hasStats() const { return !m_history.empty(); }
+  const SimulationStats& latest() const { return m_history.back(); }
+  // Oldest first
+  const std::deque<SimulationStats>& history() const { return m_history; }
+
+  bool hasDensity() const { return m_hasDensity; }
+  bool hasThermo() const { return m_hasThermo; }
+
+  private:
+  bool createProgram() const;
+  bool createBuffers() const;
+  bool createKernels(const std::string& velBufferName, const std::string& densityBufferName, const std::string& thermoBufferName) const;
+
+  // Move completed read backs to the history
+  void collect();
+
+  struct Slot
+  {
+    std::vector<std::array<float, 4>> partialStats;
+    size_t update = 0;
+    size_t nbParticles = 0;
+    bool isInFlight = false;
+    // Set from the OpenCL callback thread, shared as the callback can be called after the ring is destroyed
+    std::shared_ptr<std::atomic<bool>> isReady;
+  };
+  std::string m_namespace;
+
+  std::vector<Slot> m_slots;
+  size_t m_nextSlot;
+
+  size_t m_nbUpdates;
+
+  bool m_hasDensity;
+  bool m_hasThermo;
+
+  std::deque<SimulationStats> m_history;
+
+  bool m_init;
+};
+}
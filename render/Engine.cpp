@@ -2,9 +2,13 @@
 #include "GLSL.hpp"
 #include "Logging.hpp"
 #include "Math.hpp"
+#include "Tracing.hpp"
 
 using namespace Render;
 
+// Number of frames in flight before their queries are read back
+#define NB_QUERY_FRAMES 3
+
 Engine::Engine(EngineParams params)
     : m_maxNbParticles(params.maxNbParticles)
     , m_nbParticles(params.currNbParticles)
@@ -15,6 +19,10 @@ Engine::Engine(EngineParams params)
     , m_isGridVisible(false)
     , m_targetPos({ 0.0f, 0.0f, 0.0f })
     , m_dimension(params.dimension)
+    , m_currentFrameQueries(0)
+    , m_isTimingSupported(false)
+    , m_isTimingEnabled(false)
+    , m_isFrameTimed(false)
 {
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_PROGRAM_POINT_SIZE);
@@ -37,10 +45,19 @@ Engine::Engine(EngineParams params)
   initGrid();
 
   initTarget();
+
+  initQueries();
 }
 
 Engine::~Engine()
 {
+  for (auto& frameQueries : m_frameQueries)
+  {
+    glDeleteQueries(NB_RENDER_PASSES, frameQueries.timeQueries.data());
+    glDeleteQueries(NB_RENDER_PASSES, frameQueries.startQueries.data());
+    glDeleteQueries(1, &frameQueries.samplesQuery);
+  }
+
   glDeleteBuffers(1, &m_pointCloudCoordVBO);
   glDeleteBuffers(1, &m_pointCloudColorVBO);
   glDeleteBuffers(1, &m_box2DVBO);
@@ -86,25 +103,173 @@ void Engine::initPointCloud()
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+void Engine::initQueries()
+{
+  // Timer queries are core since OpenGL 3.3, the context being created with a 3.0 minimum
+  m_isTimingSupported = (GLAD_GL_VERSION_3_3 != 0);
+  if (!m_isTimingSupported)
+  {
+    LOG_INFO("GPU timer queries not supported, render passes cannot be timed");
+    return;
+  }
+
+  m_frameQueries.resize(NB_QUERY_FRAMES);
+  for (auto& frameQueries : m_frameQueries)
+  {
+    glGenQueries(NB_RENDER_PASSES, frameQueries.timeQueries.data());
+    glGenQueries(NB_RENDER_PASSES, frameQueries.startQueries.data());
+    glGenQueries(1, &frameQueries.samplesQuery);
+    frameQueries.isPassIssued.fill(false);
+    frameQueries.nbParticles = 0;
+    frameQueries.isIssued = false;
+  }
+}
+
+void Engine::enableTiming(bool enable)
+{
+  m_isTimingEnabled = enable && m_isTimingSupported;
+
+  if (!m_isTimingEnabled)
+    m_renderStats = RenderStats();
+}
+
 void Engine::draw()
 {
   loadCameraPos();
 
+  // Last frames of a trace are collected while it is being written
+  m_isFrameTimed = m_isTimingSupported && (m_isTimingEnabled || Utils::Tracer::Get().isBusy());
+  if (m_isFrameTimed)
+  {
+    collectQueries();
+
+    // Results of the slot not available after a full ring of frames are dropped
+    FrameQueries& frameQueries = m_frameQueries[m_currentFrameQueries];
+    frameQueries.isPassIssued.fill(false);
+    frameQueries.nbParticles = m_nbParticles;
+    frameQueries.isIssued = true;
+  }
+
+  TRACE_SCOPE("drawScene");
+
   if (m_isBoxVisible)
+  {
+    beginPass(RenderPass::BOX_PASS);
     drawBox();
+    endPass(RenderPass::BOX_PASS);
+  }
 
   if (m_isGridVisible)
+  {
+    beginPass(RenderPass::GRID_PASS);
     drawGrid();
+    endPass(RenderPass::GRID_PASS);
+  }
 
+  beginPass(RenderPass::POINT_CLOUD_PASS);
   drawPointCloud();
+  endPass(RenderPass::POINT_CLOUD_PASS);
 
   if (m_isTargetVisible)
+  {
+    beginPass(RenderPass::TARGET_PASS);
     drawTarget();
+    endPass(RenderPass::TARGET_PASS);
+  }
+
+  if (m_isFrameTimed)
+    m_currentFrameQueries = (m_currentFrameQueries + 1) % m_frameQueries.size();
 
   glFlush();
   glFinish();
 }
 
+void Engine::beginPass(RenderPass pass)
+{
+  if (!m_isFrameTimed)
+    return;
+
+  FrameQueries& frameQueries = m_frameQueries[m_currentFrameQueries];
+  glQueryCounter(frameQueries.startQueries[pass], GL_TIMESTAMP);
+  glBeginQuery(GL_TIME_ELAPSED, frameQueries.timeQueries[pass]);
+
+  // Samples counted for points only, the other passes being negligible lines
+  if (pass == RenderPass::POINT_CLOUD_PASS)
+    glBeginQuery(GL_SAMPLES_PASSED, frameQueries.samplesQuery);
+}
+
+void Engine::endPass(RenderPass pass)
+{
+  if (!m_isFrameTimed)
+    return;
+
+  if (pass == RenderPass::POINT_CLOUD_PASS)
+    glEndQuery(GL_SAMPLES_PASSED);
+
+  glEndQuery(GL_TIME_ELAPSED);
+
+  m_frameQueries[m_currentFrameQueries].isPassIssued[pass] = true;
+}
+
+void Engine::collectQueries()
+{
+  Utils::Tracer& tracer = Utils::Tracer::Get();
+
+  // GPU clock sampled along with host one, converting pass timestamps to host time
+  GLint64 gpuTimeNs = 0;
+  if (tracer.isBusy())
+    glGetInteger64v(GL_TIMESTAMP, &gpuTimeNs);
+  const double hostTimeUs = tracer.nowUs();
+
+  for (size_t i = 0; i < m_frameQueries.size(); ++i)
+  {
+    FrameQueries& frameQueries = m_frameQueries[(m_currentFrameQueries + i) % m_frameQueries.size()];
+    if (!frameQueries.isIssued)
+      continue;
+
+    // Queries complete in order, the samples one ending before the last pass of the frame
+    GLuint lastQuery = frameQueries.samplesQuery;
+    for (size_t pass = 0; pass < NB_RENDER_PASSES; ++pass)
+    {
+      if (frameQueries.isPassIssued[pass])
+        lastQuery = frameQueries.timeQueries[pass];
+    }
+
+    GLuint isAvailable = GL_FALSE;
+    glGetQueryObjectuiv(lastQuery, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+    if (isAvailable == GL_FALSE)
+      break;
+
+    RenderStats renderStats;
+    for (size_t pass = 0; pass < NB_RENDER_PASSES; ++pass)
+    {
+      if (!frameQueries.isPassIssued[pass])
+        continue;
+
+      GLuint64 elapsedTime = 0;
+      glGetQueryObjectui64v(frameQueries.timeQueries[pass], GL_QUERY_RESULT, &elapsedTime);
+      renderStats.passTimesMs[pass] = (float)(elapsedTime * 1e-06);
+
+      if (gpuTimeNs > 0)
+      {
+        GLuint64 startTime = 0;
+        glGetQueryObjectui64v(frameQueries.startQueries[pass], GL_QUERY_RESULT, &startTime);
+        const double startUs = hostTimeUs + (double)((GLint64)startTime - gpuTimeNs) * 1e-03;
+        tracer.addTrackSpan("OpenGL device", ALL_RENDER_PASSES.at((RenderPass)pass), "gl_device", startUs, startUs + elapsedTime * 1e-03);
+      }
+    }
+
+    GLuint64 nbSamples = 0;
+    glGetQueryObjectui64v(frameQueries.samplesQuery, GL_QUERY_RESULT, &nbSamples);
+    renderStats.nbPointSamples = (unsigned long long)nbSamples;
+    renderStats.nbParticles = frameQueries.nbParticles;
+    renderStats.isValid = true;
+
+    m_renderStats = renderStats;
+    frameQueries.isIssued = false;
+  }
+}
+
 void Engine::loadCameraPos()
 {
   if (!m_camera)
@@ -6,7 +6,9 @@
 
 #include <array>
 #include <glad/glad.h>
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace Render
@@ -18,6 +20,34 @@ enum class UserAction
   ZOOM
 };
 
+// Draw passes of a frame, timed separately on GPU
+enum RenderPass
+{
+  BOX_PASS,
+  GRID_PASS,
+  POINT_CLOUD_PASS,
+  TARGET_PASS,
+  NB_RENDER_PASSES
+};
+
+static const std::map<RenderPass, std::string> ALL_RENDER_PASSES {
+  { RenderPass::BOX_PASS, "Box" },
+  { RenderPass::GRID_PASS, "Grid" },
+  { RenderPass::POINT_CLOUD_PASS, "Point cloud" },
+  { RenderPass::TARGET_PASS, "Target" },
+};
+
+// GPU cost of the last frame whose timer queries are available, a few frames behind the current one
+struct RenderStats
+{
+  // Negative for passes not drawn in that frame
+  std::array<float, NB_RENDER_PASSES> passTimesMs = { -1.0f, -1.0f, -1.0f, -1.0f };
+  // Samples written by the point cloud, MSAA samples included, growing with point size and overdraw
+  unsigned long long nbPointSamples = 0;
+  size_t nbParticles = 0;
+  bool isValid = false;
+};
+
 struct EngineParams
 {
   size_t currNbParticles = 0;
@@ -58,7 +88,7 @@ class Engine
       m_camera->setSceneAspectRatio((float)windowSize.x / windowSize.y);
   }
 
-  inline void setNbParticles(int nbParticles) { m_nbParticles = nbParticles; }
+  inline void setNbParticles(size_t nbParticles) { m_nbParticles = nbParticles; }
 
   inline size_t getPointSize() { return m_pointSize; }
   inline void setPointSize(size_t pointSize) { m_pointSize = pointSize; }
@@ -77,6 +107,12 @@ class Engine
 
   inline void setTargetPos(const Math::float3& pos) { m_targetPos = pos; }
 
+  // Requires OpenGL 3.3 timer queries, results being read without stalling once available
+  inline bool isTimingSupported() const { return m_isTimingSupported; }
+  inline bool isTimingEnabled() const { return m_isTimingEnabled; }
+  void enableTiming(bool enable);
+  inline const RenderStats& renderStats() const { return m_renderStats; }
+
   void setDimension(Geometry::Dimension dim) { m_dimension = dim; }
   Geometry::Dimension dimension() const { return m_dimension; }
 
@@ -102,6 +138,12 @@ class Engine
 
   void loadCameraPos();
 
+  void initQueries();
+  void beginPass(RenderPass pass);
+  void endPass(RenderPass pass);
+  // Read the results of previous frames that are available, oldest first
+  void collectQueries();
+
   void initCamera(float sceneAspectRatio);
 
   const GLuint m_pointCloudPosAttribIndex { 0 };
@@ -141,6 +183,25 @@ class Engine
 
   std::unique_ptr<Camera> m_camera;
 
+  // Ring of queries, a frame being read back a few frames later
+  struct FrameQueries
+  {
+    std::array<GLuint, NB_RENDER_PASSES> timeQueries;
+    // Timestamps of the start of the passes, placing them on the trace timeline
+    std::array<GLuint, NB_RENDER_PASSES> startQueries;
+    std::array<bool, NB_RENDER_PASSES> isPassIssued;
+    GLuint samplesQuery;
+    size_t nbParticles;
+    bool isIssued;
+  };
+  std::vector<FrameQueries> m_frameQueries;
+  size_t m_currentFrameQueries;
+  bool m_isTimingSupported;
+  bool m_isTimingEnabled;
+  // Queries are issued when timing is enabled or a trace is captured
+  bool m_isFrameTimed;
+  RenderStats m_renderStats;
+
   Geometry::Dimension m_dimension;
 
   void* m_pointCloudCoordsBufferStart;
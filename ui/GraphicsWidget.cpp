@@ -45,5 +45,36 @@ void UI::GraphicsWidget::display()
   {
     m_graphicsEngine->setPointSize((size_t)pointSize);
   }
+
+  if (m_graphicsEngine->isTimingSupported())
+  {
+    ImGui::Spacing();
+
+    bool isTimingEnabled = m_graphicsEngine->isTimingEnabled();
+    if (ImGui::Checkbox(" GPU Timing ", &isTimingEnabled))
+    {
+      m_graphicsEngine->enableTiming(isTimingEnabled);
+    }
+
+    const Render::RenderStats& renderStats = m_graphicsEngine->renderStats();
+    if (isTimingEnabled && renderStats.isValid)
+    {
+      float totalTimeMs = 0.0f;
+      for (const auto& pass : Render::ALL_RENDER_PASSES)
+      {
+        const float passTimeMs = renderStats.passTimesMs[pass.first];
+        if (passTimeMs < 0.0f)
+          continue;
+
+        ImGui::Text(" %s %.3f ms", pass.second.c_str(), passTimeMs);
+        totalTimeMs += passTimeMs;
+      }
+      ImGui::Text(" Render total %.3f ms", totalTimeMs);
+
+      // Samples per particle grow with point size, overlapping points with blending all being shaded
+      const float samplesPerParticle = (renderStats.nbParticles > 0) ? (float)renderStats.nbPointSamples / renderStats.nbParticles : 0.0f;
+      ImGui::Text(" Point samples %llu (%.1f per particle)", renderStats.nbPointSamples, samplesPerParticle);
+    }
+  }
   ImGui::End();
 }
\ No newline at end of file
@@ -8,6 +8,10 @@
 
 #include <imgui.h>
 
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
 void displayBoundaryConditions(Physics::Model* engine)
 {
   if (!engine)
@@ -102,6 +106,19 @@ void displayCloudsParameters(Physics::Clouds* cloudsEngine)
     cloudsEngine->setNbJacobiIters((size_t)nbJacobiIters);
   }
 
+  // Time step is split over the substeps, more substeps make the step more accurate and more expensive
+  int nbSubsteps = (int)cloudsEngine->getNbSubsteps();
+  if (ImGui::SliderInt("Nb Substeps", &nbSubsteps, 1, 4))
+  {
+    cloudsEngine->setNbSubsteps((size_t)nbSubsteps);
+  }
+
+  bool isWarmStartEnabled = cloudsEngine->isWarmStartEnabled();
+  if (ImGui::Checkbox("Warm Start", &isWarmStartEnabled))
+  {
+    cloudsEngine->enableWarmStart(isWarmStartEnabled);
+  }
+
   bool isArtPressureEnabled = cloudsEngine->isArtPressureEnabled();
   if (ImGui::Checkbox("Enable Artificial Pressure", &isArtPressureEnabled))
   {
@@ -158,6 +175,24 @@ void displayCloudsParameters(Physics::Clouds* cloudsEngine)
     cloudsEngine->enableTempSmoothing(isTempSmoothingEnabled);
   }
 
+  if (isTempSmoothingEnabled)
+  {
+    bool isTempGridSmoothingEnabled = cloudsEngine->isTempGridSmoothingEnabled();
+    if (ImGui::Checkbox("Smooth Temperature On Grid", &isTempGridSmoothingEnabled))
+    {
+      cloudsEngine->enableTempGridSmoothing(isTempGridSmoothingEnabled);
+    }
+
+    if (isTempGridSmoothingEnabled)
+    {
+      int nbTempGridIters = (int)cloudsEngine->getNbTempGridIters();
+      if (ImGui::SliderInt("Nb Grid Smoothing Iterations", &nbTempGridIters, 1, 16))
+      {
+        cloudsEngine->setNbTempGridIters((size_t)nbTempGridIters);
+      }
+    }
+  }
+
   float groundHeatCoeff = cloudsEngine->getGroundHeatCoeff();
   if (ImGui::SliderFloat("Ground Heat Coefficient", &groundHeatCoeff, 0.0f, 1000.0f, "%.4f"))
   {
@@ -265,6 +300,25 @@ void displayFluidsParameters(Physics::Fluids* fluidsEngine)
     fluidsEngine->setNbJacobiIters((size_t)nbJacobiIters);
   }
 
+  // Time step is split over the substeps, more substeps make the step more accurate and more expensive
+  int nbSubsteps = (int)fluidsEngine->getNbSubsteps();
+  if (ImGui::SliderInt("Nb Substeps", &nbSubsteps, 1, 4))
+  {
+    fluidsEngine->setNbSubsteps((size_t)nbSubsteps);
+  }
+
+  bool isWarmStartEnabled = fluidsEngine->isWarmStartEnabled();
+  if (ImGui::Checkbox("Warm Start", &isWarmStartEnabled))
+  {
+    fluidsEngine->enableWarmStart(isWarmStartEnabled);
+  }
+
+  bool isUnilateralConstraintEnabled = fluidsEngine->isUnilateralConstraintEnabled();
+  if (ImGui::Checkbox("Unilateral Constraint", &isUnilateralConstraintEnabled))
+  {
+    fluidsEngine->enableUnilateralConstraint(isUnilateralConstraintEnabled);
+  }
+
   bool isArtPressureEnabled = fluidsEngine->isArtPressureEnabled();
   if (ImGui::Checkbox("Enable Artificial Pressure", &isArtPressureEnabled))
   {
@@ -311,6 +365,71 @@ void displayFluidsParameters(Physics::Fluids* fluidsEngine)
     }
   }
 
+  // Ensemble mode, shared parameters above being overridden per instance
+  if (fluidsEngine->nbInstances() > 1)
+  {
+    ImGui::Spacing();
+    ImGui::Text("Instances");
+    ImGui::Spacing();
+
+    for (size_t instance = 0; instance < fluidsEngine->nbInstances(); ++instance)
+    {
+      ImGui::PushID((int)instance);
+      if (ImGui::TreeNode("Instance", "Instance %d", (int)instance))
+      {
+        auto instanceParams = fluidsEngine->getInstanceParams(instance);
+
+        bool isChanged = ImGui::SliderFloat("Rest Density", &instanceParams[0], 10.0f, 1000.0f);
+        isChanged |= ImGui::SliderFloat("Relax CFM", &instanceParams[1], 100.0f, 1000.f);
+        isChanged |= ImGui::SliderFloat("Vorticity Coefficient", &instanceParams[2], 0.0f, 0.001f, "%.4f");
+        isChanged |= ImGui::SliderFloat("Viscosity Coefficient", &instanceParams[3], 0.0f, 0.001f, "%.4f");
+        if (isChanged)
+        {
+          fluidsEngine->setInstanceParams(instance, instanceParams[0], instanceParams[1], instanceParams[2], instanceParams[3]);
+        }
+
+        ImGui::TreePop();
+      }
+      ImGui::PopID();
+    }
+  }
+
+  ImGui::Spacing();
+  ImGui::Text("Sleeping particles");
+  ImGui::Spacing();
+
+  bool isSleepingEnabled = fluidsEngine->isSleepingEnabled();
+  if (ImGui::Checkbox("Enable Sleeping", &isSleepingEnabled))
+  {
+    fluidsEngine->enableSleeping(isSleepingEnabled);
+  }
+  if (isSleepingEnabled)
+  {
+    ImGui::Value("Active particles", (int)fluidsEngine->nbActiveParticles());
+  }
+
+  ImGui::Spacing();
+  ImGui::Text("Blow-up detection");
+  ImGui::Spacing();
+
+  const auto healthCheck = fluidsEngine->getHealthCheck();
+  if (ImGui::BeginCombo("Health check", Physics::Fluids::ALL_HEALTH_CHECKS.at(healthCheck).c_str()))
+  {
+    for (const auto& check : Physics::Fluids::ALL_HEALTH_CHECKS)
+    {
+      if (ImGui::Selectable(check.second.c_str(), healthCheck == check.first))
+        fluidsEngine->setHealthCheck(check.first);
+    }
+    ImGui::EndCombo();
+  }
+  if (healthCheck != Physics::Fluids::HealthCheck::DISABLED)
+  {
+    const auto& health = fluidsEngine->lastHealth();
+    ImGui::Value("Non finite particles", (int)health.nbNonFiniteParts);
+    ImGui::Value("Speed capped particles", (int)health.nbSpeedCappedParts);
+    ImGui::Value("Wall clamps", (int)health.nbWallClamps);
+  }
+
   ImGui::End();
 }
 
@@ -348,6 +467,10 @@ void displayBoidsParameters(Physics::Boids* boidsEngine)
   {
     for (const auto& nbParticlesPair : Utils::ALL_NB_PARTICLES)
     {
+      // Only sizes fitting in the allocated buffers
+      if (nbParticlesPair.first > boidsEngine->maxNbParticles())
+        break;
+
       if (ImGui::Selectable(nbParticlesPair.second.name.c_str(), nbParticles == nbParticlesPair.first))
       {
         boidsEngine->setNbParticles(nbParticlesPair.first);
@@ -466,6 +589,36 @@ void displayBoidsParameters(Physics::Boids* boidsEngine)
   ImGui::End();
 }
 
+void displayStatistics(const Physics::Model* engine)
+{
+  const Physics::Statistics* statistics = engine ? engine->statistics() : nullptr;
+  if (!statistics || !statistics->hasStats())
+    return;
+
+  ImGui::Begin("Statistics Widget", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+  // Stats of the last completed updates, the device may already be a few updates ahead
+  const auto& history = statistics->history();
+  const auto plotStat = [&history](const char* label, float Physics::SimulationStats::*stat)
+  {
+    std::vector<float> values(history.size());
+    std::transform(history.cbegin(), history.cend(), values.begin(), [stat](const Physics::SimulationStats& stats) { return stats.*stat; });
+
+    const std::string overlay = std::to_string(values.back());
+    ImGui::PlotLines(label, values.data(), (int)values.size(), 0, overlay.c_str(), FLT_MAX, FLT_MAX, ImVec2(250, 50));
+  };
+
+  ImGui::Value("Update", (int)statistics->latest().update);
+  if (statistics->hasDensity())
+    plotStat("Mean density error", &Physics::SimulationStats::meanDensityError);
+  plotStat("Mean kinetic energy", &Physics::SimulationStats::meanKineticEnergy);
+  plotStat("Max speed", &Physics::SimulationStats::maxSpeed);
+  if (statistics->hasThermo())
+    plotStat("Cloud coverage", &Physics::SimulationStats::cloudCoverage);
+
+  ImGui::End();
+}
+
 void UI::PhysicsWidget::display()
 {
   auto physicsEngine = m_physicsEngine.lock();
@@ -486,4 +639,6 @@ void UI::PhysicsWidget::display()
     displayFluidsParameters(fluidsEngine);
   else if (cloudsEngine)
     displayCloudsParameters(cloudsEngine);
+
+  displayStatistics(physicsEngine.get());
 }
\ No newline at end of file
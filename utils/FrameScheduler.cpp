@@ -0,0 +1,133 @@
+#include "FrameScheduler.hpp"
+
+#include <algorithm>
+#include <thread>
+
+using namespace Utils;
+
+// Part of the wait spent spinning rather than sleeping, OS sleep can overshoot by about a millisecond
+constexpr auto SPIN_MARGIN = std::chrono::microseconds(1500);
+
+namespace
+{
+FrameScheduler::Clock::duration PeriodFromRate(int rate)
+{
+  return std::chrono::duration_cast<FrameScheduler::Clock::duration>(std::chrono::duration<double>(1.0 / std::max(rate, 1)));
+}
+
+float ToMs(FrameScheduler::Clock::duration duration)
+{
+  return std::chrono::duration<float, std::milli>(duration).count();
+}
+}
+
+FrameScheduler::FrameScheduler(int physicsRate, int renderRate)
+    : m_physicsRate(physicsRate)
+    , m_renderRate(renderRate)
+    , m_isVsyncEnabled(false)
+    , m_refreshRate(60)
+    , m_physicsPeriod(PeriodFromRate(physicsRate))
+    , m_renderPeriod(PeriodFromRate(renderRate))
+    , m_nextPhysicsDeadline(Clock::now())
+    , m_nextRenderDeadline(Clock::now())
+    , m_lastPhysicsStep(Clock::now())
+    , m_lastRenderedFrame(Clock::now())
+{
+}
+
+void FrameScheduler::setPhysicsRate(int rate)
+{
+  if (rate == m_physicsRate)
+    return;
+
+  m_physicsRate = rate;
+  m_physicsPeriod = PeriodFromRate(rate);
+  m_nextPhysicsDeadline = std::min(m_nextPhysicsDeadline, Clock::now() + m_physicsPeriod);
+}
+
+void FrameScheduler::setRenderRate(int rate)
+{
+  if (rate == m_renderRate)
+    return;
+
+  m_renderRate = rate;
+  m_renderPeriod = PeriodFromRate(rate);
+  m_nextRenderDeadline = std::min(m_nextRenderDeadline, Clock::now() + m_renderPeriod);
+}
+
+void FrameScheduler::setVsync(bool isEnabled, int refreshRate)
+{
+  m_isVsyncEnabled = isEnabled;
+  m_refreshRate = (refreshRate > 0) ? refreshRate : 60;
+}
+
+bool FrameScheduler::isRenderPacedByVsync() const
+{
+  return m_isVsyncEnabled && m_renderRate >= m_refreshRate;
+}
+
+bool FrameScheduler::isPhysicsStepDue()
+{
+  const auto now = Clock::now();
+
+  if (now < m_nextPhysicsDeadline)
+    return false;
+
+  const auto lateness = now - m_nextPhysicsDeadline;
+  m_stats.maxPhysicsLatenessMs = std::max(m_stats.maxPhysicsLatenessMs, ToMs(lateness));
+
+  // Dropping the deadlines we are too late for, the cadence stays aligned on the original schedule
+  const auto nbMissed = (size_t)(lateness / m_physicsPeriod);
+  m_stats.nbMissedPhysicsDeadlines += nbMissed;
+  m_nextPhysicsDeadline += (nbMissed + 1) * m_physicsPeriod;
+
+  m_stats.physicsStepIntervalMs = ToMs(now - m_lastPhysicsStep);
+  m_lastPhysicsStep = now;
+  ++m_stats.nbPhysicsSteps;
+
+  return true;
+}
+
+bool FrameScheduler::isRenderDue()
+{
+  const auto now = Clock::now();
+
+  if (!isRenderPacedByVsync())
+  {
+    if (now < m_nextRenderDeadline)
+      return false;
+
+    const auto nbMissed = (size_t)((now - m_nextRenderDeadline) / m_renderPeriod);
+    m_stats.nbMissedRenderDeadlines += nbMissed;
+    m_nextRenderDeadline += (nbMissed + 1) * m_renderPeriod;
+  }
+  else if (now - m_lastRenderedFrame > 2 * PeriodFromRate(m_refreshRate))
+  {
+    // Swap did not return within two vertical blanks, a refresh has been missed
+    ++m_stats.nbMissedRenderDeadlines;
+  }
+
+  m_stats.renderFrameIntervalMs = ToMs(now - m_lastRenderedFrame);
+  m_lastRenderedFrame = now;
+  ++m_stats.nbRenderedFrames;
+
+  return true;
+}
+
+void FrameScheduler::waitForNextDeadline() const
+{
+  // Swap blocks until next vertical blank, waiting here would only delay next frame
+  if (isRenderPacedByVsync())
+    return;
+
+  sleepUntil(std::min(m_nextPhysicsDeadline, m_nextRenderDeadline));
+}
+
+void FrameScheduler::sleepUntil(Clock::time_point deadline) const
+{
+  if (Clock::now() + SPIN_MARGIN < deadline)
+    std::this_thread::sleep_until(deadline - SPIN_MARGIN);
+
+  while (Clock::now() < deadline)
+    std::this_thread::yield();
+}
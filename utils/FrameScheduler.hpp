@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace Utils
+{
+// Deadline statistics, reset with the scheduler
+struct FrameStats
+{
+  size_t nbPhysicsSteps = 0;
+  // Physics deadlines skipped because the previous step or frame took too long
+  size_t nbMissedPhysicsDeadlines = 0;
+  size_t nbRenderedFrames = 0;
+  size_t nbMissedRenderDeadlines = 0;
+  // Measured interval between the two last physics steps, in ms
+  float physicsStepIntervalMs = 0.0f;
+  // Measured interval between the two last rendered frames, in ms
+  float renderFrameIntervalMs = 0.0f;
+  // Worst delay observed between a physics deadline and the start of its step, in ms
+  float maxPhysicsLatenessMs = 0.0f;
+};
+
+// Paces the main loop with separate physics and render rates
+// Instead of spinning, the calling thread sleeps until the next deadline and only spins for the last fraction of it,
+// as OS sleep granularity is coarser than the targeted accuracy.
+// With vsync, buffer swap already blocks until vertical blank, render is then paced by the swap
+class FrameScheduler
+{
+  public:
+  using Clock = std::chrono::steady_clock;
+
+  FrameScheduler(int physicsRate = 60, int renderRate = 60);
+  ~FrameScheduler() = default;
+
+  void setPhysicsRate(int rate);
+  int physicsRate() const { return m_physicsRate; }
+
+  void setRenderRate(int rate);
+  int renderRate() const { return m_renderRate; }
+
+  // Refresh rate of the display is needed to know if swap alone is enough to pace rendering
+  void setVsync(bool isEnabled, int refreshRate);
+  bool isVsyncEnabled() const { return m_isVsyncEnabled; }
+
+  // True once per physics deadline, late deadlines are dropped instead of being caught up
+  bool isPhysicsStepDue();
+  // True once per render deadline, or always if rendering is paced by vsync
+  bool isRenderDue();
+
+  // Sleep until the closest deadline
+  void waitForNextDeadline() const;
+
+  const FrameStats& stats() const { return m_stats; }
+  void resetStats() { m_stats = FrameStats(); }
+
+  private:
+  bool isRenderPacedByVsync() const;
+  void sleepUntil(Clock::time_point deadline) const;
+
+  int m_physicsRate;
+  int m_renderRate;
+
+  bool m_isVsyncEnabled;
+  int m_refreshRate;
+
+  Clock::duration m_physicsPeriod;
+  Clock::duration m_renderPeriod;
+
+  Clock::time_point m_nextPhysicsDeadline;
+  Clock::time_point m_nextRenderDeadline;
+
+  Clock::time_point m_lastPhysicsStep;
+  Clock::time_point m_lastRenderedFrame;
+
+  FrameStats m_stats;
+};
+}
@@ -1,6 +1,7 @@
 
 #include "Geometry.hpp"
 #include "Logging.hpp"
+#include <algorithm>
 #include <cmath>
 
 namespace Geometry
@@ -14,13 +15,13 @@ std::vector<Math::float3> Generate2DGrid(Shape2D shape, Plane plane,
     return std::vector<Math::float3>();
   }
 
-  if (gridRes.x * gridRes.y <= 0)
+  if (gridRes.x <= 0 || gridRes.y <= 0)
   {
     LOG_ERROR("Cannot generate grid with negative or null number of vertices");
     return std::vector<Math::float3>();
   }
 
-  std::vector<Math::float3> verts(gridRes.x * gridRes.y, Math::float3(0.0f, 0.0f, 0.0f));
+  std::vector<Math::float3> verts((size_t)gridRes.x * gridRes.y, Math::float3(0.0f, 0.0f, 0.0f));
 
   switch (shape)
   {
@@ -46,13 +47,13 @@ std::vector<Math::float3> Generate3DGrid(Shape3D shape,
     return std::vector<Math::float3>();
   }
 
-  if (gridRes.x * gridRes.y * gridRes.z <= 0)
+  if (gridRes.x <= 0 || gridRes.y <= 0 || gridRes.z <= 0)
   {
     LOG_ERROR("Cannot generate grid with negative or null number of vertices");
     return std::vector<Math::float3>();
   }
 
-  std::vector<Math::float3> verts(gridRes.x * gridRes.y * gridRes.z, Math::float3(0.0f, 0.0f, 0.0f));
+  std::vector<Math::float3> verts((size_t)gridRes.x * gridRes.y * gridRes.z, Math::float3(0.0f, 0.0f, 0.0f));
 
   switch (shape)
   {
@@ -70,7 +71,7 @@ std::vector<Math::float3> Generate3DGrid(Shape3D shape,
 
 void GenerateRectangularGrid(Plane plane, std::vector<Math::float3>& verts, Math::int2 gridRes, Math::float3 gridStartPos, Math::float3 gridEndPos, Distribution distribution)
 {
-  int nbVertices = gridRes.x * gridRes.y;
+  size_t nbVertices = (size_t)gridRes.x * gridRes.y;
 
   if (verts.size() < nbVertices)
   {
@@ -102,7 +103,7 @@ void GenerateRectangularGrid(Plane plane, std::vector<Math::float3>& verts, Math
     break;
   }
 
-  int vertIndex = 0;
+  size_t vertIndex = 0;
   if (distribution == Distribution::Uniform)
   {
     for (int ix = 0; ix < gridResExt.x; ++ix)
@@ -122,7 +123,7 @@ void GenerateRectangularGrid(Plane plane, std::vector<Math::float3>& verts, Math
   }
   else if (distribution == Distribution::Random)
   {
-    for (int i = 0; i < nbVertices; ++i)
+    for (size_t i = 0; i < nbVertices; ++i)
     {
       verts[vertIndex++] = {
         (float)rand() / (float)RAND_MAX * vec.x + gridStartPos.x,
@@ -146,7 +147,7 @@ void GenerateCircularGrid(Plane plane, std::vector<Math::float3>& verts, Math::i
   float radius = Math::length(vec) / 2.0f;
   float angleSpacing = 2.0f * Math::PI_F / gridRes.x;
   float radiusSpacing = radius / gridRes.y;
-  int vertIndex = 0;
+  size_t vertIndex = 0;
 
   switch (plane)
   {
@@ -197,7 +198,7 @@ void GenerateCircularGrid(Plane plane, std::vector<Math::float3>& verts, Math::i
 
 void GenerateBoxGrid(std::vector<Math::float3>& verts, Math::int3 gridRes, Math::float3 gridStartPos, Math::float3 gridEndPos, Distribution distribution)
 {
-  int nbVertices = gridRes.x * gridRes.y * gridRes.z;
+  size_t nbVertices = (size_t)gridRes.x * gridRes.y * gridRes.z;
 
   if (verts.size() < nbVertices)
   {
@@ -208,7 +209,7 @@ void GenerateBoxGrid(std::vector<Math::float3>& verts, Math::int3 gridRes, Math:
   Math::float3 vec = gridEndPos - gridStartPos;
   Math::float3 gridSpacing = Math::float3({ vec.x / gridRes.x, vec.y / gridRes.y, vec.z / gridRes.z });
 
-  int vertIndex = 0;
+  size_t vertIndex = 0;
   if (distribution == Distribution::Uniform)
   {
     for (int ix = 0; ix < gridRes.x; ++ix)
@@ -228,7 +229,7 @@ void GenerateBoxGrid(std::vector<Math::float3>& verts, Math::int3 gridRes, Math:
   }
   else if (distribution == Distribution::Random)
   {
-    for (int i = 0; i < nbVertices; ++i)
+    for (size_t i = 0; i < nbVertices; ++i)
     {
       verts[vertIndex++] = {
         (float)rand() / (float)RAND_MAX * vec.x + gridStartPos.x,
@@ -241,7 +242,7 @@ void GenerateBoxGrid(std::vector<Math::float3>& verts, Math::int3 gridRes, Math:
 
 void GenerateSphereGrid(std::vector<Math::float3>& verts, Math::int3 gridRes, Math::float3 gridStartPos, Math::float3 gridEndPos)
 {
-  if (verts.size() < gridRes.x * gridRes.y * gridRes.z)
+  if (verts.size() < (size_t)gridRes.x * gridRes.y * gridRes.z)
   {
     LOG_ERROR("Cannot generate grid with this resolution");
     return;
@@ -254,7 +255,7 @@ void GenerateSphereGrid(std::vector<Math::float3>& verts, Math::int3 gridRes, Ma
   float thetaSpacing = 2.0f * Math::PI_F / gridRes.y;
   float radiusSpacing = radius / gridRes.z;
 
-  int vertIndex = 0;
+  size_t vertIndex = 0;
   for (int iphi = 0; iphi < gridRes.x; ++iphi)
   {
     for (int itheta = 0; itheta < gridRes.y; ++itheta)
@@ -270,4 +271,15 @@ void GenerateSphereGrid(std::vector<Math::float3>& verts, Math::int3 gridRes, Ma
     }
   }
 }
-}
\ No newline at end of file
+
+BoxSize3D ComputeGridRes(BoxSize3D boxSize, float effectRadius)
+{
+  // Smallest side sets the cell size, a bit bigger than the effect radius if it does not divide the side
+  const size_t minSide = std::min({ boxSize.x, boxSize.y, boxSize.z });
+  const size_t minSideRes = std::max((size_t)std::floor(minSide / effectRadius + 1e-3f), (size_t)1);
+  const float cellSize = (float)minSide / minSideRes;
+
+  // Other sides are expected to be multiples of the smallest one, cells stay cubic
+  return { (size_t)std::round(boxSize.x / cellSize), (size_t)std::round(boxSize.y / cellSize), (size_t)std::round(boxSize.z / cellSize) };
+}
+}
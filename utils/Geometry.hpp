@@ -49,9 +49,15 @@ struct BoxSize3D
 // Dimensions of the bounding box where the particles evolve
 static constexpr BoxSize3D BOX_SIZE_3D = { 10, 10, 10 };
 
-// Resolution of the cells forming the 3D grid containing all the particles
+// Resolution of the cells forming the 3D grid containing all the particles, for the reference number of particles
 static constexpr BoxSize3D GRID_RES_3D = { 30, 30, 30 };
 
+// Radius of the particle effect for the reference number of particles, equal to the grid cell size
+static constexpr float REF_EFFECT_RADIUS = (float)BOX_SIZE_3D.x / GRID_RES_3D.x;
+
+// Resolution of the grid whose cells are as big as the effect radius, so that neighbours are found in adjacent cells only
+BoxSize3D ComputeGridRes(BoxSize3D boxSize, float effectRadius);
+
 // 3D Box
 using Vertex3D = std::array<float, 3>;
 static constexpr std::array<Vertex3D, 8> RefCubeVertices {
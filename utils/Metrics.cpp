@@ -0,0 +1,326 @@
+#include "Metrics.hpp"
+
+#include "Logging.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+#define CLOSE_SOCKET closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+#define CLOSE_SOCKET close
+#endif
+
+// Clients closing their connection early must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+using namespace Utils;
+
+// Metrics file is rotated once bigger, older files being suffixed by .1, .2...
+#define METRICS_FILE_MAX_SIZE (4 * 1024 * 1024)
+#define METRICS_FILE_NB_ROTATIONS 3
+// Delay after which the listener checks if it must stop, when no client connects or sends its request
+#define LISTEN_TIMEOUT_MS 200
+#define MAX_REQUEST_SIZE 1024
+
+namespace
+{
+const char* TypeName(MetricType type)
+{
+  return (type == MetricType::COUNTER) ? "counter" : "gauge";
+}
+}
+
+MetricsExporter::~MetricsExporter()
+{
+  stop();
+}
+
+Metric& MetricsExporter::metric(const std::string& name, MetricType type, const std::string& help, const std::string& labels)
+{
+  std::lock_guard<std::mutex> lock(m_entriesMutex);
+
+  const std::string key = name + "{" + labels + "}";
+  auto it = m_entriesByKey.find(key);
+  if (it != m_entriesByKey.end())
+    return it->second->metric;
+
+  m_entries.emplace_back();
+  MetricEntry& entry = m_entries.back();
+  entry.name = name;
+  entry.type = type;
+  entry.help = help;
+  entry.labels = labels;
+  m_entriesByKey[key] = &entry;
+
+  return entry.metric;
+}
+
+void MetricsExporter::removeMetrics(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(m_entriesMutex);
+
+  for (auto it = m_entries.begin(); it != m_entries.end();)
+  {
+    if (it->name != name)
+    {
+      ++it;
+      continue;
+    }
+
+    m_entriesByKey.erase(it->name + "{" + it->labels + "}");
+    it = m_entries.erase(it);
+  }
+}
+
+bool MetricsExporter::start(int port, const std::string& filePath, std::chrono::milliseconds period)
+{
+  if (m_isRunning)
+    return true;
+
+  if (port != 0 && !openListener(port))
+    return false;
+
+  m_filePath = filePath;
+  m_period = period;
+  m_isRunning = true;
+
+  m_publishThread = std::thread(&MetricsExporter::publishLoop, this);
+  if (port != 0)
+    m_listenThread = std::thread(&MetricsExporter::listenLoop, this);
+
+  LOG_INFO("Metrics published every {} ms{}{}", period.count(),
+      filePath.empty() ? "" : " to " + filePath,
+      (port != 0) ? " on http://127.0.0.1:" + std::to_string(port) + "/metrics" : "");
+
+  return true;
+}
+
+void MetricsExporter::stop()
+{
+  if (!m_isRunning)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_stopMutex);
+    m_isRunning = false;
+  }
+  m_stopCondition.notify_all();
+
+  if (m_publishThread.joinable())
+    m_publishThread.join();
+  if (m_listenThread.joinable())
+    m_listenThread.join();
+
+  closeListener();
+}
+
+std::string MetricsExporter::serialize(bool hasTimestamps) const
+{
+  const auto timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+  std::lock_guard<std::mutex> lock(m_entriesMutex);
+
+  // Samples of a same metric name must be grouped under their HELP and TYPE lines
+  std::map<std::string, std::vector<const MetricEntry*>> entriesByName;
+  for (const auto& entry : m_entries)
+    entriesByName[entry.name].push_back(&entry);
+
+  std::ostringstream text;
+  for (const auto& namedEntries : entriesByName)
+  {
+    const MetricEntry& first = *namedEntries.second.front();
+    text << "# HELP " << first.name << " " << first.help << "\n";
+    text << "# TYPE " << first.name << " " << TypeName(first.type) << "\n";
+
+    for (const MetricEntry* entry : namedEntries.second)
+    {
+      text << entry->name;
+      if (!entry->labels.empty())
+        text << "{" << entry->labels << "}";
+      text << " " << entry->metric.value();
+      if (hasTimestamps)
+        text << " " << timestampMs;
+      text << "\n";
+    }
+  }
+
+  return text.str();
+}
+
+void MetricsExporter::publishLoop()
+{
+  std::unique_lock<std::mutex> lock(m_stopMutex);
+  while (m_isRunning)
+  {
+    lock.unlock();
+
+    const std::string snapshot = serialize();
+    {
+      std::lock_guard<std::mutex> snapshotLock(m_snapshotMutex);
+      m_lastSnapshot = snapshot;
+    }
+
+    if (!m_filePath.empty())
+      appendToFile(serialize(true));
+
+    lock.lock();
+    m_stopCondition.wait_for(lock, m_period, [this]() { return !m_isRunning; });
+  }
+}
+
+void MetricsExporter::appendToFile(const std::string& text)
+{
+  std::error_code error;
+  if (std::filesystem::exists(m_filePath, error) && std::filesystem::file_size(m_filePath, error) > METRICS_FILE_MAX_SIZE)
+  {
+    // Oldest file is dropped, then each one is shifted
+    std::filesystem::remove(m_filePath + "." + std::to_string(METRICS_FILE_NB_ROTATIONS), error);
+    for (int rotation = METRICS_FILE_NB_ROTATIONS - 1; rotation > 0; --rotation)
+      std::filesystem::rename(m_filePath + "." + std::to_string(rotation), m_filePath + "." + std::to_string(rotation + 1), error);
+    std::filesystem::rename(m_filePath, m_filePath + ".1", error);
+  }
+
+  std::ofstream file(m_filePath, std::ios::app);
+  if (!file.is_open())
+  {
+    LOG_ERROR("Cannot write metrics to {}", m_filePath);
+    return;
+  }
+
+  file << text;
+}
+
+bool MetricsExporter::openListener(int port)
+{
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+  {
+    LOG_ERROR("Cannot initialize sockets for metrics listener");
+    return false;
+  }
+#endif
+
+  SocketHandle listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenSocket == (SocketHandle)-1)
+  {
+    LOG_ERROR("Cannot create socket for metrics listener");
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return false;
+  }
+
+  int reuse = 1;
+  setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+  // Local only, metrics are scraped by an agent running next to the job
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons((unsigned short)port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(listenSocket, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, 4) != 0)
+  {
+    LOG_ERROR("Cannot listen on port {} for metrics", port);
+    CLOSE_SOCKET(listenSocket);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return false;
+  }
+
+  m_listenSocket = (long long)listenSocket;
+
+  return true;
+}
+
+void MetricsExporter::closeListener()
+{
+  if (m_listenSocket == -1)
+    return;
+
+  CLOSE_SOCKET((SocketHandle)m_listenSocket);
+  m_listenSocket = -1;
+
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+void MetricsExporter::listenLoop()
+{
+  const SocketHandle listenSocket = (SocketHandle)m_listenSocket;
+
+  while (m_isRunning)
+  {
+    // Waiting with a timeout to notice stop requests
+    fd_set readSockets;
+    FD_ZERO(&readSockets);
+    FD_SET(listenSocket, &readSockets);
+    timeval timeout = { 0, LISTEN_TIMEOUT_MS * 1000 };
+
+    if (select((int)listenSocket + 1, &readSockets, nullptr, nullptr, &timeout) <= 0)
+      continue;
+
+    SocketHandle clientSocket = accept(listenSocket, nullptr, nullptr);
+    if (clientSocket == (SocketHandle)-1)
+      continue;
+
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(clientSocket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+    // Clients silent after connecting are dropped, a blocking read would also block stop requests
+    fd_set clientSockets;
+    FD_ZERO(&clientSockets);
+    FD_SET(clientSocket, &clientSockets);
+    timeout = { 0, LISTEN_TIMEOUT_MS * 1000 };
+
+    if (select((int)clientSocket + 1, &clientSockets, nullptr, nullptr, &timeout) <= 0)
+    {
+      CLOSE_SOCKET(clientSocket);
+      continue;
+    }
+
+    char request[MAX_REQUEST_SIZE] = {};
+    recv(clientSocket, request, MAX_REQUEST_SIZE - 1, 0);
+
+    std::string response;
+    if (std::string(request).rfind("GET /metrics", 0) == 0)
+    {
+      std::string body;
+      {
+        std::lock_guard<std::mutex> lock(m_snapshotMutex);
+        body = m_lastSnapshot;
+      }
+      response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(body.size())
+          + "\r\nConnection: close\r\n\r\n" + body;
+    }
+    else
+    {
+      response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+
+    send(clientSocket, response.data(), (int)response.size(), SEND_FLAGS);
+    CLOSE_SOCKET(clientSocket);
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Utils
+{
+// Value of a metric, updated without lock from the simulation thread and read from the publishing one
+class Metric
+{
+  public:
+  void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+  void add(double value)
+  {
+    double current = m_value.load(std::memory_order_relaxed);
+    while (!m_value.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+      ;
+  }
+  double value() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+  std::atomic<double> m_value { 0.0 };
+};
+
+enum class MetricType
+{
+  GAUGE,
+  COUNTER
+};
+
+// Metrics published in Prometheus text format by a background thread, to a rotating file and to a local HTTP listener
+// Registration takes a lock, returned metrics are meant to be kept by callers so that updating them costs a relaxed atomic store
+class MetricsExporter
+{
+  public:
+  MetricsExporter() = default;
+  ~MetricsExporter();
+
+  // Labels are given in Prometheus syntax without braces, e.g. kernel="fld_computeDensity"
+  // Same name, type and labels return the same metric
+  Metric& metric(const std::string& name, MetricType type, const std::string& help, const std::string& labels = "");
+  // All the metrics with this name are not published anymore, references to them must be dropped
+  void removeMetrics(const std::string& name);
+
+  // Serialized every period, appended to the file rotated once too big if filePath is not empty,
+  // and served on http://127.0.0.1:port/metrics if port is not 0
+  bool start(int port, const std::string& filePath, std::chrono::milliseconds period = std::chrono::milliseconds(1000));
+  void stop();
+  bool isRunning() const { return m_isRunning; }
+
+  // Text exposition format, timestamps being added to samples written to file
+  std::string serialize(bool hasTimestamps = false) const;
+
+  private:
+  void publishLoop();
+  void listenLoop();
+  void appendToFile(const std::string& text);
+  bool openListener(int port);
+  void closeListener();
+
+  struct MetricEntry
+  {
+    std::string name;
+    MetricType type;
+    std::string help;
+    std::string labels;
+    Metric metric;
+  };
+  // Entries are never moved once created, references to their metric stay valid until they are removed
+  std::list<MetricEntry> m_entries;
+  std::map<std::string, MetricEntry*> m_entriesByKey;
+  mutable std::mutex m_entriesMutex;
+
+  // Last serialization, served to HTTP clients
+  std::string m_lastSnapshot;
+  std::mutex m_snapshotMutex;
+
+  std::string m_filePath;
+  std::chrono::milliseconds m_period { 1000 };
+
+  // Socket handle, kept as an integer to keep system headers out of this one
+  long long m_listenSocket = -1;
+
+  std::atomic<bool> m_isRunning { false };
+  // Wakes up the publishing thread when stopping
+  std::mutex m_stopMutex;
+  std::condition_variable m_stopCondition;
+  std::thread m_publishThread;
+  std::thread m_listenThread;
+};
+}
@@ -1,7 +1,9 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <map>
 #include <string>
 #include <utility>
@@ -19,7 +21,14 @@ enum NbParticles
   P16K = 1 << 14,
   P32K = 1 << 15,
   P65K = 1 << 16,
-  P130K = 1 << 17
+  P130K = 1 << 17,
+  P262K = 1 << 18,
+  P524K = 1 << 19,
+  P1M = 1 << 20,
+  P2M = 1 << 21,
+  P4M = 1 << 22,
+  P8M = 1 << 23,
+  P16M = 1 << 24
 };
 
 struct CompareNbParticles
@@ -33,37 +42,90 @@ struct CompareNbParticles
 struct NbParticlesInfo
 {
   const std::string name;
-  const std::array<int, 2> subdiv2D;
-  const std::array<int, 3> subdiv3D;
 };
 
 static const std::map<NbParticles, NbParticlesInfo, CompareNbParticles> ALL_NB_PARTICLES {
-  { NbParticles::P512, { "512", { 32, 16 }, { 8, 8, 8 } } },
-  { NbParticles::P1K, { "1k", { 32, 32 }, { 16, 8, 8 } } },
-  { NbParticles::P4K, { "4k", { 64, 64 }, { 16, 16, 16 } } },
-  { NbParticles::P8K, { "8k", { 128, 64 }, { 32, 16, 16 } } },
-  { NbParticles::P16K, { "16k", { 128, 128 }, { 32, 32, 16 } } },
-  { NbParticles::P32K, { "32k", { 128, 256 }, { 32, 32, 32 } } },
-  { NbParticles::P65K, { "65k", { 256, 256 }, { 64, 32, 32 } } },
-  { NbParticles::P130K, { "130k", { 256, 512 }, { 64, 64, 32 } } }
+  { NbParticles::P512, { "512" } },
+  { NbParticles::P1K, { "1k" } },
+  { NbParticles::P4K, { "4k" } },
+  { NbParticles::P8K, { "8k" } },
+  { NbParticles::P16K, { "16k" } },
+  { NbParticles::P32K, { "32k" } },
+  { NbParticles::P65K, { "65k" } },
+  { NbParticles::P130K, { "130k" } },
+  { NbParticles::P262K, { "262k" } },
+  { NbParticles::P524K, { "524k" } },
+  { NbParticles::P1M, { "1M" } },
+  { NbParticles::P2M, { "2M" } },
+  { NbParticles::P4M, { "4M" } },
+  { NbParticles::P8M, { "8M" } },
+  { NbParticles::P16M, { "16M" } }
 };
 
-static std::array<int, 2> GetNbParticlesSubdiv2D(NbParticles nbParts)
+// Number of particles the initial cases, box and grid resolution are designed for
+// Bigger systems refine the initial lattices and the grid accordingly
+static constexpr size_t REF_NB_PARTICLES = NbParticles::P130K;
+
+// Buffers are sized for a multiple of this number of particles, as required by radix sort work partitioning
+static constexpr size_t NB_PARTICLES_GRANULARITY = 512;
+
+static size_t GetSupportedMaxNbParticles(size_t maxNbParticles)
+{
+  const size_t nbParts = std::max(maxNbParticles, REF_NB_PARTICLES);
+  return (nbParts + NB_PARTICLES_GRANULARITY - 1) / NB_PARTICLES_GRANULARITY * NB_PARTICLES_GRANULARITY;
+};
+
+static bool IsPowerOfTwo(size_t nbParts)
 {
-  const auto& it = ALL_NB_PARTICLES.find(nbParts);
-  if (it != ALL_NB_PARTICLES.end())
-    return it->second.subdiv2D;
-  else
+  return nbParts != 0 && (nbParts & (nbParts - 1)) == 0;
+};
+
+static int Log2(size_t nbParts)
+{
+  int log2 = 0;
+  while (nbParts >>= 1)
+    ++log2;
+  return log2;
+};
+
+// Lattice subdivisions as even as possible along each axis
+// Powers of two are split exactly, other numbers get the biggest lattice not exceeding them
+static std::array<int, 2> GetNbParticlesSubdiv2D(size_t nbParts)
+{
+  if (nbParts == 0)
     return { 0, 0 };
+
+  // Odd powers of two keep the orientation of the former table, wider than tall up to 8k and taller than wide from 32k
+  if (IsPowerOfTwo(nbParts))
+  {
+    const int log2 = Log2(nbParts);
+    const int longSubdiv = 1 << ((log2 + 1) / 2);
+    const int shortSubdiv = 1 << (log2 / 2);
+    if (nbParts >= NbParticles::P32K)
+      return { shortSubdiv, longSubdiv };
+    return { longSubdiv, shortSubdiv };
+  }
+
+  const int subdivX = std::max((int)std::round(std::sqrt((double)nbParts)), 1);
+  const int subdivY = std::max((int)(nbParts / subdivX), 1);
+  return { subdivX, subdivY };
 };
 
-static std::array<int, 3> GetNbParticlesSubdiv3D(NbParticles nbParts)
+static std::array<int, 3> GetNbParticlesSubdiv3D(size_t nbParts)
 {
-  const auto& it = ALL_NB_PARTICLES.find(nbParts);
-  if (it != ALL_NB_PARTICLES.end())
-    return it->second.subdiv3D;
-  else
+  if (nbParts == 0)
     return { 0, 0, 0 };
+
+  if (IsPowerOfTwo(nbParts))
+  {
+    const int log2 = Log2(nbParts);
+    return { 1 << ((log2 + 2) / 3), 1 << ((log2 + 1) / 3), 1 << (log2 / 3) };
+  }
+
+  const int subdivX = std::max((int)std::round(std::cbrt((double)nbParts)), 1);
+  const int subdivY = std::max((int)std::round(std::sqrt((double)nbParts / subdivX)), 1);
+  const int subdivZ = std::max((int)(nbParts / ((size_t)subdivX * subdivY)), 1);
+  return { subdivX, subdivY, subdivZ };
 };
 
-}
\ No newline at end of file
+}
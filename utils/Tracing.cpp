@@ -0,0 +1,196 @@
+#include "Tracing.hpp"
+
+#include "Logging.hpp"
+
+#include <fstream>
+#include <iomanip>
+
+using namespace Utils;
+
+// Single process in the trace, threads and tracks being told apart by id
+#define TRACE_PROCESS_ID 1
+
+namespace
+{
+// Names are kernel or pass names, only quotes and backslashes need escaping
+std::string EscapeJson(const std::string& text)
+{
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text)
+  {
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    escaped += c;
+  }
+  return escaped;
+}
+}
+
+Tracer& Tracer::Get()
+{
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer()
+    : m_startTime(Clock::now())
+    , m_nbThreads(0)
+    , m_isCapturing(false)
+    , m_nbPendingFrames(0)
+    , m_nbCapturedFrames(0)
+    , m_isWritePending(false)
+    , m_frameStartUs(0.0)
+{
+}
+
+void Tracer::requestCapture(size_t nbFrames, const std::string& filePath)
+{
+  if (isBusy() || nbFrames == 0)
+    return;
+
+  m_nbPendingFrames = nbFrames;
+  m_filePath = filePath;
+
+  LOG_INFO("Tracing the next {} frames to {}", nbFrames, filePath);
+}
+
+void Tracer::nextFrame()
+{
+  const double nowUs = this->nowUs();
+
+  if (m_isWritePending)
+  {
+    m_isWritePending = false;
+    if (write())
+      LOG_INFO("Trace of {} frames written to {}", m_nbCapturedFrames, m_filePath);
+    clearBuffers();
+  }
+
+  if (m_isCapturing)
+  {
+    addSpan("Frame " + std::to_string(m_nbCapturedFrames), "frame", m_frameStartUs, nowUs);
+    ++m_nbCapturedFrames;
+
+    if (--m_nbPendingFrames == 0)
+    {
+      m_isCapturing = false;
+      m_isWritePending = true;
+    }
+  }
+  else if (m_nbPendingFrames > 0 && !m_isWritePending)
+  {
+    clearBuffers();
+    m_nbCapturedFrames = 0;
+    m_isCapturing = true;
+  }
+
+  m_frameStartUs = nowUs;
+}
+
+double Tracer::nowUs() const
+{
+  return std::chrono::duration<double, std::micro>(Clock::now() - m_startTime).count();
+}
+
+void Tracer::addSpan(const std::string& name, const char* category, double startUs, double endUs)
+{
+  TraceBuffer& buffer = threadBuffer();
+
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.events.push_back({ name, category, startUs, endUs - startUs });
+}
+
+void Tracer::addTrackSpan(const std::string& trackName, const std::string& name, const char* category, double startUs, double endUs)
+{
+  TraceBuffer* buffer = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    auto it = m_trackBuffers.find(trackName);
+    if (it == m_trackBuffers.end())
+      it = m_trackBuffers.emplace(trackName, &createBuffer(trackName)).first;
+    buffer = it->second;
+  }
+
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  buffer->events.push_back({ name, category, startUs, endUs - startUs });
+}
+
+Tracer::TraceBuffer& Tracer::threadBuffer()
+{
+  // Registered at the first span of each thread
+  thread_local TraceBuffer* buffer = nullptr;
+  if (buffer == nullptr)
+  {
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    buffer = &createBuffer((m_nbThreads == 0) ? "Main thread" : "Thread " + std::to_string(m_nbThreads));
+    ++m_nbThreads;
+  }
+  return *buffer;
+}
+
+Tracer::TraceBuffer& Tracer::createBuffer(const std::string& name)
+{
+  // Called with the buffers mutex held
+  auto buffer = std::make_unique<TraceBuffer>();
+  buffer->name = name;
+  buffer->id = m_buffers.size() + 1;
+  m_buffers.push_back(std::move(buffer));
+
+  return *m_buffers.back();
+}
+
+void Tracer::clearBuffers()
+{
+  std::lock_guard<std::mutex> lock(m_buffersMutex);
+  for (auto& buffer : m_buffers)
+  {
+    std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+    buffer->events.clear();
+  }
+}
+
+bool Tracer::write() const
+{
+  std::ofstream file(m_filePath);
+  if (!file.is_open())
+  {
+    LOG_ERROR("Cannot write trace to {}", m_filePath);
+    return false;
+  }
+
+  // Microseconds with a fixed precision, long runs would lose sub-millisecond accuracy otherwise
+  file << std::fixed << std::setprecision(3);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+  bool isFirstEvent = true;
+  const auto separator = [&isFirstEvent]()
+  {
+    const char* separator = isFirstEvent ? "" : ",\n";
+    isFirstEvent = false;
+    return separator;
+  };
+
+  std::lock_guard<std::mutex> lock(m_buffersMutex);
+  for (const auto& buffer : m_buffers)
+  {
+    std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+
+    // Metadata naming the thread or track, kept in creation order
+    file << separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << TRACE_PROCESS_ID << ",\"tid\":" << buffer->id
+         << ",\"args\":{\"name\":\"" << EscapeJson(buffer->name) << "\"}}";
+    file << separator() << "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":" << TRACE_PROCESS_ID << ",\"tid\":" << buffer->id
+         << ",\"args\":{\"sort_index\":" << buffer->id << "}}";
+
+    for (const auto& event : buffer->events)
+    {
+      file << separator() << "{\"name\":\"" << EscapeJson(event.name) << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\""
+           << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs
+           << ",\"pid\":" << TRACE_PROCESS_ID << ",\"tid\":" << buffer->id << "}";
+    }
+  }
+
+  file << "\n]}\n";
+
+  return true;
+}
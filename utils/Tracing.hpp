@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Utils
+{
+// Timeline of CPU and device spans over a window of frames, written in Chrome trace JSON format,
+// readable by chrome://tracing and Perfetto
+// Spans are only recorded while capturing, each thread appending to its own buffer,
+// device spans being converted to host time by their producer
+class Tracer
+{
+  public:
+  using Clock = std::chrono::steady_clock;
+
+  static Tracer& Get();
+
+  // Capture starts with the next frame and is written to filePath once nbFrames frames are complete
+  void requestCapture(size_t nbFrames, const std::string& filePath);
+  bool isCapturing() const { return m_isCapturing.load(std::memory_order_relaxed); }
+  // Capture requested or being written
+  bool isBusy() const { return m_isCapturing || m_nbPendingFrames > 0 || m_isWritePending; }
+
+  // Frame boundary, called once per frame by the main loop
+  void nextFrame();
+
+  // Microseconds since the creation of the tracer, the time base of all spans
+  double nowUs() const;
+
+  // Span on the calling thread
+  void addSpan(const std::string& name, const char* category, double startUs, double endUs);
+  // Span on a named track, for timelines of devices
+  void addTrackSpan(const std::string& trackName, const std::string& name, const char* category, double startUs, double endUs);
+
+  private:
+  Tracer();
+  ~Tracer() = default;
+
+  struct TraceEvent
+  {
+    std::string name;
+    const char* category;
+    double startUs;
+    double durationUs;
+  };
+  // Events of a thread or a track, only contended while being written
+  struct TraceBuffer
+  {
+    std::string name;
+    size_t id;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+  };
+
+  TraceBuffer& threadBuffer();
+  TraceBuffer& createBuffer(const std::string& name);
+  void clearBuffers();
+  bool write() const;
+
+  Clock::time_point m_startTime;
+
+  // Owned here, outliving the threads they are registered for
+  std::deque<std::unique_ptr<TraceBuffer>> m_buffers;
+  std::map<std::string, TraceBuffer*> m_trackBuffers;
+  size_t m_nbThreads;
+  mutable std::mutex m_buffersMutex;
+
+  std::atomic<bool> m_isCapturing;
+  // Frames waiting for the capture to start or to end
+  size_t m_nbPendingFrames;
+  size_t m_nbCapturedFrames;
+  // Written one frame after the window, device spans of the last frame being collected during that frame
+  bool m_isWritePending;
+  double m_frameStartUs;
+  std::string m_filePath;
+};
+
+// CPU span covering the scope, free when not capturing
+class ScopedTrace
+{
+  public:
+  ScopedTrace(const char* name, const char* category = "cpu")
+      : m_name(name)
+      , m_category(category)
+      , m_startUs(Tracer::Get().isCapturing() ? Tracer::Get().nowUs() : -1.0)
+  {
+  }
+  ~ScopedTrace()
+  {
+    if (m_startUs >= 0.0)
+      Tracer::Get().addSpan(m_name, m_category, m_startUs, Tracer::Get().nowUs());
+  }
+
+  private:
+  const char* m_name;
+  const char* m_category;
+  double m_startUs;
+};
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(...) Utils::ScopedTrace TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)